@@ -0,0 +1,411 @@
+#include "benchmark.hpp"
+
+#include <limits>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <utility>
+#include <iomanip>
+#include <iostream>
+
+#include "../labutils/error.hpp"
+#include "../labutils/vkutil.hpp"
+#include "../labutils/to_string.hpp"
+#include "../labutils/gltf_model.hpp"
+#include "../labutils/upload_context.hpp"
+namespace lut = labutils;
+
+
+namespace
+{
+	using Clock_ = std::chrono::steady_clock;
+
+	namespace cfg
+	{
+		// --render: the colour target drawn instead of a swapchain image
+		constexpr VkFormat kOffscreenFormat = VK_FORMAT_R8G8B8A8_SRGB;
+	}
+
+	// Colour image for rendering without a swapchain.
+	std::tuple<lut::Image, lut::ImageView> create_color_target(lut::VulkanContext const&, VkExtent2D, VkFormat, lut::Allocator const&);
+
+	std::string json_string(char const* aText)
+	{
+		std::string ret = "\"";
+		for (char const* c = aText; *c; ++c)
+		{
+			if ('"' == *c || '\\' == *c)
+				ret += '\\';
+			ret += *c;
+		}
+		return ret + "\"";
+	}
+
+	double total_ms(std::vector<lut::GpuProfiler::Sample> const& aPasses)
+	{
+		double ms = 0.0;
+		for (auto const& pass : aPasses)
+			ms += pass.ms;
+		return ms;
+	}
+
+	void print_json_passes(std::ostream& aOut, std::vector<lut::GpuProfiler::Sample> const& aPasses)
+	{
+		aOut << '{';
+		for (std::size_t i = 0; i < aPasses.size(); ++i)
+			aOut << (i ? ", " : " ") << json_string(aPasses[i].name) << ": " << aPasses[i].ms;
+		aOut << (aPasses.empty() ? "}" : " }");
+	}
+}
+
+int run_headless_benchmark(BenchmarkOptions const& aOptions)
+{
+	std::vector<BenchmarkRow> rows;
+	std::vector<lut::GpuProfiler::PassTime> gpuAverages;
+	double loadMs = 0.0;
+	VkPhysicalDeviceProperties deviceProps{};
+
+	{
+		labutils::GltfModel model;
+		auto const loadStart = Clock_::now();
+		if (!model.loadFromFile(aOptions.modelPath, aOptions.weldParts))
+			throw lut::Error("Unable to load model '%s'", aOptions.modelPath);
+		loadMs = std::chrono::duration<double, std::milli>(Clock_::now() - loadStart).count();
+
+		// no surface and no swapchain; the graphics queue does the compute too
+		lut::VulkanContext context = lut::make_vulkan_context();
+		vkGetPhysicalDeviceProperties(context.physicalDevice, &deviceProps);
+
+		lut::Allocator allocator = lut::create_allocator(context);
+		lut::UploadContext uploads(context, allocator);
+		lut::DescriptorPool dpool = lut::create_descriptor_pool(context);
+		lut::CommandPool cpool = lut::create_command_pool(context, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+		VkCommandBuffer cmd = lut::alloc_command_buffer(context, cpool.handle);
+
+		SubdivisionPipelines const subdiv = create_subdivision_pipelines(context, dpool.handle);
+
+		// every submission is waited for, so one slot does
+		lut::GpuProfiler profiler(context, 1);
+
+		// Offscreen target, looked at from the front of the cage's bounding
+		// sphere so that the whole model is drawn
+		VkExtent2D const extent = aOptions.renderExtent;
+		bool const render = extent.width > 0 && extent.height > 0;
+
+		lut::RenderPass renderPass;
+		lut::DescriptorSetLayout sceneLayout;
+		lut::PipelineLayout pipeLayout;
+		lut::Pipeline quadPipe, wirePipe;
+		lut::Image colorImage, depthImage;
+		lut::ImageView colorView, depthView;
+		lut::Framebuffer framebuffer;
+		lut::Buffer sceneUBO;
+		VkDescriptorSet sceneDescriptors = VK_NULL_HANDLE;
+		glsl::SceneUniform sceneUniforms{};
+		if (render)
+		{
+			renderPass = create_render_pass(context, cfg::kOffscreenFormat, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+			sceneLayout = create_scene_descriptor_layout(context);
+			pipeLayout = create_pipeline_layout(context, sceneLayout.handle);
+			quadPipe = create_model_pipeline2(context, extent, renderPass.handle, pipeLayout.handle);
+			wirePipe = create_wireframe_pipeline22(context, extent, renderPass.handle, pipeLayout.handle);
+
+			std::tie(colorImage, colorView) = create_color_target(context, extent, cfg::kOffscreenFormat, allocator);
+			std::tie(depthImage, depthView) = create_depth_buffer(context, extent, allocator);
+
+			VkImageView attachments[2] = { colorView.handle, depthView.handle };
+			VkFramebufferCreateInfo fbInfo{};
+			fbInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			fbInfo.renderPass = renderPass.handle;
+			fbInfo.attachmentCount = 2;
+			fbInfo.pAttachments = attachments;
+			fbInfo.width = extent.width;
+			fbInfo.height = extent.height;
+			fbInfo.layers = 1;
+
+			VkFramebuffer fb = VK_NULL_HANDLE;
+			if (auto const res = vkCreateFramebuffer(context.device, &fbInfo, nullptr, &fb); VK_SUCCESS != res)
+			{
+				throw lut::Error("Unable to create offscreen framebuffer\n"
+					"vkCreateFramebuffer() returned %s", lut::to_string(res).c_str());
+			}
+			framebuffer = lut::Framebuffer(context.device, fb);
+
+			sceneUBO = lut::create_buffer(
+				allocator,
+				sizeof(glsl::SceneUniform),
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				0,
+				VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE
+			);
+			sceneDescriptors = lut::alloc_desc_set(context, dpool.handle, sceneLayout.handle);
+
+			VkDescriptorBufferInfo sceneUboInfo{};
+			sceneUboInfo.buffer = sceneUBO.buffer;
+			sceneUboInfo.range = VK_WHOLE_SIZE;
+
+			VkWriteDescriptorSet desc{};
+			desc.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			desc.dstSet = sceneDescriptors;
+			desc.dstBinding = 0;
+			desc.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			desc.descriptorCount = 1;
+			desc.pBufferInfo = &sceneUboInfo;
+			vkUpdateDescriptorSets(context.device, 1, &desc, 0, nullptr);
+
+			glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+			for (auto const& v : model.m_vertices)
+			{
+				lo = glm::min(lo, v.pos);
+				hi = glm::max(hi, v.pos);
+			}
+			update_scene_uniforms(sceneUniforms, extent.width, extent.height, frame_bounds(lo, hi));
+		}
+
+		for (std::uint32_t repeat = 0; repeat < aOptions.repeats; ++repeat)
+		{
+			if (model.subTime > 0)
+			{
+				model.restoreLevel(lut::GltfModel::LevelState{});
+				model.subTime = 0;
+			}
+
+			SubdivisionMesh subMeshes[2];
+			int curr = 0;
+			int next = 1;
+
+			for (std::uint32_t level = 1; level <= aOptions.levels; ++level)
+			{
+				BenchmarkRow row{};
+				row.repeat = repeat;
+				LevelReport& report = row.report;
+
+				// the same steps as the viewer's, without its caches
+				if (model.subTime == 0 || !aOptions.gpu)
+				{
+					report.mode = "CPU";
+					report.verticesBefore = model.m_quadVertices.size();
+					report.facesBefore = model.m_mesh.face_count();
+					report.edgesBefore = model.m_edgeList.size();
+
+					auto const cpuStart = Clock_::now();
+					if (model.subTime == 0)
+						model.firstSubdivision();
+					else
+						model.subdivideQuadOnce();
+					auto const cpuEnd = Clock_::now();
+					report.refineMs = std::chrono::duration<double, std::milli>(cpuEnd - cpuStart).count();
+
+					if (aOptions.limit)
+					{
+						std::vector<glm::vec3> limitPositions, limitNormals;
+						model.evaluateLimitSurface(limitPositions, limitNormals);
+						subMeshes[curr] = create_model_buffer(allocator, uploads, model, &limitPositions, &limitNormals);
+					}
+					else
+						subMeshes[curr] = create_model_buffer(allocator, uploads, model);
+					subMeshes[next] = SubdivisionMesh{};
+					uploads.flush();
+					report.uploadMs = std::chrono::duration<double, std::milli>(Clock_::now() - cpuEnd).count();
+				}
+				else
+				{
+					report.mode = "GPU";
+					report.verticesBefore = subMeshes[curr].vertexCount;
+					report.facesBefore = subMeshes[curr].faceCount;
+					report.edgesBefore = subMeshes[curr].edgeCount;
+
+					auto const allocStart = Clock_::now();
+					subMeshes[next] = create_empty_buffer(context, allocator,
+						subMeshes[curr].vertexCount,
+						subMeshes[curr].edgeCount,
+						subMeshes[curr].faceCount);
+					auto const gpuStart = Clock_::now();
+					report.uploadMs = std::chrono::duration<double, std::milli>(gpuStart - allocStart).count();
+
+					update_subdivision_descriptors(context, subdiv.passes, subMeshes[curr], subMeshes[next]);
+					if (aOptions.limit)
+						update_limit_descriptors(context, subdiv.limit.descriptors, subMeshes[next]);
+					dispatch_subdivision_passes(cmd, subMeshes[curr], subMeshes[next], subdiv.passes, aOptions.limit ? &subdiv.limit : nullptr, &profiler, 0);
+					submit_and_wait_for_compute(context, context.graphicsQueue, cmd);
+					report.refineMs = std::chrono::duration<double, std::milli>(Clock_::now() - gpuStart).count();
+					profiler.collect(0, &report.gpuPasses);
+
+					// the parent is not needed again
+					std::swap(curr, next);
+					subMeshes[next] = SubdivisionMesh{};
+				}
+
+				model.subTime++;
+				report.level = model.subTime;
+				if (aOptions.limit && aOptions.gpu && report.level > 1 && repeat == 0)
+					warn_semi_sharp_limit(model.initial_sharpness, report.level);
+				report.vertices = subMeshes[curr].vertexCount;
+				report.faces = subMeshes[curr].faceCount;
+				report.edges = subMeshes[curr].edgeCount;
+
+				row.hostBytes = model.saveLevel().byte_size();
+				row.meshBytes = device_bytes(allocator, subMeshes[curr]);
+				VmaTotalStatistics stats{};
+				vmaCalculateStatistics(allocator.allocator, &stats);
+				row.allocatedBytes = stats.total.statistics.allocationBytes;
+
+				if (render)
+				{
+					rc_draw_quads(
+						cmd,
+						renderPass.handle,
+						framebuffer.handle,
+						quadPipe.handle,
+						wirePipe.handle,
+						extent,
+						subMeshes[curr].drawVertices.buffer,
+						subMeshes[curr].drawNormals.buffer,
+						subMeshes[curr].drawIndices.buffer,
+						subMeshes[curr].drawLinelists.buffer,
+						subMeshes[curr].faceCount * 6,
+						subMeshes[curr].edgeCount * 2,
+						sceneUBO.buffer,
+						sceneUniforms,
+						pipeLayout.handle,
+						sceneDescriptors,
+						nullptr,
+						nullptr,
+						&profiler,
+						0
+					);
+					auto const renderStart = Clock_::now();
+					submit_and_wait_for_compute(context, context.graphicsQueue, cmd);
+					row.renderMs = std::chrono::duration<double, std::milli>(Clock_::now() - renderStart).count();
+					profiler.collect(0, &row.renderPasses);
+				}
+
+				std::fprintf(stderr, "repeat %u, level %d (%s): %.3f ms\n", repeat, report.level, report.mode, report.refineMs);
+				rows.push_back(row);
+			}
+		}
+
+		vkDeviceWaitIdle(context.device);
+		gpuAverages = profiler.passes();
+	}
+
+	if (aOptions.csv)
+		print_benchmark_csv(std::cout, rows);
+	else
+		print_benchmark_json(std::cout, aOptions, deviceProps.deviceName, loadMs, rows, gpuAverages);
+
+	return 0;
+}
+
+void print_benchmark_csv(std::ostream& aOut, std::vector<BenchmarkRow> const& aRows)
+{
+	aOut << "repeat,level,mode,refine_ms,upload_ms,render_ms,gpu_refine_ms,gpu_render_ms,vertices,faces,edges,host_bytes,mesh_bytes,allocated_bytes\n";
+	aOut << std::fixed << std::setprecision(3);
+	for (auto const& row : aRows)
+	{
+		aOut << row.repeat << ',' << row.report.level << ',' << row.report.mode << ','
+			<< row.report.refineMs << ',' << row.report.uploadMs << ',' << row.renderMs << ','
+			<< total_ms(row.report.gpuPasses) << ',' << total_ms(row.renderPasses) << ','
+			<< row.report.vertices << ',' << row.report.faces << ',' << row.report.edges << ','
+			<< row.hostBytes << ',' << row.meshBytes << ',' << row.allocatedBytes << '\n';
+	}
+}
+
+void print_benchmark_json(std::ostream& aOut, BenchmarkOptions const& aOptions, char const* aDeviceName, double aLoadMs,
+	std::vector<BenchmarkRow> const& aRows, std::vector<lut::GpuProfiler::PassTime> const& aGpuAverages)
+{
+	aOut << std::fixed << std::setprecision(3);
+	aOut << "{\n";
+	aOut << "  \"model\": " << json_string(aOptions.modelPath) << ",\n";
+	aOut << "  \"device\": " << json_string(aDeviceName) << ",\n";
+	aOut << "  \"subdivision\": \"" << (aOptions.gpu ? "GPU" : "CPU") << "\",\n";
+	aOut << "  \"limit\": " << (aOptions.limit ? "true" : "false") << ",\n";
+	aOut << "  \"render\": ";
+	if (aOptions.renderExtent.width > 0)
+		aOut << '"' << aOptions.renderExtent.width << 'x' << aOptions.renderExtent.height << "\",\n";
+	else
+		aOut << "null,\n";
+	aOut << "  \"loadMs\": " << aLoadMs << ",\n";
+	aOut << "  \"levels\": [\n";
+	for (std::size_t i = 0; i < aRows.size(); ++i)
+	{
+		auto const& row = aRows[i];
+		aOut << "    { \"repeat\": " << row.repeat << ", \"level\": " << row.report.level
+			<< ", \"mode\": \"" << row.report.mode << '"'
+			<< ", \"refineMs\": " << row.report.refineMs << ", \"uploadMs\": " << row.report.uploadMs
+			<< ", \"renderMs\": " << row.renderMs
+			<< ", \"vertices\": " << row.report.vertices << ", \"faces\": " << row.report.faces << ", \"edges\": " << row.report.edges
+			<< ", \"hostBytes\": " << row.hostBytes << ", \"meshBytes\": " << row.meshBytes << ", \"allocatedBytes\": " << row.allocatedBytes
+			<< ", \"gpuPasses\": ";
+		print_json_passes(aOut, row.report.gpuPasses);
+		aOut << ", \"renderPasses\": ";
+		print_json_passes(aOut, row.renderPasses);
+		aOut << " }" << (i + 1 < aRows.size() ? "," : "") << '\n';
+	}
+	aOut << "  ],\n";
+	aOut << "  \"gpuAverages\": [\n";
+	for (std::size_t i = 0; i < aGpuAverages.size(); ++i)
+	{
+		auto const& pass = aGpuAverages[i];
+		aOut << "    { \"name\": " << json_string(pass.name.c_str()) << ", \"averageMs\": " << pass.averageMs
+			<< ", \"samples\": " << pass.samples << " }" << (i + 1 < aGpuAverages.size() ? "," : "") << '\n';
+	}
+	aOut << "  ]\n";
+	aOut << "}\n";
+}
+
+namespace
+{
+	std::tuple<lut::Image, lut::ImageView> create_color_target(lut::VulkanContext const& aContext, VkExtent2D aExtent, VkFormat aFormat, lut::Allocator const& aAllocator)
+	{
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = aFormat;
+		imageInfo.extent.width = aExtent.width;
+		imageInfo.extent.height = aExtent.height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		VmaAllocationCreateInfo allocInfo{};
+		allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+		VkImage image = VK_NULL_HANDLE;
+		VmaAllocation allocation = VK_NULL_HANDLE;
+
+		if (auto const res = vmaCreateImage(aAllocator.allocator, &imageInfo, &allocInfo, &image, &allocation, nullptr); VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to allocate offscreen colour image.\n"
+				"vmaCreateImage() returned %s", lut::to_string(res).c_str());
+		}
+
+		lut::Image colorImage(aAllocator.allocator, image, allocation);
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = colorImage.image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = aFormat;
+		viewInfo.components = VkComponentMapping{};
+		viewInfo.subresourceRange = VkImageSubresourceRange{
+			VK_IMAGE_ASPECT_COLOR_BIT,
+			0, 1,
+			0, 1
+		};
+
+		VkImageView view = VK_NULL_HANDLE;
+		if (auto const res = vkCreateImageView(aContext.device, &viewInfo, nullptr, &view); VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to create image view\n"
+				"vkCreateImageView() returned %s", lut::to_string(res).c_str());
+		}
+
+		return { std::move(colorImage), lut::ImageView(aContext.device, view) };
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <iosfwd>
+#include <vector>
+#include <cstdint>
+
+#include <volk/volk.h>
+
+#include "../labutils/gpu_profiler.hpp"
+
+#include "renderer.hpp"
+
+
+// --headless: refines the model level by level without a window, on the
+// CPU or (after the first level) on the GPU chain, optionally draws every
+// level into an offscreen image, and prints one row per level and repeat
+// on stdout. Whatever else is printed on the way goes to stderr. The
+// topology cache is not used, so every repeat refines from the cage.
+struct BenchmarkOptions
+{
+	char const* modelPath = nullptr;    // glTF or GLB
+	std::uint32_t levels = 0;
+	std::uint32_t repeats = 1;
+	bool gpu = false;
+	bool limit = false;
+	bool weldParts = false;
+	bool csv = false;                   // JSON otherwise
+	VkExtent2D renderExtent{ 0, 0 };    // 0x0: no rendering
+};
+
+// One level of one repeat; the byte counts are taken after the level is
+// uploaded. meshBytes is what its buffers allocated, allocatedBytes all
+// of VMA's live allocations (render targets and the like included) and
+// hostBytes the CPU-side level the model keeps. The GPU passes of the
+// level itself are in report.gpuPasses, those of its draw in renderPasses.
+struct BenchmarkRow
+{
+	std::uint32_t repeat = 0;
+	LevelReport report;
+	double renderMs = 0.0;
+	std::vector<labutils::GpuProfiler::Sample> renderPasses;
+	std::size_t hostBytes = 0;
+	VkDeviceSize meshBytes = 0;
+	VkDeviceSize allocatedBytes = 0;
+};
+
+int run_headless_benchmark(BenchmarkOptions const&);
+
+// The output of run_headless_benchmark(). The GPU columns of the CSV are
+// the sums of the timed passes, 0 where nothing was timed; the JSON has
+// every pass, and aGpuAverages (GpuProfiler::passes()) over the whole run.
+void print_benchmark_csv(std::ostream&, std::vector<BenchmarkRow> const&);
+void print_benchmark_json(
+	std::ostream&,
+	BenchmarkOptions const&,
+	char const* aDeviceName,
+	double aLoadMs,
+	std::vector<BenchmarkRow> const&,
+	std::vector<labutils::GpuProfiler::PassTime> const& aGpuAverages
+);
@@ -0,0 +1,97 @@
+#include "level_cache.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <cassert>
+#include <algorithm>
+
+
+namespace
+{
+	double mib(std::size_t aBytes)
+	{
+		return double(aBytes) / (1024.0 * 1024.0);
+	}
+}
+
+LevelCache::LevelCache(std::size_t aByteBudget)
+	: mByteBudget(aByteBudget)
+{}
+
+void LevelCache::put(CachedLevel aLevel, labutils::Allocator const& aAllocator)
+{
+	aLevel.hostBytes = aLevel.gpuResident ? 0 : aLevel.state.byte_size();
+	aLevel.deviceBytes = std::size_t(::device_bytes(aAllocator, aLevel.mesh));
+	aLevel.lastUse = ++mClock;
+
+	auto const it = std::find_if(mLevels.begin(), mLevels.end(), [&](CachedLevel const& c) { return c.level == aLevel.level; });
+	if (it != mLevels.end())
+		*it = std::move(aLevel);
+	else
+		mLevels.emplace_back(std::move(aLevel));
+
+	evict_to_budget();
+}
+
+bool LevelCache::contains(std::uint32_t aLevel) const
+{
+	return std::any_of(mLevels.begin(), mLevels.end(), [&](CachedLevel const& c) { return c.level == aLevel; });
+}
+
+CachedLevel LevelCache::take(std::uint32_t aLevel)
+{
+	auto const it = std::find_if(mLevels.begin(), mLevels.end(), [&](CachedLevel const& c) { return c.level == aLevel; });
+	assert(it != mLevels.end());
+
+	CachedLevel level = std::move(*it);
+	mLevels.erase(it);
+	return level;
+}
+
+void LevelCache::clear()
+{
+	mLevels.clear();
+}
+
+std::size_t LevelCache::host_bytes() const
+{
+	std::size_t bytes = 0;
+	for (auto const& c : mLevels)
+		bytes += c.hostBytes;
+	return bytes;
+}
+
+std::size_t LevelCache::device_bytes() const
+{
+	std::size_t bytes = 0;
+	for (auto const& c : mLevels)
+		bytes += c.deviceBytes;
+	return bytes;
+}
+
+void LevelCache::print_usage() const
+{
+	std::vector<CachedLevel const*> sorted;
+	for (auto const& c : mLevels)
+		sorted.push_back(&c);
+	std::sort(sorted.begin(), sorted.end(), [](CachedLevel const* a, CachedLevel const* b) { return a->level < b->level; });
+
+	std::cout << std::fixed << std::setprecision(2);
+	for (CachedLevel const* c : sorted)
+	{
+		std::cout << "  level " << c->level << ": host " << mib(c->hostBytes) << " MiB, device "
+			<< mib(c->deviceBytes) << " MiB" << (c->gpuResident ? " (device only)" : "") << "\n";
+	}
+	std::cout << "Level cache: " << mLevels.size() << " levels, host " << mib(host_bytes())
+		<< " MiB + device " << mib(device_bytes()) << " MiB of " << mib(mByteBudget) << " MiB" << std::endl;
+}
+
+void LevelCache::evict_to_budget()
+{
+	while (!mLevels.empty() && host_bytes() + device_bytes() > mByteBudget)
+	{
+		auto const oldest = std::min_element(mLevels.begin(), mLevels.end(),
+			[](CachedLevel const& a, CachedLevel const& b) { return a.lastUse < b.lastUse; });
+		mLevels.erase(oldest);
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "../labutils/allocator.hpp"
+#include "../labutils/gltf_model.hpp"
+
+#include "vertex_data.hpp"
+
+
+// A refinement level that is not on screen: its device buffers and, unless
+// the level only ever existed on the device (--gpu), the model's CPU state.
+struct CachedLevel
+{
+	std::uint32_t level = 0;
+	bool gpuResident = false;                // no CPU state; the model stays at its last CPU level
+
+	labutils::GltfModel::LevelState state;
+	SubdivisionMesh mesh;
+
+	std::size_t hostBytes = 0;
+	std::size_t deviceBytes = 0;
+	std::uint64_t lastUse = 0;
+};
+
+// Levels the user has stepped away from, so that going back to one of them
+// (or forward again) swaps buffers instead of refining. The least recently
+// used levels are dropped once the host and device bytes together exceed
+// the budget; a dropped level is refined again from the cage when needed.
+// A level larger than the whole budget is not kept at all.
+class LevelCache
+{
+public:
+	explicit LevelCache(std::size_t aByteBudget);
+
+	// Takes aLevel over, replacing an entry for the same level, and evicts
+	// down to the budget. Fills in the byte counts. Evicted buffers are freed
+	// at once, so the device must not be using them.
+	void put(CachedLevel aLevel, labutils::Allocator const&);
+
+	bool contains(std::uint32_t aLevel) const;
+	// Removes the entry for aLevel and returns it; contains() must be true.
+	CachedLevel take(std::uint32_t aLevel);
+
+	// Drops every entry, e.g. once the cage they were refined from changed.
+	void clear();
+
+	std::size_t size() const { return mLevels.size(); }
+	std::size_t byte_budget() const { return mByteBudget; }
+	std::size_t host_bytes() const;
+	std::size_t device_bytes() const;
+
+	// One line per cached level and a total.
+	void print_usage() const;
+
+private:
+	void evict_to_budget();
+
+	std::vector<CachedLevel> mLevels;
+	std::size_t mByteBudget;
+	std::uint64_t mClock = 0;
+};
@@ -1,13 +1,16 @@
 #include <iostream>
+#include <iomanip>
 #include <chrono>
 #include <volk/volk.h>
 
 #include <tuple>
+#include <algorithm>
 #include <limits>
 #include <vector>
 #include <stdexcept>
 
 #include <cstdio>
+#include <cstdlib>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
@@ -35,8 +38,14 @@ using namespace labutils::literals;
 namespace lut = labutils;
 
 #include "vertex_data.hpp"
+#include "level_cache.hpp"
+#include "renderer.hpp"
+#include "benchmark.hpp"
 
 #include "../labutils/gltf_model.hpp"
+#include "../labutils/cpu_profiler.hpp"
+#include "../labutils/gpu_profiler.hpp"
+#include "../labutils/topology_cache.hpp"
 
 namespace
 {
@@ -53,11 +62,21 @@ namespace
 		constexpr char const* kFragShaderPath = SHADERDIR_ "shader3d.frag.spv";
 		constexpr char const* kFragModelPath = SHADERDIR_ "shadermodel.frag.spv";
 		constexpr char const* kFragWirePath = SHADERDIR_ "wireframe.frag.spv";
+		constexpr char const* kVertQuadPath = SHADERDIR_ "shaderquad.vert.spv";
+		constexpr char const* kFragQuadPath = SHADERDIR_ "shaderquad.frag.spv";
+		constexpr char const* kVertPatchPath = SHADERDIR_ "bsplinePatch.vert.spv";
+		constexpr char const* kTescPatchPath = SHADERDIR_ "bsplinePatch.tesc.spv";
+		constexpr char const* kTesePatchPath = SHADERDIR_ "bsplinePatch.tese.spv";
 		constexpr char const* kCompShaderPath = SHADERDIR_ "test.comp.spv";
 		constexpr char const* kfaceCompShaderPath = SHADERDIR_ "facePoints.comp.spv";
 		constexpr char const* kedgeCompShaderPath = SHADERDIR_ "edgePoints.comp.spv";
 		constexpr char const* kvertexCompShaderPath = SHADERDIR_ "vertexPoints.comp.spv";
 		constexpr char const* kdrawCompShaderPath = SHADERDIR_ "drawBuffer.comp.spv";
+		constexpr char const* kstencilCompShaderPath = SHADERDIR_ "stencilEval.comp.spv";
+		constexpr char const* ktopologyCompShaderPath = SHADERDIR_ "refineTopology.comp.spv";
+		constexpr char const* kadjacencyCompShaderPath = SHADERDIR_ "refineAdjacency.comp.spv";
+		constexpr char const* kscanCompShaderPath = SHADERDIR_ "prefixScan.comp.spv";
+		constexpr char const* klimitCompShaderPath = SHADERDIR_ "limitPoints.comp.spv";
 
 
 
@@ -65,6 +84,8 @@ namespace
 
 #		undef SHADERDIR_
 		constexpr char const* modelPath = MODELDIR_ "/models/icosahedron/scene.gltf";
+		// written next to the model, see labutils::TopologyCache
+		constexpr char const* kTopologyCacheSuffix = ".subdcache";
 		constexpr VkFormat kDepthFormat = VK_FORMAT_D32_SFLOAT;
 
 
@@ -85,6 +106,11 @@ namespace
 		constexpr float kCameraFastMult = 5.f; // speed multiplier
 		constexpr float kCameraSlowMult = 0.05f; // speed multiplier
 		constexpr float kCameraMouseSensitivity = 0.005f; // radians per pixel
+
+		// --view-adaptive: screen error that stops refinement, and how often
+		// a moving camera may trigger a new selection
+		constexpr float kViewPixelTolerance = 1.f;
+		constexpr float kViewRefineInterval = 0.1f; // seconds
 	}
 	// GLFW callbacks
 	void glfw_callback_key_press(GLFWwindow*, int, int, int, int);
@@ -118,57 +144,58 @@ namespace
 
 		// set 1 when "P" pressed to subdivide once
 		bool shouldSubdivision = 0;
+		// set 1 when "O" pressed to step back one level
+		bool shouldCoarsen = 0;
+
+		// toggled by "G": deform the base cage every frame and re-evaluate the
+		// refined vertices on the GPU from the stencil tables
+		bool animateCage = false;
+
+		// set 1 when "T" pressed to print the GPU pass timings
+		bool printGpuTimes = 0;
 	};
 
 	// update state based on elapsed time
 	void update_user_state(UserState&, float aElapsedTime);
 
-	// Uniform data
-	namespace glsl
-	{
-		struct SceneUniform
-		{
-			// Note: need to be careful about the packing/alignment here!
-			glm::mat4 camera;
-			glm::mat4 projection;
-			glm::mat4 projCam;
-		};
-
-		// We want to use vkCmdUpdateBuffer() to update the contents of our uniform buffers.
-		// vkCmdUpdateBuffer() has a number of requirements, including the two below. See:
-		// https://www.khronos.org/registry/vulkan/specs/1.3-extensions/man/html/vkCmdUpdateBuffer.html
-		static_assert(sizeof(SceneUniform) <= 65536, "SceneUniform must be less than 65536 bytes for vkCmdUpdateBuffer");
-		static_assert(sizeof(SceneUniform) % 4 == 0, "SceneUniform size must be a multiple of 4 bytes");
-
-
-	}
-
 	// Helpers:
 	lut::RenderPass create_render_pass( lut::VulkanWindow const& );
 
-	lut::DescriptorSetLayout create_scene_descriptor_layout( lut::VulkanWindow const& );
-	lut::DescriptorSetLayout create_object_descriptor_layout( lut::VulkanWindow const& );
-	lut::DescriptorSetLayout create_compute_descriptor_layout(lut::VulkanWindow const&);
-	lut::DescriptorSetLayout create_descriptor_set_layout_face(lut::VulkanWindow const&);
-	lut::DescriptorSetLayout create_descriptor_set_layout_edge(lut::VulkanWindow const&);
-	lut::DescriptorSetLayout create_descriptor_set_layout_vertex(lut::VulkanWindow const&);
-	lut::DescriptorSetLayout create_descriptor_set_layout_draw(lut::VulkanWindow const&);
+	lut::DescriptorSetLayout create_object_descriptor_layout( lut::VulkanContext const& );
+	lut::DescriptorSetLayout create_compute_descriptor_layout(lut::VulkanContext const&);
+	lut::DescriptorSetLayout create_descriptor_set_layout_face(lut::VulkanContext const&);
+	lut::DescriptorSetLayout create_descriptor_set_layout_edge(lut::VulkanContext const&);
+	lut::DescriptorSetLayout create_descriptor_set_layout_vertex(lut::VulkanContext const&);
+	lut::DescriptorSetLayout create_descriptor_set_layout_draw(lut::VulkanContext const&);
+	lut::DescriptorSetLayout create_descriptor_set_layout_stencil(lut::VulkanContext const&);
+	lut::DescriptorSetLayout create_descriptor_set_layout_topology(lut::VulkanContext const&);
+	lut::DescriptorSetLayout create_descriptor_set_layout_adjacency(lut::VulkanContext const&);
+	lut::DescriptorSetLayout create_descriptor_set_layout_scan(lut::VulkanContext const&);
+	lut::DescriptorSetLayout create_descriptor_set_layout_limit(lut::VulkanContext const&);
 
-	lut::PipelineLayout create_pipeline_layout( lut::VulkanContext const&, VkDescriptorSetLayout );
 	lut::PipelineLayout create_compute_pipeline_layout(lut::VulkanContext const&, VkDescriptorSetLayout );
+	lut::PipelineLayout create_patch_pipeline_layout(lut::VulkanContext const&, VkDescriptorSetLayout );
 	lut::Pipeline create_pipeline( lut::VulkanWindow const&, VkRenderPass, VkPipelineLayout );
 	lut::Pipeline create_model_pipeline1(lut::VulkanWindow const&, VkRenderPass, VkPipelineLayout);
 	lut::Pipeline create_model_pipeline2(lut::VulkanWindow const&, VkRenderPass, VkPipelineLayout);
+	// Regular B-spline patches through the tessellation stages; needs the
+	// tessellationShader feature and a layout from create_patch_pipeline_layout().
+	lut::Pipeline create_patch_pipeline(lut::VulkanWindow const&, VkRenderPass, VkPipelineLayout);
 	lut::Pipeline create_wireframe_pipeline1(lut::VulkanWindow const&, VkRenderPass, VkPipelineLayout);
 	lut::Pipeline create_wireframe_pipeline12(lut::VulkanWindow const&, VkRenderPass, VkPipelineLayout);
 	lut::Pipeline create_wireframe_pipeline22(lut::VulkanWindow const&, VkRenderPass, VkPipelineLayout);
 
 	lut::Pipeline create_wireframe_pipeline2(lut::VulkanWindow const&, VkRenderPass, VkPipelineLayout);
-	lut::Pipeline create_compute_pipeline(lut::VulkanWindow const&, VkPipelineLayout);
-	lut::Pipeline create_face_compute_pipeline(lut::VulkanWindow const&, VkPipelineLayout);
-	lut::Pipeline create_edge_compute_pipeline(lut::VulkanWindow const&, VkPipelineLayout);
-	lut::Pipeline create_vertex_compute_pipeline(lut::VulkanWindow const&, VkPipelineLayout);
-	lut::Pipeline create_draw_compute_pipeline(lut::VulkanWindow const&, VkPipelineLayout);
+	lut::Pipeline create_compute_pipeline(lut::VulkanContext const&, VkPipelineLayout);
+	lut::Pipeline create_face_compute_pipeline(lut::VulkanContext const&, VkPipelineLayout);
+	lut::Pipeline create_edge_compute_pipeline(lut::VulkanContext const&, VkPipelineLayout);
+	lut::Pipeline create_vertex_compute_pipeline(lut::VulkanContext const&, VkPipelineLayout);
+	lut::Pipeline create_draw_compute_pipeline(lut::VulkanContext const&, VkPipelineLayout);
+	lut::Pipeline create_stencil_compute_pipeline(lut::VulkanContext const&, VkPipelineLayout);
+	lut::Pipeline create_topology_compute_pipeline(lut::VulkanContext const&, VkPipelineLayout);
+	lut::Pipeline create_adjacency_compute_pipeline(lut::VulkanContext const&, VkPipelineLayout);
+	lut::Pipeline create_scan_compute_pipeline(lut::VulkanContext const&, VkPipelineLayout);
+	lut::Pipeline create_limit_compute_pipeline(lut::VulkanContext const&, VkPipelineLayout);
 
 
 
@@ -184,40 +211,36 @@ namespace
 	);
 
 	glsl::SceneUniform sceneUniforms{};
-	void update_scene_uniforms(
-		glsl::SceneUniform&,
-		std::uint32_t aFramebufferWidth,
-		std::uint32_t aFramebufferHeight,
-		UserState&
-	);
 
-	void dispatch_subdivision_passes(
-		VkCommandBuffer,
 
-		SubdivisionMesh& inMesh,
-		SubdivisionMesh& outMesh,
+	// Average time of aRepeats dispatches of aPass over aInvocations threads,
+	// each submitted and waited for on its own.
+	double time_compute_pass(
+		lut::VulkanContext const&,
+		VkCommandBuffer,
+		ComputePass const&,
+		SubdivisionMesh const& inMesh,
+		std::uint32_t aInvocations,
+		std::uint32_t aRepeats
+	);
 
-		VkPipeline,
-		VkPipelineLayout,
-		VkDescriptorSet,
+	void print_level_report(LevelReport const&);
 
-		VkPipeline,
-		VkPipelineLayout,
-		VkDescriptorSet,
+	// --trace: writes what was profiled so far to aPath, if not null.
+	void write_trace(char const* aPath);
 
-		VkPipeline,
-		VkPipelineLayout,
-		VkDescriptorSet,	
+	// Records the limit pass, with the barriers that order it after earlier
+	// compute or transfer writes of the control points and before the draw.
+	void record_limit_evaluation(VkCommandBuffer, ComputePass const&, SubdivisionMesh const&);
 
-		VkPipeline,
-		VkPipelineLayout,
-		VkDescriptorSet
+	void update_stencil_descriptors(
+		lut::VulkanContext const&,
+		VkDescriptorSet,
+		StencilBuffers const&,
+		VkBuffer aDrawVertices
 	);
 
-	void submit_and_wait_for_compute(
-		lut::VulkanWindow const&,
-		VkQueue,
-		VkCommandBuffer);
+	void record_stencil_evaluation(VkCommandBuffer, StencilPass const&);
 
 	void rc_draw_triangles(
 		VkCommandBuffer,
@@ -235,24 +258,6 @@ namespace
 		VkDescriptorSet aSceneDescriptors
 	);
 
-	void rc_draw_quads(
-		VkCommandBuffer aCmdBuff,
-		VkRenderPass aRenderPass,
-		VkFramebuffer aFramebuffer,
-		VkPipeline aGraphicsPipe,
-		VkPipeline aWireframePipe,
-		VkExtent2D const& aImageExtent,
-		VkBuffer aPositionBuffer,
-		VkBuffer aIndexBuffer,
-		VkBuffer aLinelistsBuffer,
-		std::uint32_t aIndicesCount,
-		std::uint32_t aLinelistsCount,
-		VkBuffer aSceneUBO,
-		glsl::SceneUniform const& aSceneUniform,
-		VkPipelineLayout aGraphicsLayout,
-		VkDescriptorSet aSceneDescriptors
-	);
-
 	void record_compute_commands(
 		VkCommandBuffer aCmdBuff,
 		VkPipeline aComputePipeline,
@@ -280,12 +285,147 @@ namespace
 }
 
 
-int main() try
+int main(int aArgc, char* aArgv[]) try
 {
+	LUT_PROFILE_THREAD_NAME("main");
+
+	bool gpuSubdivision = false;
+	bool adaptiveSubdivision = false;
+	bool limitSurface = false;
+	bool tessellatePatches = false;
+	bool viewAdaptive = false;
+	bool benchVertexPass = false;
+	bool validateTopology = false;
+	std::uint32_t pendingLevels = 0;
+	std::size_t cacheBudgetMiB = 512;
+	bool useDiskCache = true;
+	bool weldParts = false;
+	char const* modelPath = cfg::modelPath;
+	char const* tracePath = nullptr;
+	bool headless = false;
+	BenchmarkOptions bench{};
+	for (int i = 1; i < aArgc; ++i)
+	{
+		if (0 == std::strcmp(aArgv[i], "--gpu"))
+			gpuSubdivision = true;
+		else if (0 == std::strcmp(aArgv[i], "--cpu"))
+			gpuSubdivision = false;
+		else if (0 == std::strcmp(aArgv[i], "--levels") && i + 1 < aArgc)
+			pendingLevels = std::uint32_t(std::strtoul(aArgv[++i], nullptr, 10));
+		else if (0 == std::strcmp(aArgv[i], "--bench-vertex"))
+			benchVertexPass = true;
+		else if (0 == std::strcmp(aArgv[i], "--validate"))
+			validateTopology = true;
+		else if (0 == std::strcmp(aArgv[i], "--adaptive"))
+			adaptiveSubdivision = true;
+		else if (0 == std::strcmp(aArgv[i], "--limit"))
+			limitSurface = true;
+		else if (0 == std::strcmp(aArgv[i], "--tessellate"))
+			adaptiveSubdivision = tessellatePatches = true;
+		else if (0 == std::strcmp(aArgv[i], "--view-adaptive"))
+			viewAdaptive = true;
+		else if (0 == std::strcmp(aArgv[i], "--cache-mib") && i + 1 < aArgc)
+			cacheBudgetMiB = std::size_t(std::strtoull(aArgv[++i], nullptr, 10));
+		else if (0 == std::strcmp(aArgv[i], "--no-disk-cache"))
+			useDiskCache = false;
+		else if (0 == std::strcmp(aArgv[i], "--weld-parts"))
+			weldParts = true;
+		else if (0 == std::strcmp(aArgv[i], "--model") && i + 1 < aArgc)
+			modelPath = aArgv[++i];
+		else if (0 == std::strcmp(aArgv[i], "--trace") && i + 1 < aArgc)
+			tracePath = aArgv[++i];
+		else if (0 == std::strcmp(aArgv[i], "--headless"))
+			headless = true;
+		else if (0 == std::strcmp(aArgv[i], "--repeat") && i + 1 < aArgc)
+			bench.repeats = std::uint32_t(std::strtoul(aArgv[++i], nullptr, 10));
+		else if (0 == std::strcmp(aArgv[i], "--format") && i + 1 < aArgc && (0 == std::strcmp(aArgv[i + 1], "json") || 0 == std::strcmp(aArgv[i + 1], "csv")))
+			bench.csv = 0 == std::strcmp(aArgv[++i], "csv");
+		else if (0 == std::strcmp(aArgv[i], "--render") && i + 1 < aArgc
+			&& 2 == std::sscanf(aArgv[i + 1], "%ux%u", &bench.renderExtent.width, &bench.renderExtent.height))
+			++i;
+		else
+			throw lut::Error("Unknown argument '%s'\n"
+				"Usage: exercise4 [--cpu | --gpu | --adaptive | --tessellate | --view-adaptive] [--levels N] [--cache-mib N] [--no-disk-cache] [--weld-parts] [--bench-vertex] [--validate] [--limit] [--model PATH] [--trace FILE]\n"
+				"       exercise4 --headless [--cpu | --gpu] --levels N [--repeat K] [--format json|csv] [--render WxH] [--limit] [--weld-parts] [--model PATH] [--trace FILE]\n"
+				"  --gpu             keep every level after the first on the device (the first\n"
+				"                    turns triangles into quads and always runs on the CPU)\n"
+				"  --adaptive        refine only around extraordinary vertices, creases and\n"
+				"                    boundaries (CPU only)\n"
+				"  --tessellate      refine adaptively and draw the regular patches with the\n"
+				"                    tessellation stages instead of refining them\n"
+				"  --view-adaptive   pick a level per face from its screen-space error, again\n"
+				"                    whenever the camera moves (CPU only)\n"
+				"  --levels N        subdivide N times before the first frame\n"
+				"  --limit           draw every level on its limit surface, with limit normals\n"
+				"  --cache-mib N     memory budget for the levels O and P step between\n"
+				"  --no-disk-cache   neither read nor write the topology cache next to the model\n"
+				"  --weld-parts      weld the scene's meshes into one connected cage\n"
+				"  --bench-vertex    time the vertex point pass alone after every GPU level\n"
+				"  --validate        read every GPU level's topology back and check it\n"
+				"  --model PATH      load another glTF/GLB file\n"
+				"  --trace FILE      write the CPU zones and GPU passes to FILE as a Chrome trace\n"
+				"                    on the way out (release builds need LUT_PROFILING=1)\n"
+				"  --headless        run the benchmark (benchmark.hpp) instead of the viewer", aArgv[i]);
+	}
+	if (headless)
+	{
+		if (adaptiveSubdivision || viewAdaptive)
+			throw lut::Error("--headless benchmarks uniform levels and cannot be combined with --adaptive, --tessellate or --view-adaptive");
+		if (0 == pendingLevels || 0 == bench.repeats)
+			throw lut::Error("--headless needs --levels N and --repeat K greater than zero");
+
+		bench.modelPath = modelPath;
+		bench.levels = pendingLevels;
+		bench.gpu = gpuSubdivision;
+		bench.limit = limitSurface;
+		bench.weldParts = weldParts;
+		int const ret = run_headless_benchmark(bench);
+		write_trace(tracePath);
+		return ret;
+	}
+	if (adaptiveSubdivision && gpuSubdivision)
+		throw lut::Error("--adaptive runs on the CPU and cannot be combined with --gpu");
+	if (adaptiveSubdivision && limitSurface)
+		throw lut::Error("--limit needs a uniformly refined level and cannot be combined with --adaptive");
+	if (viewAdaptive && (gpuSubdivision || adaptiveSubdivision || limitSurface))
+		throw lut::Error("--view-adaptive cannot be combined with --gpu, --adaptive, --tessellate or --limit");
+	std::cout << "Subdivision mode: " << (gpuSubdivision ? "GPU" : viewAdaptive ? "CPU (view-dependent)" : tessellatePatches ? "CPU (adaptive) + tessellated patches"
+		: adaptiveSubdivision ? "CPU (adaptive)" : "CPU") << std::endl;
+
 	labutils::GltfModel model;
-	if (model.loadFromFile(cfg::modelPath))
+	model.patchesOnDevice = tessellatePatches;
+
+	// The welded base mesh, and the uniform levels refined so far, come from
+	// the topology cache when the model file and the load options (here
+	// --weld-parts) are unchanged
+	auto const loadStart = std::chrono::high_resolution_clock::now();
+	lut::TopologyCache diskCache(std::string(modelPath) + cfg::kTopologyCacheSuffix,
+		useDiskCache ? lut::hash_model_inputs(modelPath, weldParts ? 1u : 0u) : 0);
+	bool const diskLevels = useDiskCache && !adaptiveSubdivision && !viewAdaptive;
+	bool loaded = false;
+	if (diskCache.has_base())
 	{
-		std::cout << "load successfully!" << std::endl;
+		std::vector<lut::Vertex> baseVertices;
+		std::vector<std::uint32_t> baseIndices;
+		std::vector<lut::GltfModel::MeshPart> baseParts;
+		loaded = diskCache.read_base(baseVertices, baseIndices, baseParts);
+		if (loaded)
+		{
+			model.setBaseMesh(std::move(baseVertices), std::move(baseIndices), std::move(baseParts));
+			std::cout << "Topology cache: base mesh and " << diskCache.level_count() << " levels" << std::endl;
+		}
+	}
+	if (!loaded)
+	{
+		loaded = model.loadFromFile(modelPath, weldParts);
+		if (loaded && useDiskCache)
+			diskCache.write_base(model.m_vertices, model.m_indices, model.get_parts());
+	}
+	auto const loadEnd = std::chrono::high_resolution_clock::now();
+	if (loaded)
+	{
+		std::cout << "load successfully! (" << model.get_parts().size() << " parts, " << model.m_vertices.size() << " vertices, "
+			<< std::fixed << std::setprecision(3) << std::chrono::duration<double, std::milli>(loadEnd - loadStart).count() << " ms)" << std::endl;
 	}
 	else
 	{
@@ -312,6 +452,9 @@ int main() try
 	// Create VMA allocator
 	lut::Allocator allocator = lut::create_allocator( window );
 
+	// every mesh upload goes through its staging ring
+	lut::UploadContext uploads( window, allocator );
+
 	// Intialize resources
 	lut::RenderPass renderPass = create_render_pass( window );
 
@@ -327,6 +470,19 @@ int main() try
 	lut::Pipeline pipe2 = create_model_pipeline2(window, renderPass.handle, pipeLayout.handle);
 	lut::Pipeline wire_pipe2 = create_wireframe_pipeline2(window, renderPass.handle, pipeLayout.handle);
 
+	lut::PipelineLayout patchLayout;
+	lut::Pipeline patchPipe;
+	if (tessellatePatches)
+	{
+		VkPhysicalDeviceFeatures features{};
+		vkGetPhysicalDeviceFeatures(window.physicalDevice, &features);
+		if (!features.tessellationShader)
+			throw lut::Error("--tessellate: the device does not support tessellation shaders");
+
+		patchLayout = create_patch_pipeline_layout(window, sceneLayout.handle);
+		patchPipe = create_patch_pipeline(window, renderPass.handle, patchLayout.handle);
+	}
+
 
 	auto [depthBuffer, depthBufferView] = create_depth_buffer(window, allocator);
 
@@ -348,9 +504,16 @@ int main() try
 		renderFinished.emplace_back( lut::create_semaphore( window ) );
 	}
 
+	// one timestamp slot per frame in flight, and one for the subdivision
+	lut::GpuProfiler gpuProfiler(window, std::uint32_t(cbuffers.size()) + 1);
+	std::uint32_t const subdivProfilerSlot = std::uint32_t(cbuffers.size());
+
 	// Load data
-	ModelMesh modelMesh= create_model_buffer_tri(window, allocator, model);
+	ModelMesh modelMesh= create_model_buffer_tri(allocator, uploads, model);
 	SubdivisionMesh subMeshes[2];
+	PatchMesh patchMesh;
+	// levels stepped away from; the one on screen is never in here
+	LevelCache levelCache(cacheBudgetMiB * 1024 * 1024);
 	//std::vector<SubdivisionMesh> subMeshes(2);
 	int curr = 0;
 	int next = 1;
@@ -398,6 +561,8 @@ int main() try
 
 	//record current time
 	auto previousClock = Clock_::now();
+	glm::mat4 viewProjCam{ 0.f };                 // camera of the last view-dependent selection
+	auto lastViewRefine = previousClock - std::chrono::seconds(1);
 
 	// Application main loop
 	bool recreateSwapchain = false;
@@ -405,44 +570,57 @@ int main() try
 	///////////////////////////////////////////////////////////////////////////////////////////
 
 
-	lut::DescriptorSetLayout facelayout = create_descriptor_set_layout_face(window);
-	lut::DescriptorSetLayout edgelayout = create_descriptor_set_layout_edge(window);
-	lut::DescriptorSetLayout vertexlayout = create_descriptor_set_layout_vertex(window);
-	lut::DescriptorSetLayout drawlayout = create_descriptor_set_layout_draw(window);
-
-
-	lut::PipelineLayout facepipeLayout = create_compute_pipeline_layout(window, facelayout.handle);
-	lut::PipelineLayout edgepipeLayout = create_compute_pipeline_layout(window, edgelayout.handle);
-	lut::PipelineLayout vertexpipeLayout = create_compute_pipeline_layout(window, vertexlayout.handle);
-	lut::PipelineLayout drawpipeLayout = create_compute_pipeline_layout(window, drawlayout.handle);
-
-
+	SubdivisionPipelines const subdiv = create_subdivision_pipelines(window, dpool.handle);
+	SubdivisionPasses const& subdivPasses = subdiv.passes;
+	ComputePass const& limitPass = subdiv.limit;
+	VkDescriptorSet const limitDescriptors = limitPass.descriptors;
 
-	VkDescriptorSet faceDescriptors = lut::alloc_desc_set(
+	lut::DescriptorSetLayout stencillayout = create_descriptor_set_layout_stencil(window);
+	lut::PipelineLayout stencilpipeLayout = create_compute_pipeline_layout(window, stencillayout.handle);
+	VkDescriptorSet stencilDescriptors = lut::alloc_desc_set(
 		window,
 		dpool.handle,
-		facelayout.handle
-	);
-	VkDescriptorSet edgeDescriptors = lut::alloc_desc_set(
-		window,
-		dpool.handle,
-		edgelayout.handle
-	);
-	VkDescriptorSet vertexDescriptors = lut::alloc_desc_set(
-		window,
-		dpool.handle,
-		vertexlayout.handle
-	);
-	VkDescriptorSet drawDescriptors = lut::alloc_desc_set(
-		window,
-		dpool.handle,
-		drawlayout.handle
+		stencillayout.handle
 	);
+	lut::Pipeline stencilcompPipe = create_stencil_compute_pipeline(window, stencilpipeLayout.handle);
+
+	VkCommandBuffer subdivCmd = lut::alloc_command_buffer(window, cpool.handle);
+
+	// true once subMeshes[curr] was refined on the device; the CPU model then
+	// stays at the first level, so there are no stencils for it
+	bool gpuResident = false;
+
+	// Base cage -> current level on the device. Built the first time the cage
+	// is animated and dropped whenever the topology changes.
+	StencilBuffers stencils;
+	std::vector<glm::vec4> animatedCage;
+	float cageTime = 0.f;
+	float cageScale = 1.f;
+	bool cageDeformed = false;
 
-	lut::Pipeline facecompPipe = create_face_compute_pipeline(window, facepipeLayout.handle);
-	lut::Pipeline edgecompPipe = create_edge_compute_pipeline(window, edgepipeLayout.handle);
-	lut::Pipeline vertexcompPipe = create_vertex_compute_pipeline(window, vertexpipeLayout.handle);
-	lut::Pipeline drawcompPipe = create_draw_compute_pipeline(window, drawpipeLayout.handle);
+	// Moves the level on screen (aMesh, plus the model's CPU state unless
+	// it only exists on the device) into the cache, and back out of it.
+	auto const stashLevel = [&](SubdivisionMesh&& aMesh, bool aOnDevice) {
+		if (model.subTime == 0)
+			return; // the triangle cage is always kept
+		CachedLevel entry;
+		entry.level = std::uint32_t(model.subTime);
+		entry.gpuResident = aOnDevice;
+		if (!aOnDevice)
+			entry.state = model.saveLevel();
+		entry.mesh = std::move(aMesh);
+		levelCache.put(std::move(entry), allocator);
+	};
+	auto const restoreLevel = [&](CachedLevel&& aEntry) {
+		if (!aEntry.gpuResident)
+			model.restoreLevel(std::move(aEntry.state));
+		model.subTime = int(aEntry.level);
+		gpuResident = aEntry.gpuResident;
+		subMeshes[curr] = std::move(aEntry.mesh);
+		subMeshes[next] = SubdivisionMesh{};
+		if (tessellatePatches)
+			patchMesh = create_patch_buffer(allocator, uploads, model.get_patches(), lut::patch_sides(model.get_adaptive_level(), model.get_patches()));
+	};
 
 
 
@@ -459,6 +637,8 @@ int main() try
 		// reaction to user input (or similar).
 		glfwPollEvents(); // or: glfwWaitEvents()
 
+		LUT_PROFILE_ZONE("frame");
+
 		// Recreate swap chain?
 		if( recreateSwapchain )
 		{
@@ -482,6 +662,8 @@ int main() try
 
 				pipe2 = create_model_pipeline2(window, renderPass.handle, pipeLayout.handle);
 				wire_pipe2 = create_wireframe_pipeline2(window, renderPass.handle, pipeLayout.handle);
+				if (tessellatePatches)
+					patchPipe = create_patch_pipeline(window, renderPass.handle, patchLayout.handle);
 			}
 
 			framebuffers.clear();
@@ -505,6 +687,9 @@ int main() try
 				"vkWaitForFences() returned %s", frameIndex, lut::to_string(res).c_str());
 		}
 
+		// the frame that last used these resources is done, and so are its timestamps
+		gpuProfiler.collect(std::uint32_t(frameIndex));
+
 		// Acquire next swap chain image
 		assert(frameIndex < imageAvailable.size());
 
@@ -567,117 +752,293 @@ int main() try
 
 		// Prepare data for this frame
 		glsl::SceneUniform sceneUniforms{};
-		update_scene_uniforms(sceneUniforms, window.swapchainExtent.width, window.swapchainExtent.height, state);
+		update_scene_uniforms(sceneUniforms, window.swapchainExtent.width, window.swapchainExtent.height, state.camera2world);
 
 		if (state.shouldSubdivision)
 		{
-			vkDeviceWaitIdle(window.device);
+			++pendingLevels;
+			state.shouldSubdivision = 0;
+		}
 
-			// Timer
-			auto startTime = std::chrono::high_resolution_clock::now();
-			// Data
-			size_t verticesBefore = model.m_quadVertices.size();
-			size_t facesBefore = model.m_quadFaces.size();
-			size_t edgesBefore = model.m_edgeList.size();
+		if (state.printGpuTimes)
+		{
+			state.printGpuTimes = 0;
+			std::cout << std::flush;
+			gpuProfiler.print(stdout);
+		}
 
-			if (model.subTime == 0)
+		// Step back one level: from the cache if it is still there, otherwise
+		// refined again from the cage (reusing whatever is cached on the way)
+		if (state.shouldCoarsen)
+		{
+			state.shouldCoarsen = 0;
+			if (!viewAdaptive && model.subTime > 0)
 			{
-				// CPU
-				auto cpuStart = std::chrono::high_resolution_clock::now();
-				model.firstSubdivision();
-				model.subTime++;
-				auto cpuEnd = std::chrono::high_resolution_clock::now();
-				double cpuTime = std::chrono::duration<double, std::milli>(cpuEnd - cpuStart).count();
+				vkDeviceWaitIdle(window.device);
 
+				std::uint32_t const target = std::uint32_t(model.subTime) - 1;
+				stashLevel(std::move(subMeshes[curr]), gpuResident);
+				subMeshes[next] = SubdivisionMesh{};
+				if (target > 0 && levelCache.contains(target))
+					restoreLevel(levelCache.take(target));
+				else
+				{
+					model.restoreLevel(lut::GltfModel::LevelState{});
+					model.subTime = 0;
+					gpuResident = false;
+					pendingLevels = target;
+				}
+
+				stencils = StencilBuffers{};
+				cageDeformed = false;
+				std::cout << "Level " << target << "\n";
+				levelCache.print_usage();
+			}
+		}
 
-				auto gpuStart = std::chrono::high_resolution_clock::now();
-				subMeshes[next] = create_model_buffer(window, allocator, model);
-				subMeshes[curr] = create_empty_buffer(window, allocator,
-					model.m_quadVertices.size(),
-					model.m_edgeList.size(),
-					model.m_quadFaces.size());
+		// View-dependent levels follow the camera instead of the P key
+		if (viewAdaptive)
+		{
+			pendingLevels = 0;
+			auto const sinceRefine = std::chrono::duration_cast<Secondsf_>(now - lastViewRefine).count();
+			if (sceneUniforms.projCam != viewProjCam && sinceRefine >= cfg::kViewRefineInterval)
+			{
 				vkDeviceWaitIdle(window.device);
-				auto gpuEnd = std::chrono::high_resolution_clock::now();
-				double gpuTime = std::chrono::duration<double, std::milli>(gpuEnd - gpuStart).count();
-
-				std::swap(curr, next);
-
-
-				size_t vertexMemory = model.m_quadVertices.size() * sizeof(lut::Vertex);
-				size_t indexMemory = model.m_quadIndices.size() * sizeof(uint32_t);
-				size_t edgeMemory = model.m_quadLinelists.size() * sizeof(uint32_t);
-				size_t totalMemoryMB = (vertexMemory + indexMemory + edgeMemory);
-				std::cout << "\n========== Subdivision Level " << model.subTime << " ==========\n";
-				std::cout << std::fixed << std::setprecision(2);
-				std::cout << "CPU Subdivision Time: " << cpuTime << " ms\n";
-				std::cout << "GPU Buffer Creation:  " << gpuTime << " ms\n";
-				std::cout << "Total Time:          " << (cpuTime + gpuTime) << " ms\n";
-				std::cout << "------- Mesh Statistics -------\n";
-				std::cout << "Vertices: " << verticesBefore << " -> " << model.m_quadVertices.size()
-					 << "\n";
-				std::cout << "Faces:    " << facesBefore << " -> " << model.m_quadFaces.size()
-					<< "\n";
-				std::cout << "Edges:    " << edgesBefore << " -> " << model.m_edgeList.size()
-					<< "\n";
-				std::cout << "------- Memory Usage -------\n";
-				std::cout << "Vertex Buffer:  " << vertexMemory / (1024.0 * 1024.0) << " MB\n";
-				std::cout << "Index Buffer:   " << indexMemory / (1024.0 * 1024.0) << " MB\n";
-				std::cout << "Edge Buffer:    " << edgeMemory / (1024.0 * 1024.0) << " MB\n";
-				std::cout << "Total GPU Mem:  " << totalMemoryMB / (1024.0 * 1024.0) << " MB\n";
-				std::cout << "=====================================\n\n";
+
+				lut::ScreenError error;
+				error.projCam = sceneUniforms.projCam;
+				error.focalPixels = 0.5f * float(window.swapchainExtent.height) * std::abs(sceneUniforms.projection[1][1]);
+				error.tolerance = cfg::kViewPixelTolerance;
+
+				auto const refineStart = std::chrono::high_resolution_clock::now();
+				lut::ViewDependentStats const stats = model.subdivideViewDependent(error);
+				auto const refineEnd = std::chrono::high_resolution_clock::now();
+				if (model.get_quad_mesh().face_count() > 0)
+					subMeshes[curr] = create_model_buffer(allocator, uploads, model);
+				else
+					subMeshes[curr] = SubdivisionMesh{}; // nothing in view
+				subMeshes[next] = SubdivisionMesh{};
+				uploads.flush();
+				auto const uploadEnd = std::chrono::high_resolution_clock::now();
+
+				model.subTime = std::max(model.subTime, 1);
+				viewProjCam = sceneUniforms.projCam;
+				lastViewRefine = now;
+
+				std::cout << "View-dependent: " << stats.faces << " faces, deepest level " << stats.deepestLevel
+					<< ", refine " << std::fixed << std::setprecision(3)
+					<< std::chrono::duration<double, std::milli>(refineEnd - refineStart).count() << " ms, upload "
+					<< std::chrono::duration<double, std::milli>(uploadEnd - refineEnd).count() << " ms" << std::endl;
 			}
-			else
+		}
+
+		if (pendingLevels > 0)
+		{
+			vkDeviceWaitIdle(window.device);
+
+			for (; pendingLevels > 0; --pendingLevels)
 			{
-				
-				auto cpuStart = std::chrono::high_resolution_clock::now();
-				model.subdivideQuadOnce();
+				std::uint32_t const nextLevel = std::uint32_t(model.subTime) + 1;
+				if (levelCache.contains(nextLevel))
+				{
+					stashLevel(std::move(subMeshes[curr]), gpuResident);
+					restoreLevel(levelCache.take(nextLevel));
+					std::cout << "Level " << nextLevel << " (cached)\n";
+					continue;
+				}
+
+				LevelReport report{};
+
+				if (model.subTime == 0 || !gpuSubdivision)
+				{
+					stashLevel(std::move(subMeshes[curr]), gpuResident);
+
+					report.mode = "CPU";
+					report.verticesBefore = model.m_quadVertices.size();
+					report.facesBefore = model.m_mesh.face_count();
+					report.edgesBefore = model.m_edgeList.size();
+
+					auto cpuStart = std::chrono::high_resolution_clock::now();
+					lut::GltfModel::LevelState diskLevel;
+					bool const fromDisk = diskLevels && nextLevel <= diskCache.level_count() && diskCache.read_level(nextLevel, diskLevel);
+					if (fromDisk)
+					{
+						model.restoreLevel(std::move(diskLevel));
+						report.mode = "CPU (disk cache)";
+					}
+					else if (adaptiveSubdivision)
+						model.subdivideAdaptiveOnce();
+					else if (model.subTime == 0)
+						model.firstSubdivision();
+					else
+						model.subdivideQuadOnce();
+					auto cpuEnd = std::chrono::high_resolution_clock::now();
+					report.refineMs = std::chrono::duration<double, std::milli>(cpuEnd - cpuStart).count();
+
+					if (limitSurface)
+					{
+						std::vector<glm::vec3> limitPositions, limitNormals;
+						model.evaluateLimitSurface(limitPositions, limitNormals);
+						subMeshes[curr] = create_model_buffer(allocator, uploads, model, &limitPositions, &limitNormals);
+					}
+					else if (model.get_quad_mesh().face_count() > 0)
+						subMeshes[curr] = create_model_buffer(allocator, uploads, model);
+					else
+						subMeshes[curr] = SubdivisionMesh{}; // every face is a patch
+					if (tessellatePatches)
+						patchMesh = create_patch_buffer(allocator, uploads, model.get_patches(), lut::patch_sides(model.get_adaptive_level(), model.get_patches()));
+					subMeshes[next] = SubdivisionMesh{};
+					uploads.flush();    // so that uploadMs includes the copies
+					auto uploadEnd = std::chrono::high_resolution_clock::now();
+					report.uploadMs = std::chrono::duration<double, std::milli>(uploadEnd - cpuEnd).count();
+
+					if (diskLevels && !fromDisk && nextLevel == diskCache.level_count() + 1)
+						diskCache.append_level(model.saveLevel());
+				}
+				else
+				{
+					// ping-pong: subMeshes[curr] is the parent, subMeshes[next]
+					// (two levels old) is replaced by the child
+					report.mode = "GPU";
+					report.verticesBefore = subMeshes[curr].vertexCount;
+					report.facesBefore = subMeshes[curr].faceCount;
+					report.edgesBefore = subMeshes[curr].edgeCount;
+
+					auto allocStart = std::chrono::high_resolution_clock::now();
+					subMeshes[next] = create_empty_buffer(window, allocator,
+						subMeshes[curr].vertexCount,
+						subMeshes[curr].edgeCount,
+						subMeshes[curr].faceCount);
+					auto gpuStart = std::chrono::high_resolution_clock::now();
+					report.uploadMs = std::chrono::duration<double, std::milli>(gpuStart - allocStart).count();
+
+					update_subdivision_descriptors(window, subdivPasses, subMeshes[curr], subMeshes[next]);
+					if (limitSurface)
+						update_limit_descriptors(window, limitDescriptors, subMeshes[next]);
+					dispatch_subdivision_passes(subdivCmd, subMeshes[curr], subMeshes[next], subdivPasses, limitSurface ? &limitPass : nullptr,
+						&gpuProfiler, subdivProfilerSlot);
+					submit_and_wait_for_compute(window, window.graphicsQueue, subdivCmd);
+					auto gpuEnd = std::chrono::high_resolution_clock::now();
+					report.refineMs = std::chrono::duration<double, std::milli>(gpuEnd - gpuStart).count();
+					gpuProfiler.collect(subdivProfilerSlot, &report.gpuPasses);
+
+					if (benchVertexPass)
+					{
+						// the parent's lists start at scanned offsets, so the
+						// cost per vertex should not grow with the level
+						std::uint32_t const parentVertices = subMeshes[curr].vertexCount;
+						double const ms = time_compute_pass(window, subdivCmd, subdivPasses.vertex, subMeshes[curr], parentVertices, 10);
+						std::cout << "Vertex pass: " << parentVertices << " vertices, "
+							<< std::fixed << std::setprecision(3) << ms << " ms, "
+							<< (ms * 1e6 / double(parentVertices)) << " ns/vertex" << std::endl;
+					}
+
+					std::swap(curr, next);
+					stashLevel(std::move(subMeshes[next]), gpuResident);
+					gpuResident = true;
+
+					if (validateTopology)
+						validate_gpu_topology(window, allocator, window.graphicsQueue, subMeshes[curr]);
+				}
+
 				model.subTime++;
-				auto cpuEnd = std::chrono::high_resolution_clock::now();
-				double cpuTime = std::chrono::duration<double, std::milli>(cpuEnd - cpuStart).count();
-
-				
-				auto gpuStart = std::chrono::high_resolution_clock::now();
-				subMeshes[next] = create_model_buffer(window, allocator, model);
-				subMeshes[curr] = create_empty_buffer(window, allocator,
-					model.m_quadVertices.size(),
-					model.m_edgeList.size(),
-					model.m_quadFaces.size());
+				report.level = model.subTime;
+				report.vertices = subMeshes[curr].vertexCount;
+				report.faces = subMeshes[curr].faceCount;
+				report.edges = subMeshes[curr].edgeCount;
+				print_level_report(report);
+				if (limitSurface && gpuResident)
+					warn_semi_sharp_limit(model.initial_sharpness, report.level);
+
+				if (adaptiveSubdivision)
+				{
+					std::cout << "Adaptive: " << model.get_patches().patch_count() << " patches, "
+						<< model.get_adaptive_level().active_face_count() << " faces still refined ("
+						<< model.get_adaptive_level().mesh.face_count() << " with margin)\n\n";
+				}
+			}
+			levelCache.print_usage();
+
+			stencils = StencilBuffers{};
+			cageDeformed = false;
+		}
+
+		// Animated cage: only the base control points go to the GPU, the
+		// refined vertices are rebuilt in place by stencilEval.comp.
+		StencilPass stencilPass{};
+		bool const evaluateStencils = model.subTime > 0 && !gpuResident && !adaptiveSubdivision && !viewAdaptive && (state.animateCage || cageDeformed);
+		if (evaluateStencils)
+		{
+			if (!stencils.isValid())
+			{
 				vkDeviceWaitIdle(window.device);
-				auto gpuEnd = std::chrono::high_resolution_clock::now();
-				double gpuTime = std::chrono::duration<double, std::milli>(gpuEnd - gpuStart).count();
-
-				std::swap(curr, next);
-
-				
-				size_t vertexMemory = model.m_quadVertices.size() * sizeof(lut::Vertex);
-				size_t indexMemory = model.m_quadIndices.size() * sizeof(uint32_t);
-				size_t edgeMemory = model.m_quadLinelists.size() * sizeof(uint32_t);
-				size_t totalMemoryMB = (vertexMemory + indexMemory + edgeMemory);
-
-				
-				std::cout << "\n========== Subdivision Level " << model.subTime << " ==========\n";
-				std::cout << std::fixed << std::setprecision(2);
-				std::cout << "CPU Subdivision Time: " << cpuTime << " ms\n";
-				std::cout << "GPU Buffer Creation:  " << gpuTime << " ms\n";
-				std::cout << "Total Time:          " << (cpuTime + gpuTime) << " ms\n";
-				std::cout << "------- Mesh Statistics -------\n";
-				std::cout << "Vertices: " << verticesBefore << " -> " << model.m_quadVertices.size()
-					<< " (x" << (float)model.m_quadVertices.size() / verticesBefore << ")\n";
-				std::cout << "Faces:    " << facesBefore << " -> " << model.m_quadFaces.size()
-					<< " (x" << (float)model.m_quadFaces.size() / facesBefore << ")\n";
-				std::cout << "Edges:    " << edgesBefore << " -> " << model.m_edgeList.size()
-					<< " (x" << (float)model.m_edgeList.size() / edgesBefore << ")\n";
-				std::cout << "------- Memory Usage -------\n";
-				std::cout << "Vertex Buffer:  " << vertexMemory / (1024.0 * 1024.0) << " MB\n";
-				std::cout << "Index Buffer:   " << indexMemory / (1024.0 * 1024.0) << " MB\n";
-				std::cout << "Edge Buffer:    " << edgeMemory / (1024.0 * 1024.0) << " MB\n";
-				std::cout << "Total GPU Mem:  " << totalMemoryMB / (1024.0 * 1024.0) << " MB\n";
-				std::cout << "=====================================\n\n";
+
+				auto stencilStart = std::chrono::high_resolution_clock::now();
+				lut::StencilTable const& table = model.refinedStencils();
+				stencils = create_stencil_buffers(allocator, uploads, table, model.m_vertices, std::uint32_t(cbuffers.size()));
+				assert(stencils.rowCount == subMeshes[curr].vertexCount);
+				// on the limit surface the stencils rebuild the control points
+				// and limitPoints.comp takes it from there
+				VkBuffer const stencilTarget = limitSurface ? subMeshes[curr].controlPoints.buffer : subMeshes[curr].drawVertices.buffer;
+				update_stencil_descriptors(window, stencilDescriptors, stencils, stencilTarget);
+				if (limitSurface)
+				{
+					update_limit_descriptors(window, limitDescriptors, subMeshes[curr]);
+					warn_semi_sharp_limit(model.initial_sharpness, model.subTime);
+				}
+				auto stencilEnd = std::chrono::high_resolution_clock::now();
+				std::cout << "Stencil upload: " << std::chrono::duration<double, std::milli>(stencilEnd - stencilStart).count() << " ms\n";
+
+				glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+				for (auto const& v : model.m_vertices)
+				{
+					lo = glm::min(lo, v.pos);
+					hi = glm::max(hi, v.pos);
+				}
+				cageScale = glm::length(hi - lo);
 			}
 
-			state.shouldSubdivision = 0;
+			if (state.animateCage)
+				cageTime += dt;
+
+			// once switched off, one more pass puts the rest cage back
+			animatedCage.resize(model.m_vertices.size());
+			for (std::size_t i = 0; i < model.m_vertices.size(); ++i)
+			{
+				auto const& v = model.m_vertices[i];
+				float const wave = state.animateCage
+					? 0.03f * cageScale * std::sin(3.f * cageTime + 8.f * v.pos.y / cageScale)
+					: 0.f;
+				animatedCage[i] = glm::vec4(v.pos + wave * v.normal, 1.f);
+			}
+			write_stencil_cage(allocator, stencils, animatedCage, std::uint32_t(frameIndex));
+			cageDeformed = state.animateCage;
+
+			stencilPass.pipeline = stencilcompPipe.handle;
+			stencilPass.layout = stencilpipeLayout.handle;
+			stencilPass.descriptors = stencilDescriptors;
+			stencilPass.buffers = &stencils;
+			stencilPass.drawVertices = limitSurface ? subMeshes[curr].controlPoints.buffer : subMeshes[curr].drawVertices.buffer;
+			stencilPass.slot = std::uint32_t(frameIndex);
+			if (limitSurface)
+			{
+				stencilPass.limit = &limitPass;
+				stencilPass.mesh = &subMeshes[curr];
+			}
 		}
 		
+		PatchDraw patchDraw{};
+		if (tessellatePatches)
+		{
+			patchDraw.pipeline = patchPipe.handle;
+			patchDraw.layout = patchLayout.handle;
+			patchDraw.controlPoints = patchMesh.controlPoints.buffer;
+			patchDraw.sides = patchMesh.sides.buffer;
+			patchDraw.patchCount = patchMesh.patchCount;
+			patchDraw.constants.viewport = glm::vec2(window.swapchainExtent.width, window.swapchainExtent.height);
+			patchDraw.constants.pixelsPerSegment = 8.f;
+		}
+
 		// record commands according to subTime for drawing
 		if (model.subTime == 0)
 		{
@@ -708,6 +1069,7 @@ int main() try
 				wire_pipe22.handle,
 				window.swapchainExtent,
 				subMeshes[curr].drawVertices.buffer,
+				subMeshes[curr].drawNormals.buffer,
 				subMeshes[curr].drawIndices.buffer,
 				subMeshes[curr].drawLinelists.buffer,
 				subMeshes[curr].faceCount * 6,
@@ -715,7 +1077,11 @@ int main() try
 				sceneUBO.buffer,
 				sceneUniforms,
 				pipeLayout.handle,
-				sceneDescriptors
+				sceneDescriptors,
+				evaluateStencils ? &stencilPass : nullptr,
+				tessellatePatches ? &patchDraw : nullptr,
+				&gpuProfiler,
+				std::uint32_t(frameIndex)
 			);
 		}
 
@@ -743,6 +1109,7 @@ int main() try
 	// to ensure that all Vulkan commands have finished before that.
 	vkDeviceWaitIdle( window.device );
 
+	write_trace(tracePath);
 	return 0;
 }
 catch( std::exception const& eErr )
@@ -793,6 +1160,24 @@ namespace
 				state->shouldSubdivision = 1;
 			}
 			break;
+		case GLFW_KEY_O:
+			if (aAction == GLFW_PRESS)
+			{
+				state->shouldCoarsen = 1;
+			}
+			break;
+		case GLFW_KEY_G:
+			if (aAction == GLFW_PRESS)
+			{
+				state->animateCage = !state->animateCage;
+			}
+			break;
+		case GLFW_KEY_T:
+			if (aAction == GLFW_PRESS)
+			{
+				state->printGpuTimes = 1;
+			}
+			break;
 
 		case GLFW_KEY_LEFT_SHIFT: [[fallthrough]];
 		case GLFW_KEY_RIGHT_SHIFT:
@@ -837,25 +1222,34 @@ namespace
 
 }
 
-namespace
+void update_scene_uniforms(glsl::SceneUniform& aSceneUniforms, std::uint32_t aFramebufferWidth, std::uint32_t aFramebufferHeight, glm::mat4 const& aCamera2world)
 {
-	void update_scene_uniforms(glsl::SceneUniform& aSceneUniforms, std::uint32_t aFramebufferWidth, std::uint32_t aFramebufferHeight, UserState& aState)
-	{
-		float const aspect = aFramebufferWidth / float(aFramebufferHeight);
+	float const aspect = aFramebufferWidth / float(aFramebufferHeight);
 
-		aSceneUniforms.projection = glm::perspectiveRH_ZO(
-			lut::Radians(cfg::kCameraFov).value(),
-			aspect,
-			cfg::kCameraNear,
-			cfg::kCameraFar
-		);
-		aSceneUniforms.projection[1][1] *= -1.f; // mirror Y axis
+	aSceneUniforms.projection = glm::perspectiveRH_ZO(
+		lut::Radians(cfg::kCameraFov).value(),
+		aspect,
+		cfg::kCameraNear,
+		cfg::kCameraFar
+	);
+	aSceneUniforms.projection[1][1] *= -1.f; // mirror Y axis
 
-		aSceneUniforms.camera = glm::inverse(aState.camera2world);
+	aSceneUniforms.camera = glm::inverse(aCamera2world);
 
-		aSceneUniforms.projCam = aSceneUniforms.projection * aSceneUniforms.camera;
-	}
+	aSceneUniforms.projCam = aSceneUniforms.projection * aSceneUniforms.camera;
+}
 
+glm::mat4 frame_bounds(glm::vec3 const& aMin, glm::vec3 const& aMax)
+{
+	// the bounding sphere just touches the top and bottom of the view
+	float const radius = 0.5f * glm::length(aMax - aMin);
+	float const distance = radius / std::sin(0.5f * lut::Radians(cfg::kCameraFov).value());
+
+	return glm::translate(0.5f * (aMin + aMax) + glm::vec3(0.f, 0.f, distance));
+}
+
+namespace
+{
 	void update_user_state(UserState& aState, float aElapsedTime)
 	{
 		auto& cam = aState.camera2world;
@@ -905,124 +1299,163 @@ namespace
 
 }
 
+lut::RenderPass create_render_pass(lut::VulkanContext const& aContext, VkFormat aColorFormat, VkImageLayout aFinalLayout)
+{
+	VkAttachmentDescription attachments[2]{};
+	attachments[0].format = aColorFormat;
+	attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+	attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	attachments[0].finalLayout = aFinalLayout;
+
+	attachments[1].format = cfg::kDepthFormat;
+	attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+	attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+
+	VkAttachmentReference subpassAttachments[1]{};
+	subpassAttachments[0].attachment = 0; // this refers to attachments[0]
+	subpassAttachments[0].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	// New:
+	VkAttachmentReference depthAttachment{};
+	depthAttachment.attachment = 1; // this refers to attachments[1]
+	depthAttachment.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkSubpassDescription subpasses[1]{};
+	subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpasses[0].colorAttachmentCount = 1;
+	subpasses[0].pColorAttachments = subpassAttachments;
+	// New line for depth attachment
+	subpasses[0].pDepthStencilAttachment = &depthAttachment;
+
+
+	// Requires a subpass dependency to ensure that the first transition happens after the presentation engine is done with it.
+	// https://github.com/KhronosGroup/Vulkan-Docs/wiki/Synchronization-Examples-(Legacy-synchronization-APIs)#combined-graphicspresent-queue
+	// WARNING: The following has changed! Make sure to update it!
+	VkSubpassDependency deps[2]{};
+	deps[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+	deps[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	deps[0].srcAccessMask = 0;
+	deps[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	deps[0].dstSubpass = 0;
+	deps[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	deps[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+
+	deps[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+	deps[1].srcSubpass = VK_SUBPASS_EXTERNAL;
+	deps[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	deps[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	deps[1].dstSubpass = 0;
+	deps[1].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+	deps[1].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+
+
+	// https://www.khronos.org/registry/vulkan/specs/1.2-extensions/man/html/VkRenderPassCreateInfo.html
+	VkRenderPassCreateInfo passInfo{};
+	passInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	passInfo.attachmentCount = 2;
+	passInfo.pAttachments = attachments;
+	passInfo.subpassCount = 1;
+	passInfo.pSubpasses = subpasses;
+	passInfo.dependencyCount = 2; // different dependency, same code
+	passInfo.pDependencies = deps; // different dependency, same code
+
+	VkRenderPass rpass = VK_NULL_HANDLE;
+	if (auto const res = vkCreateRenderPass(aContext.device, &passInfo, nullptr, &rpass);
+		VK_SUCCESS != res)
+	{
+		throw lut::Error("Unable to create render pass\n"
+			"vkCreateRenderPass() returned %s\n", lut::to_string(res).c_str());
+	}
+
+	return lut::RenderPass(aContext.device, rpass);
+
+}
+
 namespace
 {
 	lut::RenderPass create_render_pass(lut::VulkanWindow const& aWindow)
 	{
-		VkAttachmentDescription attachments[2]{};
-		attachments[0].format = aWindow.swapchainFormat;
-		attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
-		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-		attachments[1].format = cfg::kDepthFormat;
-		attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
-		attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-
-		VkAttachmentReference subpassAttachments[1]{};
-		subpassAttachments[0].attachment = 0; // this refers to attachments[0]
-		subpassAttachments[0].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-		// New:
-		VkAttachmentReference depthAttachment{};
-		depthAttachment.attachment = 1; // this refers to attachments[1]
-		depthAttachment.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-		VkSubpassDescription subpasses[1]{};
-		subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-		subpasses[0].colorAttachmentCount = 1;
-		subpasses[0].pColorAttachments = subpassAttachments;
-		// New line for depth attachment
-		subpasses[0].pDepthStencilAttachment = &depthAttachment;
-
-
-		// Requires a subpass dependency to ensure that the first transition happens after the presentation engine is done with it.
-		// https://github.com/KhronosGroup/Vulkan-Docs/wiki/Synchronization-Examples-(Legacy-synchronization-APIs)#combined-graphicspresent-queue
-		// WARNING: The following has changed! Make sure to update it!
-		VkSubpassDependency deps[2]{};
-		deps[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-		deps[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-		deps[0].srcAccessMask = 0;
-		deps[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		deps[0].dstSubpass = 0;
-		deps[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		deps[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-
-		deps[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-		deps[1].srcSubpass = VK_SUBPASS_EXTERNAL;
-		deps[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-		deps[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-		deps[1].dstSubpass = 0;
-		deps[1].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
-		deps[1].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-
-
-		// https://www.khronos.org/registry/vulkan/specs/1.2-extensions/man/html/VkRenderPassCreateInfo.html
-		VkRenderPassCreateInfo passInfo{};
-		passInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-		passInfo.attachmentCount = 2;
-		passInfo.pAttachments = attachments;
-		passInfo.subpassCount = 1;
-		passInfo.pSubpasses = subpasses;
-		passInfo.dependencyCount = 2; // different dependency, same code
-		passInfo.pDependencies = deps; // different dependency, same code
-
-		VkRenderPass rpass = VK_NULL_HANDLE;
-		if (auto const res = vkCreateRenderPass(aWindow.device, &passInfo, nullptr, &rpass);
-			VK_SUCCESS != res)
-		{
-			throw lut::Error("Unable to create render pass\n"
-				"vkCreateRenderPass() returned %s\n", lut::to_string(res).c_str());
-		}
+		return create_render_pass(aWindow, aWindow.swapchainFormat, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+	}
+}
+
+lut::PipelineLayout create_pipeline_layout(lut::VulkanContext const& aContext, VkDescriptorSetLayout aSceneLayout)
+{
+	VkDescriptorSetLayout layouts[] = {
+		// Order must match the set = N in the shaders
+		aSceneLayout // set 0
+	};
 
-		return lut::RenderPass(aWindow.device, rpass);
+	VkPipelineLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.setLayoutCount = sizeof(layouts) / sizeof(layouts[0]); // updated!
+	layoutInfo.pSetLayouts = layouts; // updated!
+	layoutInfo.pushConstantRangeCount = 0;
+	layoutInfo.pPushConstantRanges = nullptr;
 
+	VkPipelineLayout layout = VK_NULL_HANDLE;
+	if (auto const res = vkCreatePipelineLayout(aContext.device, &layoutInfo, nullptr, &layout);
+		VK_SUCCESS != res)
+	{
+		throw lut::Error("Unable to create pipeline layout\n"
+			"vkCreatePipelineLayout() returned %s",
+			lut::to_string(res).c_str());
 	}
 
-	lut::PipelineLayout create_pipeline_layout(lut::VulkanContext const& aContext, VkDescriptorSetLayout aSceneLayout)
+	return lut::PipelineLayout(aContext.device, layout);
+
+}
+
+namespace
+{
+	lut::PipelineLayout create_compute_pipeline_layout(lut::VulkanContext const& aContext, VkDescriptorSetLayout aComputeSetLayout)
 	{
 		VkDescriptorSetLayout layouts[] = {
-			// Order must match the set = N in the shaders
-			aSceneLayout // set 0
+			aComputeSetLayout  // set = 0, matches shader
 		};
 
+		// Describe push constant range
+		VkPushConstantRange pcRange{};
+		pcRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pcRange.offset = 0;
+		pcRange.size = sizeof(uint32_t) * 3; // vertexCount, edgeCount, faceCount
+
 		VkPipelineLayoutCreateInfo layoutInfo{};
 		layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		layoutInfo.setLayoutCount = sizeof(layouts) / sizeof(layouts[0]); // updated!
-		layoutInfo.pSetLayouts = layouts; // updated!
-		layoutInfo.pushConstantRangeCount = 0;
-		layoutInfo.pPushConstantRanges = nullptr;
+		layoutInfo.setLayoutCount = 1;
+		layoutInfo.pSetLayouts = layouts;
+		layoutInfo.pushConstantRangeCount = 1;
+		layoutInfo.pPushConstantRanges = &pcRange;
 
 		VkPipelineLayout layout = VK_NULL_HANDLE;
 		if (auto const res = vkCreatePipelineLayout(aContext.device, &layoutInfo, nullptr, &layout);
 			VK_SUCCESS != res)
 		{
-			throw lut::Error("Unable to create pipeline layout\n"
+			throw lut::Error("Unable to create compute pipeline layout\n"
 				"vkCreatePipelineLayout() returned %s",
 				lut::to_string(res).c_str());
 		}
 
-		return lut::PipelineLayout(aContext.device, layout);
-
+		return labutils::PipelineLayout(aContext.device, layout);
 	}
 
-	lut::PipelineLayout create_compute_pipeline_layout(lut::VulkanContext const& aContext, VkDescriptorSetLayout aComputeSetLayout)
+	lut::PipelineLayout create_patch_pipeline_layout(lut::VulkanContext const& aContext, VkDescriptorSetLayout aSceneLayout)
 	{
 		VkDescriptorSetLayout layouts[] = {
-			aComputeSetLayout  // set = 0, matches shader
+			aSceneLayout // set 0
 		};
 
-		// Describe push constant range
+		// PatchConstants, read by bsplinePatch.tesc
 		VkPushConstantRange pcRange{};
-		pcRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pcRange.stageFlags = VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
 		pcRange.offset = 0;
-		pcRange.size = sizeof(uint32_t) * 3; // vertexCount, edgeCount, faceCount
+		pcRange.size = sizeof(PatchConstants);
 
 		VkPipelineLayoutCreateInfo layoutInfo{};
 		layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -1035,7 +1468,7 @@ namespace
 		if (auto const res = vkCreatePipelineLayout(aContext.device, &layoutInfo, nullptr, &layout);
 			VK_SUCCESS != res)
 		{
-			throw lut::Error("Unable to create compute pipeline layout\n"
+			throw lut::Error("Unable to create patch pipeline layout\n"
 				"vkCreatePipelineLayout() returned %s",
 				lut::to_string(res).c_str());
 		}
@@ -1361,15 +1794,188 @@ namespace
 		return lut::Pipeline(aWindow.device, pipe);
 
 	}
+}
+
+lut::Pipeline create_model_pipeline2(lut::VulkanContext const& aContext, VkExtent2D aExtent, VkRenderPass aRenderPass, VkPipelineLayout aPipelineLayout)
+{
+
+	//Load shader modules
+	lut::ShaderModule vert = lut::load_shader_module(aContext, cfg::kVertQuadPath);
+	lut::ShaderModule frag = lut::load_shader_module(aContext, cfg::kFragQuadPath);
+
+	// Define shader stages in the pipeline
+	VkPipelineShaderStageCreateInfo stages[2]{};
+
+	stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	stages[0].module = vert.handle;
+	stages[0].pName = "main";
+
+	stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	stages[1].module = frag.handle;
+	stages[1].pName = "main";
+
+	// Pull data from the vertex buffer
+	VkPipelineVertexInputStateCreateInfo inputInfo{};
+
+	// Declare how data is read from buffer: positions, then the limit
+	// normals (all zero unless the level was pushed to the limit surface)
+	VkVertexInputBindingDescription vertexInputs[2]{};
+	vertexInputs[0].binding = 0;
+	vertexInputs[0].stride = sizeof(glm::vec4);
+	vertexInputs[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	vertexInputs[1].binding = 1;
+	vertexInputs[1].stride = sizeof(glm::vec4);
+	vertexInputs[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	// Map data to vertex shaders' input
+	VkVertexInputAttributeDescription vertexAttributes[2]{};
+
+	// Position attribute
+	vertexAttributes[0].binding = 0; // must match binding above
+	vertexAttributes[0].location = 0; // must match shader
+	vertexAttributes[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+	vertexAttributes[0].offset = 0;
+
+	// Normal attribute
+	vertexAttributes[1].binding = 1; // must match binding above
+	vertexAttributes[1].location = 1; // must match shader
+	vertexAttributes[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+	vertexAttributes[1].offset = 0;
+
+
+	inputInfo.vertexBindingDescriptionCount = 2; // number of vertexInputs above
+	inputInfo.pVertexBindingDescriptions = vertexInputs;
+
+	inputInfo.vertexAttributeDescriptionCount = 2; // number of vertexAttributes above
+	inputInfo.pVertexAttributeDescriptions = vertexAttributes;
+
+	inputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+	// Define which primitive (point, line, triangle, ...) the input is assembled into for rasterization.
+	VkPipelineInputAssemblyStateCreateInfo assemblyInfo{};
+	assemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	assemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	assemblyInfo.primitiveRestartEnable = VK_FALSE;
+
+	// Define viewport and scissor regions
+	VkViewport viewport{};
+	viewport.x = 0.f;
+	viewport.y = 0.f;
+
+	viewport.width = aExtent.width;
+	viewport.height = aExtent.height;
+
+	viewport.minDepth = 0.f;
+	viewport.maxDepth = 1.f;
+
+	VkRect2D scissor{};
+	scissor.offset = VkOffset2D{ 0, 0 };
+	scissor.extent = VkExtent2D{ aExtent.width, aExtent.height };
+
+	VkPipelineViewportStateCreateInfo viewportInfo{};
+	viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportInfo.viewportCount = 1;
+	viewportInfo.pViewports = &viewport;
+	viewportInfo.scissorCount = 1;
+	viewportInfo.pScissors = &scissor;
+
+	// Define rasterization options
+	VkPipelineRasterizationStateCreateInfo rasterInfo{};
+	rasterInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterInfo.depthClampEnable = VK_FALSE;
+	rasterInfo.rasterizerDiscardEnable = VK_FALSE;
+	rasterInfo.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterInfo.cullMode = VK_CULL_MODE_NONE;
+	rasterInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	rasterInfo.lineWidth = 1.f; // Required.
+	rasterInfo.depthBiasEnable = VK_TRUE;
+	rasterInfo.depthBiasConstantFactor = 1.f;   // translate a little for wireframes before mesh
+	rasterInfo.depthBiasSlopeFactor = 1.f;
+
+
+	// Define multisampling state
+	VkPipelineMultisampleStateCreateInfo samplingInfo{};
+	samplingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	samplingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	// Define blend state
+	// We define one blend state per color attachment - this example uses a single color attachment, so we only need one.
+	VkPipelineColorBlendAttachmentState blendStates[1]{};
+	blendStates[0].blendEnable = VK_FALSE;
+	blendStates[0].colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+		VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+	VkPipelineColorBlendStateCreateInfo blendInfo{};
+	blendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	blendInfo.logicOpEnable = VK_FALSE;
+	blendInfo.attachmentCount = 1;
+	blendInfo.pAttachments = blendStates;
+
+	VkPipelineDepthStencilStateCreateInfo depthInfo{};
+	depthInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthInfo.depthTestEnable = VK_TRUE;
+	depthInfo.depthWriteEnable = VK_TRUE;
+	depthInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+	depthInfo.minDepthBounds = 0.f;
+	depthInfo.maxDepthBounds = 1.f;
+
+
+	// Create pipeline
+	// finally!
+	VkGraphicsPipelineCreateInfo pipeInfo{};
+	pipeInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+
+	pipeInfo.stageCount = 2; // vertex + fragment stages
+	pipeInfo.pStages = stages;
+
+	pipeInfo.pVertexInputState = &inputInfo;
+	pipeInfo.pInputAssemblyState = &assemblyInfo;
+	pipeInfo.pTessellationState = nullptr; // no tessellation
+	pipeInfo.pViewportState = &viewportInfo;
+	pipeInfo.pRasterizationState = &rasterInfo;
+	pipeInfo.pMultisampleState = &samplingInfo;
+	//pipeInfo.pDepthStencilState = nullptr; // no depth or stencil buffers
+	pipeInfo.pColorBlendState = &blendInfo;
+	pipeInfo.pDynamicState = nullptr; // no dynamic states
+	pipeInfo.pDepthStencilState = &depthInfo;
+
+	pipeInfo.layout = aPipelineLayout;
+	pipeInfo.renderPass = aRenderPass;
+	pipeInfo.subpass = 0; // first subpass of aRenderPass
+
+	VkPipeline pipe = VK_NULL_HANDLE;
+	if (auto const res = vkCreateGraphicsPipelines(aContext.device, VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &pipe);
+		VK_SUCCESS != res)
+	{
+		throw lut::Error("Unable to create graphics pipeline\n"
+			"vkCreateGraphicsPipelines() returned %s", lut::to_string(res).c_str());
+	}
+
+	return lut::Pipeline(aContext.device, pipe);
+
+}
+
+namespace
+{
 	lut::Pipeline create_model_pipeline2(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, VkPipelineLayout aPipelineLayout)
+	{
+		return create_model_pipeline2(aWindow, aWindow.swapchainExtent, aRenderPass, aPipelineLayout);
+	}
+
+	lut::Pipeline create_patch_pipeline(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, VkPipelineLayout aPipelineLayout)
 	{
 
 		//Load shader modules
-		lut::ShaderModule vert = lut::load_shader_module(aWindow, cfg::kVertModelPath);
-		lut::ShaderModule frag = lut::load_shader_module(aWindow, cfg::kFragModelPath);
+		lut::ShaderModule vert = lut::load_shader_module(aWindow, cfg::kVertPatchPath);
+		lut::ShaderModule tesc = lut::load_shader_module(aWindow, cfg::kTescPatchPath);
+		lut::ShaderModule tese = lut::load_shader_module(aWindow, cfg::kTesePatchPath);
+		lut::ShaderModule frag = lut::load_shader_module(aWindow, cfg::kFragQuadPath);
 
 		// Define shader stages in the pipeline
-		VkPipelineShaderStageCreateInfo stages[2]{};
+		VkPipelineShaderStageCreateInfo stages[4]{};
 
 		stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
@@ -1377,25 +1983,35 @@ namespace
 		stages[0].pName = "main";
 
 		stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		stages[1].module = frag.handle;
+		stages[1].stage = VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+		stages[1].module = tesc.handle;
 		stages[1].pName = "main";
 
+		stages[2].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		stages[2].stage = VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+		stages[2].module = tese.handle;
+		stages[2].pName = "main";
+
+		stages[3].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		stages[3].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		stages[3].module = frag.handle;
+		stages[3].pName = "main";
+
 		// Pull data from the vertex buffer
 		VkPipelineVertexInputStateCreateInfo inputInfo{};
 
-		// Declare how data is read from buffer
-		VkVertexInputBindingDescription vertexInputs[1]{};
+		// Declare how data is read from buffer: 16 control points per patch,
+		// and the side data next to them (see PatchMesh)
+		VkVertexInputBindingDescription vertexInputs[2]{};
 		vertexInputs[0].binding = 0;
 		vertexInputs[0].stride = sizeof(glm::vec4);
 		vertexInputs[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-		//vertexInputs[1].binding = 1;
-		//vertexInputs[1].stride = sizeof(float) * 2;
-		//vertexInputs[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		vertexInputs[1].binding = 1;
+		vertexInputs[1].stride = sizeof(glm::vec4);
+		vertexInputs[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
 		// Map data to vertex shaders' input
-		VkVertexInputAttributeDescription vertexAttributes[1]{};
+		VkVertexInputAttributeDescription vertexAttributes[2]{};
 
 		// Position attribute
 		vertexAttributes[0].binding = 0; // must match binding above
@@ -1403,17 +2019,17 @@ namespace
 		vertexAttributes[0].format = VK_FORMAT_R32G32B32_SFLOAT;
 		vertexAttributes[0].offset = 0;
 
-		// Index attribute
-		//vertexAttributes[1].binding = 1; // must match binding above
-		//vertexAttributes[1].location = 1; // must match shader
-		//vertexAttributes[1].format = VK_FORMAT_R32G32_SFLOAT;
-		//vertexAttributes[1].offset = 0;
+		// Side attribute
+		vertexAttributes[1].binding = 1;
+		vertexAttributes[1].location = 1;
+		vertexAttributes[1].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		vertexAttributes[1].offset = 0;
 
 
-		inputInfo.vertexBindingDescriptionCount = 1; // number of vertexInputs above
+		inputInfo.vertexBindingDescriptionCount = 2; // number of vertexInputs above
 		inputInfo.pVertexBindingDescriptions = vertexInputs;
 
-		inputInfo.vertexAttributeDescriptionCount = 1; // number of vertexAttributes above
+		inputInfo.vertexAttributeDescriptionCount = 2; // number of vertexAttributes above
 		inputInfo.pVertexAttributeDescriptions = vertexAttributes;
 
 		inputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -1421,9 +2037,13 @@ namespace
 		// Define which primitive (point, line, triangle, ...) the input is assembled into for rasterization.
 		VkPipelineInputAssemblyStateCreateInfo assemblyInfo{};
 		assemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-		assemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		assemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_PATCH_LIST;
 		assemblyInfo.primitiveRestartEnable = VK_FALSE;
 
+		VkPipelineTessellationStateCreateInfo tessInfo{};
+		tessInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_TESSELLATION_STATE_CREATE_INFO;
+		tessInfo.patchControlPoints = 16;
+
 		// Define viewport and scissor regions
 		VkViewport viewport{};
 		viewport.x = 0.f;
@@ -1492,12 +2112,12 @@ namespace
 		VkGraphicsPipelineCreateInfo pipeInfo{};
 		pipeInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
 
-		pipeInfo.stageCount = 2; // vertex + fragment stages
+		pipeInfo.stageCount = 4; // vertex + tessellation + fragment stages
 		pipeInfo.pStages = stages;
 
 		pipeInfo.pVertexInputState = &inputInfo;
 		pipeInfo.pInputAssemblyState = &assemblyInfo;
-		pipeInfo.pTessellationState = nullptr; // no tessellation
+		pipeInfo.pTessellationState = &tessInfo;
 		pipeInfo.pViewportState = &viewportInfo;
 		pipeInfo.pRasterizationState = &rasterInfo;
 		pipeInfo.pMultisampleState = &samplingInfo;
@@ -1514,7 +2134,7 @@ namespace
 		if (auto const res = vkCreateGraphicsPipelines(aWindow.device, VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &pipe);
 			VK_SUCCESS != res)
 		{
-			throw lut::Error("Unable to create graphics pipeline\n"
+			throw lut::Error("Unable to create patch pipeline\n"
 				"vkCreateGraphicsPipelines() returned %s", lut::to_string(res).c_str());
 		}
 
@@ -1675,7 +2295,172 @@ namespace
 		return lut::Pipeline(aWindow.device, pipe);
 
 	}
+}
+
+lut::Pipeline create_wireframe_pipeline22(lut::VulkanContext const& aContext, VkExtent2D aExtent, VkRenderPass aRenderPass, VkPipelineLayout aPipelineLayout)
+{
+	//Load shader modules
+	lut::ShaderModule vert = lut::load_shader_module(aContext, cfg::kVertModelPath);
+	lut::ShaderModule frag = lut::load_shader_module(aContext, cfg::kFragWirePath);
+
+	// Define shader stages in the pipeline
+	VkPipelineShaderStageCreateInfo stages[2]{};
+
+	stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	stages[0].module = vert.handle;
+	stages[0].pName = "main";
+
+	stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	stages[1].module = frag.handle;
+	stages[1].pName = "main";
+
+	// Pull data from the vertex buffer
+	VkPipelineVertexInputStateCreateInfo inputInfo{};
+
+	// Declare how data is read from buffer
+	VkVertexInputBindingDescription vertexInputs[1]{};
+	vertexInputs[0].binding = 0;
+	vertexInputs[0].stride = sizeof(glm::vec4);
+	vertexInputs[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	//vertexInputs[1].binding = 1;
+	//vertexInputs[1].stride = sizeof(float) * 2;
+	//vertexInputs[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	// Map data to vertex shaders' input
+	VkVertexInputAttributeDescription vertexAttributes[1]{};
+
+	// Position attribute
+	vertexAttributes[0].binding = 0; // must match binding above
+	vertexAttributes[0].location = 0; // must match shader
+	vertexAttributes[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+	vertexAttributes[0].offset = 0;
+
+	inputInfo.vertexBindingDescriptionCount = 1; // number of vertexInputs above
+	inputInfo.pVertexBindingDescriptions = vertexInputs;
+
+	inputInfo.vertexAttributeDescriptionCount = 1; // number of vertexAttributes above
+	inputInfo.pVertexAttributeDescriptions = vertexAttributes;
+
+	inputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+	// Define which primitive (point, line, triangle, ...) the input is assembled into for rasterization.
+	VkPipelineInputAssemblyStateCreateInfo assemblyInfo{};
+	assemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	assemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+	assemblyInfo.primitiveRestartEnable = VK_FALSE;
+
+	// Define viewport and scissor regions
+	VkViewport viewport{};
+	viewport.x = 0.f;
+	viewport.y = 0.f;
+
+	viewport.width = aExtent.width;
+	viewport.height = aExtent.height;
+
+	viewport.minDepth = 0.f;
+	viewport.maxDepth = 1.f;
+
+	VkRect2D scissor{};
+	scissor.offset = VkOffset2D{ 0, 0 };
+	scissor.extent = VkExtent2D{ aExtent.width, aExtent.height };
+
+	VkPipelineViewportStateCreateInfo viewportInfo{};
+	viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportInfo.viewportCount = 1;
+	viewportInfo.pViewports = &viewport;
+	viewportInfo.scissorCount = 1;
+	viewportInfo.pScissors = &scissor;
+
+	// Define rasterization(draw lines!!)
+	VkPipelineRasterizationStateCreateInfo rasterInfo{};
+	rasterInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterInfo.depthClampEnable = VK_FALSE;
+	rasterInfo.rasterizerDiscardEnable = VK_FALSE;
+	rasterInfo.polygonMode = VK_POLYGON_MODE_LINE;
+	rasterInfo.cullMode = VK_CULL_MODE_NONE;
+	rasterInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	rasterInfo.lineWidth = 1.f; // Required.
+	// Set bias for depth-buffer
+	rasterInfo.depthBiasEnable = VK_FALSE;
+	//rasterInfo.depthBiasConstantFactor = -1.f;   // translate a little for wireframes before mesh
+	//rasterInfo.depthBiasSlopeFactor = -1.f;
+
+
+	// Define multisampling state
+	VkPipelineMultisampleStateCreateInfo samplingInfo{};
+	samplingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	samplingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	// Define blend state
+	// We define one blend state per color attachment - this example uses a single color attachment, so we only need one.
+	VkPipelineColorBlendAttachmentState blendStates[1]{};
+	blendStates[0].blendEnable = VK_FALSE;
+	blendStates[0].colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+		VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+	VkPipelineColorBlendStateCreateInfo blendInfo{};
+	blendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	blendInfo.logicOpEnable = VK_FALSE;
+	blendInfo.attachmentCount = 1;
+	blendInfo.pAttachments = blendStates;
+
+	VkPipelineDepthStencilStateCreateInfo depthInfo{};
+	depthInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+
+	depthInfo.depthTestEnable = VK_TRUE;
+	depthInfo.depthWriteEnable = VK_TRUE;
+	depthInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+	depthInfo.minDepthBounds = 0.f;
+	depthInfo.maxDepthBounds = 1.f;
+
+
+	// Create pipeline
+	// finally!
+	VkGraphicsPipelineCreateInfo pipeInfo{};
+	pipeInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+
+	pipeInfo.stageCount = 2; // vertex + fragment stages
+	pipeInfo.pStages = stages;
+
+	pipeInfo.pVertexInputState = &inputInfo;
+	pipeInfo.pInputAssemblyState = &assemblyInfo;
+	pipeInfo.pTessellationState = nullptr; // no tessellation
+	pipeInfo.pViewportState = &viewportInfo;
+	pipeInfo.pRasterizationState = &rasterInfo;
+	pipeInfo.pMultisampleState = &samplingInfo;
+	//pipeInfo.pDepthStencilState = nullptr; // no depth or stencil buffers
+	pipeInfo.pColorBlendState = &blendInfo;
+	pipeInfo.pDynamicState = nullptr; // no dynamic states
+	pipeInfo.pDepthStencilState = &depthInfo;
+
+	pipeInfo.layout = aPipelineLayout;
+	pipeInfo.renderPass = aRenderPass;
+	pipeInfo.subpass = 0; // first subpass of aRenderPass
+
+
+	VkPipeline pipe = VK_NULL_HANDLE;
+	if (auto const res = vkCreateGraphicsPipelines(aContext.device, VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &pipe);
+		VK_SUCCESS != res)
+	{
+		throw lut::Error("Unable to create graphics pipeline\n"
+			"vkCreateGraphicsPipelines() returned %s", lut::to_string(res).c_str());
+	}
+
+	return lut::Pipeline(aContext.device, pipe);
+
+}
+
+namespace
+{
 	lut::Pipeline create_wireframe_pipeline22(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, VkPipelineLayout aPipelineLayout)
+	{
+		return create_wireframe_pipeline22(aWindow, aWindow.swapchainExtent, aRenderPass, aPipelineLayout);
+	}
+
+	lut::Pipeline create_wireframe_pipeline1(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, VkPipelineLayout aPipelineLayout)
 	{
 		//Load shader modules
 		lut::ShaderModule vert = lut::load_shader_module(aWindow, cfg::kVertModelPath);
@@ -1700,7 +2485,7 @@ namespace
 		// Declare how data is read from buffer
 		VkVertexInputBindingDescription vertexInputs[1]{};
 		vertexInputs[0].binding = 0;
-		vertexInputs[0].stride = sizeof(glm::vec4);
+		vertexInputs[0].stride = sizeof(glm::vec3);
 		vertexInputs[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
 		//vertexInputs[1].binding = 1;
@@ -1830,8 +2615,7 @@ namespace
 		return lut::Pipeline(aWindow.device, pipe);
 
 	}
-
-	lut::Pipeline create_wireframe_pipeline1(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, VkPipelineLayout aPipelineLayout)
+	lut::Pipeline create_wireframe_pipeline2(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, VkPipelineLayout aPipelineLayout)
 	{
 		//Load shader modules
 		lut::ShaderModule vert = lut::load_shader_module(aWindow, cfg::kVertModelPath);
@@ -1856,162 +2640,7 @@ namespace
 		// Declare how data is read from buffer
 		VkVertexInputBindingDescription vertexInputs[1]{};
 		vertexInputs[0].binding = 0;
-		vertexInputs[0].stride = sizeof(glm::vec3);
-		vertexInputs[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-		//vertexInputs[1].binding = 1;
-		//vertexInputs[1].stride = sizeof(float) * 2;
-		//vertexInputs[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-		// Map data to vertex shaders' input
-		VkVertexInputAttributeDescription vertexAttributes[1]{};
-
-		// Position attribute
-		vertexAttributes[0].binding = 0; // must match binding above
-		vertexAttributes[0].location = 0; // must match shader
-		vertexAttributes[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-		vertexAttributes[0].offset = 0;
-
-		inputInfo.vertexBindingDescriptionCount = 1; // number of vertexInputs above
-		inputInfo.pVertexBindingDescriptions = vertexInputs;
-
-		inputInfo.vertexAttributeDescriptionCount = 1; // number of vertexAttributes above
-		inputInfo.pVertexAttributeDescriptions = vertexAttributes;
-
-		inputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-
-		// Define which primitive (point, line, triangle, ...) the input is assembled into for rasterization.
-		VkPipelineInputAssemblyStateCreateInfo assemblyInfo{};
-		assemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-		assemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
-		assemblyInfo.primitiveRestartEnable = VK_FALSE;
-
-		// Define viewport and scissor regions
-		VkViewport viewport{};
-		viewport.x = 0.f;
-		viewport.y = 0.f;
-
-		viewport.width = aWindow.swapchainExtent.width;
-		viewport.height = aWindow.swapchainExtent.height;
-
-		viewport.minDepth = 0.f;
-		viewport.maxDepth = 1.f;
-
-		VkRect2D scissor{};
-		scissor.offset = VkOffset2D{ 0, 0 };
-		scissor.extent = VkExtent2D{ aWindow.swapchainExtent.width, aWindow.swapchainExtent.height };
-
-		VkPipelineViewportStateCreateInfo viewportInfo{};
-		viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-		viewportInfo.viewportCount = 1;
-		viewportInfo.pViewports = &viewport;
-		viewportInfo.scissorCount = 1;
-		viewportInfo.pScissors = &scissor;
-
-		// Define rasterization(draw lines!!)
-		VkPipelineRasterizationStateCreateInfo rasterInfo{};
-		rasterInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-		rasterInfo.depthClampEnable = VK_FALSE;
-		rasterInfo.rasterizerDiscardEnable = VK_FALSE;
-		rasterInfo.polygonMode = VK_POLYGON_MODE_LINE;
-		rasterInfo.cullMode = VK_CULL_MODE_NONE;
-		rasterInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-		rasterInfo.lineWidth = 1.f; // Required.
-		// Set bias for depth-buffer
-		rasterInfo.depthBiasEnable = VK_FALSE;
-		//rasterInfo.depthBiasConstantFactor = -1.f;   // translate a little for wireframes before mesh
-		//rasterInfo.depthBiasSlopeFactor = -1.f;
-
-
-		// Define multisampling state
-		VkPipelineMultisampleStateCreateInfo samplingInfo{};
-		samplingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-		samplingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-		// Define blend state
-		// We define one blend state per color attachment - this example uses a single color attachment, so we only need one.
-		VkPipelineColorBlendAttachmentState blendStates[1]{};
-		blendStates[0].blendEnable = VK_FALSE;
-		blendStates[0].colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-			VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-
-		VkPipelineColorBlendStateCreateInfo blendInfo{};
-		blendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-		blendInfo.logicOpEnable = VK_FALSE;
-		blendInfo.attachmentCount = 1;
-		blendInfo.pAttachments = blendStates;
-
-		VkPipelineDepthStencilStateCreateInfo depthInfo{};
-		depthInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-
-		depthInfo.depthTestEnable = VK_TRUE;
-		depthInfo.depthWriteEnable = VK_TRUE;
-		depthInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
-		depthInfo.minDepthBounds = 0.f;
-		depthInfo.maxDepthBounds = 1.f;
-
-
-		// Create pipeline
-		// finally!
-		VkGraphicsPipelineCreateInfo pipeInfo{};
-		pipeInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-
-		pipeInfo.stageCount = 2; // vertex + fragment stages
-		pipeInfo.pStages = stages;
-
-		pipeInfo.pVertexInputState = &inputInfo;
-		pipeInfo.pInputAssemblyState = &assemblyInfo;
-		pipeInfo.pTessellationState = nullptr; // no tessellation
-		pipeInfo.pViewportState = &viewportInfo;
-		pipeInfo.pRasterizationState = &rasterInfo;
-		pipeInfo.pMultisampleState = &samplingInfo;
-		//pipeInfo.pDepthStencilState = nullptr; // no depth or stencil buffers
-		pipeInfo.pColorBlendState = &blendInfo;
-		pipeInfo.pDynamicState = nullptr; // no dynamic states
-		pipeInfo.pDepthStencilState = &depthInfo;
-
-		pipeInfo.layout = aPipelineLayout;
-		pipeInfo.renderPass = aRenderPass;
-		pipeInfo.subpass = 0; // first subpass of aRenderPass
-
-
-		VkPipeline pipe = VK_NULL_HANDLE;
-		if (auto const res = vkCreateGraphicsPipelines(aWindow.device, VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &pipe);
-			VK_SUCCESS != res)
-		{
-			throw lut::Error("Unable to create graphics pipeline\n"
-				"vkCreateGraphicsPipelines() returned %s", lut::to_string(res).c_str());
-		}
-
-		return lut::Pipeline(aWindow.device, pipe);
-
-	}
-	lut::Pipeline create_wireframe_pipeline2(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, VkPipelineLayout aPipelineLayout)
-	{
-		//Load shader modules
-		lut::ShaderModule vert = lut::load_shader_module(aWindow, cfg::kVertModelPath);
-		lut::ShaderModule frag = lut::load_shader_module(aWindow, cfg::kFragWirePath);
-
-		// Define shader stages in the pipeline
-		VkPipelineShaderStageCreateInfo stages[2]{};
-
-		stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-		stages[0].module = vert.handle;
-		stages[0].pName = "main";
-
-		stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		stages[1].module = frag.handle;
-		stages[1].pName = "main";
-
-		// Pull data from the vertex buffer
-		VkPipelineVertexInputStateCreateInfo inputInfo{};
-
-		// Declare how data is read from buffer
-		VkVertexInputBindingDescription vertexInputs[1]{};
-		vertexInputs[0].binding = 0;
-		vertexInputs[0].stride = sizeof(glm::vec4);
+		vertexInputs[0].stride = sizeof(glm::vec4);
 		vertexInputs[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
 		//vertexInputs[1].binding = 1;
@@ -2146,12 +2775,12 @@ namespace
 		return lut::Pipeline(aWindow.device, pipe);
 
 	}
-	lut::Pipeline create_compute_pipeline(lut::VulkanWindow const& aWindow, VkPipelineLayout aPipelineLayout)
+	lut::Pipeline create_compute_pipeline(lut::VulkanContext const& aContext, VkPipelineLayout aPipelineLayout)
 	{
 
 		//Load shader modules
-		lut::ShaderModule comp = lut::load_shader_module(aWindow, cfg::kCompShaderPath);
-		//lut::ShaderModule frag = lut::load_shader_module(aWindow, cfg::kFragModelPath);
+		lut::ShaderModule comp = lut::load_shader_module(aContext, cfg::kCompShaderPath);
+		//lut::ShaderModule frag = lut::load_shader_module(aContext, cfg::kFragModelPath);
 
 		// Define shader stages in the pipeline
 		VkPipelineShaderStageCreateInfo stages[1]{};
@@ -2169,22 +2798,22 @@ namespace
 
 		
 		VkPipeline pipe = VK_NULL_HANDLE;
-		if (auto const res = vkCreateComputePipelines(aWindow.device, VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &pipe);
+		if (auto const res = vkCreateComputePipelines(aContext.device, VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &pipe);
 			VK_SUCCESS != res)
 		{
 			throw lut::Error("Unable to create compute pipeline\n"
 				"vkCreateComputePipelines() returned %s", lut::to_string(res).c_str());
 		}
 
-		return lut::Pipeline(aWindow.device, pipe);
+		return lut::Pipeline(aContext.device, pipe);
 
 	}
 
-	lut::Pipeline create_face_compute_pipeline(lut::VulkanWindow const& aWindow, VkPipelineLayout aPipelineLayout)
+	lut::Pipeline create_face_compute_pipeline(lut::VulkanContext const& aContext, VkPipelineLayout aPipelineLayout)
 	{
 
 		//Load shader modules
-		lut::ShaderModule comp = lut::load_shader_module(aWindow, cfg::kfaceCompShaderPath);
+		lut::ShaderModule comp = lut::load_shader_module(aContext, cfg::kfaceCompShaderPath);
 
 		// Define shader stages in the pipeline
 		VkPipelineShaderStageCreateInfo stages[1]{};
@@ -2202,21 +2831,21 @@ namespace
 
 
 		VkPipeline pipe = VK_NULL_HANDLE;
-		if (auto const res = vkCreateComputePipelines(aWindow.device, VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &pipe);
+		if (auto const res = vkCreateComputePipelines(aContext.device, VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &pipe);
 			VK_SUCCESS != res)
 		{
 			throw lut::Error("Unable to create compute pipeline\n"
 				"vkCreateComputePipelines() returned %s", lut::to_string(res).c_str());
 		}
 
-		return lut::Pipeline(aWindow.device, pipe);
+		return lut::Pipeline(aContext.device, pipe);
 
 	}
-	lut::Pipeline create_edge_compute_pipeline(lut::VulkanWindow const& aWindow, VkPipelineLayout aPipelineLayout)
+	lut::Pipeline create_edge_compute_pipeline(lut::VulkanContext const& aContext, VkPipelineLayout aPipelineLayout)
 	{
 
 		//Load shader modules
-		lut::ShaderModule comp = lut::load_shader_module(aWindow, cfg::kedgeCompShaderPath);
+		lut::ShaderModule comp = lut::load_shader_module(aContext, cfg::kedgeCompShaderPath);
 
 		// Define shader stages in the pipeline
 		VkPipelineShaderStageCreateInfo stages[1]{};
@@ -2234,21 +2863,21 @@ namespace
 
 
 		VkPipeline pipe = VK_NULL_HANDLE;
-		if (auto const res = vkCreateComputePipelines(aWindow.device, VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &pipe);
+		if (auto const res = vkCreateComputePipelines(aContext.device, VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &pipe);
 			VK_SUCCESS != res)
 		{
 			throw lut::Error("Unable to create compute pipeline\n"
 				"vkCreateComputePipelines() returned %s", lut::to_string(res).c_str());
 		}
 
-		return lut::Pipeline(aWindow.device, pipe);
+		return lut::Pipeline(aContext.device, pipe);
 
 	}
-	lut::Pipeline create_vertex_compute_pipeline(lut::VulkanWindow const& aWindow, VkPipelineLayout aPipelineLayout)
+	lut::Pipeline create_vertex_compute_pipeline(lut::VulkanContext const& aContext, VkPipelineLayout aPipelineLayout)
 	{
 
 		//Load shader modules
-		lut::ShaderModule comp = lut::load_shader_module(aWindow, cfg::kvertexCompShaderPath);
+		lut::ShaderModule comp = lut::load_shader_module(aContext, cfg::kvertexCompShaderPath);
 
 		// Define shader stages in the pipeline
 		VkPipelineShaderStageCreateInfo stages[1]{};
@@ -2261,25 +2890,165 @@ namespace
 
 		VkComputePipelineCreateInfo pipeInfo{};
 		pipeInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-		pipeInfo.stage = stages[0];
+		pipeInfo.stage = stages[0];
+		pipeInfo.layout = aPipelineLayout;
+
+
+		VkPipeline pipe = VK_NULL_HANDLE;
+		if (auto const res = vkCreateComputePipelines(aContext.device, VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &pipe);
+			VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to create compute pipeline\n"
+				"vkCreateComputePipelines() returned %s", lut::to_string(res).c_str());
+		}
+
+		return lut::Pipeline(aContext.device, pipe);
+
+	}
+	lut::Pipeline create_draw_compute_pipeline(lut::VulkanContext const& aContext, VkPipelineLayout aPipelineLayout)
+	{
+		// Step 1: Load compute shader module
+		lut::ShaderModule comp = lut::load_shader_module(aContext, cfg::kdrawCompShaderPath);
+
+		// Step 2: Describe compute shader stage
+		VkPipelineShaderStageCreateInfo stageInfo{};
+		stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		stageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		stageInfo.module = comp.handle;
+		stageInfo.pName = "main";
+
+		// Step 3: Create compute pipeline
+		VkComputePipelineCreateInfo pipeInfo{};
+		pipeInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipeInfo.stage = stageInfo;
+		pipeInfo.layout = aPipelineLayout;
+
+		VkPipeline pipe = VK_NULL_HANDLE;
+		if (auto const res = vkCreateComputePipelines(aContext.device, VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &pipe);
+			VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to create draw compute pipeline\n"
+				"vkCreateComputePipelines() returned %s", lut::to_string(res).c_str());
+		}
+
+		return lut::Pipeline(aContext.device, pipe);
+	}
+	lut::Pipeline create_stencil_compute_pipeline(lut::VulkanContext const& aContext, VkPipelineLayout aPipelineLayout)
+	{
+		// Step 1: Load compute shader module
+		lut::ShaderModule comp = lut::load_shader_module(aContext, cfg::kstencilCompShaderPath);
+
+		// Step 2: Describe compute shader stage
+		VkPipelineShaderStageCreateInfo stageInfo{};
+		stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		stageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		stageInfo.module = comp.handle;
+		stageInfo.pName = "main";
+
+		// Step 3: Create compute pipeline
+		VkComputePipelineCreateInfo pipeInfo{};
+		pipeInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipeInfo.stage = stageInfo;
+		pipeInfo.layout = aPipelineLayout;
+
+		VkPipeline pipe = VK_NULL_HANDLE;
+		if (auto const res = vkCreateComputePipelines(aContext.device, VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &pipe);
+			VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to create stencil compute pipeline\n"
+				"vkCreateComputePipelines() returned %s", lut::to_string(res).c_str());
+		}
+
+		return lut::Pipeline(aContext.device, pipe);
+	}
+	lut::Pipeline create_topology_compute_pipeline(lut::VulkanContext const& aContext, VkPipelineLayout aPipelineLayout)
+	{
+		// Step 1: Load compute shader module
+		lut::ShaderModule comp = lut::load_shader_module(aContext, cfg::ktopologyCompShaderPath);
+
+		// Step 2: Describe compute shader stage
+		VkPipelineShaderStageCreateInfo stageInfo{};
+		stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		stageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		stageInfo.module = comp.handle;
+		stageInfo.pName = "main";
+
+		// Step 3: Create compute pipeline
+		VkComputePipelineCreateInfo pipeInfo{};
+		pipeInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipeInfo.stage = stageInfo;
+		pipeInfo.layout = aPipelineLayout;
+
+		VkPipeline pipe = VK_NULL_HANDLE;
+		if (auto const res = vkCreateComputePipelines(aContext.device, VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &pipe);
+			VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to create topology compute pipeline\n"
+				"vkCreateComputePipelines() returned %s", lut::to_string(res).c_str());
+		}
+
+		return lut::Pipeline(aContext.device, pipe);
+	}
+	lut::Pipeline create_adjacency_compute_pipeline(lut::VulkanContext const& aContext, VkPipelineLayout aPipelineLayout)
+	{
+		// Step 1: Load compute shader module
+		lut::ShaderModule comp = lut::load_shader_module(aContext, cfg::kadjacencyCompShaderPath);
+
+		// Step 2: Describe compute shader stage
+		VkPipelineShaderStageCreateInfo stageInfo{};
+		stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		stageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		stageInfo.module = comp.handle;
+		stageInfo.pName = "main";
+
+		// Step 3: Create compute pipeline
+		VkComputePipelineCreateInfo pipeInfo{};
+		pipeInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipeInfo.stage = stageInfo;
+		pipeInfo.layout = aPipelineLayout;
+
+		VkPipeline pipe = VK_NULL_HANDLE;
+		if (auto const res = vkCreateComputePipelines(aContext.device, VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &pipe);
+			VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to create adjacency compute pipeline\n"
+				"vkCreateComputePipelines() returned %s", lut::to_string(res).c_str());
+		}
+
+		return lut::Pipeline(aContext.device, pipe);
+	}
+	lut::Pipeline create_scan_compute_pipeline(lut::VulkanContext const& aContext, VkPipelineLayout aPipelineLayout)
+	{
+		// Step 1: Load compute shader module
+		lut::ShaderModule comp = lut::load_shader_module(aContext, cfg::kscanCompShaderPath);
+
+		// Step 2: Describe compute shader stage
+		VkPipelineShaderStageCreateInfo stageInfo{};
+		stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		stageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		stageInfo.module = comp.handle;
+		stageInfo.pName = "main";
+
+		// Step 3: Create compute pipeline
+		VkComputePipelineCreateInfo pipeInfo{};
+		pipeInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipeInfo.stage = stageInfo;
 		pipeInfo.layout = aPipelineLayout;
 
-
 		VkPipeline pipe = VK_NULL_HANDLE;
-		if (auto const res = vkCreateComputePipelines(aWindow.device, VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &pipe);
+		if (auto const res = vkCreateComputePipelines(aContext.device, VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &pipe);
 			VK_SUCCESS != res)
 		{
-			throw lut::Error("Unable to create compute pipeline\n"
+			throw lut::Error("Unable to create scan compute pipeline\n"
 				"vkCreateComputePipelines() returned %s", lut::to_string(res).c_str());
 		}
 
-		return lut::Pipeline(aWindow.device, pipe);
-
+		return lut::Pipeline(aContext.device, pipe);
 	}
-	lut::Pipeline create_draw_compute_pipeline(lut::VulkanWindow const& aWindow, VkPipelineLayout aPipelineLayout)
+	lut::Pipeline create_limit_compute_pipeline(lut::VulkanContext const& aContext, VkPipelineLayout aPipelineLayout)
 	{
 		// Step 1: Load compute shader module
-		lut::ShaderModule comp = lut::load_shader_module(aWindow, cfg::kdrawCompShaderPath);
+		lut::ShaderModule comp = lut::load_shader_module(aContext, cfg::klimitCompShaderPath);
 
 		// Step 2: Describe compute shader stage
 		VkPipelineShaderStageCreateInfo stageInfo{};
@@ -2295,14 +3064,14 @@ namespace
 		pipeInfo.layout = aPipelineLayout;
 
 		VkPipeline pipe = VK_NULL_HANDLE;
-		if (auto const res = vkCreateComputePipelines(aWindow.device, VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &pipe);
+		if (auto const res = vkCreateComputePipelines(aContext.device, VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &pipe);
 			VK_SUCCESS != res)
 		{
-			throw lut::Error("Unable to create draw compute pipeline\n"
+			throw lut::Error("Unable to create limit compute pipeline\n"
 				"vkCreateComputePipelines() returned %s", lut::to_string(res).c_str());
 		}
 
-		return lut::Pipeline(aWindow.device, pipe);
+		return lut::Pipeline(aContext.device, pipe);
 	}
 
 
@@ -2345,39 +3114,45 @@ namespace
 		}
 
 	}
+}
 
-	lut::DescriptorSetLayout create_scene_descriptor_layout( lut::VulkanWindow const& aWindow )
+lut::DescriptorSetLayout create_scene_descriptor_layout( lut::VulkanContext const& aContext )
+{
+	// Step 1: Describe binding for the uniform buffer
+	VkDescriptorSetLayoutBinding bindings[1]{};
+	bindings[0].binding = 0; // must match binding = 0 in the shader
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	bindings[0].descriptorCount = 1;
+	// the patch pipeline projects in its tessellation stages
+	bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT
+		| VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT | VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+
+	// Step 2: Fill layout create info
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = sizeof(bindings) / sizeof(bindings[0]);
+	layoutInfo.pBindings = bindings;
+
+	// Step 3: Create the descriptor set layout
+	VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+	if (auto const res = vkCreateDescriptorSetLayout(aContext.device, &layoutInfo, nullptr, &layout); VK_SUCCESS != res)
 	{
-		// Step 1: Describe binding for the uniform buffer
-		VkDescriptorSetLayoutBinding bindings[1]{};
-		bindings[0].binding = 0; // must match binding = 0 in the shader
-		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		bindings[0].descriptorCount = 1;
-		bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-
-		// Step 2: Fill layout create info
-		VkDescriptorSetLayoutCreateInfo layoutInfo{};
-		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-		layoutInfo.bindingCount = sizeof(bindings) / sizeof(bindings[0]);
-		layoutInfo.pBindings = bindings;
+		throw lut::Error("Unable to create descriptor set layout\n" "vkCreateDescriptorSetLayout() returned %s",
+			lut::to_string(res).c_str());
+	}
 
-		// Step 3: Create the descriptor set layout
-		VkDescriptorSetLayout layout = VK_NULL_HANDLE;
-		if (auto const res = vkCreateDescriptorSetLayout(aWindow.device, &layoutInfo, nullptr, &layout); VK_SUCCESS != res)
-		{
-			throw lut::Error("Unable to create descriptor set layout\n" "vkCreateDescriptorSetLayout() returned %s",
-				lut::to_string(res).c_str());
-		}
+	// Step 4: Return wrapped descriptor set layout
+	return lut::DescriptorSetLayout(aContext.device, layout);
 
-		// Step 4: Return wrapped descriptor set layout
-		return lut::DescriptorSetLayout(aWindow.device, layout);
+}
 
-	}
-	lut::DescriptorSetLayout create_object_descriptor_layout( lut::VulkanWindow const& aWindow )
+namespace
+{
+	lut::DescriptorSetLayout create_object_descriptor_layout( lut::VulkanContext const& aContext )
 	{
 		throw lut::Error( "Not yet implemented" ); //TODO: (Section 4) implement me!
 	}
-	lut::DescriptorSetLayout create_compute_descriptor_layout(lut::VulkanWindow const& aWindow)
+	lut::DescriptorSetLayout create_compute_descriptor_layout(lut::VulkanContext const& aContext)
 	{
 		// Step 1: Describe binding for the storage buffer
 		VkDescriptorSetLayoutBinding bindings[1]{};
@@ -2394,17 +3169,17 @@ namespace
 
 		// Step 3: Create the descriptor set layout
 		VkDescriptorSetLayout layout = VK_NULL_HANDLE;
-		if (auto const res = vkCreateDescriptorSetLayout(aWindow.device, &layoutInfo, nullptr, &layout); VK_SUCCESS != res)
+		if (auto const res = vkCreateDescriptorSetLayout(aContext.device, &layoutInfo, nullptr, &layout); VK_SUCCESS != res)
 		{
 			throw lut::Error("Unable to create descriptor set layout\n" "vkCreateDescriptorSetLayout() returned %s",
 				lut::to_string(res).c_str());
 		}
 
 		// Step 4: Return wrapped descriptor set layout
-		return lut::DescriptorSetLayout(aWindow.device, layout);
+		return lut::DescriptorSetLayout(aContext.device, layout);
 
 	}
-	lut::DescriptorSetLayout create_descriptor_set_layout_face(lut::VulkanWindow const& aWindow)
+	lut::DescriptorSetLayout create_descriptor_set_layout_face(lut::VulkanContext const& aContext)
 	{
 		// Step 1: Describe binding for the storage buffer
 		VkDescriptorSetLayoutBinding bindings[3]{};
@@ -2431,19 +3206,19 @@ namespace
 
 		// Step 3: Create the descriptor set layout
 		VkDescriptorSetLayout layout = VK_NULL_HANDLE;
-		if (auto const res = vkCreateDescriptorSetLayout(aWindow.device, &layoutInfo, nullptr, &layout); VK_SUCCESS != res)
+		if (auto const res = vkCreateDescriptorSetLayout(aContext.device, &layoutInfo, nullptr, &layout); VK_SUCCESS != res)
 		{
 			throw lut::Error("Unable to create descriptor set layout\n" "vkCreateDescriptorSetLayout() returned %s",
 				lut::to_string(res).c_str());
 		}
 
 		// Step 4: Return wrapped descriptor set layout
-		return lut::DescriptorSetLayout(aWindow.device, layout);
+		return lut::DescriptorSetLayout(aContext.device, layout);
 	}
-	lut::DescriptorSetLayout create_descriptor_set_layout_edge(lut::VulkanWindow const& aWindow)
+	lut::DescriptorSetLayout create_descriptor_set_layout_edge(lut::VulkanContext const& aContext)
 	{
 		// Step 1: Describe binding for the storage buffer
-		VkDescriptorSetLayoutBinding bindings[5]{};
+		VkDescriptorSetLayoutBinding bindings[6]{};
 		bindings[0].binding = 0;
 		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
 		bindings[0].descriptorCount = 1;
@@ -2471,6 +3246,11 @@ namespace
 		bindings[4].descriptorCount = 1;
 		bindings[4].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
+		bindings[5].binding = 13;
+		bindings[5].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[5].descriptorCount = 1;
+		bindings[5].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
 		// Step 2: Fill layout create info
 		VkDescriptorSetLayoutCreateInfo layoutInfo{};
 		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -2479,19 +3259,19 @@ namespace
 
 		// Step 3: Create the descriptor set layout
 		VkDescriptorSetLayout layout = VK_NULL_HANDLE;
-		if (auto const res = vkCreateDescriptorSetLayout(aWindow.device, &layoutInfo, nullptr, &layout); VK_SUCCESS != res)
+		if (auto const res = vkCreateDescriptorSetLayout(aContext.device, &layoutInfo, nullptr, &layout); VK_SUCCESS != res)
 		{
 			throw lut::Error("Unable to create descriptor set layout\n" "vkCreateDescriptorSetLayout() returned %s",
 				lut::to_string(res).c_str());
 		}
 
 		// Step 4: Return wrapped descriptor set layout
-		return lut::DescriptorSetLayout(aWindow.device, layout);
+		return lut::DescriptorSetLayout(aContext.device, layout);
 	}
-	lut::DescriptorSetLayout create_descriptor_set_layout_vertex(lut::VulkanWindow const& aWindow)
+	lut::DescriptorSetLayout create_descriptor_set_layout_vertex(lut::VulkanContext const& aContext)
 	{
 		// Step 1: Describe binding for the storage buffer
-		VkDescriptorSetLayoutBinding bindings[9]{};
+		VkDescriptorSetLayoutBinding bindings[12]{};
 		bindings[0].binding = 0;
 		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
 		bindings[0].descriptorCount = 1;
@@ -2539,6 +3319,21 @@ namespace
 		bindings[8].descriptorCount = 1;
 		bindings[8].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
+		bindings[9].binding = 11;
+		bindings[9].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[9].descriptorCount = 1;
+		bindings[9].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		bindings[10].binding = 12;
+		bindings[10].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[10].descriptorCount = 1;
+		bindings[10].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		bindings[11].binding = 13;
+		bindings[11].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[11].descriptorCount = 1;
+		bindings[11].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
 		// Step 2: Fill layout create info
 		VkDescriptorSetLayoutCreateInfo layoutInfo{};
 		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -2547,18 +3342,18 @@ namespace
 
 		// Step 3: Create the descriptor set layout
 		VkDescriptorSetLayout layout = VK_NULL_HANDLE;
-		if (auto const res = vkCreateDescriptorSetLayout(aWindow.device, &layoutInfo, nullptr, &layout); VK_SUCCESS != res)
+		if (auto const res = vkCreateDescriptorSetLayout(aContext.device, &layoutInfo, nullptr, &layout); VK_SUCCESS != res)
 		{
 			throw lut::Error("Unable to create descriptor set layout\n" "vkCreateDescriptorSetLayout() returned %s",
 				lut::to_string(res).c_str());
 		}
 
 		// Step 4: Return wrapped descriptor set layout
-		return lut::DescriptorSetLayout(aWindow.device, layout);
+		return lut::DescriptorSetLayout(aContext.device, layout);
 	}
-	lut::DescriptorSetLayout create_descriptor_set_layout_draw(lut::VulkanWindow const& aWindow)
+	lut::DescriptorSetLayout create_descriptor_set_layout_draw(lut::VulkanContext const& aContext)
 	{
-		VkDescriptorSetLayoutBinding bindings[10]{};
+		VkDescriptorSetLayoutBinding bindings[9]{};
 
 		// binding 0 : updatedVertices   (read)
 		bindings[0].binding = 0;
@@ -2600,9 +3395,6 @@ namespace
 		bindings[8] = bindings[5];
 		bindings[8].binding = 8;
 
-		// binding 9 : newEdgeList       (write ─ 12×face raw edges)
-		bindings[9] = bindings[5];
-		bindings[9].binding = 9;
 
 
 
@@ -2615,14 +3407,207 @@ namespace
 		layoutInfo.pBindings = bindings;
 
 		VkDescriptorSetLayout layout = VK_NULL_HANDLE;
-		if (auto const res = vkCreateDescriptorSetLayout(aWindow.device, &layoutInfo, nullptr, &layout);
+		if (auto const res = vkCreateDescriptorSetLayout(aContext.device, &layoutInfo, nullptr, &layout);
 			VK_SUCCESS != res)
 		{
 			throw lut::Error("Unable to create draw descriptor set layout\n"
 				"vkCreateDescriptorSetLayout() returned %s", lut::to_string(res).c_str());
 		}
 
-		return lut::DescriptorSetLayout(aWindow.device, layout);
+		return lut::DescriptorSetLayout(aContext.device, layout);
+	}
+	lut::DescriptorSetLayout create_descriptor_set_layout_stencil(lut::VulkanContext const& aContext)
+	{
+		VkDescriptorSetLayoutBinding bindings[5]{};
+
+		// binding 0 : cagePoints        (read)
+		bindings[0].binding = 0;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[0].descriptorCount = 1;
+		bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		// binding 1 : stencilOffsets    (read)
+		bindings[1] = bindings[0];
+		bindings[1].binding = 1;
+
+		// binding 2 : stencilIndices    (read)
+		bindings[2] = bindings[0];
+		bindings[2].binding = 2;
+
+		// binding 3 : stencilWeights    (read)
+		bindings[3] = bindings[0];
+		bindings[3].binding = 3;
+
+		// binding 4 : drawVertices      (write - VBO for draw)
+		bindings[4] = bindings[0];
+		bindings[4].binding = 4;
+
+		// Create layout
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(std::size(bindings));
+		layoutInfo.pBindings = bindings;
+
+		VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+		if (auto const res = vkCreateDescriptorSetLayout(aContext.device, &layoutInfo, nullptr, &layout);
+			VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to create stencil descriptor set layout\n"
+				"vkCreateDescriptorSetLayout() returned %s", lut::to_string(res).c_str());
+		}
+
+		return lut::DescriptorSetLayout(aContext.device, layout);
+	}
+
+	lut::DescriptorSetLayout create_descriptor_set_layout_topology(lut::VulkanContext const& aContext)
+	{
+		VkDescriptorSetLayoutBinding bindings[10]{};
+
+		// binding 0 : quadFaces         (read)
+		bindings[0].binding = 0;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[0].descriptorCount = 1;
+		bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		// binding 1 : faceEdgeIndices   (read)
+		// binding 2 : edgeToFace        (read)
+		// binding 3 : newFaceEdgeIndices (write)
+		// binding 4 : newEdgeList       (write)
+		// binding 5 : newEdgeToFace     (write)
+		// binding 6 : newVertexFaceCounts (write)
+		// binding 7 : newVertexEdgeCounts (write)
+		// binding 8 : edgeSharpness     (read)
+		// binding 9 : newEdgeSharpness  (write)
+		for (std::uint32_t i = 1; i < std::size(bindings); ++i)
+		{
+			bindings[i] = bindings[0];
+			bindings[i].binding = i;
+		}
+
+		// Create layout
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(std::size(bindings));
+		layoutInfo.pBindings = bindings;
+
+		VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+		if (auto const res = vkCreateDescriptorSetLayout(aContext.device, &layoutInfo, nullptr, &layout);
+			VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to create topology descriptor set layout\n"
+				"vkCreateDescriptorSetLayout() returned %s", lut::to_string(res).c_str());
+		}
+
+		return lut::DescriptorSetLayout(aContext.device, layout);
+	}
+	lut::DescriptorSetLayout create_descriptor_set_layout_adjacency(lut::VulkanContext const& aContext)
+	{
+		VkDescriptorSetLayoutBinding bindings[9]{};
+
+		// binding 0 : quadFaces         (read)
+		bindings[0].binding = 0;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[0].descriptorCount = 1;
+		bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		// binding 1 : faceEdgeIndices   (read)
+		// binding 2 : edgeToFace        (read)
+		// binding 3 : vertexFaceIndices (read)
+		// binding 4 : vertexEdgeIndices (read)
+		// binding 5 : newVertexFaceOffsets (read)
+		// binding 6 : newVertexEdgeOffsets (read)
+		// binding 7 : newVertexFaceIndices (write)
+		// binding 8 : newVertexEdgeIndices (write)
+		for (std::uint32_t i = 1; i < std::size(bindings); ++i)
+		{
+			bindings[i] = bindings[0];
+			bindings[i].binding = i;
+		}
+
+		// Create layout
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(std::size(bindings));
+		layoutInfo.pBindings = bindings;
+
+		VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+		if (auto const res = vkCreateDescriptorSetLayout(aContext.device, &layoutInfo, nullptr, &layout);
+			VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to create adjacency descriptor set layout\n"
+				"vkCreateDescriptorSetLayout() returned %s", lut::to_string(res).c_str());
+		}
+
+		return lut::DescriptorSetLayout(aContext.device, layout);
+	}
+
+	lut::DescriptorSetLayout create_descriptor_set_layout_scan(lut::VulkanContext const& aContext)
+	{
+		VkDescriptorSetLayoutBinding bindings[3]{};
+
+		// binding 0 : counts            (read)
+		bindings[0].binding = 0;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[0].descriptorCount = 1;
+		bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		// binding 1 : offsets           (write)
+		bindings[1] = bindings[0];
+		bindings[1].binding = 1;
+
+		// binding 2 : blockSums         (scratch)
+		bindings[2] = bindings[0];
+		bindings[2].binding = 2;
+
+		// Create layout
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(std::size(bindings));
+		layoutInfo.pBindings = bindings;
+
+		VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+		if (auto const res = vkCreateDescriptorSetLayout(aContext.device, &layoutInfo, nullptr, &layout);
+			VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to create scan descriptor set layout\n"
+				"vkCreateDescriptorSetLayout() returned %s", lut::to_string(res).c_str());
+		}
+
+		return lut::DescriptorSetLayout(aContext.device, layout);
+	}
+
+	lut::DescriptorSetLayout create_descriptor_set_layout_limit(lut::VulkanContext const& aContext)
+	{
+		VkDescriptorSetLayoutBinding bindings[12]{};
+
+		// bindings 0 - 9 : controlPoints, quadFaces, faceEdgeIndices,
+		// edgeToFace, edgeList, vertexFaceOffsets, vertexFaceIndices,
+		// vertexEdgeOffsets, vertexEdgeIndices, edgeSharpness (read)
+		// binding 10     : drawVertices  (write - VBO for draw)
+		// binding 11     : drawNormals   (write - VBO for draw)
+		for (std::uint32_t i = 0; i < std::size(bindings); ++i)
+		{
+			bindings[i].binding = i;
+			bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[i].descriptorCount = 1;
+			bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+
+		// Create layout
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(std::size(bindings));
+		layoutInfo.pBindings = bindings;
+
+		VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+		if (auto const res = vkCreateDescriptorSetLayout(aContext.device, &layoutInfo, nullptr, &layout);
+			VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to create limit descriptor set layout\n"
+				"vkCreateDescriptorSetLayout() returned %s", lut::to_string(res).c_str());
+		}
+
+		return lut::DescriptorSetLayout(aContext.device, layout);
 	}
 
 	struct PushConstants {
@@ -2630,212 +3615,680 @@ namespace
 		uint32_t edgeCount;
 		uint32_t faceCount;
 	};
+}
+
+SubdivisionPipelines create_subdivision_pipelines(lut::VulkanContext const& aContext, VkDescriptorPool aPool)
+{
+	SubdivisionPipelines ret;
+
+	ret.faceLayout = create_descriptor_set_layout_face(aContext);
+	ret.edgeLayout = create_descriptor_set_layout_edge(aContext);
+	ret.vertexLayout = create_descriptor_set_layout_vertex(aContext);
+	ret.drawLayout = create_descriptor_set_layout_draw(aContext);
+	ret.topologyLayout = create_descriptor_set_layout_topology(aContext);
+	ret.adjacencyLayout = create_descriptor_set_layout_adjacency(aContext);
+	ret.scanLayout = create_descriptor_set_layout_scan(aContext);
+	ret.limitLayout = create_descriptor_set_layout_limit(aContext);
+
+	ret.facePipeLayout = create_compute_pipeline_layout(aContext, ret.faceLayout.handle);
+	ret.edgePipeLayout = create_compute_pipeline_layout(aContext, ret.edgeLayout.handle);
+	ret.vertexPipeLayout = create_compute_pipeline_layout(aContext, ret.vertexLayout.handle);
+	ret.drawPipeLayout = create_compute_pipeline_layout(aContext, ret.drawLayout.handle);
+	ret.topologyPipeLayout = create_compute_pipeline_layout(aContext, ret.topologyLayout.handle);
+	ret.adjacencyPipeLayout = create_compute_pipeline_layout(aContext, ret.adjacencyLayout.handle);
+	ret.scanPipeLayout = create_compute_pipeline_layout(aContext, ret.scanLayout.handle);
+	ret.limitPipeLayout = create_compute_pipeline_layout(aContext, ret.limitLayout.handle);
+
+	ret.facePipe = create_face_compute_pipeline(aContext, ret.facePipeLayout.handle);
+	ret.edgePipe = create_edge_compute_pipeline(aContext, ret.edgePipeLayout.handle);
+	ret.vertexPipe = create_vertex_compute_pipeline(aContext, ret.vertexPipeLayout.handle);
+	ret.drawPipe = create_draw_compute_pipeline(aContext, ret.drawPipeLayout.handle);
+	ret.topologyPipe = create_topology_compute_pipeline(aContext, ret.topologyPipeLayout.handle);
+	ret.adjacencyPipe = create_adjacency_compute_pipeline(aContext, ret.adjacencyPipeLayout.handle);
+	ret.scanPipe = create_scan_compute_pipeline(aContext, ret.scanPipeLayout.handle);
+	ret.limitPipe = create_limit_compute_pipeline(aContext, ret.limitPipeLayout.handle);
+
+	// one pipeline, one set per scanned count array
+	ret.passes = SubdivisionPasses{
+		{ ret.facePipe.handle, ret.facePipeLayout.handle, lut::alloc_desc_set(aContext, aPool, ret.faceLayout.handle) },
+		{ ret.edgePipe.handle, ret.edgePipeLayout.handle, lut::alloc_desc_set(aContext, aPool, ret.edgeLayout.handle) },
+		{ ret.vertexPipe.handle, ret.vertexPipeLayout.handle, lut::alloc_desc_set(aContext, aPool, ret.vertexLayout.handle) },
+		{ ret.drawPipe.handle, ret.drawPipeLayout.handle, lut::alloc_desc_set(aContext, aPool, ret.drawLayout.handle) },
+		{ ret.topologyPipe.handle, ret.topologyPipeLayout.handle, lut::alloc_desc_set(aContext, aPool, ret.topologyLayout.handle) },
+		{ ret.scanPipe.handle, ret.scanPipeLayout.handle, lut::alloc_desc_set(aContext, aPool, ret.scanLayout.handle) },
+		{ ret.scanPipe.handle, ret.scanPipeLayout.handle, lut::alloc_desc_set(aContext, aPool, ret.scanLayout.handle) },
+		{ ret.adjacencyPipe.handle, ret.adjacencyPipeLayout.handle, lut::alloc_desc_set(aContext, aPool, ret.adjacencyLayout.handle) }
+	};
+	ret.limit = ComputePass{ ret.limitPipe.handle, ret.limitPipeLayout.handle, lut::alloc_desc_set(aContext, aPool, ret.limitLayout.handle) };
+
+	return ret;
+}
+
+void update_subdivision_descriptors(
+	lut::VulkanContext const& aContext,
+	SubdivisionPasses const& aPasses,
+	SubdivisionMesh const& inMesh,
+	SubdivisionMesh const& outMesh)
+{
+	struct Binding
+	{
+		VkDescriptorSet set;
+		std::uint32_t binding;
+		VkBuffer buffer;
+	};
+
+	// must match the set = 0 bindings of each shader
+	Binding const bindings[] = {
+		// facePoints.comp
+		{ aPasses.face.descriptors, 0, inMesh.controlPoints.buffer },
+		{ aPasses.face.descriptors, 1, inMesh.quadFaces.buffer },
+		{ aPasses.face.descriptors, 8, inMesh.facePoints.buffer },
+
+		// edgePoints.comp
+		{ aPasses.edge.descriptors, 0, inMesh.controlPoints.buffer },
+		{ aPasses.edge.descriptors, 2, inMesh.edgeList.buffer },
+		{ aPasses.edge.descriptors, 3, inMesh.edgeToFace.buffer },
+		{ aPasses.edge.descriptors, 8, inMesh.facePoints.buffer },
+		{ aPasses.edge.descriptors, 9, inMesh.edgePoints.buffer },
+		{ aPasses.edge.descriptors, 13, inMesh.edgeSharpness.buffer },
+
+		// vertexPoints.comp
+		{ aPasses.vertex.descriptors, 0, inMesh.controlPoints.buffer },
+		{ aPasses.vertex.descriptors, 1, inMesh.quadFaces.buffer },
+		{ aPasses.vertex.descriptors, 2, inMesh.edgeList.buffer },
+		{ aPasses.vertex.descriptors, 4, inMesh.vertexFaceCounts.buffer },
+		{ aPasses.vertex.descriptors, 5, inMesh.vertexFaceIndices.buffer },
+		{ aPasses.vertex.descriptors, 6, inMesh.vertexEdgeCounts.buffer },
+		{ aPasses.vertex.descriptors, 7, inMesh.vertexEdgeIndices.buffer },
+		{ aPasses.vertex.descriptors, 8, inMesh.facePoints.buffer },
+		{ aPasses.vertex.descriptors, 10, inMesh.updatedVertices.buffer },
+		{ aPasses.vertex.descriptors, 11, inMesh.vertexFaceOffsets.buffer },
+		{ aPasses.vertex.descriptors, 12, inMesh.vertexEdgeOffsets.buffer },
+		{ aPasses.vertex.descriptors, 13, inMesh.edgeSharpness.buffer },
+
+		// drawBuffer.comp
+		{ aPasses.draw.descriptors, 0, inMesh.updatedVertices.buffer },
+		{ aPasses.draw.descriptors, 1, inMesh.edgePoints.buffer },
+		{ aPasses.draw.descriptors, 2, inMesh.facePoints.buffer },
+		{ aPasses.draw.descriptors, 3, inMesh.quadFaces.buffer },
+		{ aPasses.draw.descriptors, 4, inMesh.faceEdgeIndices.buffer },
+		{ aPasses.draw.descriptors, 5, outMesh.drawVertices.buffer },
+		{ aPasses.draw.descriptors, 6, outMesh.drawIndices.buffer },
+		{ aPasses.draw.descriptors, 7, outMesh.controlPoints.buffer },
+		{ aPasses.draw.descriptors, 8, outMesh.quadFaces.buffer },
+
+		// refineTopology.comp
+		{ aPasses.topology.descriptors, 0, inMesh.quadFaces.buffer },
+		{ aPasses.topology.descriptors, 1, inMesh.faceEdgeIndices.buffer },
+		{ aPasses.topology.descriptors, 2, inMesh.edgeToFace.buffer },
+		{ aPasses.topology.descriptors, 3, outMesh.faceEdgeIndices.buffer },
+		{ aPasses.topology.descriptors, 4, outMesh.edgeList.buffer },
+		{ aPasses.topology.descriptors, 5, outMesh.edgeToFace.buffer },
+		{ aPasses.topology.descriptors, 6, outMesh.vertexFaceCounts.buffer },
+		{ aPasses.topology.descriptors, 7, outMesh.vertexEdgeCounts.buffer },
+		{ aPasses.topology.descriptors, 8, inMesh.edgeSharpness.buffer },
+		{ aPasses.topology.descriptors, 9, outMesh.edgeSharpness.buffer },
+
+		// prefixScan.comp, once per child count array
+		{ aPasses.faceScan.descriptors, 0, outMesh.vertexFaceCounts.buffer },
+		{ aPasses.faceScan.descriptors, 1, outMesh.vertexFaceOffsets.buffer },
+		{ aPasses.faceScan.descriptors, 2, outMesh.vertexFaceBlockSums.buffer },
+		{ aPasses.edgeScan.descriptors, 0, outMesh.vertexEdgeCounts.buffer },
+		{ aPasses.edgeScan.descriptors, 1, outMesh.vertexEdgeOffsets.buffer },
+		{ aPasses.edgeScan.descriptors, 2, outMesh.vertexEdgeBlockSums.buffer },
+
+		// refineAdjacency.comp
+		{ aPasses.adjacency.descriptors, 0, inMesh.quadFaces.buffer },
+		{ aPasses.adjacency.descriptors, 1, inMesh.faceEdgeIndices.buffer },
+		{ aPasses.adjacency.descriptors, 2, inMesh.edgeToFace.buffer },
+		{ aPasses.adjacency.descriptors, 3, inMesh.vertexFaceIndices.buffer },
+		{ aPasses.adjacency.descriptors, 4, inMesh.vertexEdgeIndices.buffer },
+		{ aPasses.adjacency.descriptors, 5, outMesh.vertexFaceOffsets.buffer },
+		{ aPasses.adjacency.descriptors, 6, outMesh.vertexEdgeOffsets.buffer },
+		{ aPasses.adjacency.descriptors, 7, outMesh.vertexFaceIndices.buffer },
+		{ aPasses.adjacency.descriptors, 8, outMesh.vertexEdgeIndices.buffer },
+	};
+	constexpr std::uint32_t count = sizeof(bindings) / sizeof(bindings[0]);
+
+	VkDescriptorBufferInfo infos[count]{};
+	VkWriteDescriptorSet desc[count]{};
+	for (std::uint32_t i = 0; i < count; ++i)
+	{
+		infos[i].buffer = bindings[i].buffer;
+		infos[i].range = VK_WHOLE_SIZE;
+
+		desc[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		desc[i].dstSet = bindings[i].set;
+		desc[i].dstBinding = bindings[i].binding;
+		desc[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		desc[i].descriptorCount = 1;
+		desc[i].pBufferInfo = &infos[i];
+	}
+
+	vkUpdateDescriptorSets(aContext.device, count, desc, 0, nullptr);
+}
+
+namespace
+{
+	struct ScanConstants {
+		uint32_t count;
+		uint32_t phase;
+		uint32_t unused;
+	};
+
+	// Three dispatches of prefixScan.comp; aOffsets is ready for compute reads afterwards.
+	void record_prefix_scan(VkCommandBuffer aCmdBuff, ComputePass const& aPass, VkBuffer aOffsets, VkBuffer aBlockSums, std::uint32_t aCount)
+	{
+		constexpr std::uint32_t kBlock = 512; // elements per workgroup, see prefixScan.comp
+		std::uint32_t const blocks = (aCount + 1 + kBlock - 1) / kBlock;
+
+		vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, aPass.pipeline);
+		vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, aPass.layout, 0, 1, &aPass.descriptors, 0, nullptr);
+
+		std::uint32_t const groups[3] = { blocks, 1, blocks };
+		for (std::uint32_t phase = 0; phase < 3; ++phase)
+		{
+			ScanConstants sc{ aCount, phase, 0 };
+			vkCmdPushConstants(aCmdBuff, aPass.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ScanConstants), &sc);
+			vkCmdDispatch(aCmdBuff, groups[phase], 1, 1);
+
+			for (VkBuffer buffer : { aOffsets, aBlockSums })
+			{
+				lut::buffer_barrier(
+					aCmdBuff, buffer,
+					VK_ACCESS_SHADER_WRITE_BIT,
+					VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+				);
+			}
+		}
+	}
+}
+
+void dispatch_subdivision_passes(
+	VkCommandBuffer aCmdBuff,
+	SubdivisionMesh const& inMesh,
+	SubdivisionMesh const& outMesh,
+	SubdivisionPasses const& aPasses,
+	ComputePass const* aLimitPass,
+	lut::GpuProfiler* aProfiler,
+	std::uint32_t aProfilerSlot
+)
+{
+	LUT_PROFILE_FUNCTION();
+
+	// All passes take the parent's counts
+	PushConstants pc{};
+	pc.vertexCount = inMesh.vertexCount;
+	pc.edgeCount = inMesh.edgeCount;
+	pc.faceCount = inMesh.faceCount;
+
+	auto dispatch = [&](ComputePass const& aPass, std::uint32_t aInvocations, char const* aName)
+		{
+			lut::GpuScope const scope(aProfiler, aCmdBuff, aName);
+			vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, aPass.pipeline);
+			vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, aPass.layout, 0, 1, &aPass.descriptors, 0, nullptr);
+			vkCmdPushConstants(aCmdBuff, aPass.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pc);
+			vkCmdDispatch(aCmdBuff, (aInvocations + 63) / 64, 1, 1); // 64 = local_size_x
+		};
+
+	// Begin recording commands
+	VkCommandBufferBeginInfo begInfo{};
+	begInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	begInfo.pInheritanceInfo = nullptr;
+
+	if (auto const res = vkBeginCommandBuffer(aCmdBuff, &begInfo); VK_SUCCESS != res) {
+		throw lut::Error(
+			"Unable to begin recording command buffer\n"
+			"vkBeginCommandBuffer() returned %s", lut::to_string(res).c_str()
+		);
+	}
+
+	if (aProfiler)
+		aProfiler->reset(aCmdBuff, aProfilerSlot);
+
+	// Child topology. Parent vertices keep their valence, so their counts
+	// are copied; refineTopology.comp writes those of the new points.
+	VkBufferCopy countCopy{};
+	countCopy.size = std::size_t(inMesh.vertexCount) * sizeof(std::uint32_t);
+	vkCmdCopyBuffer(aCmdBuff, inMesh.vertexFaceCounts.buffer, outMesh.vertexFaceCounts.buffer, 1, &countCopy);
+	vkCmdCopyBuffer(aCmdBuff, inMesh.vertexEdgeCounts.buffer, outMesh.vertexEdgeCounts.buffer, 1, &countCopy);
+
+	dispatch(aPasses.topology, 4 * pc.faceCount, "topology");
+
+	// Face Points
+	dispatch(aPasses.face, pc.faceCount, "face points");
+
+	// barrier1
+	lut::buffer_barrier(
+		aCmdBuff, inMesh.facePoints.buffer,
+		VK_ACCESS_SHADER_WRITE_BIT,   // Face pass写
+		VK_ACCESS_SHADER_READ_BIT,    // Edge pass读
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+	);
+
+	// Edge Points
+	dispatch(aPasses.edge, pc.edgeCount, "edge points");
+
+	// Vertex Points
+	dispatch(aPasses.vertex, pc.vertexCount, "vertex points");
+
+	// barrier2: edge and vertex points are both read by the draw pass
+	lut::buffer_barrier(
+		aCmdBuff, inMesh.edgePoints.buffer,
+		VK_ACCESS_SHADER_WRITE_BIT,
+		VK_ACCESS_SHADER_READ_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+	);
+	lut::buffer_barrier(
+		aCmdBuff, inMesh.updatedVertices.buffer,
+		VK_ACCESS_SHADER_WRITE_BIT,
+		VK_ACCESS_SHADER_READ_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+	);
+
+	// Draw Buffers
+	dispatch(aPasses.draw, pc.faceCount, "draw buffers");
+
+	// barrier3: child counts, from the copy and from refineTopology.comp
+	for (VkBuffer counts : { outMesh.vertexFaceCounts.buffer, outMesh.vertexEdgeCounts.buffer })
+	{
+		lut::buffer_barrier(
+			aCmdBuff, counts,
+			VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+			VK_ACCESS_SHADER_READ_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+		);
+	}
+
+	// Child counts -> offsets
+	std::uint32_t const childVertices = pc.vertexCount + pc.edgeCount + pc.faceCount;
+	{
+		lut::GpuScope const scope(aProfiler, aCmdBuff, "count scans");
+		record_prefix_scan(aCmdBuff, aPasses.faceScan, outMesh.vertexFaceOffsets.buffer, outMesh.vertexFaceBlockSums.buffer, childVertices);
+		record_prefix_scan(aCmdBuff, aPasses.edgeScan, outMesh.vertexEdgeOffsets.buffer, outMesh.vertexEdgeBlockSums.buffer, childVertices);
+	}
+
+	// Vertex -> face / edge lists of the child
+	dispatch(aPasses.adjacency, childVertices, "adjacency");
+
+	// The line list is the child edge list as it is
+	lut::buffer_barrier(
+		aCmdBuff, outMesh.edgeList.buffer,
+		VK_ACCESS_SHADER_WRITE_BIT,
+		VK_ACCESS_TRANSFER_READ_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT
+	);
+
+	VkBufferCopy lineCopy{};
+	lineCopy.size = std::size_t(outMesh.edgeCount) * sizeof(glm::uvec2);
+	vkCmdCopyBuffer(aCmdBuff, outMesh.edgeList.buffer, outMesh.drawLinelists.buffer, 1, &lineCopy);
+
+	if (aLimitPass)
+	{
+		lut::GpuScope const scope(aProfiler, aCmdBuff, "limit points");
+		record_limit_evaluation(aCmdBuff, *aLimitPass, outMesh);
+	}
+	else
+		vkCmdFillBuffer(aCmdBuff, outMesh.drawNormals.buffer, 0, VK_WHOLE_SIZE, 0);
+
+	// Everything written here is read by the next level's passes or by the draw
+	VkMemoryBarrier done{};
+	done.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	done.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	done.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT
+		| VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+
+	vkCmdPipelineBarrier(
+		aCmdBuff,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+		0,
+		1, &done,
+		0, nullptr,
+		0, nullptr);
+
+	// End recording
+	if (auto const res = vkEndCommandBuffer(aCmdBuff); VK_SUCCESS != res) {
+		throw lut::Error(
+			"Unable to end compute command buffer\n"
+			"vkEndCommandBuffer() returned %s", lut::to_string(res).c_str()
+		);
+	}
+}
+
+void submit_and_wait_for_compute(
+	lut::VulkanContext const& aContext,
+	VkQueue computeQueue,
+	VkCommandBuffer cmdBuffer)
+{
+	LUT_PROFILE_FUNCTION();
+
+	// Create fences
+	VkFenceCreateInfo fenceInfo{};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fenceInfo.flags = 0;
+
+	VkFence computeFence = VK_NULL_HANDLE;
+	if (auto res = vkCreateFence(aContext.device, &fenceInfo, nullptr, &computeFence); res != VK_SUCCESS) {
+		throw lut::Error("vkCreateFence failed: %s", lut::to_string(res).c_str());
+	}
+
+	// Submit command buffers
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &cmdBuffer;
+
+	if (auto res = vkQueueSubmit(computeQueue, 1, &submitInfo, computeFence); res != VK_SUCCESS) {
+		vkDestroyFence(aContext.device, computeFence, nullptr);
+		throw lut::Error("vkQueueSubmit failed: %s", lut::to_string(res).c_str());
+	}
+
+	// Wait for GPU finished
+	if (auto res = vkWaitForFences(aContext.device, 1, &computeFence, VK_TRUE, UINT64_MAX); res != VK_SUCCESS) {
+		vkDestroyFence(aContext.device, computeFence, nullptr);
+		throw lut::Error("vkWaitForFences failed: %s", lut::to_string(res).c_str());
+	}
+
+	vkDestroyFence(aContext.device, computeFence, nullptr);
+}
 
-	void dispatch_subdivision_passes(
+namespace
+{
+	double time_compute_pass(
+		lut::VulkanContext const& aContext,
 		VkCommandBuffer aCmdBuff,
-		SubdivisionMesh& inMesh,
-		SubdivisionMesh& outMesh,
-		VkPipeline facePipeline,
-		VkPipelineLayout faceLayout,
-		VkDescriptorSet faceDescriptorSet,
-		VkPipeline edgePipeline,
-		VkPipelineLayout edgeLayout,
-		VkDescriptorSet edgeDescriptorSet,
-		VkPipeline vertexPipeline,
-		VkPipelineLayout vertexLayout,
-		VkDescriptorSet vertexDescriptorSet,
-		VkPipeline drawPipeline,
-		VkPipelineLayout drawLayout,
-		VkDescriptorSet drawDescriptorSet
+		ComputePass const& aPass,
+		SubdivisionMesh const& inMesh,
+		std::uint32_t aInvocations,
+		std::uint32_t aRepeats
 	)
 	{
-		// Fill constant data
 		PushConstants pc{};
 		pc.vertexCount = inMesh.vertexCount;
 		pc.edgeCount = inMesh.edgeCount;
 		pc.faceCount = inMesh.faceCount;
 
-		// Begin recording commands
-		VkCommandBufferBeginInfo begInfo{};
-		begInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		begInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-		begInfo.pInheritanceInfo = nullptr;
-
-		if (auto const res = vkBeginCommandBuffer(aCmdBuff, &begInfo); VK_SUCCESS != res) {
-			throw lut::Error(
-				"Unable to begin recording command buffer\n"
-				"vkBeginCommandBuffer() returned %s", lut::to_string(res).c_str()
-			);
-		}
-
-		// Face Points
-		vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, facePipeline);
-		vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, faceLayout, 0, 1, &faceDescriptorSet, 0, nullptr);
-		vkCmdPushConstants(aCmdBuff, faceLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pc);
-		vkCmdDispatch(aCmdBuff, (pc.faceCount + 63) / 64, 1, 1); // 64 = local_size_x
-
-		// barrier1
-		VkBufferMemoryBarrier barrier1{};
-		barrier1.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
-		barrier1.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;   // Face pass写
-		barrier1.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;    // Edge pass读
-		barrier1.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		barrier1.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		barrier1.buffer = inMesh.facePoints.buffer;
-		barrier1.offset = 0;
-		barrier1.size = VK_WHOLE_SIZE;
-
-		vkCmdPipelineBarrier(
-			aCmdBuff,
-			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,   // srcStage
-			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,   // dstStage
-			0,
-			0, nullptr,
-			1, &barrier1,
-			0, nullptr);
-
+		double totalMs = 0.0;
+		for (std::uint32_t i = 0; i < aRepeats; ++i)
+		{
+			VkCommandBufferBeginInfo begInfo{};
+			begInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			begInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+			if (auto const res = vkBeginCommandBuffer(aCmdBuff, &begInfo); VK_SUCCESS != res) {
+				throw lut::Error(
+					"Unable to begin recording command buffer\n"
+					"vkBeginCommandBuffer() returned %s", lut::to_string(res).c_str()
+				);
+			}
 
-		// Edge Points
-		vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, edgePipeline);
-		vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, edgeLayout, 0, 1, &edgeDescriptorSet, 0, nullptr);
-		vkCmdPushConstants(aCmdBuff, edgeLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pc);
-		vkCmdDispatch(aCmdBuff, (pc.edgeCount + 63) / 64, 1, 1);
+			vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, aPass.pipeline);
+			vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, aPass.layout, 0, 1, &aPass.descriptors, 0, nullptr);
+			vkCmdPushConstants(aCmdBuff, aPass.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pc);
+			vkCmdDispatch(aCmdBuff, (aInvocations + 63) / 64, 1, 1);
 
-		// barrier2
-		VkBufferMemoryBarrier barrier2{};
-		barrier2.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
-		barrier2.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;   // Face pass
-		barrier2.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;    // Edge pass
-		barrier2.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		barrier2.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		barrier2.buffer = inMesh.edgePoints.buffer;
-		barrier2.offset = 0;
-		barrier2.size = VK_WHOLE_SIZE;
+			if (auto const res = vkEndCommandBuffer(aCmdBuff); VK_SUCCESS != res) {
+				throw lut::Error(
+					"Unable to end compute command buffer\n"
+					"vkEndCommandBuffer() returned %s", lut::to_string(res).c_str()
+				);
+			}
 
-		vkCmdPipelineBarrier(
-			aCmdBuff,
-			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,   // srcStage
-			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,   // dstStage
-			0,
-			0, nullptr,
-			1, &barrier2,
-			0, nullptr);
+			auto start = std::chrono::high_resolution_clock::now();
+			submit_and_wait_for_compute(aContext, aContext.graphicsQueue, aCmdBuff);
+			auto end = std::chrono::high_resolution_clock::now();
+			totalMs += std::chrono::duration<double, std::milli>(end - start).count();
+		}
 
-		// Vertex Points
-		vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, vertexPipeline);
-		vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, vertexLayout, 0, 1, &vertexDescriptorSet, 0, nullptr);
-		vkCmdPushConstants(aCmdBuff, vertexLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pc);
-		vkCmdDispatch(aCmdBuff, (pc.vertexCount + 63) / 64, 1, 1);
+		return totalMs / double(aRepeats);
+	}
 
-		// barrier3
-		VkBufferMemoryBarrier barriers3{};
+	void print_level_report(LevelReport const& aReport)
+	{
+		auto ratio = [](std::size_t aAfter, std::size_t aBefore) {
+			return aBefore ? float(aAfter) / float(aBefore) : 0.f;
+		};
 
-		// 3a. updatedVertices
-		barriers3.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
-		barriers3.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;  // Vertex pass
-		barriers3.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;   // Draw pass
-		barriers3.buffer = inMesh.updatedVertices.buffer;
-		barriers3.offset = 0;
-		barriers3.size = VK_WHOLE_SIZE;
+		// what the draw reads: vec4 positions, 6 indices per quad, 2 per edge
+		std::size_t const vertexMemory = aReport.vertices * sizeof(glm::vec4);
+		std::size_t const indexMemory = aReport.faces * 6 * sizeof(std::uint32_t);
+		std::size_t const edgeMemory = aReport.edges * 2 * sizeof(std::uint32_t);
+		double const toMB = 1.0 / (1024.0 * 1024.0);
+
+		std::cout << "\n========== Subdivision Level " << aReport.level << " (" << aReport.mode << ") ==========\n";
+		std::cout << std::fixed << std::setprecision(2);
+		std::cout << aReport.mode << " Subdivision Time: " << aReport.refineMs << " ms\n";
+		std::cout << "GPU Buffer Creation:  " << aReport.uploadMs << " ms\n";
+		std::cout << "Total Time:          " << (aReport.refineMs + aReport.uploadMs) << " ms\n";
+		std::cout << "------- Mesh Statistics -------\n";
+		std::cout << "Vertices: " << aReport.verticesBefore << " -> " << aReport.vertices
+			<< " (x" << ratio(aReport.vertices, aReport.verticesBefore) << ")\n";
+		std::cout << "Faces:    " << aReport.facesBefore << " -> " << aReport.faces
+			<< " (x" << ratio(aReport.faces, aReport.facesBefore) << ")\n";
+		std::cout << "Edges:    " << aReport.edgesBefore << " -> " << aReport.edges
+			<< " (x" << ratio(aReport.edges, aReport.edgesBefore) << ")\n";
+		std::cout << "------- Memory Usage -------\n";
+		std::cout << "Vertex Buffer:  " << vertexMemory * toMB << " MB\n";
+		std::cout << "Index Buffer:   " << indexMemory * toMB << " MB\n";
+		std::cout << "Edge Buffer:    " << edgeMemory * toMB << " MB\n";
+		std::cout << "Total GPU Mem:  " << (vertexMemory + indexMemory + edgeMemory) * toMB << " MB\n";
+		if (!aReport.gpuPasses.empty())
+		{
+			std::cout << "------- GPU Passes -------\n";
+			std::cout << std::setprecision(3);
+			for (auto const& pass : aReport.gpuPasses)
+				std::cout << std::left << std::setw(16) << pass.name << std::right << pass.ms << " ms\n";
+		}
+		std::cout << "=====================================\n\n";
+	}
 
+	void update_stencil_descriptors(
+		lut::VulkanContext const& aContext,
+		VkDescriptorSet aDescriptors,
+		StencilBuffers const& aStencils,
+		VkBuffer aDrawVertices)
+	{
+		VkBuffer const buffers[] = {
+			aStencils.cagePoints.buffer,
+			aStencils.stencilOffsets.buffer,
+			aStencils.stencilIndices.buffer,
+			aStencils.stencilWeights.buffer,
+			aDrawVertices
+		};
+		constexpr std::uint32_t count = sizeof(buffers) / sizeof(buffers[0]);
 
-		vkCmdPipelineBarrier(
-			aCmdBuff,
-			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,   // srcStage
-			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,   // dstStage
-			0,
-			0, nullptr,
-			1, &barriers3,
-			0, nullptr);
+		VkDescriptorBufferInfo infos[count]{};
+		VkWriteDescriptorSet desc[count]{};
+		for (std::uint32_t i = 0; i < count; ++i)
+		{
+			infos[i].buffer = buffers[i];
+			infos[i].range = VK_WHOLE_SIZE;
+
+			desc[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			desc[i].dstSet = aDescriptors;
+			desc[i].dstBinding = i;
+			desc[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			desc[i].descriptorCount = 1;
+			desc[i].pBufferInfo = &infos[i];
+		}
 
-		// Draw Buffers
-		vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, drawPipeline);
-		vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, drawLayout, 0, 1, &drawDescriptorSet, 0, nullptr);
-		vkCmdPushConstants(aCmdBuff, drawLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pc);
-		vkCmdDispatch(aCmdBuff, (pc.faceCount + 63) / 64, 1, 1);
+		vkUpdateDescriptorSets(aContext.device, count, desc, 0, nullptr);
+	}
 
+	void record_stencil_evaluation(VkCommandBuffer aCmdBuff, StencilPass const& aPass)
+	{
+		StencilBuffers const& sb = *aPass.buffers;
 
+		// the previous frame may still be reading the cage
 		lut::buffer_barrier(
-			aCmdBuff, outMesh.drawVertices.buffer,
-			VK_ACCESS_SHADER_WRITE_BIT,
-			VK_ACCESS_TRANSFER_READ_BIT,
+			aCmdBuff, sb.cagePoints.buffer,
+			VK_ACCESS_SHADER_READ_BIT,
+			VK_ACCESS_TRANSFER_WRITE_BIT,
 			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
 			VK_PIPELINE_STAGE_TRANSFER_BIT
 		);
 
+		VkBufferCopy copy{};
+		copy.srcOffset = aPass.slot * sb.cage_bytes();
+		copy.size = sb.cage_bytes();
+		vkCmdCopyBuffer(aCmdBuff, sb.cageStaging.buffer, sb.cagePoints.buffer, 1, &copy);
+
 		lut::buffer_barrier(
-			aCmdBuff, outMesh.drawIndices.buffer,
-			VK_ACCESS_SHADER_WRITE_BIT,
-			VK_ACCESS_TRANSFER_READ_BIT,
-			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT
-		);
-		lut::buffer_barrier(
-			aCmdBuff, outMesh.controlPoints.buffer,
-			VK_ACCESS_SHADER_WRITE_BIT,
-			VK_ACCESS_TRANSFER_READ_BIT,
-			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT
+			aCmdBuff, sb.cagePoints.buffer,
+			VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_ACCESS_SHADER_READ_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
 		);
+
+		// ... and still be drawing from the refined vertices (or, with a
+		// limit pass, reading them in limitPoints.comp)
 		lut::buffer_barrier(
-			aCmdBuff, outMesh.quadFaces.buffer,
+			aCmdBuff, aPass.drawVertices,
+			VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT,
 			VK_ACCESS_SHADER_WRITE_BIT,
-			VK_ACCESS_TRANSFER_READ_BIT,
-			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
 		);
+
+		// stencilEval.comp reads { rowCount, sourceCount, unused }
+		PushConstants pc{};
+		pc.vertexCount = sb.rowCount;
+		pc.edgeCount = sb.sourceCount;
+
+		vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, aPass.pipeline);
+		vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, aPass.layout, 0, 1, &aPass.descriptors, 0, nullptr);
+		vkCmdPushConstants(aCmdBuff, aPass.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pc);
+		vkCmdDispatch(aCmdBuff, (sb.rowCount + 63) / 64, 1, 1); // 64 = local_size_x
+
+		if (aPass.limit)
+		{
+			record_limit_evaluation(aCmdBuff, *aPass.limit, *aPass.mesh);
+			return;
+		}
+
 		lut::buffer_barrier(
-			aCmdBuff, outMesh.edgeList.buffer,
+			aCmdBuff, aPass.drawVertices,
 			VK_ACCESS_SHADER_WRITE_BIT,
-			VK_ACCESS_TRANSFER_READ_BIT,
+			VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
 			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
 		);
+	}
+}
 
+void update_limit_descriptors(
+	lut::VulkanContext const& aContext,
+	VkDescriptorSet aDescriptors,
+	SubdivisionMesh const& aMesh)
+{
+	// must match the set = 0 bindings of limitPoints.comp
+	VkBuffer const buffers[] = {
+		aMesh.controlPoints.buffer,
+		aMesh.quadFaces.buffer,
+		aMesh.faceEdgeIndices.buffer,
+		aMesh.edgeToFace.buffer,
+		aMesh.edgeList.buffer,
+		aMesh.vertexFaceOffsets.buffer,
+		aMesh.vertexFaceIndices.buffer,
+		aMesh.vertexEdgeOffsets.buffer,
+		aMesh.vertexEdgeIndices.buffer,
+		aMesh.edgeSharpness.buffer,
+		aMesh.drawVertices.buffer,
+		aMesh.drawNormals.buffer
+	};
+	constexpr std::uint32_t count = sizeof(buffers) / sizeof(buffers[0]);
 
-
-		// End recording
-		if (auto const res = vkEndCommandBuffer(aCmdBuff); VK_SUCCESS != res) {
-			throw lut::Error(
-				"Unable to end compute command buffer\n"
-				"vkEndCommandBuffer() returned %s", lut::to_string(res).c_str()
-			);
-		}
+	VkDescriptorBufferInfo infos[count]{};
+	VkWriteDescriptorSet desc[count]{};
+	for (std::uint32_t i = 0; i < count; ++i)
+	{
+		infos[i].buffer = buffers[i];
+		infos[i].range = VK_WHOLE_SIZE;
+
+		desc[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		desc[i].dstSet = aDescriptors;
+		desc[i].dstBinding = i;
+		desc[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		desc[i].descriptorCount = 1;
+		desc[i].pBufferInfo = &infos[i];
 	}
-	
-	void submit_and_wait_for_compute(
-		lut::VulkanWindow const& aWindow,
-		VkQueue computeQueue,
-		VkCommandBuffer cmdBuffer)
+
+	vkUpdateDescriptorSets(aContext.device, count, desc, 0, nullptr);
+}
+
+void warn_semi_sharp_limit(std::vector<std::uint32_t> const& aCageSharpness, int aLevel)
+{
+	// creases lose one step of sharpness per level, starting at level 1
+	std::uint32_t const cage = aCageSharpness.empty() ? 0 : *std::max_element(aCageSharpness.begin(), aCageSharpness.end());
+	if (cage <= std::uint32_t(aLevel))
+		return;
+
+	std::fprintf(stderr, "Warning: level %d still has creases of sharpness up to %u; limitPoints.comp treats them as infinitely sharp, "
+		"so --limit is only exact from level %u on\n", aLevel, cage - std::uint32_t(aLevel), cage);
+}
+
+namespace
+{
+	void record_limit_evaluation(VkCommandBuffer aCmdBuff, ComputePass const& aPass, SubdivisionMesh const& aMesh)
 	{
-		// Create fences
-		VkFenceCreateInfo fenceInfo{};
-		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-		fenceInfo.flags = 0;
+		// the points and adjacency come from compute passes or copies, and
+		// drawBuffer.comp may just have written the draw vertices
+		VkMemoryBarrier inputs{};
+		inputs.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		inputs.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		inputs.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+		vkCmdPipelineBarrier(
+			aCmdBuff,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0,
+			1, &inputs,
+			0, nullptr,
+			0, nullptr);
 
-		VkFence computeFence = VK_NULL_HANDLE;
-		if (auto res = vkCreateFence(aWindow.device, &fenceInfo, nullptr, &computeFence); res != VK_SUCCESS) {
-			throw lut::Error("vkCreateFence failed: %s", lut::to_string(res).c_str());
+		// a previous frame may still be drawing from the outputs
+		for (VkBuffer target : { aMesh.drawVertices.buffer, aMesh.drawNormals.buffer })
+		{
+			lut::buffer_barrier(
+				aCmdBuff, target,
+				VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+				VK_ACCESS_SHADER_WRITE_BIT,
+				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+			);
 		}
 
-		// Submit command buffers
-		VkSubmitInfo submitInfo{};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &cmdBuffer;
+		PushConstants pc{};
+		pc.vertexCount = aMesh.vertexCount;
+		pc.edgeCount = aMesh.edgeCount;
+		pc.faceCount = aMesh.faceCount;
 
-		if (auto res = vkQueueSubmit(computeQueue, 1, &submitInfo, computeFence); res != VK_SUCCESS) {
-			vkDestroyFence(aWindow.device, computeFence, nullptr);
-			throw lut::Error("vkQueueSubmit failed: %s", lut::to_string(res).c_str());
-		}
+		vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, aPass.pipeline);
+		vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, aPass.layout, 0, 1, &aPass.descriptors, 0, nullptr);
+		vkCmdPushConstants(aCmdBuff, aPass.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pc);
+		vkCmdDispatch(aCmdBuff, (aMesh.vertexCount + 63) / 64, 1, 1); // 64 = local_size_x
 
-		// Wait for GPU finished
-		if (auto res = vkWaitForFences(aWindow.device, 1, &computeFence, VK_TRUE, UINT64_MAX); res != VK_SUCCESS) {
-			vkDestroyFence(aWindow.device, computeFence, nullptr);
-			throw lut::Error("vkWaitForFences failed: %s", lut::to_string(res).c_str());
+		for (VkBuffer target : { aMesh.drawVertices.buffer, aMesh.drawNormals.buffer })
+		{
+			lut::buffer_barrier(
+				aCmdBuff, target,
+				VK_ACCESS_SHADER_WRITE_BIT,
+				VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+			);
 		}
-
-		vkDestroyFence(aWindow.device, computeFence, nullptr);
 	}
 
 
@@ -2955,124 +4408,169 @@ namespace
 		}
 
 	}
+}
 
-	void rc_draw_quads(
-		VkCommandBuffer aCmdBuff,
-		VkRenderPass aRenderPass,
-		VkFramebuffer aFramebuffer,
-		VkPipeline aGraphicsPipe,
-		VkPipeline aWireframePipe,
-		VkExtent2D const& aImageExtent,
-		VkBuffer aPositionBuffer,
-		VkBuffer aIndexBuffer,
-		VkBuffer aLinelistsBuffer,
-		std::uint32_t aIndicesCount,
-		std::uint32_t aLinelistsCount,
-		VkBuffer aSceneUBO,
-		glsl::SceneUniform const& aSceneUniform,
-		VkPipelineLayout aGraphicsLayout,
-		VkDescriptorSet aSceneDescriptors
-	)
+void rc_draw_quads(
+	VkCommandBuffer aCmdBuff,
+	VkRenderPass aRenderPass,
+	VkFramebuffer aFramebuffer,
+	VkPipeline aGraphicsPipe,
+	VkPipeline aWireframePipe,
+	VkExtent2D const& aImageExtent,
+	VkBuffer aPositionBuffer,
+	VkBuffer aNormalBuffer,
+	VkBuffer aIndexBuffer,
+	VkBuffer aLinelistsBuffer,
+	std::uint32_t aIndicesCount,
+	std::uint32_t aLinelistsCount,
+	VkBuffer aSceneUBO,
+	glsl::SceneUniform const& aSceneUniform,
+	VkPipelineLayout aGraphicsLayout,
+	VkDescriptorSet aSceneDescriptors,
+	StencilPass const* aStencilPass,
+	PatchDraw const* aPatchDraw,
+	lut::GpuProfiler* aProfiler,
+	std::uint32_t aProfilerSlot
+)
+{
+	LUT_PROFILE_FUNCTION();
+
+	// Begin recording commands
+	VkCommandBufferBeginInfo begInfo{};
+	begInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	begInfo.pInheritanceInfo = nullptr;
+
+	if (auto const res = vkBeginCommandBuffer(aCmdBuff, &begInfo); VK_SUCCESS != res) {
+		throw lut::Error(
+			"Unable to begin recording command buffer\n"
+			"vkBeginCommandBuffer() returned %s", lut::to_string(res).c_str()
+		);
+	}
+
+	if (aProfiler)
+		aProfiler->reset(aCmdBuff, aProfilerSlot);
+
+	if (aStencilPass)
 	{
-		// Begin recording commands
-		VkCommandBufferBeginInfo begInfo{};
-		begInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		begInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-		begInfo.pInheritanceInfo = nullptr;
+		lut::GpuScope const scope(aProfiler, aCmdBuff, "stencils");
+		record_stencil_evaluation(aCmdBuff, *aStencilPass);
+	}
 
-		if (auto const res = vkBeginCommandBuffer(aCmdBuff, &begInfo); VK_SUCCESS != res) {
-			throw lut::Error(
-				"Unable to begin recording command buffer\n"
-				"vkBeginCommandBuffer() returned %s", lut::to_string(res).c_str()
-			);
-		}
 
 
+	// Upload scene uniforms; the patches read them in the tessellation stages
+	VkPipelineStageFlags const uboStages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
+		| (aPatchDraw ? VK_PIPELINE_STAGE_TESSELLATION_CONTROL_SHADER_BIT | VK_PIPELINE_STAGE_TESSELLATION_EVALUATION_SHADER_BIT : 0);
+	lut::buffer_barrier(
+		aCmdBuff,
+		aSceneUBO,
+		VK_ACCESS_UNIFORM_READ_BIT,
+		VK_ACCESS_TRANSFER_WRITE_BIT,
+		uboStages,
+		VK_PIPELINE_STAGE_TRANSFER_BIT
+	);
 
-		// Upload scene uniforms
-		lut::buffer_barrier(
-			aCmdBuff,
-			aSceneUBO,
-			VK_ACCESS_UNIFORM_READ_BIT,
-			VK_ACCESS_TRANSFER_WRITE_BIT,
-			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT
-		);
+	vkCmdUpdateBuffer(
+		aCmdBuff,
+		aSceneUBO,
+		0,
+		sizeof(glsl::SceneUniform),
+		&aSceneUniform
+	);
 
-		vkCmdUpdateBuffer(
-			aCmdBuff,
-			aSceneUBO,
-			0,
-			sizeof(glsl::SceneUniform),
-			&aSceneUniform
-		);
+	lut::buffer_barrier(
+		aCmdBuff,
+		aSceneUBO,
+		VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_ACCESS_UNIFORM_READ_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		uboStages
+	);
 
-		lut::buffer_barrier(
-			aCmdBuff,
-			aSceneUBO,
-			VK_ACCESS_TRANSFER_WRITE_BIT,
-			VK_ACCESS_UNIFORM_READ_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
-		);
 
 
+	// Begin render pass
+	VkClearValue clearValues[2]{};
+	clearValues[0].color.float32[0] = 0.1f; // Clear to a dark gray background.
+	clearValues[0].color.float32[1] = 0.1f; // Helps identify render pass visually
+	clearValues[0].color.float32[2] = 0.1f;
+	clearValues[0].color.float32[3] = 1.0f;
 
-		// Begin render pass
-		VkClearValue clearValues[2]{};
-		clearValues[0].color.float32[0] = 0.1f; // Clear to a dark gray background.
-		clearValues[0].color.float32[1] = 0.1f; // Helps identify render pass visually
-		clearValues[0].color.float32[2] = 0.1f;
-		clearValues[0].color.float32[3] = 1.0f;
+	clearValues[1].depthStencil.depth = 1.f; // new!
 
-		clearValues[1].depthStencil.depth = 1.f; // new!
 
+	VkRenderPassBeginInfo passInfo{};
+	passInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	passInfo.renderPass = aRenderPass;
+	passInfo.framebuffer = aFramebuffer;
+	passInfo.renderArea.offset = VkOffset2D{ 0, 0 };
+	passInfo.renderArea.extent = VkExtent2D{ aImageExtent.width, aImageExtent.height };
+	passInfo.clearValueCount = 2;
+	passInfo.pClearValues = clearValues;
 
-		VkRenderPassBeginInfo passInfo{};
-		passInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		passInfo.renderPass = aRenderPass;
-		passInfo.framebuffer = aFramebuffer;
-		passInfo.renderArea.offset = VkOffset2D{ 0, 0 };
-		passInfo.renderArea.extent = VkExtent2D{ aImageExtent.width, aImageExtent.height };
-		passInfo.clearValueCount = 2;
-		passInfo.pClearValues = clearValues;
+	vkCmdBeginRenderPass(aCmdBuff, &passInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-		vkCmdBeginRenderPass(aCmdBuff, &passInfo, VK_SUBPASS_CONTENTS_INLINE);
+	// Regular patches, tessellated on the device
+	if (aPatchDraw && aPatchDraw->patchCount > 0)
+	{
+		lut::GpuScope const scope(aProfiler, aCmdBuff, "draw patches");
+		vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aPatchDraw->pipeline);
+		vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aPatchDraw->layout, 0, 1, &aSceneDescriptors, 0, nullptr);
+		vkCmdPushConstants(aCmdBuff, aPatchDraw->layout, VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT, 0, sizeof(PatchConstants), &aPatchDraw->constants);
+		VkBuffer const patchBuffers[] = { aPatchDraw->controlPoints, aPatchDraw->sides };
+		VkDeviceSize const patchOffsets[] = { 0, 0 };
+		vkCmdBindVertexBuffers(aCmdBuff, 0, 2, patchBuffers, patchOffsets);
+		vkCmdDraw(aCmdBuff, 16 * aPatchDraw->patchCount, 1, 0, 0);
+	}
 
+	// The rest of the faces; with patches on the device there may be none
+	if (aIndicesCount > 0)
+	{
 		// Bind for mesh fill
-		// Bind pipeline and descriptors
-		vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aGraphicsPipe);
-		vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aGraphicsLayout, 0, 1, &aSceneDescriptors, 0, nullptr);
-		// Bind buffers
-		VkDeviceSize posOffset = 0;
-		vkCmdBindVertexBuffers(aCmdBuff, 0, 1, &aPositionBuffer, &posOffset);
-		vkCmdBindIndexBuffer(aCmdBuff, aIndexBuffer, 0, VK_INDEX_TYPE_UINT32);
-		// Draw indexed meshes
-		vkCmdDrawIndexed(aCmdBuff, aIndicesCount, 1, 0, 0, 0);
+		{
+			lut::GpuScope const scope(aProfiler, aCmdBuff, "draw quads");
+			// Bind pipeline and descriptors
+			vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aGraphicsPipe);
+			vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aGraphicsLayout, 0, 1, &aSceneDescriptors, 0, nullptr);
+			// Bind buffers: positions and normals
+			VkBuffer const fillBuffers[2] = { aPositionBuffer, aNormalBuffer };
+			VkDeviceSize const fillOffsets[2] = { 0, 0 };
+			vkCmdBindVertexBuffers(aCmdBuff, 0, 2, fillBuffers, fillOffsets);
+			vkCmdBindIndexBuffer(aCmdBuff, aIndexBuffer, 0, VK_INDEX_TYPE_UINT32);
+			// Draw indexed meshes
+			vkCmdDrawIndexed(aCmdBuff, aIndicesCount, 1, 0, 0, 0);
+		}
 
 		// Binding for wireframes
-		vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aWireframePipe);
-		vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aGraphicsLayout, 0, 1, &aSceneDescriptors, 0, nullptr);
-		vkCmdBindVertexBuffers(aCmdBuff, 0, 1, &aPositionBuffer, &posOffset);
-		vkCmdBindIndexBuffer(aCmdBuff, aLinelistsBuffer, 0, VK_INDEX_TYPE_UINT32);
-		vkCmdDrawIndexed(aCmdBuff, aLinelistsCount, 1, 0, 0, 0);
-
-		// End the render pass
-		vkCmdEndRenderPass(aCmdBuff);
+		{
+			lut::GpuScope const scope(aProfiler, aCmdBuff, "draw wireframe");
+			VkDeviceSize posOffset = 0;
+			vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aWireframePipe);
+			vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aGraphicsLayout, 0, 1, &aSceneDescriptors, 0, nullptr);
+			vkCmdBindVertexBuffers(aCmdBuff, 0, 1, &aPositionBuffer, &posOffset);
+			vkCmdBindIndexBuffer(aCmdBuff, aLinelistsBuffer, 0, VK_INDEX_TYPE_UINT32);
+			vkCmdDrawIndexed(aCmdBuff, aLinelistsCount, 1, 0, 0, 0);
+		}
+	}
 
+	// End the render pass
+	vkCmdEndRenderPass(aCmdBuff);
 
-		// End command recording
-		if (auto const res = vkEndCommandBuffer(aCmdBuff); VK_SUCCESS != res) {
-			throw lut::Error(
-				"Unable to end recording command buffer\n"
-				"vkEndCommandBuffer() returned %s",
-				lut::to_string(res).c_str()
-			);
-		}
 
+	// End command recording
+	if (auto const res = vkEndCommandBuffer(aCmdBuff); VK_SUCCESS != res) {
+		throw lut::Error(
+			"Unable to end recording command buffer\n"
+			"vkEndCommandBuffer() returned %s",
+			lut::to_string(res).c_str()
+		);
 	}
 
+}
 
+namespace
+{
 	void record_compute_commands(
 		VkCommandBuffer aCmdBuff,
 		VkPipeline aComputePipeline,
@@ -3201,62 +4699,86 @@ namespace
 		}
 
 	}
+}
 
-	std::tuple<lut::Image, lut::ImageView> create_depth_buffer(lut::VulkanWindow const& aWindow, lut::Allocator const& aAllocator)
+std::tuple<lut::Image, lut::ImageView> create_depth_buffer(lut::VulkanContext const& aContext, VkExtent2D aExtent, lut::Allocator const& aAllocator)
+{
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = cfg::kDepthFormat;
+	imageInfo.extent.width = aExtent.width;
+	imageInfo.extent.height = aExtent.height;
+	imageInfo.extent.depth = 1;
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	VmaAllocationCreateInfo allocInfo{};
+	allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+	VkImage image = VK_NULL_HANDLE;
+	VmaAllocation allocation = VK_NULL_HANDLE;
+
+	if (auto const res = vmaCreateImage(aAllocator.allocator, &imageInfo, &allocInfo, &image, &allocation, nullptr); VK_SUCCESS != res)
 	{
-		VkImageCreateInfo imageInfo{};
-		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-		imageInfo.imageType = VK_IMAGE_TYPE_2D;
-		imageInfo.format = cfg::kDepthFormat;
-		imageInfo.extent.width = aWindow.swapchainExtent.width;
-		imageInfo.extent.height = aWindow.swapchainExtent.height;
-		imageInfo.extent.depth = 1;
-		imageInfo.mipLevels = 1;
-		imageInfo.arrayLayers = 1;
-		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-
-		VmaAllocationCreateInfo allocInfo{};
-		allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-
-		VkImage image = VK_NULL_HANDLE;
-		VmaAllocation allocation = VK_NULL_HANDLE;
-
-		if (auto const res = vmaCreateImage(aAllocator.allocator, &imageInfo, &allocInfo, &image, &allocation, nullptr); VK_SUCCESS != res)
-		{
-			throw lut::Error("Unable to allocate depth buffer image.\n"
-				"vmaCreateImage() returned %s", lut::to_string(res).c_str());
-		}
-
-		lut::Image depthImage(aAllocator.allocator, image, allocation);
-
-		// Create the image view
-		VkImageViewCreateInfo viewInfo{};
-		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-		viewInfo.image = depthImage.image;
-		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		viewInfo.format = cfg::kDepthFormat;
-		viewInfo.components = VkComponentMapping{};
-		viewInfo.subresourceRange = VkImageSubresourceRange{
-			VK_IMAGE_ASPECT_DEPTH_BIT,
-			0, 1,
-			0, 1
-		};
+		throw lut::Error("Unable to allocate depth buffer image.\n"
+			"vmaCreateImage() returned %s", lut::to_string(res).c_str());
+	}
 
-		VkImageView view = VK_NULL_HANDLE;
-		if (auto const res = vkCreateImageView(aWindow.device, &viewInfo, nullptr, &view); VK_SUCCESS != res)
-		{
-			throw lut::Error("Unable to create image view\n"
-				"vkCreateImageView() returned %s", lut::to_string(res).c_str());
-		}
+	lut::Image depthImage(aAllocator.allocator, image, allocation);
+
+	// Create the image view
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = depthImage.image;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = cfg::kDepthFormat;
+	viewInfo.components = VkComponentMapping{};
+	viewInfo.subresourceRange = VkImageSubresourceRange{
+		VK_IMAGE_ASPECT_DEPTH_BIT,
+		0, 1,
+		0, 1
+	};
+
+	VkImageView view = VK_NULL_HANDLE;
+	if (auto const res = vkCreateImageView(aContext.device, &viewInfo, nullptr, &view); VK_SUCCESS != res)
+	{
+		throw lut::Error("Unable to create image view\n"
+			"vkCreateImageView() returned %s", lut::to_string(res).c_str());
+	}
 
-		return { std::move(depthImage), lut::ImageView(aWindow.device, view) };
+	return { std::move(depthImage), lut::ImageView(aContext.device, view) };
+
+}
 
+namespace
+{
+	std::tuple<lut::Image, lut::ImageView> create_depth_buffer(lut::VulkanWindow const& aWindow, lut::Allocator const& aAllocator)
+	{
+		return create_depth_buffer(aWindow, aWindow.swapchainExtent, aAllocator);
 	}
 
 }
 
+namespace
+{
+	void write_trace(char const* aPath)
+	{
+		if (!aPath)
+			return;
+
+		if (lut::profile::write_chrome_trace(aPath))
+			std::fprintf(stderr, "Trace written to '%s'\n", aPath);
+		else if (!LUT_PROFILING)
+			std::fprintf(stderr, "Warning: --trace ignored, this build has no profiling zones (LUT_PROFILING=0)\n");
+		else
+			std::fprintf(stderr, "Warning: unable to write trace to '%s'\n", aPath);
+	}
+}
+
 //EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab: 
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <tuple>
+#include <vector>
+#include <cstdint>
+
+#include <volk/volk.h>
+#include <glm/glm.hpp>
+
+#include "../labutils/vkimage.hpp"
+#include "../labutils/vkobject.hpp"
+#include "../labutils/allocator.hpp"
+#include "../labutils/gpu_profiler.hpp"
+#include "../labutils/vulkan_context.hpp"
+
+#include "vertex_data.hpp"
+
+
+// The parts of the viewer that do not need a window: the GPU subdivision
+// chain, and the render pass, pipelines and draw of the refined quads.
+// Defined in main.cpp; the headless benchmark (benchmark.hpp) runs them too.
+
+// Uniform data
+namespace glsl
+{
+	struct SceneUniform
+	{
+		// Note: need to be careful about the packing/alignment here!
+		glm::mat4 camera;
+		glm::mat4 projection;
+		glm::mat4 projCam;
+	};
+
+	// We want to use vkCmdUpdateBuffer() to update the contents of our uniform buffers.
+	// vkCmdUpdateBuffer() has a number of requirements, including the two below. See:
+	// https://www.khronos.org/registry/vulkan/specs/1.3-extensions/man/html/vkCmdUpdateBuffer.html
+	static_assert(sizeof(SceneUniform) <= 65536, "SceneUniform must be less than 65536 bytes for vkCmdUpdateBuffer");
+	static_assert(sizeof(SceneUniform) % 4 == 0, "SceneUniform size must be a multiple of 4 bytes");
+}
+
+void update_scene_uniforms(
+	glsl::SceneUniform&,
+	std::uint32_t aFramebufferWidth,
+	std::uint32_t aFramebufferHeight,
+	glm::mat4 const& aCamera2world
+);
+
+// A camera2world that looks down -z at the box [aMin, aMax] from far enough
+// away that all of it is in view.
+glm::mat4 frame_bounds( glm::vec3 const& aMin, glm::vec3 const& aMax );
+
+// aFinalLayout is the layout the colour attachment is left in
+labutils::RenderPass create_render_pass( labutils::VulkanContext const&, VkFormat aColorFormat, VkImageLayout aFinalLayout );
+
+labutils::DescriptorSetLayout create_scene_descriptor_layout( labutils::VulkanContext const& );
+labutils::PipelineLayout create_pipeline_layout( labutils::VulkanContext const&, VkDescriptorSetLayout );
+labutils::Pipeline create_model_pipeline2(labutils::VulkanContext const&, VkExtent2D, VkRenderPass, VkPipelineLayout);
+labutils::Pipeline create_wireframe_pipeline22(labutils::VulkanContext const&, VkExtent2D, VkRenderPass, VkPipelineLayout);
+
+std::tuple<labutils::Image, labutils::ImageView> create_depth_buffer(labutils::VulkanContext const&, VkExtent2D, labutils::Allocator const&);
+
+// One compute pass of the GPU subdivision chain.
+struct ComputePass
+{
+	VkPipeline pipeline;
+	VkPipelineLayout layout;
+	VkDescriptorSet descriptors;
+};
+
+// Everything needed to refine one level on the device: the point rules
+// (face, edge, vertex, draw) and the child adjacency (topology, the count
+// scans, adjacency).
+struct SubdivisionPasses
+{
+	ComputePass face;
+	ComputePass edge;
+	ComputePass vertex;
+	ComputePass draw;
+	ComputePass topology;
+	ComputePass faceScan;
+	ComputePass edgeScan;
+	ComputePass adjacency;
+};
+
+// The layouts and pipelines behind SubdivisionPasses and the limit pass,
+// with their descriptor sets allocated from the caller's pool.
+struct SubdivisionPipelines
+{
+	labutils::DescriptorSetLayout faceLayout, edgeLayout, vertexLayout, drawLayout;
+	labutils::DescriptorSetLayout topologyLayout, adjacencyLayout, scanLayout, limitLayout;
+	labutils::PipelineLayout facePipeLayout, edgePipeLayout, vertexPipeLayout, drawPipeLayout;
+	labutils::PipelineLayout topologyPipeLayout, adjacencyPipeLayout, scanPipeLayout, limitPipeLayout;
+	labutils::Pipeline facePipe, edgePipe, vertexPipe, drawPipe;
+	labutils::Pipeline topologyPipe, adjacencyPipe, scanPipe, limitPipe;
+
+	SubdivisionPasses passes;
+	ComputePass limit;
+};
+
+SubdivisionPipelines create_subdivision_pipelines(labutils::VulkanContext const&, VkDescriptorPool);
+
+void update_subdivision_descriptors(
+	labutils::VulkanContext const&,
+	SubdivisionPasses const&,
+	SubdivisionMesh const& inMesh,
+	SubdivisionMesh const& outMesh
+);
+
+// With aLimitPass (descriptors already pointing at outMesh), the child is
+// drawn on the limit surface; otherwise its drawNormals are cleared. With
+// aProfiler, every pass is timed into slot aProfilerSlot.
+void dispatch_subdivision_passes(
+	VkCommandBuffer,
+	SubdivisionMesh const& inMesh,
+	SubdivisionMesh const& outMesh,
+	SubdivisionPasses const&,
+	ComputePass const* aLimitPass = nullptr,
+	labutils::GpuProfiler* aProfiler = nullptr,
+	std::uint32_t aProfilerSlot = 0
+);
+
+void submit_and_wait_for_compute(
+	labutils::VulkanContext const&,
+	VkQueue,
+	VkCommandBuffer);
+
+// limitPoints.comp over aMesh: its control points -> limit positions and
+// normals in drawVertices / drawNormals.
+void update_limit_descriptors(
+	labutils::VulkanContext const&,
+	VkDescriptorSet,
+	SubdivisionMesh const&
+);
+
+// limitPoints.comp has no way to refine, so it takes any sharpness above 0 as
+// an infinite crease; that is only the limit once the cage's semi-sharp
+// creases have decayed. Warns on stderr if level aLevel is drawn before then.
+void warn_semi_sharp_limit( std::vector<std::uint32_t> const& aCageSharpness, int aLevel );
+
+// Timings and counts of one subdivision level, printed after each step.
+// refineMs is the CPU subdivision or the GPU dispatch (submit to fence),
+// uploadMs the buffer creation that goes with it.
+struct LevelReport
+{
+	char const* mode = "";
+	int level = 0;
+	double refineMs = 0.0;
+	double uploadMs = 0.0;
+	std::size_t verticesBefore = 0, facesBefore = 0, edgesBefore = 0;
+	std::size_t vertices = 0, faces = 0, edges = 0;
+	// device time of each pass of a GPU level, from timestamps
+	std::vector<labutils::GpuProfiler::Sample> gpuPasses;
+};
+
+// Compute work recorded in front of the render pass: copy this frame's
+// cage out of its staging slot and evaluate the refined vertices from it.
+// With a limit pass, the stencils write the control points of mesh and
+// the limit pass then pushes them to the surface.
+struct StencilPass
+{
+	VkPipeline pipeline;
+	VkPipelineLayout layout;
+	VkDescriptorSet descriptors;
+	StencilBuffers const* buffers;
+	VkBuffer drawVertices;
+	std::uint32_t slot;
+	ComputePass const* limit = nullptr;
+	SubdivisionMesh const* mesh = nullptr;
+};
+
+// Push constants of bsplinePatch.tesc: a side of a patch is split into
+// about one segment per pixelsPerSegment pixels on screen (1 to 64), in
+// steps that keep it matched with the sides across (labutils::PatchSide).
+struct PatchConstants
+{
+	glm::vec2 viewport;
+	float pixelsPerSegment;
+};
+
+// The regular patches drawn by rc_draw_quads() next to the irregular faces.
+struct PatchDraw
+{
+	VkPipeline pipeline;
+	VkPipelineLayout layout;
+	VkBuffer controlPoints;
+	VkBuffer sides;
+	std::uint32_t patchCount;
+	PatchConstants constants;
+};
+
+void rc_draw_quads(
+	VkCommandBuffer aCmdBuff,
+	VkRenderPass aRenderPass,
+	VkFramebuffer aFramebuffer,
+	VkPipeline aGraphicsPipe,
+	VkPipeline aWireframePipe,
+	VkExtent2D const& aImageExtent,
+	VkBuffer aPositionBuffer,
+	VkBuffer aNormalBuffer,
+	VkBuffer aIndexBuffer,
+	VkBuffer aLinelistsBuffer,
+	std::uint32_t aIndicesCount,
+	std::uint32_t aLinelistsCount,
+	VkBuffer aSceneUBO,
+	glsl::SceneUniform const& aSceneUniform,
+	VkPipelineLayout aGraphicsLayout,
+	VkDescriptorSet aSceneDescriptors,
+	StencilPass const* aStencilPass = nullptr,
+	PatchDraw const* aPatchDraw = nullptr,
+	labutils::GpuProfiler* aProfiler = nullptr,
+	std::uint32_t aProfilerSlot = 0
+);
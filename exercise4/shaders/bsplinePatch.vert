@@ -0,0 +1,15 @@
+#version 450
+
+// Control points of the regular patches; the tessellation stages do the rest.
+
+layout( location = 0 ) in vec3 iPosition;
+layout( location = 1 ) in vec4 iSide;
+
+layout( location = 0 ) out vec3 v2cPosition;
+layout( location = 1 ) out vec4 v2cSide;
+
+void main()
+{
+    v2cPosition = iPosition;
+    v2cSide = iSide;
+}
@@ -0,0 +1,17 @@
+#version 450
+
+layout( location = 0 ) in vec3 v2fNormal;
+
+layout( location = 0 ) out vec4 oColor;
+
+void main()
+{
+    vec3 color = vec3(0.0, 1.0, 1.0);
+
+    // headlight shading on the limit normals, flat colour without them
+    float len = length(v2fNormal);
+    if (len > 1e-6)
+        color *= 0.25 + 0.75 * abs(v2fNormal.z / len);
+
+    oColor = vec4(color, 0.5);
+}
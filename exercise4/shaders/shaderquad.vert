@@ -0,0 +1,20 @@
+#version 450
+
+layout( location = 0 ) in vec3 iPosition;
+layout( location = 1 ) in vec3 iNormal;
+
+layout( set = 0, binding = 0 ) uniform UScene
+{
+    mat4 camera;
+    mat4 projection;
+    mat4 projCam;
+} uScene;
+
+layout( location = 0 ) out vec3 v2fNormal;
+
+void main()
+{
+    // view space; stays zero when the level has no limit normals
+    v2fNormal = mat3( uScene.camera ) * iNormal;
+    gl_Position = uScene.projCam * vec4( iPosition, 1.f );
+}
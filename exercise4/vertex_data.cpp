@@ -7,10 +7,13 @@
 #include <cassert>
 #include <numeric>
 #include <cstring>
+#include <algorithm>
 
 #include "../labutils/error.hpp"
 #include "../labutils/vkutil.hpp"
 #include "../labutils/to_string.hpp"
+#include "../labutils/cpu_profiler.hpp"
+#include "../labutils/upload_context.hpp"
 #include <glm/gtx/string_cast.hpp>
 namespace lut = labutils;
 
@@ -32,11 +35,74 @@ constexpr std::size_t std430_sizeof()
 	return (sizeof(T) == 12) ? 16 : sizeof(T);
 }
 
+// Writes aVec into aDst (through staging, or in place if it is mapped) with
+// its elements padded to their std430 size.
+template<class TVec>
+void write_std430(lut::UploadContext& aUploads, lut::Buffer const& aDst, TVec const& aVec)
+{
+	using T = std::decay_t<decltype(aVec[0])>;
+	constexpr std::size_t stride = std430_sizeof<T>();
+
+	aUploads.write_elements(aDst, aVec.size(), stride, [&](std::byte* aOut, std::size_t aFirst, std::size_t aCount)
+		{
+			for (std::size_t i = 0; i < aCount; ++i)
+			{
+				std::memcpy(aOut + i * stride, &aVec[aFirst + i], sizeof(T));
+				if constexpr (stride > sizeof(T))
+					std::memset(aOut + i * stride + sizeof(T), 0, stride - sizeof(T));
+			}
+		});
+}
+
+// aCount vec4s, element i being (aPoint(i), aW).
+template<class TPoint>
+void write_vec4(lut::UploadContext& aUploads, lut::Buffer const& aDst, std::size_t aCount, float aW, TPoint&& aPoint)
+{
+	aUploads.write_elements(aDst, aCount, sizeof(glm::vec4), [&](std::byte* aOut, std::size_t aFirst, std::size_t aCount)
+		{
+			for (std::size_t i = 0; i < aCount; ++i)
+			{
+				glm::vec4 const p(aPoint(aFirst + i), aW);
+				std::memcpy(aOut + i * sizeof(glm::vec4), &p, sizeof(glm::vec4));
+			}
+		});
+}
+
+// The exclusive scan of aCounts with a trailing total (see lut::csr_offsets()),
+// summed while it is written.
+void write_csr_offsets(lut::UploadContext& aUploads, lut::Buffer const& aDst, std::vector<std::uint32_t> const& aCounts)
+{
+	std::uint32_t sum = 0;
+	aUploads.write_elements(aDst, aCounts.size() + 1, sizeof(std::uint32_t), [&](std::byte* aOut, std::size_t aFirst, std::size_t aCount)
+		{
+			for (std::size_t i = 0; i < aCount; ++i)
+			{
+				std::memcpy(aOut + i * sizeof(std::uint32_t), &sum, sizeof(std::uint32_t));
+				if (aFirst + i < aCounts.size())
+					sum += aCounts[aFirst + i];
+			}
+		});
+}
 
+// The model's integer crease levels, as the floats edgeSharpness holds.
+void write_sharpness(lut::UploadContext& aUploads, lut::Buffer const& aDst, std::vector<std::uint32_t> const& aLevels)
+{
+	aUploads.write_elements(aDst, aLevels.size(), sizeof(float), [&](std::byte* aOut, std::size_t aFirst, std::size_t aCount)
+		{
+			for (std::size_t i = 0; i < aCount; ++i)
+			{
+				float const level = float(aLevels[aFirst + i]);
+				std::memcpy(aOut + i * sizeof(float), &level, sizeof(float));
+			}
+		});
+}
 
 
-ModelMesh create_model_buffer_tri(lut::VulkanContext const& aContext, lut::Allocator const& aAllocator, lut::GltfModel const& aModel)
+
+
+ModelMesh create_model_buffer_tri(lut::Allocator const& aAllocator, lut::UploadContext& aUploads, lut::GltfModel const& aModel)
 {
+	LUT_PROFILE_FUNCTION();
 	const auto& vertices = aModel.m_vertices;   // std::vector<Vertex>
 	const auto& indices = aModel.m_indices;    // std::vector<uint32_t>
 
@@ -46,147 +112,24 @@ ModelMesh create_model_buffer_tri(lut::VulkanContext const& aContext, lut::Alloc
 	//const auto& lineLists = aModel.m_quadLinelists;    // std::vector<uint32_t>
 
 
-	std::vector<glm::vec3> vPositions;
-	vPositions.reserve(vertices.size());
-
-	for (auto const& v : vertices)
-		vPositions.push_back(v.pos);
-
-	std::size_t posBufferSize = vPositions.size() * sizeof(glm::vec3);
+	std::size_t posBufferSize = vertices.size() * sizeof(glm::vec3);
 	std::size_t indexBufferSize = indices.size() * sizeof(uint32_t);
 	//std::size_t lineListsBufferSize = lineLists.size() * sizeof(uint32_t);
 
 
 	// Create final position and index buffers
-	lut::Buffer vertexPosGPU = lut::create_buffer(
-		aAllocator,
-		posBufferSize,
-		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-		0, // no additional VmaAllocationCreateFlags
-		VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE // or just VMA_MEMORY_USAGE_AUTO
-	);
-	lut::Buffer indexGPU = lut::create_buffer(
-		aAllocator,
-		indexBufferSize,
-		VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-		//VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-		0, // no additional VmaAllocationCreateFlags
-		VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE // or just VMA_MEMORY_USAGE_AUTO
-	);
-
-
-	// create CPU visible staging buffer
-	lut::Buffer posStaging = lut::create_buffer(
-		aAllocator,
-		posBufferSize,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT
-	);
-	lut::Buffer indexStaging = lut::create_buffer(
-		aAllocator,
-		indexBufferSize,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT
-	);
-
-
-	// copy data into staging buffer
-	void* posPtr = nullptr;
-	if (auto const res = vmaMapMemory(aAllocator.allocator, posStaging.allocation, &posPtr); VK_SUCCESS != res)
-	{
-		throw lut::Error("Mapping memory for writing\n"
-			"vmaMapMemory() returned %s", lut::to_string(res).c_str());
-	}
-	std::memcpy(posPtr, vPositions.data(), posBufferSize);
-	vmaUnmapMemory(aAllocator.allocator, posStaging.allocation);
-
-	void* indexPtr = nullptr;
-	if (auto const res = vmaMapMemory(aAllocator.allocator, indexStaging.allocation, &indexPtr); VK_SUCCESS != res)
-	{
-		throw lut::Error("Mapping memory for writing\n"
-			"vmaMapMemory() returned %s", lut::to_string(res).c_str());
-	}
-	std::memcpy(indexPtr, indices.data(), indexBufferSize);
-	vmaUnmapMemory(aAllocator.allocator, indexStaging.allocation);
-
-	// transfer data from staging buffer to GPU buffer 
-
-	// Create fence to wait for transfer completion
-	lut::Fence uploadComplete = create_fence(aContext);
-
-	// Create dedicated command pool & buffer for upload
-	lut::CommandPool uploadPool = create_command_pool(aContext);
-	VkCommandBuffer uploadCmd = alloc_command_buffer(aContext, uploadPool.handle);
+	lut::Buffer vertexPosGPU = lut::create_device_buffer(aAllocator, posBufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+	lut::Buffer indexGPU = lut::create_device_buffer(aAllocator, indexBufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
 
-	// Begin recording
-	VkCommandBufferBeginInfo beginInfo{};
-	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.flags = 0;
-	beginInfo.pInheritanceInfo = nullptr;
-
-	if (auto const res = vkBeginCommandBuffer(uploadCmd, &beginInfo); VK_SUCCESS != res)
-	{
-		throw lut::Error("Beginning command buffer recording\n"
-			"vkBeginCommandBuffer() returned %s", lut::to_string(res).c_str());
-	}
-
-	// Copy position data
-	VkBufferCopy pcopy{};
-	pcopy.size = posBufferSize;
-	vkCmdCopyBuffer(uploadCmd, posStaging.buffer, vertexPosGPU.buffer, 1, &pcopy);
-
-	// Barrier to ensure safe read in vertex shader
-	lut::buffer_barrier(
-		uploadCmd,
-		vertexPosGPU.buffer,
-		VK_ACCESS_TRANSFER_WRITE_BIT,
-		VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-		VK_PIPELINE_STAGE_TRANSFER_BIT,
-		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
-	);
-
-	// Copy index data
-	VkBufferCopy icopy{};
-	icopy.size = indexBufferSize;
-	vkCmdCopyBuffer(uploadCmd, indexStaging.buffer, indexGPU.buffer, 1, &icopy);
-
-
-	lut::buffer_barrier(
-		uploadCmd,
-		indexGPU.buffer,
-		VK_ACCESS_TRANSFER_WRITE_BIT,
-		VK_ACCESS_INDEX_READ_BIT,
-		VK_PIPELINE_STAGE_TRANSFER_BIT,
-		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
-	);
-
-	// Finish recording
-	if (auto const res = vkEndCommandBuffer(uploadCmd); VK_SUCCESS != res)
-	{
-		throw lut::Error("Ending command buffer recording\n"
-			"vkEndCommandBuffer() returned %s", lut::to_string(res).c_str());
-	}
-
-	// Submit transfer commands
-	VkSubmitInfo submitInfo{};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &uploadCmd;
-
-	if (auto const res = vkQueueSubmit(aContext.graphicsQueue, 1, &submitInfo, uploadComplete.handle); VK_SUCCESS != res)
-	{
-		throw lut::Error("Submitting commands\n"
-			"vkQueueSubmit() returned %s", lut::to_string(res).c_str());
-	}
-
-	// Wait for commands to finish before we destroy the temporary resources required for the transfers
-	// (staging buffers, command pool, ...)
-
-	if (auto const res = vkWaitForFences(aContext.device, 1, &uploadComplete.handle, VK_TRUE, std::numeric_limits<std::uint64_t>::max()); VK_SUCCESS != res)
-	{
-		throw lut::Error("Waiting for upload to complete\n"
-			"vkWaitForFences() returned %s", lut::to_string(res).c_str());
-	}
+	// positions straight from the vertices; later work on the graphics queue
+	// runs after the copies
+	aUploads.write_elements(vertexPosGPU, vertices.size(), sizeof(glm::vec3), [&](std::byte* aOut, std::size_t aFirst, std::size_t aCount)
+		{
+			for (std::size_t i = 0; i < aCount; ++i)
+				std::memcpy(aOut + i * sizeof(glm::vec3), &vertices[aFirst + i].pos, sizeof(glm::vec3));
+		});
+	write_std430(aUploads, indexGPU, indices);
+	aUploads.submit();
 
 	return ModelMesh{
 	std::move(vertexPosGPU),
@@ -197,125 +140,86 @@ ModelMesh create_model_buffer_tri(lut::VulkanContext const& aContext, lut::Alloc
 
 }
 
-SubdivisionMesh create_model_buffer(lut::VulkanContext const& aContext, lut::Allocator const& aAllocator, lut::GltfModel const& aModel)
+SubdivisionMesh create_model_buffer(
+	lut::Allocator const& aAllocator,
+	lut::UploadContext& aUploads,
+	lut::GltfModel const& aModel,
+	std::vector<glm::vec3> const* aLimitPositions,
+	std::vector<glm::vec3> const* aLimitNormals)
 {
+	LUT_PROFILE_FUNCTION();
 
 
 
 	SubdivisionMesh result{};
-	std::vector<std::tuple<lut::Buffer, VkBuffer, std::size_t>> stagingPairs;
+
+	// Every array is serialised from the model straight into staging (or into
+	// the buffer itself where device memory is mapped), without a padded copy
+	// on the heap first.
+	constexpr VkBufferUsageFlags kUsage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+	auto make_buffer = [&](std::size_t size, VkBufferUsageFlags usage, labutils::Buffer& outBuf)
+		{
+			outBuf = lut::create_device_buffer(aAllocator, size, usage | kUsage);
+		};
 
 	// lambda fuction for buffer
 	auto upload_vector = [&](auto const& vec, VkBufferUsageFlags usage, labutils::Buffer& outBuf)
 		{
 			using T = std::decay_t<decltype(vec[0])>;
 
-			const std::size_t elemStd430 = std430_sizeof<T>();
-			const std::size_t allocSize = vec.size() * elemStd430;
+			const std::size_t allocSize = vec.size() * std430_sizeof<T>();
 
+			make_buffer(allocSize, usage, outBuf);
+			write_std430(aUploads, outBuf, vec);
+		};
 
-			lut::Buffer gpuBuf = create_buffer(
-				aAllocator,
-				allocSize,
-				usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-				0,
-				VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE
-			);
+	auto const& vertices = aModel.m_quadVertices;
+	std::size_t const pointBytes = vertices.size() * sizeof(glm::vec4);
 
+	make_buffer(pointBytes, 0, result.controlPoints);
+	write_vec4(aUploads, result.controlPoints, vertices.size(), 0.f, [&](std::size_t i) { return vertices[i].pos; });
 
-			lut::Buffer staging = create_buffer(
-				aAllocator,
-				allocSize,
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT
-			);
+	upload_vector(aModel.get_quad_mesh().heVertex, 0, result.quadFaces);
+	upload_vector(aModel.m_edgeList, 0, result.edgeList);
+	upload_vector(aModel.m_edgeToFace, 0, result.edgeToFace);
+	upload_vector(aModel.get_quad_mesh().heEdge, 0, result.faceEdgeIndices);
+	upload_vector(aModel.m_vertexFaceCounts, 0, result.vertexFaceCounts);
+	upload_vector(aModel.m_vertexFaceIndices, 0, result.vertexFaceIndices);
+	upload_vector(aModel.m_vertexEdgeCounts, 0, result.vertexEdgeCounts);
+	upload_vector(aModel.m_vertexEdgeIndices, 0, result.vertexEdgeIndices);
 
+	make_buffer((aModel.m_vertexFaceCounts.size() + 1) * sizeof(std::uint32_t), 0, result.vertexFaceOffsets);
+	write_csr_offsets(aUploads, result.vertexFaceOffsets, aModel.m_vertexFaceCounts);
+	make_buffer((aModel.m_vertexEdgeCounts.size() + 1) * sizeof(std::uint32_t), 0, result.vertexEdgeOffsets);
+	write_csr_offsets(aUploads, result.vertexEdgeOffsets, aModel.m_vertexEdgeCounts);
 
-			uint8_t* dst = nullptr;
-			vmaMapMemory(aAllocator.allocator, staging.allocation, (void**)&dst);
+	make_buffer(aModel.m_sharpness.size() * sizeof(float), 0, result.edgeSharpness);
+	write_sharpness(aUploads, result.edgeSharpness, aModel.m_sharpness);
 
-			for (size_t i = 0; i < vec.size(); ++i)
-			{
-				std::memcpy(dst + i * elemStd430, &vec[i], sizeof(T));                 
-				if constexpr (elemStd430 > sizeof(T))                                  
-					std::memset(dst + i * elemStd430 + sizeof(T), 0, elemStd430 - sizeof(T));
-			}
-			vmaUnmapMemory(aAllocator.allocator, staging.allocation);
-
-			outBuf = std::move(gpuBuf);
-			std::cout << "UPLOAD "
-				<< typeid(T).name()
-				<< " elem=" << vec.size()
-				<< " allocSz=" << allocSize
-				<< " stageSz=" << allocSize 
-				<< std::endl;
-			return std::make_tuple(std::move(staging), outBuf.buffer, allocSize);      
-		};
-
-
-	auto& vertices = aModel.m_quadVertices;
-	std::vector<glm::vec4> controlPoints;
-	controlPoints.reserve(vertices.size());
-	for (auto const& v : vertices)
+	make_buffer(pointBytes, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, result.drawVertices);
+	make_buffer(pointBytes, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, result.drawNormals);
+	if (aLimitPositions && aLimitNormals)
 	{
-		controlPoints.emplace_back(v.pos, 0.0f);
+		assert(aLimitPositions->size() == vertices.size() && aLimitNormals->size() == vertices.size());
+		write_vec4(aUploads, result.drawVertices, vertices.size(), 0.f, [&](std::size_t i) { return (*aLimitPositions)[i]; });
+		write_vec4(aUploads, result.drawNormals, vertices.size(), 0.f, [&](std::size_t i) { return (*aLimitNormals)[i]; });
 	}
-
-	auto stageCP = upload_vector(controlPoints, 0, result.controlPoints);
-	auto stageFQ = upload_vector(aModel.get_quad_faces(), 0, result.quadFaces);
-	auto stageEL = upload_vector(aModel.m_edgeList, 0, result.edgeList);
-	auto stageEF = upload_vector(aModel.m_edgeToFace, 0, result.edgeToFace);
-	auto stageFEI = upload_vector(aModel.m_faceEdgeIndices, 0, result.faceEdgeIndices);
-	auto stageVFCount = upload_vector(aModel.m_vertexFaceCounts, 0, result.vertexFaceCounts);
-	auto stageVFIndex = upload_vector(aModel.m_vertexFaceIndices, 0, result.vertexFaceIndices);
-	auto stageVECount = upload_vector(aModel.m_vertexEdgeCounts, 0, result.vertexEdgeCounts);
-	auto stageVEIndex = upload_vector(aModel.m_vertexEdgeIndices, 0, result.vertexEdgeIndices);
-
-	auto stagedrawdrawVertices = upload_vector(controlPoints, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, result.drawVertices);
-	auto stagedrawdrawIndices = upload_vector(aModel.m_quadIndices, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, result.drawIndices);
-	auto stagedrawLinelists = upload_vector(aModel.m_quadLinelists, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, result.drawLinelists);
-
-	stagingPairs.push_back(std::move(stageCP));
-	stagingPairs.push_back(std::move(stageFQ));
-	stagingPairs.push_back(std::move(stageEL));
-	stagingPairs.push_back(std::move(stageEF));
-	stagingPairs.push_back(std::move(stageFEI));
-	stagingPairs.push_back(std::move(stageVFCount));
-	stagingPairs.push_back(std::move(stageVFIndex));
-	stagingPairs.push_back(std::move(stageVECount));
-	stagingPairs.push_back(std::move(stageVEIndex));
-
-	stagingPairs.push_back(std::move(stagedrawdrawVertices));
-	stagingPairs.push_back(std::move(stagedrawdrawIndices));
-	stagingPairs.push_back(std::move(stagedrawLinelists));
-
-	lut::Fence uploadFence = create_fence(aContext);
-	lut::CommandPool pool = create_command_pool(aContext);
-	VkCommandBuffer cmdBuf = alloc_command_buffer(aContext, pool.handle);
-
-	VkCommandBufferBeginInfo beginInfo{};
-	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	vkBeginCommandBuffer(cmdBuf, &beginInfo);
-
-	for (auto& [staging, gpu, size] : stagingPairs) {
-		VkBufferCopy copy{};
-		copy.size = size;
-		vkCmdCopyBuffer(cmdBuf, staging.buffer, gpu, 1, &copy);
-
-		// Ensure copy stage finished before using
-		lut::buffer_barrier(
-			cmdBuf, gpu,
-			VK_ACCESS_TRANSFER_WRITE_BIT,
-			VK_ACCESS_SHADER_READ_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
-		);
+	else
+	{
+		// the control points are drawn as they are, unlit: copied on the
+		// device instead of being sent twice
+		aUploads.copy(result.controlPoints.buffer, result.drawVertices.buffer, pointBytes);
+		aUploads.fill(result.drawNormals.buffer, pointBytes, 0);
 	}
+	upload_vector(aModel.m_quadIndices, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, result.drawIndices);
+	upload_vector(aModel.m_quadLinelists, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, result.drawLinelists);
+
+	// one submit for the whole level; later work on the graphics queue runs after it
+	aUploads.submit();
 
-	vkEndCommandBuffer(cmdBuf);
 	result.facePoints = create_buffer(
 		aAllocator,
-		aModel.m_quadFaces.size() * sizeof(glm::vec4),
+		aModel.get_quad_mesh().face_count() * sizeof(glm::vec4),
 		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 		0,
 		VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE
@@ -335,16 +239,9 @@ SubdivisionMesh create_model_buffer(lut::VulkanContext const& aContext, lut::All
 		VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE
 	);
 
-	VkSubmitInfo submitInfo{};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &cmdBuf;
-	vkQueueSubmit(aContext.graphicsQueue, 1, &submitInfo, uploadFence.handle);
-	vkWaitForFences(aContext.device, 1, &uploadFence.handle, VK_TRUE, UINT64_MAX);
-
 	result.vertexCount = aModel.m_quadVertices.size();
 	result.edgeCount = aModel.m_edgeList.size();
-	result.faceCount = aModel.m_quadFaces.size();
+	result.faceCount = aModel.get_quad_mesh().face_count();
 
 	return result;
 
@@ -357,6 +254,7 @@ SubdivisionMesh create_empty_buffer(
 	std::size_t edgeCount,
 	std::size_t faceCount)
 {
+	LUT_PROFILE_FUNCTION();
 	SubdivisionMesh result{};
 
 	
@@ -375,21 +273,29 @@ SubdivisionMesh create_empty_buffer(
 
 
 	// === Geometry buffers ===
-	alloc((vertexCount + edgeCount + faceCount) * sizeof(glm::vec4), NULL, result.controlPoints);
-	alloc(4 * faceCount * sizeof(glm::uvec4), NULL, result.quadFaces);
-	alloc((edgeCount * 2 + 4 * faceCount) * sizeof(glm::uvec2), NULL, result.edgeList);
-	alloc((edgeCount * 2 + 4 * faceCount) * sizeof(glm::uvec2), NULL, result.edgeToFace);
-	alloc(4 * faceCount * sizeof(glm::uvec4), NULL, result.faceEdgeIndices);
+	alloc((vertexCount + edgeCount + faceCount) * sizeof(glm::vec4), 0, result.controlPoints);
+	alloc(4 * faceCount * sizeof(glm::uvec4), 0, result.quadFaces);
+	alloc((edgeCount * 2 + 4 * faceCount) * sizeof(glm::uvec2), 0, result.edgeList);
+	alloc((edgeCount * 2 + 4 * faceCount) * sizeof(glm::uvec2), 0, result.edgeToFace);
+	alloc(4 * faceCount * sizeof(glm::uvec4), 0, result.faceEdgeIndices);
+	alloc((edgeCount * 2 + 4 * faceCount) * sizeof(float), 0, result.edgeSharpness);
 	//allocVertex(vertexCount, result.controlPoints);          // glm::vec4
 	//allocUvec4(faceCount, result.quadFaces);                 // glm::uvec4
 	//allocUvec2(edgeCount, result.edgeList);                  // glm::uvec2
 	//allocUvec2(edgeCount * 2, result.edgeToFace);            // 2 faces per edge
 	//allocUvec4(faceCount, result.faceEdgeIndices);           // 4 edges per face
 
-	alloc((vertexCount + edgeCount + faceCount) * sizeof(uint32_t), NULL, result.vertexFaceCounts);
-	alloc(16 * faceCount * sizeof(uint32_t), NULL, result.vertexFaceIndices);
-	alloc((vertexCount + edgeCount + faceCount) * sizeof(uint32_t), NULL, result.vertexEdgeCounts);
-	alloc(2 * (edgeCount * 2 + 4 * faceCount) * sizeof(uint32_t), NULL, result.vertexEdgeIndices);
+	alloc((vertexCount + edgeCount + faceCount) * sizeof(uint32_t), 0, result.vertexFaceCounts);
+	alloc(16 * faceCount * sizeof(uint32_t), 0, result.vertexFaceIndices);
+	alloc((vertexCount + edgeCount + faceCount) * sizeof(uint32_t), 0, result.vertexEdgeCounts);
+	alloc(2 * (edgeCount * 2 + 4 * faceCount) * sizeof(uint32_t), 0, result.vertexEdgeIndices);
+
+	// scanned on the device, one block sum per 512 counts (prefixScan.comp)
+	std::size_t const scanBlocks = (vertexCount + edgeCount + faceCount + 1 + 511) / 512;
+	alloc((vertexCount + edgeCount + faceCount + 1) * sizeof(uint32_t), 0, result.vertexFaceOffsets);
+	alloc((vertexCount + edgeCount + faceCount + 1) * sizeof(uint32_t), 0, result.vertexEdgeOffsets);
+	alloc(scanBlocks * sizeof(uint32_t), 0, result.vertexFaceBlockSums);
+	alloc(scanBlocks * sizeof(uint32_t), 0, result.vertexEdgeBlockSums);
 
 	//allocUint(vertexCount, result.vertexFaceCounts);
 	//allocUint(vertexCount * 4, result.vertexFaceIndices);    // max 4 faces per vertex
@@ -397,30 +303,146 @@ SubdivisionMesh create_empty_buffer(
 	//allocUint(vertexCount * 4, result.vertexEdgeIndices);    // max 4 edges per vertex
 
 	// === Compute outputs ===
-	alloc(4 * faceCount * sizeof(glm::vec4), NULL, result.facePoints);
-	alloc((edgeCount * 2 + 4 * faceCount) * sizeof(glm::vec4), NULL, result.edgePoints);
-	alloc((vertexCount + edgeCount + faceCount) * sizeof(glm::vec4), NULL, result.updatedVertices);
+	alloc(4 * faceCount * sizeof(glm::vec4), 0, result.facePoints);
+	alloc((edgeCount * 2 + 4 * faceCount) * sizeof(glm::vec4), 0, result.edgePoints);
+	alloc((vertexCount + edgeCount + faceCount) * sizeof(glm::vec4), 0, result.updatedVertices);
 	//allocVertex(faceCount, result.facePoints);               // glm::vec4
 	//allocVertex(edgeCount, result.edgePoints);               // glm::vec4
 	//allocVertex(vertexCount, result.updatedVertices);        // glm::vec4
 
 	// === Drawing buffers ===
 	alloc((vertexCount + edgeCount + faceCount) * sizeof(glm::vec4), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, result.drawVertices);
+	alloc((vertexCount + edgeCount + faceCount) * sizeof(glm::vec4), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, result.drawNormals);
 	alloc(faceCount * 24 * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, result.drawIndices);
 	alloc((edgeCount * 2 + 4 * faceCount) * 2 * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, result.drawLinelists);
 	//allocVertex(vertexCount + edgeCount + faceCount, result.drawVertices);  // conservative overalloc
 	//allocUint(faceCount * 6, result.drawIndices);           // each quad becomes 6 indices
 	//allocUint(edgeCount * 2, result.drawLinelists);         // 1 line = 2 indices
 
+	// counts of the refined level these buffers hold
+	result.vertexCount = std::uint32_t(vertexCount + edgeCount + faceCount);
+	result.edgeCount = std::uint32_t(edgeCount * 2 + 4 * faceCount);
+	result.faceCount = std::uint32_t(4 * faceCount);
+
+	return result;
+}
+
+
+StencilBuffers create_stencil_buffers(
+	lut::Allocator const& aAllocator,
+	lut::UploadContext& aUploads,
+	lut::StencilTable const& aTable,
+	std::vector<lut::Vertex> const& aCage,
+	std::uint32_t aFrameSlots)
+{
+	LUT_PROFILE_FUNCTION();
+	assert(aTable.sourceCount == aCage.size());
+
+	StencilBuffers result{};
+	result.sourceCount = aTable.sourceCount;
+	result.rowCount = aTable.row_count();
+	result.frameSlots = aFrameSlots;
+
+	// plain 4-byte elements, no std430 padding needed
+	auto upload_vector = [&](auto const& vec, labutils::Buffer& outBuf)
+		{
+			outBuf = lut::create_device_buffer(aAllocator, vec.size() * sizeof(vec[0]), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+			write_std430(aUploads, outBuf, vec);
+		};
+
+	upload_vector(aTable.offsets, result.stencilOffsets);
+	upload_vector(aTable.indices, result.stencilIndices);
+	upload_vector(aTable.weights, result.stencilWeights);
+
+	result.cagePoints = lut::create_device_buffer(aAllocator, result.cage_bytes(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	write_vec4(aUploads, result.cagePoints, aCage.size(), 1.f, [&](std::size_t i) { return aCage[i].pos; });
+
+	// persistently mapped, one slot per frame in flight so that a frame can
+	// write its cage while the previous one is still being copied
+	result.cageStaging = create_buffer(
+		aAllocator,
+		result.cage_bytes() * aFrameSlots,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT
+	);
+	VmaAllocationInfo stagingInfo{};
+	vmaGetAllocationInfo(aAllocator.allocator, result.cageStaging.allocation, &stagingInfo);
+	result.cageMapped = stagingInfo.pMappedData;
+
+	aUploads.submit();
 
 	return result;
 }
 
+void write_stencil_cage(lut::Allocator const& aAllocator, StencilBuffers& aStencils, std::vector<glm::vec4> const& aCage, std::uint32_t aSlot)
+{
+	assert(aCage.size() == aStencils.sourceCount && aSlot < aStencils.frameSlots);
+
+	auto* dst = static_cast<std::uint8_t*>(aStencils.cageMapped) + aSlot * aStencils.cage_bytes();
+	std::memcpy(dst, aCage.data(), aStencils.cage_bytes());
+
+	// no-op on coherent memory
+	vmaFlushAllocation(aAllocator.allocator, aStencils.cageStaging.allocation, aSlot * aStencils.cage_bytes(), aStencils.cage_bytes());
+}
+
+
+VkDeviceSize device_bytes(lut::Allocator const& aAllocator, SubdivisionMesh const& aMesh)
+{
+	lut::Buffer const* const buffers[] = {
+		&aMesh.controlPoints, &aMesh.quadFaces, &aMesh.edgeList, &aMesh.edgeToFace,
+		&aMesh.vertexFaceCounts, &aMesh.vertexFaceIndices, &aMesh.vertexEdgeCounts, &aMesh.vertexEdgeIndices,
+		&aMesh.faceEdgeIndices, &aMesh.edgeSharpness,
+		&aMesh.vertexFaceOffsets, &aMesh.vertexEdgeOffsets, &aMesh.vertexFaceBlockSums, &aMesh.vertexEdgeBlockSums,
+		&aMesh.facePoints, &aMesh.edgePoints, &aMesh.updatedVertices,
+		&aMesh.drawVertices, &aMesh.drawNormals, &aMesh.drawIndices, &aMesh.drawLinelists
+	};
+
+	VkDeviceSize bytes = 0;
+	for (lut::Buffer const* buffer : buffers)
+	{
+		if (buffer->allocation == VK_NULL_HANDLE)
+			continue;
+		VmaAllocationInfo info{};
+		vmaGetAllocationInfo(aAllocator.allocator, buffer->allocation, &info);
+		bytes += info.size;
+	}
+	return bytes;
+}
+
 
-SubdivisionMesh create_model_mesh_extended(labutils::VulkanContext const& aContext,labutils::Allocator const& aAllocator, labutils::GltfModel const& aModel) {
+PatchMesh create_patch_buffer(lut::Allocator const& aAllocator, lut::UploadContext& aUploads, lut::PatchTable const& aTable, std::vector<lut::PatchSide> const& aSides)
+{
+	LUT_PROFILE_FUNCTION();
+	PatchMesh result{};
+	result.patchCount = aTable.patch_count();
+	if (0 == result.patchCount)
+		return result;
+	assert(aSides.size() == 4 * std::size_t(result.patchCount));
+
+	std::size_t const size = aTable.points.size() * sizeof(glm::vec4);
+
+	result.controlPoints = lut::create_device_buffer(aAllocator, size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+	write_vec4(aUploads, result.controlPoints, aTable.points.size(), 1.f, [&](std::size_t i) { return aTable.points[i]; });
+
+	std::vector<glm::vec4> sides(aTable.points.size(), glm::vec4(0.f));
+	for (std::size_t i = 0; i < aSides.size(); ++i)
+	{
+		lut::PatchSide const& side = aSides[i];
+		std::size_t const patch = 16 * (i / 4), k = i % 4;
+		sides[patch + k] = glm::vec4(side.a, side.referenceScale);
+		sides[patch + 4 + k] = glm::vec4(side.b, side.sideScale);
+	}
+	result.sides = lut::create_device_buffer(aAllocator, size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+	write_std430(aUploads, result.sides, sides);
+	aUploads.submit();
+
+	return result;
+}
+
+SubdivisionMesh create_model_mesh_extended(labutils::Allocator const& aAllocator, labutils::UploadContext& aUploads, labutils::GltfModel const& aModel) {
 	using namespace labutils;
 
-	const uint32_t faceCount = static_cast<uint32_t>(aModel.m_quadFaces.size());
+	const uint32_t faceCount = static_cast<uint32_t>(aModel.get_quad_mesh().face_count());
 
 	SubdivisionMesh result{};
 
@@ -433,77 +455,34 @@ SubdivisionMesh create_model_mesh_extended(labutils::VulkanContext const& aConte
 		const std::size_t allocSize = vec.size() * elemStd430;
 
 		/* GPU buffer — allocSize */
-		Buffer gpuBuf = create_buffer(
-			aAllocator,
-			allocSize,
-			usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			0,
-			VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE
-		);
-
-		/* staging buffer — 同样 allocSize！ */
-		Buffer staging = create_buffer(
-			aAllocator,
-			allocSize,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT
-		);
+		Buffer gpuBuf = create_device_buffer(aAllocator, allocSize, usage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
 
 		/* 填充数据（含 16B padding） */
-		uint8_t* dst = nullptr;
-		vmaMapMemory(aAllocator.allocator, staging.allocation, (void**)&dst);
-
-		for (size_t i = 0; i < vec.size(); ++i)
-		{
-			std::memcpy(dst + i * elemStd430, &vec[i], sizeof(T));                 // 实际数据
-			if constexpr (elemStd430 > sizeof(T))                                  // 填零 padding
-				std::memset(dst + i * elemStd430 + sizeof(T), 0, elemStd430 - sizeof(T));
-		}
-		vmaUnmapMemory(aAllocator.allocator, staging.allocation);
+		write_std430(aUploads, gpuBuf, vec);
 
 		outBuf = std::move(gpuBuf);
-		std::cout << "UPLOAD "
-			<< typeid(T).name()
-			<< " elem=" << vec.size()
-			<< " allocSz=" << allocSize
-			<< " stageSz=" << allocSize /* or dataSize */
-			<< std::endl;
-		return std::make_tuple(std::move(staging), outBuf.buffer, allocSize);      // ★ copy.size = allocSize
 	};
 
-	std::vector<std::tuple<Buffer, VkBuffer, std::size_t>> stagingPairs;
-
 	auto& vertices = aModel.get_quad_vertices();
 
-	std::vector<glm::vec4> controlPoints;
-	controlPoints.reserve(vertices.size());
-	for (auto const& v : vertices)
-		controlPoints.emplace_back(v.pos, 0.0f);
-
 	// read only buffer
-	auto stageCP = upload_vector(controlPoints, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, result.controlPoints);
-	auto stageFQ = upload_vector(aModel.get_quad_faces(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, result.quadFaces);
-	auto stageEL = upload_vector(aModel.m_edgeList, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, result.edgeList);
-	auto stageEF = upload_vector(aModel.m_edgeToFace, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, result.edgeToFace);
-	auto stageFEI = upload_vector(aModel.m_faceEdgeIndices, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, result.faceEdgeIndices);
-	auto stageVFCount = upload_vector(aModel.m_vertexFaceCounts, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, result.vertexFaceCounts);
-	auto stageVFIndex = upload_vector(aModel.m_vertexFaceIndices, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, result.vertexFaceIndices);
-	auto stageVECount = upload_vector(aModel.m_vertexEdgeCounts, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, result.vertexEdgeCounts);
-	auto stageVEIndex = upload_vector(aModel.m_vertexEdgeIndices, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, result.vertexEdgeIndices);
-	auto stagedrawVertices = upload_vector(aModel.m_quadLinelists, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, result.drawLinelists);
-
-	auto stageLinelists = upload_vector(aModel.m_quadLinelists, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, result.drawLinelists);
-
-	stagingPairs.push_back(std::move(stageCP));
-	stagingPairs.push_back(std::move(stageFQ));
-	stagingPairs.push_back(std::move(stageEL));
-	stagingPairs.push_back(std::move(stageEF));
-	stagingPairs.push_back(std::move(stageFEI));
-	stagingPairs.push_back(std::move(stageVFCount));
-	stagingPairs.push_back(std::move(stageVFIndex));
-	stagingPairs.push_back(std::move(stageVECount));
-	stagingPairs.push_back(std::move(stageVEIndex));
-	stagingPairs.push_back(std::move(stageLinelists));
+	result.controlPoints = create_device_buffer(aAllocator, vertices.size() * sizeof(glm::vec4), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+	write_vec4(aUploads, result.controlPoints, vertices.size(), 0.f, [&](std::size_t i) { return vertices[i].pos; });
+	upload_vector(aModel.get_quad_mesh().heVertex, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, result.quadFaces);
+	upload_vector(aModel.m_edgeList, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, result.edgeList);
+	upload_vector(aModel.m_edgeToFace, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, result.edgeToFace);
+	upload_vector(aModel.get_quad_mesh().heEdge, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, result.faceEdgeIndices);
+	upload_vector(aModel.m_vertexFaceCounts, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, result.vertexFaceCounts);
+	upload_vector(aModel.m_vertexFaceIndices, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, result.vertexFaceIndices);
+	upload_vector(aModel.m_vertexEdgeCounts, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, result.vertexEdgeCounts);
+	upload_vector(aModel.m_vertexEdgeIndices, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, result.vertexEdgeIndices);
+	result.vertexFaceOffsets = create_device_buffer(aAllocator, (aModel.m_vertexFaceCounts.size() + 1) * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+	write_csr_offsets(aUploads, result.vertexFaceOffsets, aModel.m_vertexFaceCounts);
+	result.vertexEdgeOffsets = create_device_buffer(aAllocator, (aModel.m_vertexEdgeCounts.size() + 1) * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+	write_csr_offsets(aUploads, result.vertexEdgeOffsets, aModel.m_vertexEdgeCounts);
+	result.edgeSharpness = create_device_buffer(aAllocator, aModel.m_sharpness.size() * sizeof(float), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+	write_sharpness(aUploads, result.edgeSharpness, aModel.m_sharpness);
+	upload_vector(aModel.m_quadLinelists, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, result.drawLinelists);
 
 	// lambda fuction for write buffer
 	auto allocOutputBuffer = [&](std::size_t count, Buffer& outBuf)
@@ -530,7 +509,7 @@ SubdivisionMesh create_model_mesh_extended(labutils::VulkanContext const& aConte
 			);
 		};
 	// write only buffer
-	allocOutputBuffer(aModel.m_quadFaces.size(), result.facePoints);
+	allocOutputBuffer(aModel.get_quad_mesh().face_count(), result.facePoints);
 	allocOutputBuffer(aModel.m_edgeList.size(), result.edgePoints);
 	allocOutputBuffer(aModel.m_quadVertices.size(), result.updatedVertices);
 	//allocOutputBuffer(aModel.m_quadFacesRaw.size() + aModel.m_edgeList.size() + aModel.m_quadVerticesRaw.size(), result.drawVertices);
@@ -544,12 +523,19 @@ SubdivisionMesh create_model_mesh_extended(labutils::VulkanContext const& aConte
 		0,
 		VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE
 	);
+	result.drawNormals = create_buffer(
+		aAllocator,
+		drawVertSize,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		0,
+		VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE
+	);
 
 
 
 	result.vertexCount = static_cast<uint32_t>(aModel.m_quadVertices.size());
 	result.edgeCount = static_cast<uint32_t>(aModel.m_edgeList.size());
-	result.faceCount = static_cast<uint32_t>(aModel.m_quadFaces.size());
+	result.faceCount = static_cast<uint32_t>(aModel.get_quad_mesh().face_count());
 
 	std::size_t drawIdxCount = faceCount * 24;
 	std::size_t drawIdxSize = drawIdxCount * sizeof(uint32_t);
@@ -565,38 +551,7 @@ SubdivisionMesh create_model_mesh_extended(labutils::VulkanContext const& aConte
 	);
 
 
-	Fence uploadFence = create_fence(aContext);
-	CommandPool pool = create_command_pool(aContext);
-	VkCommandBuffer cmdBuf = alloc_command_buffer(aContext, pool.handle);
-
-	VkCommandBufferBeginInfo beginInfo{};
-	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	vkBeginCommandBuffer(cmdBuf, &beginInfo);
-
-	for (auto& [staging, gpu, size] : stagingPairs) {
-		VkBufferCopy copy{};
-		copy.size = size;
-		vkCmdCopyBuffer(cmdBuf, staging.buffer, gpu, 1, &copy);
-
-		buffer_barrier(
-			cmdBuf, gpu,
-			VK_ACCESS_TRANSFER_WRITE_BIT,
-			VK_ACCESS_SHADER_READ_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
-		);
-	}
-
-	vkEndCommandBuffer(cmdBuf);
-
-	VkSubmitInfo submitInfo{};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &cmdBuf;
-	vkQueueSubmit(aContext.graphicsQueue, 1, &submitInfo, uploadFence.handle);
-	vkWaitForFences(aContext.device, 1, &uploadFence.handle, VK_TRUE, UINT64_MAX);
-
-
+	aUploads.submit();
 
 	return result;
 }
@@ -933,3 +888,135 @@ void debug_readback_linelist(
 
 	vmaUnmapMemory(aAllocator.allocator, staging.allocation);
 }
+
+namespace
+{
+	// Copy aCount elements of a device buffer into host memory.
+	template<class T>
+	std::vector<T> read_back(
+		labutils::VulkanContext const& aContext,
+		labutils::Allocator     const& aAllocator,
+		VkQueue                         queue,
+		labutils::Buffer        const& gpuBuffer,
+		std::size_t                     aCount)
+	{
+		using namespace labutils;
+
+		std::vector<T> result(aCount);
+		if (aCount == 0)
+			return result;
+
+		std::size_t const sizeBytes = aCount * sizeof(T);
+		Buffer staging = create_buffer(
+			aAllocator,
+			sizeBytes,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT);
+
+		auto pool = create_command_pool(aContext, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+		VkCommandBuffer cmdBuf = alloc_command_buffer(aContext, pool.handle);
+
+		VkCommandBufferBeginInfo bi{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+		vkBeginCommandBuffer(cmdBuf, &bi);
+
+		VkBufferCopy copy{ 0, 0, sizeBytes };
+		vkCmdCopyBuffer(cmdBuf, gpuBuffer.buffer, staging.buffer, 1, &copy);
+		vkEndCommandBuffer(cmdBuf);
+
+		Fence fence = create_fence(aContext);
+		VkSubmitInfo si{ VK_STRUCTURE_TYPE_SUBMIT_INFO };
+		si.commandBufferCount = 1;
+		si.pCommandBuffers = &cmdBuf;
+
+		vkQueueSubmit(queue, 1, &si, fence.handle);
+		vkWaitForFences(aContext.device, 1, &fence.handle, VK_TRUE, UINT64_MAX);
+
+		void* mapped = nullptr;
+		if (auto const res = vmaMapMemory(aAllocator.allocator, staging.allocation, &mapped); VK_SUCCESS != res)
+		{
+			throw lut::Error("Mapping memory for readback\n"
+				"vmaMapMemory() returned %s", lut::to_string(res).c_str());
+		}
+		vmaInvalidateAllocation(aAllocator.allocator, staging.allocation, 0, VK_WHOLE_SIZE);
+		std::memcpy(result.data(), mapped, sizeBytes);
+		vmaUnmapMemory(aAllocator.allocator, staging.allocation);
+
+		return result;
+	}
+}
+
+bool validate_gpu_topology(
+	labutils::VulkanContext const& aContext,
+	labutils::Allocator     const& aAllocator,
+	VkQueue                         queue,
+	SubdivisionMesh         const& aMesh)
+{
+	constexpr std::uint32_t kInvalid = 0xFFFFFFFFu;
+	constexpr std::size_t kMaxReported = 8;
+
+	auto const quads = read_back<glm::uvec4>(aContext, aAllocator, queue, aMesh.quadFaces, aMesh.faceCount);
+	auto const faceEdges = read_back<glm::uvec4>(aContext, aAllocator, queue, aMesh.faceEdgeIndices, aMesh.faceCount);
+	auto const edges = read_back<glm::uvec2>(aContext, aAllocator, queue, aMesh.edgeList, aMesh.edgeCount);
+	auto const edgeFaces = read_back<glm::uvec2>(aContext, aAllocator, queue, aMesh.edgeToFace, aMesh.edgeCount);
+
+	std::size_t problems = 0;
+	auto report = [&](char const* aWhat, std::size_t aIndex) {
+		if (problems++ < kMaxReported)
+			std::cout << "[validate] " << aWhat << " " << aIndex << "\n";
+	};
+
+	// every undirected edge exactly once, keyed on the packed (min, max) pair
+	std::vector<std::uint64_t> keys(edges.size());
+	for (std::size_t e = 0; e < edges.size(); ++e)
+	{
+		std::uint32_t const a = std::min(edges[e].x, edges[e].y);
+		std::uint32_t const b = std::max(edges[e].x, edges[e].y);
+		if (a == b || b >= aMesh.vertexCount)
+			report("degenerate or out-of-range edge", e);
+		keys[e] = (std::uint64_t(a) << 32) | b;
+	}
+	std::sort(keys.begin(), keys.end());
+	for (std::size_t i = 1; i < keys.size(); ++i)
+	{
+		if (keys[i] == keys[i - 1])
+			report("duplicate edge, sorted position", i);
+	}
+
+	// side k of face f is edge faceEdges[f][k], and that edge lists f
+	std::vector<std::uint32_t> sides(edges.size(), 0);
+	for (std::size_t f = 0; f < quads.size(); ++f)
+	{
+		for (int k = 0; k < 4; ++k)
+		{
+			std::uint32_t const e = faceEdges[f][k];
+			if (e >= edges.size())
+			{
+				report("face edge out of range, face", f);
+				continue;
+			}
+			++sides[e];
+
+			std::uint32_t const v0 = quads[f][k];
+			std::uint32_t const v1 = quads[f][(k + 1) & 3];
+			bool const sameEnds = (edges[e].x == v0 && edges[e].y == v1) || (edges[e].x == v1 && edges[e].y == v0);
+			if (!sameEnds)
+				report("face side does not match its edge, face", f);
+			if (edgeFaces[e].x != f && edgeFaces[e].y != f)
+				report("edgeToFace misses an adjacent face, edge", e);
+		}
+	}
+	for (std::size_t e = 0; e < edges.size(); ++e)
+	{
+		std::uint32_t const expected = (edgeFaces[e].y == kInvalid) ? 1u : 2u;
+		if (sides[e] != expected)
+			report("edgeToFace disagrees with the face sides, edge", e);
+	}
+
+	std::cout << "[validate] " << aMesh.vertexCount << " vertices, " << aMesh.edgeCount << " edges, "
+		<< aMesh.faceCount << " faces: " << (problems ? "FAILED" : "ok");
+	if (problems)
+		std::cout << " (" << problems << " problems)";
+	std::cout << std::endl;
+
+	return problems == 0;
+}
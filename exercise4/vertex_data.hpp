@@ -7,6 +7,7 @@
 #include "../labutils/vkbuffer.hpp"
 #include "../labutils/allocator.hpp" 
 #include "../labutils/gltf_model.hpp"
+#include "../labutils/upload_context.hpp"
 
 
 struct ColorizedMesh
@@ -38,14 +39,29 @@ struct SubdivisionMesh
 	labutils::Buffer vertexEdgeCounts;
 	labutils::Buffer vertexEdgeIndices;
 	labutils::Buffer faceEdgeIndices;
+	// one float per edge; whole values are the CPU's integer crease levels,
+	// values in (0, 1) blend the sharp rules with the smooth ones
+	labutils::Buffer edgeSharpness;
+
+	// Exclusive scans of vertexFaceCounts / vertexEdgeCounts (vertexCount + 1
+	// entries, the last one is the total), so the vertex pass reads where a
+	// list starts instead of summing every count before it. The block sums are
+	// scratch for prefixScan.comp.
+	labutils::Buffer vertexFaceOffsets;
+	labutils::Buffer vertexEdgeOffsets;
+	labutils::Buffer vertexFaceBlockSums;
+	labutils::Buffer vertexEdgeBlockSums;
 
 	labutils::Buffer facePoints;
 	labutils::Buffer edgePoints;
 	labutils::Buffer updatedVertices;
 
 
-	// For rendering
+	// For rendering. drawNormals has one vec4 per draw vertex; all zero
+	// unless the level was pushed to the limit surface, and the quad shaders
+	// then skip the lighting.
 	labutils::Buffer drawVertices;
+	labutils::Buffer drawNormals;
 	labutils::Buffer drawIndices;
 	labutils::Buffer drawLinelists;
 
@@ -64,21 +80,88 @@ struct SubdivisionMesh
 			b.allocation = VK_NULL_HANDLE;
 			};
 		free(controlPoints);   free(quadFaces);   free(edgeList);
-		free(edgeToFace);      free(faceEdgeIndices);
+		free(edgeToFace);      free(faceEdgeIndices); free(edgeSharpness);
 		free(vertexFaceCounts); free(vertexFaceIndices);
 		free(vertexEdgeCounts); free(vertexEdgeIndices);
+		free(vertexFaceOffsets); free(vertexEdgeOffsets);
+		free(vertexFaceBlockSums); free(vertexEdgeBlockSums);
 		free(drawVertices);    free(drawIndices); free(drawLinelists);
+		free(drawNormals);
 		free(facePoints);      free(edgePoints);  free(updatedVertices);
 		vertexCount = edgeCount = faceCount = 0;
 	}
 };
 
 
-ModelMesh create_model_buffer_tri(labutils::VulkanContext const&, labutils::Allocator const&, labutils::GltfModel const&);
+// Regular B-spline patches (labutils::PatchTable) for the tessellation
+// pipeline: 16 vec4 control points per patch, drawn as one patch-list
+// vertex each, and next to them one vec4 of side data per control point
+// (labutils::PatchSide): vertices 0..3 carry (a, referenceScale) of sides
+// 0..3, vertices 4..7 (b, sideScale), the rest is unused. Empty when there
+// are no patches.
+struct PatchMesh
+{
+	labutils::Buffer controlPoints;
+	labutils::Buffer sides;
+
+	std::uint32_t patchCount = 0;
+
+	bool isValid() const { return controlPoints.buffer != VK_NULL_HANDLE; }
+};
+
+
+// Refined-vertex stencils (labutils::StencilTable) on the device, together with
+// the base cage they read from. stencilEval.comp turns cagePoints into the
+// refined drawVertices in one dispatch, so a deformed cage only needs
+// cagePoints to be re-uploaded: cageStaging holds one cage-sized slot per
+// frame in flight and stays mapped.
+struct StencilBuffers
+{
+	labutils::Buffer cagePoints;
+	labutils::Buffer cageStaging;
+	labutils::Buffer stencilOffsets;
+	labutils::Buffer stencilIndices;
+	labutils::Buffer stencilWeights;
+
+	void* cageMapped = nullptr;
+
+	std::uint32_t sourceCount = 0;
+	std::uint32_t rowCount = 0;
+	std::uint32_t frameSlots = 0;
+
+	std::size_t cage_bytes() const { return std::size_t(sourceCount) * sizeof(glm::vec4); }
+	bool isValid() const { return stencilOffsets.buffer != VK_NULL_HANDLE; }
+};
+
+
+// The create_*() functions that upload queue their data on aUploads and
+// submit it once before returning, without waiting: work submitted later to
+// the graphics queue sees the buffers filled.
+ModelMesh create_model_buffer_tri(labutils::Allocator const&, labutils::UploadContext&, labutils::GltfModel const&);
+
+// Uploads the model's current level. With aLimitPositions/aLimitNormals (one
+// per quad vertex, see GltfModel::evaluateLimitSurface()) those are drawn
+// instead of the control points; controlPoints always gets the latter.
+SubdivisionMesh create_model_buffer(
+	labutils::Allocator const&,
+	labutils::UploadContext&,
+	labutils::GltfModel const&,
+	std::vector<glm::vec3> const* aLimitPositions = nullptr,
+	std::vector<glm::vec3> const* aLimitNormals = nullptr
+);
+SubdivisionMesh create_model_mesh_extended(labutils::Allocator const&, labutils::UploadContext&, labutils::GltfModel const&);
+// Device-only buffers for the level refined from a quad mesh with the given
+// vertex, edge and face counts; filled by the GPU subdivision passes.
+SubdivisionMesh create_empty_buffer(labutils::VulkanContext const&, labutils::Allocator const&, std::size_t aVertexCount, std::size_t aEdgeCount, std::size_t aFaceCount);
+
+// Device memory behind aMesh's buffers, as allocated by VMA.
+VkDeviceSize device_bytes(labutils::Allocator const&, SubdivisionMesh const& aMesh);
+
+PatchMesh create_patch_buffer(labutils::Allocator const&, labutils::UploadContext&, labutils::PatchTable const&, std::vector<labutils::PatchSide> const&);
 
-SubdivisionMesh create_model_buffer(labutils::VulkanContext const&, labutils::Allocator const&, labutils::GltfModel const&);
-SubdivisionMesh create_model_mesh_extended(labutils::VulkanContext const&, labutils::Allocator const&, labutils::GltfModel const&);
-SubdivisionMesh create_empty_buffer(labutils::VulkanContext const&, labutils::Allocator const&, std::size_t , std::size_t , std::size_t );
+StencilBuffers create_stencil_buffers(labutils::Allocator const&, labutils::UploadContext&, labutils::StencilTable const&, std::vector<labutils::Vertex> const& aCage, std::uint32_t aFrameSlots);
+// Write aCage into staging slot aSlot; the copy into cagePoints is recorded by the caller.
+void write_stencil_cage(labutils::Allocator const&, StencilBuffers&, std::vector<glm::vec4> const& aCage, std::uint32_t aSlot);
 
 
 //void debug_readback_buffer(labutils::VulkanContext const& aContext, labutils::Allocator const& aAllocator, VkQueue queue, labutils::Buffer const& gpuBuffer, std::size_t size, std::string label);
@@ -126,4 +209,13 @@ void debug_readback_edge_counts(
 	VkQueue                         queue,
 	labutils::Buffer        const& gpuBuffer,
 	std::size_t                     sizeBytes,
-	std::string            const& label);
\ No newline at end of file
+	std::string            const& label);
+
+// Reads the topology of a device-refined level back and checks it: no
+// duplicate or degenerate edge, every face side matches its edge, and
+// edgeToFace agrees with the faces. Prints a summary; true if nothing failed.
+bool validate_gpu_topology(
+	labutils::VulkanContext const& aContext,
+	labutils::Allocator     const& aAllocator,
+	VkQueue                         queue,
+	SubdivisionMesh         const& aMesh);
@@ -0,0 +1,412 @@
+#include "adaptive_refine.hpp"
+#include "limit_surface.hpp"
+#include "mesh_topology.hpp"
+#include "stencil_table.hpp"
+#include <algorithm>
+#include <cassert>
+#include <unordered_map>
+
+using namespace labutils;
+
+namespace
+{
+    // corner k of a face in the row-major 4x4 grid of its patch
+    constexpr std::uint32_t kCornerSlot[4] = { 5, 6, 10, 9 };
+
+    std::uint64_t directed_key(std::uint32_t aA, std::uint32_t aB)
+    {
+        return (std::uint64_t(aA) << 32) | aB;
+    }
+
+    std::uint64_t edge_key(std::uint32_t aA, std::uint32_t aB)
+    {
+        return aA < aB ? directed_key(aA, aB) : directed_key(aB, aA);
+    }
+}
+
+std::uint32_t AdaptiveLevel::active_face_count() const
+{
+    return std::uint32_t(std::count(faceActive.begin(), faceActive.end(), std::uint8_t(1)));
+}
+
+AdaptiveLevel labutils::make_adaptive_level(
+    HalfEdgeMesh aMesh,
+    std::vector<glm::vec3> aPoints,
+    std::vector<std::uint32_t> aSharpness,
+    std::uint32_t aLevel)
+{
+    assert(aMesh.cornersPerFace == 4 && aPoints.size() == aMesh.vertexCount);
+
+    AdaptiveLevel out;
+    out.level = aLevel;
+    out.vertexExact.assign(aMesh.vertexCount, 1);
+    out.vertexComplete.assign(aMesh.vertexCount, 1);
+    out.faceActive.assign(aMesh.face_count(), 1);
+    out.vertexId.resize(aMesh.vertexCount);
+    for (std::uint32_t v = 0; v < aMesh.vertexCount; ++v)
+        out.vertexId[v] = v;
+    out.nextVertexId = aMesh.vertexCount;
+    out.mesh = std::move(aMesh);
+    out.points = std::move(aPoints);
+    out.sharpness = std::move(aSharpness);
+    out.sharpness.resize(out.mesh.edge_count(), 0);
+    return out;
+}
+
+AdaptiveLevel labutils::refine_adaptive(const AdaptiveLevel& aLevel, PatchTable& aPatches)
+{
+    const HalfEdgeMesh& mesh = aLevel.mesh;
+    const std::uint32_t F = mesh.face_count();
+
+    // Regular active faces become patches. Their corners must be complete so
+    // that the valence seen here is the real one, and all 16 points exact.
+    std::vector<std::uint8_t> target(F, 0);
+    bool anyTarget = false;
+    for (std::uint32_t f = 0; f < F; ++f)
+    {
+        if (!aLevel.faceActive[f])
+            continue;
+
+        std::uint32_t cv[16];
+        bool patch = gather_patch_points(mesh, aLevel.sharpness, f, cv);
+        for (std::uint32_t k = 0; patch && k < 4; ++k)
+            patch = aLevel.vertexComplete[mesh.face_corners(f)[k]] != 0;
+        for (std::uint32_t i = 0; patch && i < 16; ++i)
+            patch = aLevel.vertexExact[cv[i]] != 0;
+
+        if (patch)
+        {
+            const std::uint32_t* c = mesh.face_corners(f);
+            for (std::uint32_t i = 0; i < 16; ++i)
+                aPatches.points.push_back(aLevel.points[cv[i]]);
+            aPatches.levels.push_back(aLevel.level);
+            aPatches.corners.emplace_back(aLevel.vertexId[c[0]], aLevel.vertexId[c[1]], aLevel.vertexId[c[2]], aLevel.vertexId[c[3]]);
+        }
+        else
+        {
+            target[f] = 1;
+            anyTarget = true;
+        }
+    }
+
+    if (!anyTarget)
+    {
+        AdaptiveLevel out;
+        out.level = aLevel.level + 1;
+        out.nextVertexId = aLevel.nextVertexId;
+        return out;
+    }
+
+    return refine_region(aLevel, target, &aPatches.splits);
+}
+
+AdaptiveLevel labutils::refine_region(
+    const AdaptiveLevel& aLevel,
+    const std::vector<std::uint8_t>& aTarget,
+    std::vector<glm::uvec3>* aSplits)
+{
+    const HalfEdgeMesh& mesh = aLevel.mesh;
+    const std::uint32_t F = mesh.face_count();
+    assert(aTarget.size() == F);
+
+    AdaptiveLevel out;
+    out.level = aLevel.level + 1;
+
+    std::vector<std::uint8_t> target(F, 0);
+    for (std::uint32_t f = 0; f < F; ++f)
+        target[f] = aTarget[f] && aLevel.faceActive[f];
+
+    std::vector<glm::uvec2> edgeList, edgeFaces;
+    std::vector<std::uint32_t> vfCounts, vfIndices, veCounts, veIndices;
+    build_topology_csr(mesh, TopologyCSR{ &edgeList, &edgeFaces, nullptr, &vfCounts, &vfIndices, &veCounts, &veIndices });
+    const std::vector<std::uint32_t> vfStart = csr_offsets(vfCounts);
+
+    // the refined region: every face sharing a vertex with a target
+    std::vector<std::uint8_t> keep(F, 0);
+    for (std::uint32_t f = 0; f < F; ++f)
+    {
+        if (!target[f])
+            continue;
+        for (std::uint32_t k = 0; k < 4; ++k)
+        {
+            const std::uint32_t c = mesh.face_corners(f)[k];
+            for (std::uint32_t i = vfStart[c]; i < vfStart[c + 1]; ++i)
+                keep[vfIndices[i]] = 1;
+        }
+    }
+
+    // extract it as its own mesh, vertices renumbered in ascending order
+    std::vector<std::uint32_t> faces;
+    std::vector<std::uint32_t> keptFaceCount(mesh.vertexCount, 0);
+    for (std::uint32_t f = 0; f < F; ++f)
+    {
+        if (!keep[f])
+            continue;
+        faces.push_back(f);
+        for (std::uint32_t k = 0; k < 4; ++k)
+            ++keptFaceCount[mesh.face_corners(f)[k]];
+    }
+
+    std::vector<std::uint32_t> remap(mesh.vertexCount, HalfEdgeMesh::kInvalid);
+    std::uint32_t subV = 0;
+    for (std::uint32_t v = 0; v < mesh.vertexCount; ++v)
+    {
+        if (keptFaceCount[v])
+            remap[v] = subV++;
+    }
+
+    std::vector<std::uint32_t> corners(faces.size() * 4);
+    for (std::size_t j = 0; j < faces.size(); ++j)
+    {
+        for (std::uint32_t k = 0; k < 4; ++k)
+            corners[4 * j + k] = remap[mesh.face_corners(faces[j])[k]];
+    }
+    const HalfEdgeMesh sub = make_halfedge_mesh(std::move(corners), 4, subV);
+
+    std::vector<glm::vec3> subPoints(subV);
+    std::vector<std::uint8_t> subExact(subV), subComplete(subV);
+    std::vector<std::uint32_t> subId(subV);
+    for (std::uint32_t v = 0; v < mesh.vertexCount; ++v)
+    {
+        if (remap[v] == HalfEdgeMesh::kInvalid)
+            continue;
+        const std::uint32_t u = remap[v];
+        subPoints[u] = aLevel.points[v];
+        subExact[u] = aLevel.vertexExact[v];
+        subId[u] = aLevel.vertexId[v];
+        subComplete[u] = aLevel.vertexComplete[v] && keptFaceCount[v] == vfCounts[v];
+    }
+
+    std::vector<std::uint32_t> subSharp(sub.edge_count(), 0);
+    for (std::size_t j = 0; j < faces.size(); ++j)
+    {
+        for (std::uint32_t k = 0; k < 4; ++k)
+            subSharp[sub.edge(std::uint32_t(4 * j + k))] = aLevel.sharpness[mesh.edge(4 * faces[j] + k)];
+    }
+
+    // one uniform step of the region
+    std::vector<glm::uvec2> subEdges, subEdgeFaces;
+    std::vector<std::uint32_t> subVFCounts, subVFIndices, subVECounts, subVEIndices;
+    build_topology_csr(sub, TopologyCSR{ &subEdges, &subEdgeFaces, nullptr, &subVFCounts, &subVFIndices, &subVECounts, &subVEIndices });
+    const StencilTable step = make_refinement_stencils(sub, subSharp,
+        TopologyCSR{ &subEdges, &subEdgeFaces, nullptr, &subVFCounts, &subVFIndices, &subVECounts, &subVEIndices });
+
+    out.points.assign(step.row_count(), glm::vec3(0.f));
+    evaluate_stencils(step, subPoints.data(), sizeof(glm::vec3), out.points.data(), sizeof(glm::vec3));
+
+    out.mesh = refine_halfedge_mesh(sub);
+    out.sharpness.assign(out.mesh.edge_count(), 0);
+    for (std::uint32_t e = 0; e < sub.edge_count(); ++e)
+    {
+        const std::uint32_t s = subSharp[e] ? subSharp[e] - 1 : 0;
+        out.sharpness[2 * e + 0] = s;
+        out.sharpness[2 * e + 1] = s;
+    }
+
+    // A child point is exact if its rule saw the whole neighbourhood (the
+    // vertex, or the edge, has all its faces in the region) and every point
+    // it reads is exact. Edge and face points always get all their faces.
+    const std::uint32_t V = sub.vertexCount;
+    const std::uint32_t E = sub.edge_count();
+    out.vertexExact.assign(step.row_count(), 0);
+    out.vertexComplete.assign(step.row_count(), 0);
+    for (std::uint32_t r = 0; r < step.row_count(); ++r)
+    {
+        bool complete = true;
+        if (r < V)
+            complete = subComplete[r] != 0;
+        else if (r < V + E)
+        {
+            const std::uint32_t e = r - V;
+            complete = subEdgeFaces[e].y != HalfEdgeMesh::kInvalid
+                || subComplete[subEdges[e].x] || subComplete[subEdges[e].y];
+        }
+
+        bool exact = complete;
+        for (std::uint32_t i = step.offsets[r]; exact && i < step.offsets[r + 1]; ++i)
+            exact = subExact[step.indices[i]] != 0;
+
+        out.vertexComplete[r] = complete;
+        out.vertexExact[r] = exact;
+    }
+
+    // vertex points keep their vertex's id, edge and face points are new
+    out.vertexId.resize(step.row_count());
+    out.nextVertexId = aLevel.nextVertexId;
+    for (std::uint32_t r = 0; r < step.row_count(); ++r)
+        out.vertexId[r] = r < V ? subId[r] : out.nextVertexId++;
+    if (aSplits)
+    {
+        for (std::uint32_t e = 0; e < E; ++e)
+            aSplits->emplace_back(subId[subEdges[e].x], subId[subEdges[e].y], out.vertexId[V + e]);
+    }
+
+    // child quad h of parent half-edge h: the children of region face j are 4j..4j+3
+    out.faceActive.assign(out.mesh.face_count(), 0);
+    for (std::size_t j = 0; j < faces.size(); ++j)
+    {
+        if (target[faces[j]])
+            std::fill_n(out.faceActive.begin() + 4 * j, 4, std::uint8_t(1));
+    }
+
+    return out;
+}
+
+void labutils::adaptive_draw_mesh(
+    const AdaptiveLevel& aLevel,
+    const PatchTable& aPatches,
+    std::vector<glm::vec3>& aPoints,
+    std::vector<std::uint32_t>& aQuads)
+{
+    tessellate_patches(aPatches, aLevel.level, aPoints, aQuads);
+
+    const HalfEdgeMesh& mesh = aLevel.mesh;
+    if (aLevel.active_face_count() == 0)
+        return;
+
+    // The patches are sampled on their limit surface, so the active faces are
+    // drawn there too: a corner on a patch boundary then lands on the patch's
+    // sample at the same parameter and the two do not crack. Active corners
+    // are complete (every face around them is in the region).
+    std::vector<glm::uvec2> edgeList, edgeFaces;
+    std::vector<std::uint32_t> vfCounts, vfIndices, veCounts, veIndices;
+    const TopologyCSR csr{ &edgeList, &edgeFaces, nullptr, &vfCounts, &vfIndices, &veCounts, &veIndices };
+    build_topology_csr(mesh, csr);
+
+    std::vector<glm::vec3> limit(mesh.vertexCount), normals(mesh.vertexCount);
+    evaluate_limit(mesh, aLevel.sharpness, csr,
+        aLevel.points.data(), sizeof(glm::vec3),
+        limit.data(), sizeof(glm::vec3),
+        normals.data(), sizeof(glm::vec3));
+
+    // only the points the active faces use
+    std::vector<std::uint32_t> remap(mesh.vertexCount, HalfEdgeMesh::kInvalid);
+    for (std::uint32_t f = 0; f < mesh.face_count(); ++f)
+    {
+        if (!aLevel.faceActive[f])
+            continue;
+        for (std::uint32_t k = 0; k < 4; ++k)
+        {
+            const std::uint32_t v = mesh.face_corners(f)[k];
+            if (remap[v] == HalfEdgeMesh::kInvalid)
+            {
+                remap[v] = std::uint32_t(aPoints.size());
+                aPoints.push_back(limit[v]);
+            }
+            aQuads.push_back(remap[v]);
+        }
+    }
+}
+
+std::vector<PatchSide> labutils::patch_sides(const AdaptiveLevel& aLevel, const PatchTable& aPatches)
+{
+    const std::uint32_t P = aPatches.patch_count();
+    assert(aPatches.corners.size() == P);
+
+    // Every drawn side by its direction; the face across a side runs it the
+    // other way. Active faces are drawn as quads, with no patch.
+    struct Drawn
+    {
+        std::uint32_t patch, side, level;
+    };
+    constexpr std::uint32_t kQuad = HalfEdgeMesh::kInvalid;
+
+    std::unordered_map<std::uint64_t, Drawn> drawn;
+    drawn.reserve(4 * std::size_t(P) + 4 * aLevel.active_face_count());
+    for (std::uint32_t p = 0; p < P; ++p)
+    {
+        const glm::uvec4 c = aPatches.corners[p];
+        for (std::uint32_t k = 0; k < 4; ++k)
+            drawn.emplace(directed_key(c[k], c[(k + 1) & 3]), Drawn{ p, k, aPatches.levels[p] });
+    }
+    for (std::uint32_t f = 0; f < aLevel.mesh.face_count(); ++f)
+    {
+        if (!aLevel.faceActive[f])
+            continue;
+        const std::uint32_t* c = aLevel.mesh.face_corners(f);
+        for (std::uint32_t k = 0; k < 4; ++k)
+            drawn.emplace(directed_key(aLevel.vertexId[c[k]], aLevel.vertexId[c[(k + 1) & 3]]), Drawn{ kQuad, k, aLevel.level });
+    }
+
+    // edge -> its edge point, and each half -> the split it came from
+    std::unordered_map<std::uint64_t, std::uint32_t> midpoint;
+    std::unordered_map<std::uint64_t, glm::uvec3> parent;
+    midpoint.reserve(aPatches.splits.size());
+    parent.reserve(2 * aPatches.splits.size());
+    for (const glm::uvec3& s : aPatches.splits)
+    {
+        midpoint.emplace(edge_key(s.x, s.y), s.z);
+        parent.emplace(edge_key(s.x, s.z), s);
+        parent.emplace(edge_key(s.z, s.y), s);
+    }
+
+    std::vector<PatchSide> sides(4 * std::size_t(P));
+    std::vector<glm::uvec2> stack;
+    for (std::uint32_t p = 0; p < P; ++p)
+    {
+        const glm::uvec4 c = aPatches.corners[p];
+        for (std::uint32_t k = 0; k < 4; ++k)
+        {
+            // The reference: the coarsest side across this one that contains
+            // it, or this side itself.
+            glm::uvec2 e(c[k], c[(k + 1) & 3]);
+            Drawn ref{ p, k, aPatches.levels[p] };
+            glm::uvec2 refEnds = e;
+            for (;;)
+            {
+                auto across = drawn.find(directed_key(e.y, e.x));
+                if (across != drawn.end() && across->second.level < ref.level)
+                {
+                    ref = across->second;
+                    refEnds = glm::uvec2(e.y, e.x);
+                }
+
+                auto up = parent.find(edge_key(e.x, e.y));
+                if (up == parent.end())
+                    break;
+                const glm::uvec3 s = up->second;
+                const std::uint32_t end = (e.x == s.z) ? e.y : e.x;
+                const std::uint32_t other = (end == s.x) ? s.y : s.x;
+                e = (e.x == s.z) ? glm::uvec2(other, e.y) : glm::uvec2(e.x, other);
+            }
+
+            // The finest level in the chain: walk the pieces across the
+            // reference until they are drawn.
+            std::uint32_t finest = ref.level;
+            bool fixed = ref.patch == kQuad;
+            stack.assign(1, glm::uvec2(refEnds.y, refEnds.x));
+            while (!stack.empty())
+            {
+                const glm::uvec2 piece = stack.back();
+                stack.pop_back();
+
+                auto it = drawn.find(directed_key(piece.x, piece.y));
+                if (it != drawn.end())
+                {
+                    finest = std::max(finest, it->second.level);
+                    fixed = fixed || it->second.patch == kQuad;
+                    continue;
+                }
+
+                auto mid = midpoint.find(edge_key(piece.x, piece.y));
+                if (mid != midpoint.end())
+                {
+                    stack.emplace_back(piece.x, mid->second);
+                    stack.emplace_back(mid->second, piece.y);
+                }
+            }
+
+            PatchSide& side = sides[4 * std::size_t(p) + k];
+            side.sideScale = float(1u << std::min(finest - aPatches.levels[p], 31u));
+            side.referenceScale = fixed ? 0.f : float(1u << std::min(finest - ref.level, 31u));
+            side.a = side.b = glm::vec3(0.f);
+            if (!fixed)
+            {
+                const glm::vec3* cv = aPatches.points.data() + 16 * std::size_t(ref.patch);
+                side.a = cv[kCornerSlot[ref.side]];
+                side.b = cv[kCornerSlot[(ref.side + 1) & 3]];
+            }
+        }
+    }
+    return sides;
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "halfedge_mesh.hpp"
+#include "patch_table.hpp"
+
+
+
+namespace labutils
+{
+	// Feature-adaptive Catmull-Clark. Instead of refining the whole mesh, each
+	// step hands the regular faces (see gather_patch_points()) to a PatchTable
+	// and refines only the others: faces around extraordinary vertices, creases
+	// and boundaries. The refined region shrinks towards the features, so the
+	// work per level stays roughly constant instead of growing by 4x.
+	//
+	// An AdaptiveLevel is a piece of the uniformly refined mesh at that level:
+	// the active faces that still have to be covered, plus a margin of faces
+	// around them that only exists so the active ones see their full
+	// neighbourhood. Margin vertices may have been computed from a truncated
+	// neighbourhood; vertexExact marks the ones that match uniform refinement,
+	// and vertexComplete the ones whose faces at this level are all present.
+	// Every active face has exact points on and around it, so its patch, or
+	// its children, are exact too.
+	struct AdaptiveLevel
+	{
+		std::uint32_t level = 0;
+
+		HalfEdgeMesh mesh;                      // quads
+		std::vector<glm::vec3> points;
+		std::vector<std::uint32_t> sharpness;   // per edge
+
+		std::vector<std::uint8_t> vertexExact;
+		std::vector<std::uint8_t> vertexComplete;
+		std::vector<std::uint8_t> faceActive;
+
+		// Identity of each point across levels: a vertex point keeps the id
+		// of the vertex it came from, edge and face points get new ones
+		// (nextVertexId onwards), so a vertex shared by faces of different
+		// levels has one id.
+		std::vector<std::uint32_t> vertexId;
+		std::uint32_t nextVertexId = 0;
+
+		std::uint32_t active_face_count() const;
+	};
+
+	// A whole quad mesh at aLevel: every face active, every vertex exact.
+	AdaptiveLevel make_adaptive_level(
+		HalfEdgeMesh aMesh,
+		std::vector<glm::vec3> aPoints,
+		std::vector<std::uint32_t> aSharpness,
+		std::uint32_t aLevel
+	);
+
+	// One adaptive step: regular active faces of aLevel are appended to
+	// aPatches; the rest, with a one-ring margin of faces, are refined into
+	// the returned level. The result has no active faces once everything is
+	// covered by patches.
+	AdaptiveLevel refine_adaptive(AdaptiveLevel const& aLevel, PatchTable& aPatches);
+
+	// The refinement step behind refine_adaptive(), for any choice of
+	// targets: the active faces of aLevel with aTarget[f] set, plus a one-ring
+	// margin, are refined once; the children of the targets are the active
+	// faces of the result. For every edge of the region, the ids of its end
+	// points and of its edge point (vertexId) are appended to aSplits if
+	// given. aTarget has one entry per face of aLevel.
+	AdaptiveLevel refine_region(
+		AdaptiveLevel const& aLevel,
+		std::vector<std::uint8_t> const& aTarget,
+		std::vector<glm::uvec3>* aSplits = nullptr
+	);
+
+	// Quads to draw for the surface so far: aPatches tessellated to the
+	// density of aLevel, followed by the active faces of aLevel with their
+	// corners pushed to the limit surface (evaluate_limit()), so both sides
+	// of a patch boundary sit on the same points. The points are not shared:
+	// every patch has its own (n+1)^2 grid and the active faces their own
+	// corners, so on the CPU this costs more memory than uniform refinement
+	// to the same level; only drawing the patches on the device saves it.
+	void adaptive_draw_mesh(
+		AdaptiveLevel const& aLevel,
+		PatchTable const& aPatches,
+		std::vector<glm::vec3>& aPoints,
+		std::vector<std::uint32_t>& aQuads
+	);
+
+	// How to split one side of a patch drawn on the device so that it meets
+	// what is across it. A side, the faces across it and the sides of theirs
+	// that lie along it form a chain under one reference side, the coarsest
+	// of them; with m the finest level in the chain, every side gets
+	// k * 2^(m - its level) equal segments, which puts them all on the same
+	// parameters. k comes from the screen length of the reference side
+	// (a, b) split into 2^(m - reference level) pieces, so every side of the
+	// chain computes the same k; next to an active face, drawn with one
+	// segment per side at aLevel, k is 1.
+	struct PatchSide
+	{
+		glm::vec3 a, b;             // ends of the reference side
+		float referenceScale;       // 2^(m - reference level), 0 if k is 1
+		float sideScale;            // 2^(m - level of this side)
+	};
+
+	// Four per patch of aPatches, side k running from corner k to corner
+	// k + 1, for the patches and active faces that adaptive_draw_mesh()
+	// draws at aLevel.
+	std::vector<PatchSide> patch_sides(AdaptiveLevel const& aLevel, PatchTable const& aPatches);
+}
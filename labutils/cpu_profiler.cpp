@@ -0,0 +1,184 @@
+#include "cpu_profiler.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace labutils;
+
+namespace
+{
+    struct Event
+    {
+        char const* name;
+        std::int64_t start;
+        std::int64_t duration;
+    };
+
+    // One per thread, plus the named tracks of record(). Only the owning
+    // thread writes to a thread's track; `written` counts every event ever
+    // recorded and the last kEventsPerThread of them are kept.
+    struct Track
+    {
+        std::string name;
+        std::uint32_t id = 0;
+        std::unique_ptr<Event[]> events;
+        std::atomic<std::uint64_t> written{ 0 };
+        bool shared = false;                // a record() track
+    };
+
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Track>> tracks;
+        std::int64_t epoch = profile::now_ns();
+    };
+
+    // Never destroyed: pool workers may still finish a zone during static
+    // destruction.
+    Registry& registry()
+    {
+        static Registry* registry = new Registry;
+        return *registry;
+    }
+
+    Track& add_track(std::string aName)
+    {
+        Registry& reg = registry();
+        auto track = std::make_unique<Track>();
+        track->id = std::uint32_t(reg.tracks.size() + 1);
+        track->name = aName.empty() ? "thread " + std::to_string(track->id) : std::move(aName);
+        track->events = std::make_unique<Event[]>(profile::kEventsPerThread);
+        reg.tracks.push_back(std::move(track));
+        return *reg.tracks.back();
+    }
+
+    thread_local Track* tTrack = nullptr;
+
+    Track& thread_track()
+    {
+        if (!tTrack)
+        {
+            std::lock_guard<std::mutex> lock(registry().mutex);
+            tTrack = &add_track({});
+        }
+        return *tTrack;
+    }
+
+    void push(Track& aTrack, Event const& aEvent)
+    {
+        std::uint64_t const n = aTrack.written.load(std::memory_order_relaxed);
+        aTrack.events[n % profile::kEventsPerThread] = aEvent;
+        aTrack.written.store(n + 1, std::memory_order_release);
+    }
+
+#if LUT_PROFILING
+    void write_json_string(std::FILE* aOut, char const* aText)
+    {
+        std::fputc('"', aOut);
+        for (char const* c = aText; *c; ++c)
+        {
+            if ('"' == *c || '\\' == *c)
+                std::fputc('\\', aOut);
+            if (std::uint8_t(*c) >= 0x20)
+                std::fputc(*c, aOut);
+        }
+        std::fputc('"', aOut);
+    }
+#endif
+}
+
+std::int64_t labutils::profile::now_ns() noexcept
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+labutils::profile::Zone::~Zone()
+{
+    push(thread_track(), Event{ mName, mStart, now_ns() - mStart });
+}
+
+void labutils::profile::set_thread_name(std::string aName)
+{
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    if (tTrack)
+        tTrack->name = std::move(aName);
+    else
+        tTrack = &add_track(std::move(aName));
+}
+
+void labutils::profile::record(char const* aTrack, char const* aName, std::int64_t aStartNs, std::int64_t aDurationNs)
+{
+#if LUT_PROFILING
+    // named tracks are shared between threads, so they are written under the lock
+    std::lock_guard<std::mutex> lock(registry().mutex);
+
+    Track* track = nullptr;
+    for (auto const& t : registry().tracks)
+    {
+        if (t->shared && t->name == aTrack)
+        {
+            track = t.get();
+            break;
+        }
+    }
+    if (!track)
+    {
+        track = &add_track(aTrack);
+        track->shared = true;
+    }
+
+    push(*track, Event{ aName, aStartNs, aDurationNs });
+#else
+    (void)aTrack; (void)aName; (void)aStartNs; (void)aDurationNs;
+#endif
+}
+
+bool labutils::profile::write_chrome_trace(std::string const& aPath)
+{
+#if LUT_PROFILING
+    std::FILE* out = std::fopen(aPath.c_str(), "wb");
+    if (!out)
+        return false;
+
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    std::fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    for (auto const& track : reg.tracks)
+    {
+        std::fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", first ? "" : ",\n", track->id);
+        write_json_string(out, track->name.c_str());
+        std::fprintf(out, "}}");
+        first = false;
+
+        std::uint64_t const end = track->written.load(std::memory_order_acquire);
+        std::uint64_t const begin = end > kEventsPerThread ? end - kEventsPerThread : 0;
+        for (std::uint64_t i = begin; i < end; ++i)
+        {
+            Event const& e = track->events[i % kEventsPerThread];
+            std::fprintf(out, ",\n{\"name\":");
+            write_json_string(out, e.name);
+            std::fprintf(out, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                track->id, double(e.start - reg.epoch) * 1e-3, double(e.duration) * 1e-3);
+        }
+    }
+    std::fprintf(out, "\n]}\n");
+
+    return 0 == std::fclose(out);
+#else
+    (void)aPath;
+    return false;
+#endif
+}
+
+void labutils::profile::clear()
+{
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    for (auto const& track : registry().tracks)
+        track->written.store(0, std::memory_order_relaxed);
+}
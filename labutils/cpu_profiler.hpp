@@ -0,0 +1,78 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+
+// Zones are compiled in by default in debug builds only; build with
+// LUT_PROFILING=1 (premake5 --profiling) to keep them in release, or with
+// LUT_PROFILING=0 to drop them from debug builds.
+#if !defined(LUT_PROFILING)
+#	if defined(NDEBUG)
+#		define LUT_PROFILING 0
+#	else
+#		define LUT_PROFILING 1
+#	endif
+#endif
+
+namespace labutils
+{
+	// Scoped CPU timers, kept per thread in a ring of the last
+	// kEventsPerThread zones, and written out as a Chrome trace (load it in
+	// chrome://tracing or ui.perfetto.dev). Recording takes no lock; a thread
+	// takes one once, the first time it records. write_chrome_trace() should
+	// be called while no zone is being recorded.
+	namespace profile
+	{
+		constexpr std::size_t kEventsPerThread = 1 << 14;
+
+		// Nanoseconds on the clock every zone is measured with.
+		std::int64_t now_ns() noexcept;
+
+		// A zone on the calling thread, from construction to destruction.
+		// aName is kept as a pointer, so it should be a literal (or __func__).
+		class Zone
+		{
+			public:
+				explicit Zone( char const* aName ) noexcept
+					: mName( aName ), mStart( now_ns() )
+				{}
+				~Zone();
+
+				Zone( Zone const& ) = delete;
+				Zone& operator= (Zone const&) = delete;
+
+			private:
+				char const* mName;
+				std::int64_t mStart;
+		};
+
+		// Name of the calling thread in the trace ("thread N" otherwise).
+		void set_thread_name( std::string aName );
+
+		// A zone measured by other means, e.g. a GPU pass placed on the CPU
+		// clock. It goes on the track called aTrack, which shows up in the
+		// trace like a thread of its own.
+		void record( char const* aTrack, char const* aName, std::int64_t aStartNs, std::int64_t aDurationNs );
+
+		// false if the file cannot be written, or profiling is compiled out.
+		bool write_chrome_trace( std::string const& aPath );
+
+		// Drops every recorded zone.
+		void clear();
+	}
+}
+
+#define LUT_PROFILE_CONCAT_IMPL_( a, b ) a##b
+#define LUT_PROFILE_CONCAT_( a, b ) LUT_PROFILE_CONCAT_IMPL_( a, b )
+
+#if LUT_PROFILING
+#	define LUT_PROFILE_ZONE( name ) ::labutils::profile::Zone const LUT_PROFILE_CONCAT_( lutProfileZone, __LINE__ )( name )
+#	define LUT_PROFILE_FUNCTION() LUT_PROFILE_ZONE( __func__ )
+#	define LUT_PROFILE_THREAD_NAME( name ) ::labutils::profile::set_thread_name( name )
+#else
+#	define LUT_PROFILE_ZONE( name ) do {} while( false )
+#	define LUT_PROFILE_FUNCTION() do {} while( false )
+#	define LUT_PROFILE_THREAD_NAME( name ) do {} while( false )
+#endif
@@ -2,6 +2,7 @@
 
 // SOLUTION_TAGS: vulkan-(ex-[^1]|cw-.)
 
+#include <cstdio>
 #include <cstdarg>
 
 namespace labutils
@@ -11,12 +12,19 @@ namespace labutils
 		va_list args;
 		va_start( args, aFmt );
 
-		char buff[1024]{};
-		vsnprintf( buff, 1023, aFmt, args );
+		// sized first, so that long messages (e.g. usage text) are not cut off
+		va_list sizing;
+		va_copy( sizing, args );
+		int const length = vsnprintf( nullptr, 0, aFmt, sizing );
+		va_end( sizing );
 
-		va_end( args );
+		if( length > 0 )
+		{
+			mMsg.resize( std::size_t(length) );
+			vsnprintf( mMsg.data(), mMsg.size() + 1, aFmt, args );
+		}
 
-		mMsg = buff;
+		va_end( args );
 	}
 
 	char const* Error::what() const noexcept
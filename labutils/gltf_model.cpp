@@ -3,33 +3,22 @@
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <tiny_gltf.h>
 #include <glm/gtc/epsilon.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include "gltf_model.hpp"
+#include "gltf_view.hpp"
+#include "spatial_hash.hpp"
+#include "parallel.hpp"
+#include "stencil_table.hpp"
+#include "cpu_profiler.hpp"
 #include <iostream>
-#include <unordered_set>
 
 using namespace labutils;
 
 namespace
 {
 
-    bool readAccessor(const tinygltf::Model& model, int accessorIdx, std::vector<uint8_t>& out)
-    {
-        if (accessorIdx < 0) return false;
-
-        const auto& accessor = model.accessors[accessorIdx];
-        const auto& view = model.bufferViews[accessor.bufferView];
-        const auto& buffer = model.buffers[view.buffer];
-
-        size_t offset = view.byteOffset + accessor.byteOffset;
-        size_t bytes = accessor.count *
-            tinygltf::GetComponentSizeInBytes(accessor.componentType) *
-            tinygltf::GetNumComponentsInType(accessor.type);
-
-        out.assign(buffer.data.begin() + offset,
-            buffer.data.begin() + offset + bytes);
-        return true;
-    }
-
     struct Edge {
         uint32_t a, b;
         Edge(uint32_t x, uint32_t y) : a(std::min(x, y)), b(std::max(x, y)) {}
@@ -38,45 +27,6 @@ namespace
         }
     };
 
-    //struct EdgeKey 
-    //{
-    //    uint32_t v0, v1;
-
-    //    EdgeKey(uint32_t a, uint32_t b) {
-    //        if (a < b) { v0 = a; v1 = b; }
-    //        else { v0 = b; v1 = a; }
-    //    }
-
-    //    bool operator==(const EdgeKey& other) const {
-    //        return v0 == other.v0 && v1 == other.v1;
-    //    }
-    //};
-    struct EdgeKey
-    {
-        uint32_t v0{}, v1{};               // 用零初始化即可
-
-        /* 默认构造 —— 必须有！*/
-        EdgeKey() = default;
-
-        /* 带参构造：规范化顺序（a < b）*/
-        EdgeKey(uint32_t a, uint32_t b)
-        {
-            if (a < b) { v0 = a; v1 = b; }
-            else { v0 = b; v1 = a; }
-        }
-
-        bool operator==(const EdgeKey& rhs) const
-        {
-            return v0 == rhs.v0 && v1 == rhs.v1;
-        }
-    };
-    struct EdgeKeyHash
-    {
-        std::size_t operator()(const EdgeKey& k) const {
-            return std::hash<uint32_t>()(k.v0) ^ std::hash<uint32_t>()(k.v1 << 1);
-        }
-    };
-
     void triangle_to_quads(
         const std::vector<glm::vec3>& positions,
         const std::vector<uint32_t>& indices,
@@ -129,319 +79,314 @@ namespace
         std::vector<uint32_t>& indices,
         float eps = 1e-5f)
     {
-        std::vector<TVertex>   unique;
-        std::vector<uint32_t>  remap(verts.size());
-
-        for (size_t i = 0; i < verts.size(); ++i)
-        {
-            const glm::vec3& p = verts[i].pos;
+        LUT_PROFILE_FUNCTION();
+        if (verts.empty()) return;
 
-            uint32_t hit = UINT32_MAX;
-            for (uint32_t j = 0; j < unique.size(); ++j)
-                if (glm::all(glm::epsilonEqual(p, unique[j].pos, eps)))
-                {
-                    hit = j; break;
-                }
+        std::vector<uint32_t> remap = weld_positions(&verts[0].pos, verts.size(), sizeof(TVertex), eps);
 
-            if (hit == UINT32_MAX) {         // 第一次见到这个坐标
-                hit = static_cast<uint32_t>(unique.size());
-                unique.push_back(verts[i]);
-            }
-            remap[i] = hit;
-        }
+        std::vector<TVertex> unique;
+        unique.reserve(verts.size());
+        for (size_t i = 0; i < verts.size(); ++i)
+            if (remap[i] == i) unique.push_back(verts[i]);   // 第一次见到这个坐标
 
-        for (auto& id : indices) id = remap[id];  // 重映射索引
+        compact_weld_remap(remap);
+        parallel_for(indices.size(), [&](size_t b, size_t e) {
+            for (size_t i = b; i < e; ++i) indices[i] = remap[indices[i]];  // 重映射索引
+        });
         verts.swap(unique);                       // 压缩顶点表
     }
 
-    static void analyseSharpAtVertex(
-        uint32_t                               vId,
-        const std::vector<EdgeKey>& incEdges,
-        const std::unordered_map<EdgeKey, uint32_t, EdgeKeyHash>& sharpMap,
-        uint32_t& sharpCnt,
-        glm::vec3                              neigh[2],
-        const std::vector<Vertex>& verts)
+    // A primitive of the scene and the world transform of the node using it;
+    // a mesh used by several nodes appears once per node.
+    struct PrimitiveInstance
     {
-        sharpCnt = 0;
-        for (auto& ek : incEdges)
-        {
-            auto it = sharpMap.find(ek);
-            if (it != sharpMap.end() && it->second > 0)
+        const nlohmann::json* primitive;
+        glm::mat4 world;
+        size_t node;
+    };
+
+    struct PartData
+    {
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        std::string error;
+        bool ok = false;
+    };
+
+    glm::mat4 node_transform(const nlohmann::json& node)
+    {
+        auto floats = [&](const char* key, float* out, size_t count) {
+            const auto it = node.find(key);
+            if (it == node.end() || !it->is_array() || it->size() != count) return false;
+            for (size_t i = 0; i < count; ++i) out[i] = (*it)[i].get<float>();
+            return true;
+            };
+
+        glm::mat4 matrix(1.f);
+        if (floats("matrix", &matrix[0][0], 16))   // column-major, like glm
+            return matrix;
+
+        glm::vec3 t(0.f), s(1.f);
+        float r[4] = { 0.f, 0.f, 0.f, 1.f };         // x, y, z, w
+        floats("translation", &t.x, 3);
+        floats("rotation", r, 4);
+        floats("scale", &s.x, 3);
+        return glm::translate(glm::mat4(1.f), t) * glm::mat4_cast(glm::quat(r[3], r[0], r[1], r[2])) * glm::scale(glm::mat4(1.f), s);
+    }
+
+    // Triangle primitives of the default scene, with node transforms
+    // flattened. Without scenes or nodes, every mesh is taken as it is.
+    std::vector<PrimitiveInstance> scene_primitives(const nlohmann::json& json)
+    {
+        std::vector<PrimitiveInstance> out;
+        const auto meshes = json.find("meshes");
+        if (meshes == json.end() || !meshes->is_array())
+            return out;
+
+        auto addMesh = [&](size_t mesh, const glm::mat4& world, size_t node) {
+            if (mesh >= meshes->size()) return;
+            const auto prims = (*meshes)[mesh].find("primitives");
+            if (prims == (*meshes)[mesh].end() || !prims->is_array()) return;
+            for (const auto& prim : *prims)
             {
-                if (sharpCnt < 2) {
-                    uint32_t other = (ek.v0 == vId ? ek.v1 : ek.v0);
-                    neigh[sharpCnt] = verts[other].pos;
+                if (prim.value("mode", 4) != 4) {
+                    std::cerr << "[gltf] skipping non-triangle primitive of mesh " << mesh << "\n";
+                    continue;
                 }
-                ++sharpCnt;
+                out.push_back(PrimitiveInstance{ &prim, world, node });
             }
+            };
+
+        const auto nodes = json.find("nodes");
+        const auto scenes = json.find("scenes");
+        const size_t sceneIndex = json.value("scene", 0u);
+        if (nodes == json.end() || !nodes->is_array() || scenes == json.end() || !scenes->is_array() || sceneIndex >= scenes->size())
+        {
+            for (size_t m = 0; m < meshes->size(); ++m)
+                addMesh(m, glm::mat4(1.f), 0);
+            return out;
         }
-    }
 
-    /* edgeList + sharpness → 查表 */
-    static void buildSharpMap(const std::vector<glm::uvec2>& list,
-        const std::vector<uint32_t>& sharp,
-        std::unordered_map<EdgeKey, uint32_t, EdgeKeyHash>& out)
-    {
-        for (size_t i = 0; i < list.size(); ++i)
-            out.emplace(EdgeKey(list[i][0], list[i][1]), sharp[i]);
+        // depth first from the scene roots; the visit count bounds a
+        // malformed file with cycles
+        std::vector<std::pair<size_t, glm::mat4>> stack;
+        for (const auto& root : (*scenes)[sceneIndex].value("nodes", nlohmann::json::array()))
+            stack.emplace_back(root.get<size_t>(), glm::mat4(1.f));
+        size_t visits = 0;
+        while (!stack.empty() && visits++ <= nodes->size())
+        {
+            const auto [n, parent] = stack.back();
+            stack.pop_back();
+            if (n >= nodes->size())
+                continue;
+
+            const auto& node = (*nodes)[n];
+            const glm::mat4 world = parent * node_transform(node);
+            if (node.contains("mesh"))
+                addMesh(node["mesh"].get<size_t>(), world, n);
+            for (const auto& child : node.value("children", nlohmann::json::array()))
+                stack.emplace_back(child.get<size_t>(), world);
+        }
+        return out;
     }
-}
 
-std::vector<uint32_t> GltfModel::generateTrianglesFromQuads() const
-{
-    std::vector<uint32_t> out;
-    out.reserve(m_quadFaces.size() * 6); 
-
-    for (const auto& q : m_quadFaces)
+    bool load_primitive(const GltfView& view, const PrimitiveInstance& instance, PartData& out)
     {
-        // Triangle 1: a, b, c
-        out.push_back(q.x);
-        out.push_back(q.y);
-        out.push_back(q.z);
+        const nlohmann::json& prim = *instance.primitive;
+        auto getAttr = [&](const char* name) -> int {
+            const auto attributes = prim.find("attributes");
+            if (attributes == prim.end() || !attributes->contains(name)) return -1;
+            return (*attributes)[name].get<int>();
+            };
+
+        GltfView::Accessor pos;
+        if (!view.accessor(getAttr("POSITION"), pos) || pos.components != 3 || pos.componentType != GltfView::kFloat || pos.count == 0) {
+            out.error = "missing or invalid POSITION";
+            return false;
+        }
 
-        // Triangle 2: a, c, d
-        out.push_back(q.x);
-        out.push_back(q.z);
-        out.push_back(q.w);
-    }
-    return out;
-}
+        // straight from the mapped buffer into the vertices
+        out.vertices.assign(pos.count, Vertex{});
+        read_floats(pos, &out.vertices[0].pos.x, sizeof(Vertex));
 
+        GltfView::Accessor nrm;
+        const int nrmAcc = getAttr("NORMAL");
+        bool hasNormals = nrmAcc >= 0;
+        if (hasNormals && (!view.accessor(nrmAcc, nrm) || nrm.count != pos.count || nrm.components != 3 || !read_floats(nrm, &out.vertices[0].normal.x, sizeof(Vertex)))) {
+            out.error = "Failed to read or invalid NORMAL data";
+            hasNormals = false;
+        }
 
-void GltfModel::preprocessForSubdivision() {
-    
-    std::unordered_map<glm::vec3, uint32_t, PosHasher> canonicalPosMap;
-    std::vector<uint32_t> vertexRemap(m_quadVertices.size());
-
-    for (uint32_t i = 0; i < m_quadVertices.size(); ++i) {
-        glm::vec3 pos = m_quadVertices[i].pos;
-        bool found = false;
-        for (const auto& [p, idx] : canonicalPosMap) {
-            if (pos_equal(p, pos)) {
-                vertexRemap[i] = idx;
-                found = true;
-                break;
+        const int idxAcc = prim.value("indices", -1);
+        if (idxAcc >= 0)
+        {
+            GltfView::Accessor idx;
+            if (!view.accessor(idxAcc, idx)) {
+                out.error = "Failed to read indices";
+                return false;
+            }
+            out.indices.resize(idx.count);
+            if (!read_indices(idx, out.indices.data())) {
+                out.error = "Unsupported index type: " + std::to_string(idx.componentType);
+                return false;
             }
         }
-        if (!found) {
-            vertexRemap[i] = i;
-            canonicalPosMap[pos] = i;
+        else
+        {
+            out.indices.resize(pos.count);
+            std::iota(out.indices.begin(), out.indices.end(), 0u);
         }
-    }
-
-
-    std::map<Edge, std::vector<uint32_t>> edgeFaces;  // Edge -> Faces
-    std::map<uint32_t, std::vector<uint32_t>> vertexFaces; // Vertex -> Faces
-    std::map<uint32_t, std::vector<uint32_t>> vertexEdges; // Vertex -> Edges
-
-    
-    std::map<Edge, uint32_t> edgeIndexMap;
-    for (uint32_t faceID = 0; faceID < m_quadFaces.size(); ++faceID) {
-        const glm::uvec4& q = m_quadFaces[faceID];
-        uint32_t vs[4] = { q.x, q.y, q.z, q.w };
-        for (int i = 0; i < 4; ++i) {
-            //Edge e(vs[i], vs[(i + 1) % 4]);
-            Edge e(vertexRemap[vs[i]], vertexRemap[vs[(i + 1) % 4]]);
-            uint32_t eid;
-            if (edgeIndexMap.count(e) == 0) {
-                eid = static_cast<uint32_t>(m_edgeList.size());
-                edgeIndexMap[e] = eid;
-                m_edgeList.emplace_back(glm::uvec2(e.a, e.b));
-                m_edgeToFace.emplace_back(glm::uvec2(~0u, ~0u));
-            }
-            else {
-                eid = edgeIndexMap[e];
+        out.indices.resize(out.indices.size() - out.indices.size() % 3);
+        for (uint32_t idx : out.indices)
+        {
+            if (idx >= pos.count) {
+                out.error = "index out of range";
+                return false;
             }
-
-            glm::uvec2& ef = m_edgeToFace[eid];
-            if (ef.x == ~0u) ef.x = faceID;
-            else ef.y = faceID;
         }
 
-        for (int i = 0; i < 4; ++i) {
-            uint32_t vid = vertexRemap[vs[i]];
-            vertexFaces[vid].push_back(faceID);
+        const glm::mat4& world = instance.world;
+        const glm::mat3 normalMatrix = glm::inverseTranspose(glm::mat3(world));
+        for (Vertex& v : out.vertices)
+        {
+            v.pos = glm::vec3(world * glm::vec4(v.pos, 1.f));
+            v.normal = hasNormals ? glm::normalize(normalMatrix * v.normal) : glm::vec3(0, 1, 0);
         }
-    }
-
-    
-    for (uint32_t eid = 0; eid < m_edgeList.size(); ++eid) {
-        const glm::uvec2& e = m_edgeList[eid];
-        uint32_t v0 = vertexRemap[e.x];
-        uint32_t v1 = vertexRemap[e.y];
-        vertexEdges[e.x].push_back(eid);
-        vertexEdges[e.y].push_back(eid);
-    }
 
-    // face —> edges
-    m_faceEdgeIndices.clear();
-    m_faceEdgeIndices.reserve(m_quadFaces.size());
-
-    for (const glm::uvec4& q : m_quadFaces) {
-        uint32_t v[4] = { q.x, q.y, q.z, q.w };
-        glm::uvec4 fe;
-        for (int i = 0; i < 4; ++i) {
-            Edge e(vertexRemap[v[i]],
-                vertexRemap[v[(i + 1) & 3]]);
-            fe[i] = edgeIndexMap[e];
+        // a mirroring transform turns the faces inside out
+        if (glm::determinant(glm::mat3(world)) < 0.f)
+        {
+            for (size_t i = 0; i < out.indices.size(); i += 3)
+                std::swap(out.indices[i + 1], out.indices[i + 2]);
         }
-        m_faceEdgeIndices.push_back(fe);
+        return true;
     }
+}
 
-    uint32_t canonicalVertexCount = static_cast<uint32_t>(canonicalPosMap.size());
-
-    
-    m_vertexFaceCounts.clear();
-    m_vertexFaceIndices.clear();
+std::vector<uint32_t> GltfModel::generateTrianglesFromQuads() const
+{
+    std::vector<uint32_t> out;
+    out.reserve(size_t(m_mesh.face_count()) * 6); 
 
-    for (uint32_t i = 0; i < canonicalVertexCount; ++i)
+    for (uint32_t f = 0; f < m_mesh.face_count(); ++f)
     {
-        const auto& list = vertexFaces[i];
-        m_vertexFaceCounts.push_back(static_cast<uint32_t>(list.size()));
-        m_vertexFaceIndices.insert(m_vertexFaceIndices.end(), list.begin(), list.end());
-    }
-
+        const uint32_t* q = m_mesh.face_corners(f);
 
-    
-    m_vertexEdgeCounts.clear();
-    m_vertexEdgeIndices.clear();
+        // Triangle 1: a, b, c
+        out.push_back(q[0]);
+        out.push_back(q[1]);
+        out.push_back(q[2]);
 
-    for (uint32_t i = 0; i < canonicalVertexCount; ++i)
-    {
-        const auto& list = vertexEdges[i];
-        m_vertexEdgeCounts.push_back(static_cast<uint32_t>(list.size()));
-        m_vertexEdgeIndices.insert(m_vertexEdgeIndices.end(), list.begin(), list.end());
+        // Triangle 2: a, c, d
+        out.push_back(q[0]);
+        out.push_back(q[2]);
+        out.push_back(q[3]);
     }
+    return out;
+}
 
+
+void GltfModel::preprocessForSubdivision() {
+    LUT_PROFILE_FUNCTION();
+    
+    // vertexRemap[i] = index of the first vertex at the same position (pos_equal semantics)
+    std::vector<uint32_t> vertexRemap;
+    if (!m_quadVertices.empty())
+        vertexRemap = weld_positions(&m_quadVertices[0].pos, m_quadVertices.size(), sizeof(Vertex), 1e-6f, WeldMetric::euclidean);
+
+    // faces in terms of canonical vertices; the CSR arrays keep one (possibly
+    // empty) slot per original vertex so that ids stay valid for the shaders
+    std::vector<uint32_t> canonical(m_mesh.heVertex.size());
+    for (size_t i = 0; i < canonical.size(); ++i)
+        canonical[i] = vertexRemap[m_mesh.heVertex[i]];
+
+    setQuadMesh(make_halfedge_mesh(std::move(canonical), 4, static_cast<uint32_t>(m_quadVertices.size())));
 }
 
 
-bool GltfModel::loadFromFile(const std::string& path)
+bool GltfModel::loadFromFile(const std::string& path, bool weldParts)
 {
-    tinygltf::TinyGLTF loader;
-    tinygltf::Model model;
-    std::string warn, err;
-
-    if (!loader.LoadASCIIFromFile(&model, &err, &warn, path)) {
-        std::cerr << "[tinygltf] " << err << '\n';
-        return false;
-    }
-    if (!warn.empty()) std::cerr << "[tinygltf] warn: " << warn << '\n';
+    LUT_PROFILE_FUNCTION();
+    GltfView view;
+    return view.open(path) && loadFromView(view, weldParts);
+}
 
-    if (model.meshes.empty() || model.meshes.front().primitives.empty()) {
+bool GltfModel::loadFromView(const GltfView& view, bool weldParts)
+{
+    const std::vector<PrimitiveInstance> instances = scene_primitives(view.json());
+    if (instances.empty()) {
         std::cerr << "[gltf] no mesh data\n";
         return false;
     }
-    const auto& prim = model.meshes.front().primitives.front();
-
-    auto getAttr = [&](const char* name) -> int {
-        auto it = prim.attributes.find(name);
-        return (it == prim.attributes.end()) ? -1 : it->second;
-        };
 
-    int posAcc = getAttr("POSITION");
-    if (posAcc < 0) {
-        std::cerr << "[gltf] POSITION missing\n";
-        return false;
-    }
+    // every primitive on its own; they only share the view
+    std::vector<PartData> parts(instances.size());
+    parallel_for(instances.size(), [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; ++i)
+        {
+            parts[i].ok = load_primitive(view, instances[i], parts[i]);
+            if (parts[i].ok && !weldParts)
+                weldVertices(parts[i].vertices, parts[i].indices);
+        }
+    }, 1);
 
-    const auto& posAccessor = model.accessors[posAcc];
-    if (posAccessor.type != TINYGLTF_TYPE_VEC3 ||
-        posAccessor.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT) {
-        std::cerr << "[gltf] Invalid POSITION attribute type\n";
+    // a cage with a primitive missing would subdivide into a different
+    // surface, so any primitive that cannot be read fails the whole load
+    bool complete = true;
+    size_t vertexTotal = 0, indexTotal = 0;
+    for (size_t i = 0; i < parts.size(); ++i)
+    {
+        if (!parts[i].error.empty())
+            std::cerr << "[gltf] node " << instances[i].node << ": " << parts[i].error << "\n";
+        complete = complete && parts[i].ok;
+        vertexTotal += parts[i].vertices.size();
+        indexTotal += parts[i].indices.size();
+    }
+    if (!complete) {
+        std::cerr << "[gltf] cannot load every primitive\n";
         return false;
     }
-
-    int nrmAcc = getAttr("NORMAL");
-    int uvAcc = getAttr("TEXCOORD_0");
-    int idxAcc = prim.indices >= 0 ? prim.indices : -1;
-
-    std::vector<uint8_t> posRaw;
-    if (!readAccessor(model, posAcc, posRaw)) {
-        std::cerr << "[gltf] Failed to read POSITION data\n";
+    if (vertexTotal == 0) {
+        std::cerr << "[gltf] no mesh data\n";
         return false;
     }
 
-    size_t vtxCount = posAccessor.count;
-    m_vertices.resize(vtxCount);
-
-
-    const auto* posData = reinterpret_cast<const glm::vec3*>(posRaw.data());
-    for (size_t i = 0; i < vtxCount; ++i) {
-        m_vertices[i].pos = posData[i];
-    }
-
-    if (nrmAcc >= 0) {
-        const auto& nrmAccessor = model.accessors[nrmAcc];
-        if (nrmAccessor.type == TINYGLTF_TYPE_VEC3 &&
-            nrmAccessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT)
-        {
-            std::vector<uint8_t> nrmRaw;
-            if (readAccessor(model, nrmAcc, nrmRaw) &&
-                nrmRaw.size() == vtxCount * sizeof(glm::vec3))
-            {
-                const auto* nrmData = reinterpret_cast<const glm::vec3*>(nrmRaw.data());
-                for (size_t i = 0; i < vtxCount; ++i) {
-                    m_vertices[i].normal = nrmData[i];
-                }
-            }
-            else {
-                std::cerr << "[gltf] Failed to read or invalid NORMAL data\n";
-            }
-        }
-        else {
-            std::cerr << "[gltf] Invalid NORMAL attribute type\n";
-        }
-    }
-    else {
-        for (auto& v : m_vertices) v.normal = glm::vec3(0, 1, 0);
-    }
-
-
-
-
-    if (idxAcc >= 0) 
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<MeshPart> ranges;
+    vertices.reserve(vertexTotal);
+    indices.reserve(indexTotal);
+    for (PartData& part : parts)
     {
-        const auto& idxAccessor = model.accessors[idxAcc];
-        const auto& view = model.bufferViews[idxAccessor.bufferView];
-        const auto& buffer = model.buffers[view.buffer];
-        const uint8_t* data = buffer.data.data() + view.byteOffset + idxAccessor.byteOffset;
-
-        m_indices.resize(idxAccessor.count);
-
-        switch (idxAccessor.componentType) {
-        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
-            std::memcpy(m_indices.data(), data, idxAccessor.count * sizeof(uint32_t));
-            break;
-        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
-            for (size_t i = 0; i < idxAccessor.count; ++i) {
-                m_indices[i] = reinterpret_cast<const uint16_t*>(data)[i];
-            }
-            break;
-        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
-            for (size_t i = 0; i < idxAccessor.count; ++i) {
-                m_indices[i] = reinterpret_cast<const uint8_t*>(data)[i];
-            }
-            break;
-        default:
-            std::cerr << "Unsupported index type: " << idxAccessor.componentType << "\n";
-            return false;
-        }
+        const uint32_t base = static_cast<uint32_t>(vertices.size());
+        ranges.push_back(MeshPart{ base, static_cast<uint32_t>(part.vertices.size()),
+            static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(part.indices.size()) });
+        vertices.insert(vertices.end(), part.vertices.begin(), part.vertices.end());
+        for (uint32_t idx : part.indices)
+            indices.push_back(base + idx);
+        part = PartData{};
     }
-    else 
+
+    if (weldParts)
     {
-        m_indices.resize(vtxCount);
-        std::iota(m_indices.begin(), m_indices.end(), 0u);
+        weldVertices(vertices, indices);
+        ranges.assign(1, MeshPart{ 0, static_cast<uint32_t>(vertices.size()), 0, static_cast<uint32_t>(indices.size()) });
     }
 
-    weldVertices(m_vertices, m_indices);
+    setBaseMesh(std::move(vertices), std::move(indices), std::move(ranges));
+    return true;
+}
+
+void GltfModel::setBaseMesh(std::vector<Vertex> vertices, std::vector<uint32_t> indices, std::vector<MeshPart> parts)
+{
+    m_vertices = std::move(vertices);
+    m_indices = std::move(indices);
+    m_parts = std::move(parts);
 
     m_quadVertices = m_vertices;
     m_quadIndices = m_indices;
     // just fill the data randomly
     m_quadLinelists = m_quadIndices;
-
-    return true;
 }
 
 
@@ -581,461 +526,275 @@ void GltfModel::load_unit_gemometry()
 
 void labutils::GltfModel::firstSubdivision()
 {
-    std::unordered_map<EdgeKey, uint32_t, EdgeKeyHash> sharpOld;
-    {
-        std::unordered_set<EdgeKey, EdgeKeyHash> seen;
-        size_t sharpIdx = 0;
-
-        const size_t triCnt = m_indices.size() / 3;
-        for (size_t t = 0; t < triCnt; ++t)
-        {
-            uint32_t i0 = m_indices[3 * t + 0];
-            uint32_t i1 = m_indices[3 * t + 1];
-            uint32_t i2 = m_indices[3 * t + 2];
-
-            EdgeKey edges[3] = { EdgeKey(i0,i1), EdgeKey(i1,i2), EdgeKey(i2,i0) };
-            for (auto& ek : edges)
-                if (seen.insert(ek).second)
-                {
-                    uint32_t s = (sharpIdx < initial_sharpness.size()) ?
-                        initial_sharpness[sharpIdx] : 0;
-                    sharpOld.emplace(ek, s);
-                    ++sharpIdx;
-                }
-        }
-
-        if (sharpIdx != initial_sharpness.size())
-            std::cerr << "[firstSubdivision]  initial_sharpness counts(" << initial_sharpness.size()
-            << ") don't match with(" << sharpIdx << ") \n";
-    }
-
-    
-    m_quadVertices.clear();
-    m_quadFaces.clear();
-    m_quadIndices.clear();
-    m_quadLinelists.clear();
-    m_edgeList.clear();
-    m_edgeToFace.clear();
-    m_sharpness.clear();
-    m_vertexFaceCounts.clear();
-    m_vertexFaceIndices.clear();
-    m_vertexEdgeCounts.clear();
-    m_vertexEdgeIndices.clear();
-    m_faceEdgeIndices.clear();
-
-    using FaceVec = std::vector<uint32_t>;
-    using EdgeVec = std::vector<EdgeKey>;
-    std::unordered_map<uint32_t, FaceVec> vertexFaces;
-    std::unordered_map<uint32_t, EdgeVec> vertexEdges;
-    std::unordered_map<EdgeKey, FaceVec, EdgeKeyHash> edgeToFaces;
-
-    const size_t triCnt = m_indices.size() / 3;
-    for (size_t t = 0; t < triCnt; ++t)
-    {
-        uint32_t i0 = m_indices[3 * t + 0], i1 = m_indices[3 * t + 1], i2 = m_indices[3 * t + 2];
-        uint32_t fid = uint32_t(t);
-        EdgeKey e01(i0, i1), e12(i1, i2), e20(i2, i0);
-
-        edgeToFaces[e01].push_back(fid);
-        edgeToFaces[e12].push_back(fid);
-        edgeToFaces[e20].push_back(fid);
-
-        vertexFaces[i0].push_back(fid);  vertexFaces[i1].push_back(fid);  vertexFaces[i2].push_back(fid);
-        vertexEdges[i0].push_back(e01);  vertexEdges[i0].push_back(e20);
-        vertexEdges[i1].push_back(e01);  vertexEdges[i1].push_back(e12);
-        vertexEdges[i2].push_back(e12);  vertexEdges[i2].push_back(e20);
-    }
-
-    
-    std::vector<uint32_t>  facePointIdx(triCnt);
-    std::vector<glm::vec3> facePoints(triCnt);
-
-    for (size_t t = 0; t < triCnt; ++t)
-    {
-        uint32_t i0 = m_indices[3 * t + 0], i1 = m_indices[3 * t + 1], i2 = m_indices[3 * t + 2];
-        glm::vec3 p = (m_vertices[i0].pos + m_vertices[i1].pos + m_vertices[i2].pos) / 3.f;
-
-        facePointIdx[t] = uint32_t(m_quadVertices.size());
-        facePoints[t] = p;
-        m_quadVertices.push_back(Vertex{ p });
-    }
-
-    
-    std::unordered_map<EdgeKey, uint32_t, EdgeKeyHash> edgePtIdx;
-    std::unordered_map<uint32_t, EdgeKey>             edgePtParent;
-
-    for (auto& [ek, fl] : edgeToFaces)
-    {
-        glm::vec3 v0 = m_vertices[ek.v0].pos, v1 = m_vertices[ek.v1].pos;
-        uint32_t  s = sharpOld[ek];
+    LUT_PROFILE_FUNCTION();
+    // edge ids follow first appearance, which is also the order
+    // initial_sharpness is specified in
+    const HalfEdgeMesh tri = make_halfedge_mesh(m_indices, 3, static_cast<uint32_t>(m_vertices.size()));
 
-        glm::vec3 p = (s > 0) ? (v0 + v1) * 0.5f :
-            ([&] { glm::vec3 f(0.f); for (uint32_t fid : fl)f += facePoints[fid];
-        f /= float(fl.size()); return ((v0 + v1) * 0.5f + f) * 0.5f; }());
+    std::vector<glm::uvec2> triEdges, triEdgeFaces;
+    std::vector<uint32_t>   vfCounts, vfIndices, veCounts, veIndices;
+    build_topology_csr(tri,
+        TopologyCSR{ &triEdges, &triEdgeFaces, nullptr, &vfCounts, &vfIndices, &veCounts, &veIndices });
 
-        uint32_t vid = uint32_t(m_quadVertices.size());
-        m_quadVertices.push_back(Vertex{ p });
-        edgePtIdx[ek] = vid; edgePtParent[vid] = ek;
-    }
+    const uint32_t E = tri.edge_count();
+    if (E != initial_sharpness.size())
+        std::cerr << "[firstSubdivision]  initial_sharpness counts(" << initial_sharpness.size()
+        << ") don't match with(" << E << ") \n";
 
-    std::unordered_map<uint32_t, uint32_t> newVIdx;
+    std::vector<uint32_t> sharpOld(E, 0);
+    std::copy_n(initial_sharpness.begin(), std::min<size_t>(E, initial_sharpness.size()), sharpOld.begin());
 
-    for (uint32_t vid = 0; vid < m_vertices.size(); ++vid)
-    {
-        uint32_t cnt; glm::vec3 nei[2];
-        analyseSharpAtVertex(vid, vertexEdges[vid], sharpOld, cnt, nei, m_vertices);
-
-        glm::vec3 S = m_vertices[vid].pos, newPos;
-        if (cnt >= 3)      newPos = S;
-        else if (cnt == 2) newPos = (nei[0] + 6.f * S + nei[1]) / 8.f;
-        else            /* smooth */ {
-            glm::vec3 Q(0.f); for (uint32_t fid : vertexFaces[vid]) Q += facePoints[fid];
-            Q /= float(vertexFaces[vid].size());
-            glm::vec3 R(0.f); for (auto& ek : vertexEdges[vid]) R += (m_vertices[ek.v0].pos + m_vertices[ek.v1].pos) * 0.5f;
-            R /= float(vertexEdges[vid].size());
-            newPos = (Q + 2.f * R + (float(vertexFaces[vid].size()) - 3.f) * S) / float(vertexFaces[vid].size());
-        }
+    m_levelStencils.clear();
+    m_stencils = StencilTable{};
+    m_stencilLevels = 0;
 
-        uint32_t nid = uint32_t(m_quadVertices.size());
-        m_quadVertices.push_back(Vertex{ newPos });
-        newVIdx[vid] = nid;
-    }
+    refineLevel(tri, m_vertices, sharpOld,
+        TopologyCSR{ &triEdges, &triEdgeFaces, nullptr, &vfCounts, &vfIndices, &veCounts, &veIndices });
 
-    struct EdgeInfo { uint32_t idx, f0, f1; };
-    std::unordered_map<EdgeKey, EdgeInfo, EdgeKeyHash> edgeMap;
-    //std::unordered_map<EdgeKey, uint32_t, EdgeKeyHash> edgeIdxMap;
-    std::unordered_map<EdgeKey, uint32_t, EdgeKeyHash> edgeIndexMap;
+    //debugPrintVerticesAndIndices(m_quadVertices, m_quadIndices, "Print");
+    //debugPrintEdgeList();
+    //debugPrintEdgeToFace();
+    //debugPrintQuadFaces();
+}
 
-    auto regEdge = [&](uint32_t a, uint32_t b, uint32_t sharp, uint32_t fid)->uint32_t
-        {
-            EdgeKey k(a, b);
-            auto it = edgeMap.find(k);
-            if (it == edgeMap.end()) {
-                EdgeInfo inf{ uint32_t(m_edgeList.size()),fid,UINT32_MAX };
-                edgeMap.emplace(k, inf); edgeIndexMap[k] = inf.idx;
-                m_edgeList.emplace_back(k.v0, k.v1);
-                m_sharpness.push_back(sharp);
-                return inf.idx;
-            }
-            else { if (it->second.f1 == UINT32_MAX) it->second.f1 = fid; return it->second.idx; }
-        };
+void labutils::GltfModel::subdivideQuadOnce()
+{
+    LUT_PROFILE_FUNCTION();
+    // The parent level's mesh and CSR arrays are still valid, so no adjacency
+    // has to be rediscovered here. Move them out; refineLevel() refills them.
+    const HalfEdgeMesh          oldMesh = std::move(m_mesh);
+    const std::vector<Vertex>   oldVerts = std::move(m_quadVertices);
+    std::vector<glm::uvec2>     oldEdges = std::move(m_edgeList);
+    std::vector<glm::uvec2>     oldEdgeFaces = std::move(m_edgeToFace);
+    std::vector<uint32_t>       oldVFCounts = std::move(m_vertexFaceCounts);
+    std::vector<uint32_t>       oldVFIndices = std::move(m_vertexFaceIndices);
+    std::vector<uint32_t>       oldVECounts = std::move(m_vertexEdgeCounts);
+    std::vector<uint32_t>       oldVEIndices = std::move(m_vertexEdgeIndices);
+    std::vector<uint32_t>       oldSharp = std::move(m_sharpness);
+    oldSharp.resize(oldMesh.edge_count(), 0);
+
+    refineLevel(oldMesh, oldVerts, oldSharp,
+        TopologyCSR{ &oldEdges, &oldEdgeFaces, nullptr, &oldVFCounts, &oldVFIndices, &oldVECounts, &oldVEIndices });
+}
 
-    for (size_t t = 0; t < triCnt; ++t)
+void GltfModel::subdivideAdaptiveOnce()
+{
+    LUT_PROFILE_FUNCTION();
+    if (m_adaptive.level == 0)
     {
-        uint32_t i0 = m_indices[3 * t + 0], i1 = m_indices[3 * t + 1], i2 = m_indices[3 * t + 2];
-        uint32_t v0 = newVIdx[i0], v1 = newVIdx[i1], v2 = newVIdx[i2];
-        uint32_t e01 = edgePtIdx[EdgeKey(i0, i1)], e12 = edgePtIdx[EdgeKey(i1, i2)], e20 = edgePtIdx[EdgeKey(i2, i0)];
-        uint32_t fp = facePointIdx[t];
+        firstSubdivision();
 
-        uint32_t s01 = sharpOld[EdgeKey(i0, i1)], s12 = sharpOld[EdgeKey(i1, i2)], s20 = sharpOld[EdgeKey(i2, i0)];
-
-        glm::uvec4 quads[3] = { {v0,e01,fp,e20},{v1,e12,fp,e01},{v2,e20,fp,e12} };
-
-        for (int q = 0; q < 3; ++q)
-        {
-            uint32_t fNew = uint32_t(m_quadFaces.size());
-            m_quadFaces.push_back(quads[q]);
-
-            const uint32_t vv[4] = { quads[q][0],quads[q][1],quads[q][2],quads[q][3] };
-            glm::uvec4 eIdx;
-            for (int e = 0; e < 4; ++e)
-            {
-                uint32_t a = vv[e], b = vv[(e + 1) & 3];
-
-                uint32_t sharp = 0;
-                auto childOf = [&](EdgeKey parent)->bool {
-                    return (edgePtParent.count(a) && edgePtParent[a] == parent) ||
-                        (edgePtParent.count(b) && edgePtParent[b] == parent);
-                    };
-                if (childOf(EdgeKey(i0, i1))) sharp = s01 ? s01 - 1 : 0;
-                else if (childOf(EdgeKey(i1, i2))) sharp = s12 ? s12 - 1 : 0;
-                else if (childOf(EdgeKey(i2, i0))) sharp = s20 ? s20 - 1 : 0;
-
-                eIdx[e] = regEdge(a, b, sharp, fNew);
-            }
-            m_faceEdgeIndices.push_back(eIdx);
-        }
+        std::vector<glm::vec3> points(m_quadVertices.size());
+        for (size_t i = 0; i < points.size(); ++i)
+            points[i] = m_quadVertices[i].pos;
+        m_adaptive = make_adaptive_level(m_mesh, std::move(points), m_sharpness, 1);
+        m_patches = PatchTable{};
     }
-
-    m_edgeToFace.resize(m_edgeList.size(), glm::uvec2(UINT32_MAX, UINT32_MAX));
-    for (auto& [key, info] : edgeMap)
-        m_edgeToFace[info.idx] = glm::uvec2(info.f0, info.f1);
-
-    for (const auto& q : m_quadFaces)
+    else
     {
-        m_quadIndices.push_back(q[0]);
-        m_quadIndices.push_back(q[1]);
-        m_quadIndices.push_back(q[2]);
-        m_quadIndices.push_back(q[2]);
-        m_quadIndices.push_back(q[3]);
-        m_quadIndices.push_back(q[0]);
+        m_adaptive = refine_adaptive(m_adaptive, m_patches);
     }
 
-    //for (size_t vid = 0; vid < m_vertices.size(); ++vid)
-    //{
-    //    /* face adjacency */
-    //    const auto& fvec = vertexFaces[vid];
-    //    m_vertexFaceCounts.push_back(static_cast<uint32_t>(fvec.size()));
-    //    for (uint32_t fid : fvec) m_vertexFaceIndices.push_back(fid);
-
-    //    /* edge adjacency */
-    //    const auto& evec = vertexEdges[vid];
-    //    m_vertexEdgeCounts.push_back(static_cast<uint32_t>(evec.size()));
-    //    for (const auto& ek : evec)
-    //        m_vertexEdgeIndices.push_back(edgeIndexMap[ek]);
-    //}
-    // 
+    m_levelStencils.clear();
+    m_stencils = StencilTable{};
+    m_stencilLevels = 0;
 
-    const uint32_t Vp = static_cast<uint32_t>(m_quadVertices.size());
+    std::vector<glm::vec3> points;
+    std::vector<uint32_t> quads;
+    adaptive_draw_mesh(m_adaptive, patchesOnDevice ? PatchTable{} : m_patches, points, quads);
 
-    std::vector<std::vector<uint32_t>> vFaces(Vp);   
-    std::vector<std::vector<uint32_t>> vEdges(Vp);   
+    m_quadVertices.assign(points.size(), Vertex{});
+    for (size_t i = 0; i < points.size(); ++i)
+        m_quadVertices[i].pos = points[i];
+    setQuadMesh(make_halfedge_mesh(std::move(quads), 4, static_cast<uint32_t>(points.size())));
+    m_sharpness.assign(m_mesh.edge_count(), 0);
+}
 
-    for (uint32_t fid = 0; fid < m_quadFaces.size(); ++fid)
+ViewDependentStats GltfModel::subdivideViewDependent(const ScreenError& error)
+{
+    LUT_PROFILE_FUNCTION();
+    if (m_adaptive.level == 0)
     {
-        const glm::uvec4& q = m_quadFaces[fid];
-
-
-        for (int k = 0; k < 4; ++k)
-            vFaces[q[k]].push_back(fid);
-
-        const uint32_t v[4] = { q[0], q[1], q[2], q[3] };
-        for (int e = 0; e < 4; ++e)
-        {
-            uint32_t a = v[e];
-            uint32_t b = v[(e + 1) & 3];
-
-            EdgeKey key(a, b);                 
-            uint32_t eid = edgeIndexMap[key];  
+        firstSubdivision();
 
-            vEdges[a].push_back(eid);
-            vEdges[b].push_back(eid);         
-        }
+        std::vector<glm::vec3> points(m_quadVertices.size());
+        for (size_t i = 0; i < points.size(); ++i)
+            points[i] = m_quadVertices[i].pos;
+        m_adaptive = make_adaptive_level(m_mesh, std::move(points), m_sharpness, 1);
+        m_patches = PatchTable{};
     }
 
-    m_vertexFaceCounts.reserve(Vp);
-    m_vertexEdgeCounts.reserve(Vp);
-    m_vertexFaceIndices.reserve(Vp * 4);              
-    m_vertexEdgeIndices.reserve(m_edgeList.size() * 2);
-
-    for (uint32_t vid = 0; vid < Vp; ++vid)
-    {
-        m_vertexFaceCounts.push_back(static_cast<uint32_t>(vFaces[vid].size()));
-        for (uint32_t fid : vFaces[vid])
-            m_vertexFaceIndices.push_back(fid);
+    m_levelStencils.clear();
+    m_stencils = StencilTable{};
+    m_stencilLevels = 0;
 
-        m_vertexEdgeCounts.push_back(static_cast<uint32_t>(vEdges[vid].size()));
-        for (uint32_t eid : vEdges[vid])
-            m_vertexEdgeIndices.push_back(eid);
-    }
-    //debugPrintVerticesAndIndices(m_quadVertices, m_quadIndices, "Print");
-    //debugPrintEdgeList();
-    //debugPrintEdgeToFace();
-    //debugPrintQuadFaces();
-    m_quadLinelists.clear();
-    m_quadLinelists.reserve(m_edgeList.size() * 2); 
+    std::vector<glm::vec3> points;
+    std::vector<uint32_t> quads;
+    const ViewDependentStats stats = view_dependent_mesh(m_adaptive, error, points, quads);
 
-    for (const auto& edge : m_edgeList) {
-        m_quadLinelists.push_back(edge.x); 
-        m_quadLinelists.push_back(edge.y); 
-    }
+    m_quadVertices.assign(points.size(), Vertex{});
+    for (size_t i = 0; i < points.size(); ++i)
+        m_quadVertices[i].pos = points[i];
+    setQuadMesh(make_halfedge_mesh(std::move(quads), 4, static_cast<uint32_t>(points.size())));
+    m_sharpness.assign(m_mesh.edge_count(), 0);
+    return stats;
 }
 
-void labutils::GltfModel::subdivideQuadOnce()
+namespace
 {
-
-    const auto oldVerts = m_quadVertices;
-    const auto oldFaces = m_quadFaces;
-    const auto oldEdges = m_edgeList;
-    const auto oldSharp = m_sharpness;
-    const size_t faceCnt = oldFaces.size();
-
-    std::unordered_map<EdgeKey, uint32_t, EdgeKeyHash> sharpOld;
-    buildSharpMap(oldEdges, oldSharp, sharpOld);
-
-    m_quadVertices.clear();   m_quadFaces.clear();  m_quadIndices.clear();
-    m_quadLinelists.clear();  m_edgeList.clear();   m_edgeToFace.clear();
-    m_sharpness.clear();      m_vertexFaceCounts.clear();
-    m_vertexFaceIndices.clear(); m_vertexEdgeCounts.clear();
-    m_vertexEdgeIndices.clear(); m_faceEdgeIndices.clear();
-
-    using FaceVec = std::vector<uint32_t>;
-    using EdgeVec = std::vector<EdgeKey>;
-    std::unordered_map<uint32_t, FaceVec> vertexFaces;
-    std::unordered_map<uint32_t, EdgeVec> vertexEdges;
-    std::unordered_map<EdgeKey, FaceVec, EdgeKeyHash> edgeToFaces;
-
-    for (uint32_t fid = 0; fid < faceCnt; ++fid)
+    template< typename tVec >
+    std::size_t capacity_bytes(const tVec& aVec)
     {
-        const glm::uvec4& q = oldFaces[fid];
-        uint32_t v[4] = { q[0],q[1],q[2],q[3] };
-        EdgeKey e01(v[0], v[1]), e12(v[1], v[2]), e23(v[2], v[3]), e30(v[3], v[0]);
-
-        edgeToFaces[e01].push_back(fid); edgeToFaces[e12].push_back(fid);
-        edgeToFaces[e23].push_back(fid); edgeToFaces[e30].push_back(fid);
-
-        for (int i = 0; i < 4; ++i) {
-            vertexFaces[v[i]].push_back(fid);
-            vertexEdges[v[i]].push_back(EdgeKey(v[i], v[(i + 1) & 3]));
-        }
+        return aVec.capacity() * sizeof(typename tVec::value_type);
     }
 
-    std::vector<uint32_t> facePtIdx(faceCnt);
-    std::vector<glm::vec3> facePts(faceCnt);
-    for (uint32_t fid = 0; fid < faceCnt; ++fid)
+    std::size_t mesh_bytes(const HalfEdgeMesh& aMesh)
     {
-        auto& q = oldFaces[fid];
-        glm::vec3 p = (oldVerts[q[0]].pos + oldVerts[q[1]].pos +
-            oldVerts[q[2]].pos + oldVerts[q[3]].pos) * 0.25f;
-        facePtIdx[fid] = uint32_t(m_quadVertices.size());
-        facePts[fid] = p;
-        m_quadVertices.push_back(Vertex{ p });
+        return capacity_bytes(aMesh.heVertex) + capacity_bytes(aMesh.heTwin) + capacity_bytes(aMesh.heEdge)
+            + capacity_bytes(aMesh.edgeHalfEdge) + capacity_bytes(aMesh.vertexHalfEdge);
     }
+}
 
-    std::unordered_map<EdgeKey, uint32_t, EdgeKeyHash> edgePtIdx;
-    std::unordered_map<uint32_t, EdgeKey>             edgePtParent;
-
-    for (auto& [ek, fl] : edgeToFaces)
-    {
-        glm::vec3 v0 = oldVerts[ek.v0].pos, v1 = oldVerts[ek.v1].pos;
-        uint32_t  s = sharpOld[ek];
-        glm::vec3 p = (s > 0) ? (v0 + v1) * 0.5f :
-            ([&] {glm::vec3 f(0.f); for (uint32_t fid : fl)f += facePts[fid];
-        f /= float(fl.size()); return ((v0 + v1) * 0.5f + f) * 0.5f; }());
-
-        uint32_t vid = uint32_t(m_quadVertices.size());
-        m_quadVertices.push_back(Vertex{ p });
-        edgePtIdx[ek] = vid; edgePtParent[vid] = ek;
-    }
+std::size_t GltfModel::LevelState::byte_size() const
+{
+    std::size_t bytes = capacity_bytes(quadVertices) + mesh_bytes(mesh)
+        + capacity_bytes(quadIndices) + capacity_bytes(quadLinelists)
+        + capacity_bytes(edgeList) + capacity_bytes(edgeToFace) + capacity_bytes(sharpness)
+        + capacity_bytes(vertexFaceCounts) + capacity_bytes(vertexFaceIndices)
+        + capacity_bytes(vertexEdgeCounts) + capacity_bytes(vertexEdgeIndices)
+        + capacity_bytes(levelStencils);
+    for (const StencilTable& table : levelStencils)
+        bytes += capacity_bytes(table.offsets) + capacity_bytes(table.indices) + capacity_bytes(table.weights);
+
+    bytes += mesh_bytes(adaptive.mesh) + capacity_bytes(adaptive.points) + capacity_bytes(adaptive.sharpness)
+        + capacity_bytes(adaptive.vertexExact) + capacity_bytes(adaptive.vertexComplete)
+        + capacity_bytes(adaptive.faceActive) + capacity_bytes(adaptive.vertexId);
+    bytes += capacity_bytes(patches.points) + capacity_bytes(patches.levels)
+        + capacity_bytes(patches.corners) + capacity_bytes(patches.splits);
+    return bytes;
+}
 
-    std::unordered_map<uint32_t, uint32_t> newVIdx;
-    for (uint32_t vid = 0; vid < oldVerts.size(); ++vid)
-    {
-        uint32_t cnt; glm::vec3 nei[2];
-        analyseSharpAtVertex(vid, vertexEdges[vid], sharpOld, cnt, nei, oldVerts);
-
-        glm::vec3 S = oldVerts[vid].pos, newPos;
-        if (cnt >= 3)      newPos = S;
-        else if (cnt == 2) newPos = (nei[0] + 6.f * S + nei[1]) / 8.f;
-        else {/* smooth */
-            glm::vec3 Q(0.f); for (uint32_t fid : vertexFaces[vid]) Q += facePts[fid];
-            Q /= float(vertexFaces[vid].size());
-            glm::vec3 R(0.f); for (auto& ek : vertexEdges[vid]) R += (oldVerts[ek.v0].pos + oldVerts[ek.v1].pos) * 0.5f;
-            R /= float(vertexEdges[vid].size());
-            newPos = (Q + 2.f * R + (float(vertexFaces[vid].size()) - 3.f) * S) / float(vertexFaces[vid].size());
-        }
+GltfModel::LevelState GltfModel::saveLevel() const
+{
+    LevelState state;
+    state.quadVertices = m_quadVertices;
+    state.mesh = m_mesh;
+    state.quadIndices = m_quadIndices;
+    state.quadLinelists = m_quadLinelists;
+    state.edgeList = m_edgeList;
+    state.edgeToFace = m_edgeToFace;
+    state.sharpness = m_sharpness;
+    state.vertexFaceCounts = m_vertexFaceCounts;
+    state.vertexFaceIndices = m_vertexFaceIndices;
+    state.vertexEdgeCounts = m_vertexEdgeCounts;
+    state.vertexEdgeIndices = m_vertexEdgeIndices;
+    state.levelStencils = m_levelStencils;
+    state.adaptive = m_adaptive;
+    state.patches = m_patches;
+    return state;
+}
 
-        uint32_t nid = uint32_t(m_quadVertices.size());
-        m_quadVertices.push_back(Vertex{ newPos });
-        newVIdx[vid] = nid;
-    }
+void GltfModel::restoreLevel(LevelState state)
+{
+    m_quadVertices = std::move(state.quadVertices);
+    m_mesh = std::move(state.mesh);
+    m_quadIndices = std::move(state.quadIndices);
+    m_quadLinelists = std::move(state.quadLinelists);
+    m_edgeList = std::move(state.edgeList);
+    m_edgeToFace = std::move(state.edgeToFace);
+    m_sharpness = std::move(state.sharpness);
+    m_vertexFaceCounts = std::move(state.vertexFaceCounts);
+    m_vertexFaceIndices = std::move(state.vertexFaceIndices);
+    m_vertexEdgeCounts = std::move(state.vertexEdgeCounts);
+    m_vertexEdgeIndices = std::move(state.vertexEdgeIndices);
+    m_levelStencils = std::move(state.levelStencils);
+    m_adaptive = std::move(state.adaptive);
+    m_patches = std::move(state.patches);
+
+    // the composed table is rebuilt on the next refinedStencils()
+    m_stencils = StencilTable{};
+    m_stencilLevels = 0;
+}
 
-    struct EdgeInfo { uint32_t idx, f0, f1; };
-    std::unordered_map<EdgeKey, EdgeInfo, EdgeKeyHash> edgeMap;
-    std::unordered_map<EdgeKey, uint32_t, EdgeKeyHash> edgeIndexMap;
+void GltfModel::refineLevel(const HalfEdgeMesh& parent, const std::vector<Vertex>& parentVerts,
+    const std::vector<uint32_t>& parentSharp, const TopologyCSR& parentCsr)
+{
+    // new vertex layout, same as drawBuffer.comp: [vertex points | edge points | face points]
+    StencilTable step = make_refinement_stencils(parent, parentSharp, parentCsr);
 
-    auto regEdge = [&](uint32_t a, uint32_t b, uint32_t sharp, uint32_t fid)->uint32_t
-        {
-            EdgeKey k(a, b);
-            auto it = edgeMap.find(k);
-            if (it == edgeMap.end()) {
-                EdgeInfo inf{ uint32_t(m_edgeList.size()),fid,UINT32_MAX };
-                edgeMap.emplace(k, inf); edgeIndexMap[k] = inf.idx;
-                m_edgeList.emplace_back(k.v0, k.v1);
-                m_sharpness.push_back(sharp);
-                return inf.idx;
-            }
-            else { if (it->second.f1 == UINT32_MAX) it->second.f1 = fid; return it->second.idx; }
-        };
+    m_quadVertices.assign(step.row_count(), Vertex{});
+    if (!m_quadVertices.empty())
+        evaluate_stencils(step, &parentVerts[0].pos, sizeof(Vertex), &m_quadVertices[0].pos, sizeof(Vertex));
+    m_levelStencils.push_back(std::move(step));
 
-    auto childSharp = [&](uint32_t ep, uint32_t other)->uint32_t
-        {
-            auto it = edgePtParent.find(ep);
-            if (it == edgePtParent.end()) return 0;
-            uint32_t s = sharpOld[it->second];
-            if (s == 0) return 0;
-            return s - 1;                     
-        };
-
-    for (uint32_t fid = 0; fid < faceCnt; ++fid)
-    {
-        auto& q = oldFaces[fid];
-        uint32_t v0 = newVIdx[q[0]], v1 = newVIdx[q[1]],
-            v2 = newVIdx[q[2]], v3 = newVIdx[q[3]];
-        uint32_t e01 = edgePtIdx[EdgeKey(q[0], q[1])],
-            e12 = edgePtIdx[EdgeKey(q[1], q[2])],
-            e23 = edgePtIdx[EdgeKey(q[2], q[3])],
-            e30 = edgePtIdx[EdgeKey(q[3], q[0])],
-            fp = facePtIdx[fid];
-
-        glm::uvec4 quads[4] = { {v0,e01,fp,e30},{v1,e12,fp,e01},
-                             {v2,e23,fp,e12},{v3,e30,fp,e23} };
-
-        for (int qd = 0; qd < 4; ++qd)
-        {
-            uint32_t fNew = uint32_t(m_quadFaces.size());
-            m_quadFaces.push_back(quads[qd]);
+    // child topology is a pure function of the parent's
+    setQuadMesh(refine_halfedge_mesh(parent));
+    inheritSharpness(parentSharp);
+}
 
-            const uint32_t vv[4] = { quads[qd][0],quads[qd][1],quads[qd][2],quads[qd][3] };
-            glm::uvec4 eIdx;
-            for (int e = 0; e < 4; ++e)
-            {
-                uint32_t a = vv[e], b = vv[(e + 1) & 3];
-                uint32_t sharp = childSharp(a, b);
-                eIdx[e] = regEdge(a, b, sharp, fNew);
-            }
-            m_faceEdgeIndices.push_back(eIdx);
-        }
-    }
-    for (auto e : m_edgeList)
+const StencilTable& GltfModel::refinedStencils()
+{
+    // compose lazily: pressing P repeatedly shouldn't pay for tables nobody reads
+    if (m_stencilLevels == 0 && !m_levelStencils.empty())
     {
-        m_quadLinelists.push_back(e[0]);
-        m_quadLinelists.push_back(e[1]);
+        m_stencils = m_levelStencils[0];
+        m_stencilLevels = 1;
     }
+    for (; m_stencilLevels < m_levelStencils.size(); ++m_stencilLevels)
+        m_stencils = compose_stencils(m_levelStencils[m_stencilLevels], m_stencils);
+    return m_stencils;
+}
 
-    m_edgeToFace.resize(m_edgeList.size(), glm::uvec2(UINT32_MAX, UINT32_MAX));
-    for (auto& [key, info] : edgeMap)
-        m_edgeToFace[info.idx] = glm::uvec2(info.f0, info.f1);
-
-    for (const auto& q : m_quadFaces)
-    {
-        m_quadIndices.push_back(q[0]); m_quadIndices.push_back(q[1]); m_quadIndices.push_back(q[2]);
-        m_quadIndices.push_back(q[2]); m_quadIndices.push_back(q[3]); m_quadIndices.push_back(q[0]);
-    }
+void GltfModel::reevaluateRefinedVertices()
+{
+    const StencilTable& table = refinedStencils();
+    if (table.row_count() == 0 || m_vertices.empty())
+        return;
 
-    const uint32_t Vp = static_cast<uint32_t>(m_quadVertices.size());
-    std::vector<std::vector<uint32_t>> vFaces(Vp);
-    std::vector<std::vector<uint32_t>> vEdges(Vp);
+    m_quadVertices.resize(table.row_count());
+    evaluate_stencils(table, &m_vertices[0].pos, sizeof(Vertex), &m_quadVertices[0].pos, sizeof(Vertex));
+}
 
-    for (uint32_t fid = 0; fid < m_quadFaces.size(); ++fid)
-    {
-        const glm::uvec4& q = m_quadFaces[fid];
-        for (int k = 0; k < 4; ++k)
-            vFaces[q[k]].push_back(fid);
+void GltfModel::evaluateLimitSurface(std::vector<glm::vec3>& positions, std::vector<glm::vec3>& normals)
+{
+    LUT_PROFILE_FUNCTION();
+    positions.resize(m_quadVertices.size());
+    normals.resize(m_quadVertices.size());
+    if (m_quadVertices.empty())
+        return;
+
+    evaluate_limit(m_mesh, m_sharpness,
+        TopologyCSR{ &m_edgeList, &m_edgeToFace, nullptr,
+            &m_vertexFaceCounts, &m_vertexFaceIndices,
+            &m_vertexEdgeCounts, &m_vertexEdgeIndices },
+        &m_quadVertices[0].pos, sizeof(Vertex),
+        positions.data(), sizeof(glm::vec3),
+        normals.data(), sizeof(glm::vec3));
+}
 
-        const uint32_t v[4] = { q[0], q[1], q[2], q[3] };
-        for (int e = 0; e < 4; ++e)
-        {
-            EdgeKey key(v[e], v[(e + 1) & 3]);
-            uint32_t eid = edgeIndexMap[key];
+void GltfModel::setQuadMesh(HalfEdgeMesh mesh)
+{
+    m_mesh = std::move(mesh);
 
-            vEdges[v[e]].push_back(eid);
-            vEdges[v[(e + 1) & 3]].push_back(eid);
-        }
-    }
+    build_topology_csr(m_mesh, TopologyCSR{
+        &m_edgeList, &m_edgeToFace, nullptr,
+        &m_vertexFaceCounts, &m_vertexFaceIndices,
+        &m_vertexEdgeCounts, &m_vertexEdgeIndices });
 
-    m_vertexFaceCounts.reserve(Vp);
-    m_vertexEdgeCounts.reserve(Vp);
-    m_vertexFaceIndices.reserve(Vp * 4);
-    m_vertexEdgeIndices.reserve(m_edgeList.size() * 2);
+    m_quadIndices = triangulate_faces(m_mesh);
+    m_quadLinelists = edge_line_list(m_mesh);
+}
 
-    for (uint32_t vid = 0; vid < Vp; ++vid)
+void GltfModel::inheritSharpness(const std::vector<uint32_t>& parentSharp)
+{
+    // Parent edge e splits into child edges 2e and 2e+1, which carry its crease;
+    // the edges from edge points to the face point (2E + h) are smooth.
+    m_sharpness.assign(m_mesh.edge_count(), 0);
+    for (size_t e = 0; e < parentSharp.size(); ++e)
     {
-        m_vertexFaceCounts.push_back(static_cast<uint32_t>(vFaces[vid].size()));
-        for (uint32_t fid : vFaces[vid]) m_vertexFaceIndices.push_back(fid);
-
-        m_vertexEdgeCounts.push_back(static_cast<uint32_t>(vEdges[vid].size()));
-        for (uint32_t eid : vEdges[vid]) m_vertexEdgeIndices.push_back(eid);
+        uint32_t s = parentSharp[e] ? parentSharp[e] - 1 : 0;
+        m_sharpness[2 * e + 0] = s;
+        m_sharpness[2 * e + 1] = s;
     }
 }
 
@@ -1071,9 +830,9 @@ void GltfModel::debugPrintEdgeToFace() {
 }
 
 void GltfModel::debugPrintQuadFaces() {
-    std::cout << "QuadFaces (" << m_quadFaces.size() << "):\n";
-    for (size_t i = 0; i < m_quadFaces.size(); ++i) {
-        const auto& q = m_quadFaces[i];
+    std::cout << "QuadFaces (" << m_mesh.face_count() << "):\n";
+    for (uint32_t i = 0; i < m_mesh.face_count(); ++i) {
+        const uint32_t* q = m_mesh.face_corners(i);
         std::cout << "  [" << i << "] " << q[0] << "," << q[1]
             << "," << q[2] << "," << q[3] << "\n";
     }
@@ -3,11 +3,20 @@
 #include <vector>
 #include <glm/glm.hpp>
 #include <vulkan/vulkan_core.h>
+#include "adaptive_refine.hpp"
+#include "halfedge_mesh.hpp"
+#include "limit_surface.hpp"
+#include "mesh_topology.hpp"
+#include "patch_table.hpp"
+#include "stencil_table.hpp"
+#include "view_adaptive.hpp"
 
 
 
 namespace labutils
 {
+	class GltfView;
+
 	struct Vertex {
 		glm::vec3 pos;
 		glm::vec3 normal;
@@ -34,13 +43,31 @@ namespace labutils
 	{
 	public:
 		int subTime = 0;
-		bool loadFromFile(const std::string& path);
+		// One primitive of the loaded scene, as a range of the base cage
+		// (m_vertices / m_indices).
+		struct MeshPart
+		{
+			uint32_t firstVertex = 0, vertexCount = 0;
+			uint32_t firstIndex = 0, indexCount = 0;
+		};
+
+		// Loads every triangle primitive of the default scene, with node
+		// transforms applied, into one cage. Each primitive is read and
+		// welded on its own (in parallel), so the parts stay separate
+		// components that subdivide independently but are refined and
+		// uploaded as one batch; with weldParts, coincident vertices of
+		// different parts are welded too and m_parts is a single range.
+		bool loadFromFile(const std::string& path, bool weldParts = false);
+		// The welded triangle mesh loadFromFile() ends with, e.g. from a
+		// TopologyCache.
+		void setBaseMesh(std::vector<Vertex> vertices, std::vector<uint32_t> indices, std::vector<MeshPart> parts);
+		const std::vector<MeshPart>& get_parts() const { return m_parts; }
 		const std::vector<Vertex>& get_vertices() const { return m_vertices; }
 		const std::vector<uint32_t>& get_indices() const { return m_indices; }
 
 		const std::vector<Vertex>& get_quad_vertices() const { return m_quadVertices; }
 		const std::vector<uint32_t>& get_quad_indices() const { return m_quadIndices; }
-		const std::vector<glm::uvec4>& get_quad_faces() const { return m_quadFaces;  }
+		const HalfEdgeMesh& get_quad_mesh() const { return m_mesh; }
 
 		const uint32_t& get_vertexCount() const { return m_vertices.size(); }
 		const uint32_t& get_quad_vertexCount() const { return m_quadVertices.size(); }
@@ -50,6 +77,57 @@ namespace labutils
 		void load_unit_gemometry();
 		void firstSubdivision();
 		void subdivideQuadOnce();
+		// Feature-adaptive alternative to subdivideQuadOnce(): the first call
+		// refines uniformly, later ones only around extraordinary vertices,
+		// creases and boundaries (see adaptive_refine.hpp). m_mesh and
+		// m_quadVertices then hold what is drawn, the patches tessellated to
+		// the current level plus the faces still being refined; there are no
+		// stencil tables for them, so refinedStencils() is empty. With
+		// patchesOnDevice set, the patches are left to the tessellation
+		// shaders and only the faces still being refined are exported.
+		void subdivideAdaptiveOnce();
+		bool patchesOnDevice = false;
+		// View-dependent alternative: the first level is refined further face
+		// by face until each face is below the screen error of error (see
+		// view_adaptive.hpp), from scratch on every call. m_quadVertices are
+		// on the limit surface already; there are no stencils or creases.
+		ViewDependentStats subdivideViewDependent(ScreenError const& error);
+		const PatchTable& get_patches() const { return m_patches; }
+		const AdaptiveLevel& get_adaptive_level() const { return m_adaptive; }
+		// Base cage (m_vertices) -> current level, built on first use after a
+		// level change. Valid until the topology or sharpness changes.
+		const StencilTable& refinedStencils();
+		// Recompute m_quadVertices from moved m_vertices without touching topology.
+		void reevaluateRefinedVertices();
+		// Limit positions and unit normals of the current level's vertices
+		// (see limit_surface.hpp); m_quadVertices stay the control points.
+		void evaluateLimitSurface(std::vector<glm::vec3>& positions, std::vector<glm::vec3>& normals);
+		// Everything that makes up the current level on the CPU: the quad
+		// mesh and its exported arrays, sharpness, the per-step stencils and
+		// the adaptive state. Saved when a level is left and put back when
+		// it is revisited, so stepping between levels recomputes nothing.
+		struct LevelState
+		{
+			std::vector<Vertex> quadVertices;
+			HalfEdgeMesh mesh;
+			std::vector<uint32_t> quadIndices;
+			std::vector<uint32_t> quadLinelists;
+			std::vector<glm::uvec2> edgeList;
+			std::vector<glm::uvec2> edgeToFace;
+			std::vector<uint32_t> sharpness;
+			std::vector<uint32_t> vertexFaceCounts;
+			std::vector<uint32_t> vertexFaceIndices;
+			std::vector<uint32_t> vertexEdgeCounts;
+			std::vector<uint32_t> vertexEdgeIndices;
+			std::vector<StencilTable> levelStencils;
+			AdaptiveLevel adaptive;
+			PatchTable patches;
+
+			// host memory held, by vector capacity
+			std::size_t byte_size() const;
+		};
+		LevelState saveLevel() const;
+		void restoreLevel(LevelState state);
 		void debugPrintVerticesAndIndices(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const std::string& name) const;
 		void debugPrintEdgeList();
 		void debugPrintEdgeToFace();
@@ -57,11 +135,13 @@ namespace labutils
 		// raw triangle data
 		std::vector<Vertex>   m_vertices;
 		std::vector<uint32_t> m_indices;
+		std::vector<MeshPart> m_parts;
 		std::vector<uint32_t> initial_sharpness;
 
-		// quad data
+		// quad data; m_mesh owns the connectivity of the current level, the
+		// remaining arrays are exported from it for drawing and the shaders
 		std::vector<Vertex> m_quadVertices;
-		std::vector<glm::uvec4> m_quadFaces;
+		HalfEdgeMesh m_mesh;
 		std::vector<uint32_t> m_quadIndices;
 		std::vector<uint32_t> m_quadLinelists;
 
@@ -74,14 +154,28 @@ namespace labutils
 		std::vector<uint32_t> m_vertexFaceIndices;
 		std::vector<uint32_t> m_vertexEdgeCounts;
 		std::vector<uint32_t> m_vertexEdgeIndices;
-		std::vector<glm::uvec4> m_faceEdgeIndices;
 
 
 	private:
-
-
-
-
+		std::vector<StencilTable> m_levelStencils;   // one per refinement step
+		StencilTable m_stencils;
+		size_t m_stencilLevels = 0;                  // steps folded into m_stencils
+
+		AdaptiveLevel m_adaptive;                    // level 0 until subdivideAdaptiveOnce()
+		PatchTable m_patches;
+
+		// loadFromFile() reads every primitive of the scene through a mapped
+		// GltfView; false if any of them cannot be read.
+		bool loadFromView(GltfView const& view, bool weldParts);
+
+		// Replaces m_mesh and re-exports the edge/vertex CSR arrays,
+		// m_quadIndices and m_quadLinelists from it.
+		void setQuadMesh(HalfEdgeMesh mesh);
+		// One Catmull-Clark step of parent (triangles or quads) into m_quadVertices/m_mesh.
+		void refineLevel(const HalfEdgeMesh& parent, const std::vector<Vertex>& parentVerts,
+			const std::vector<uint32_t>& parentSharp, const TopologyCSR& parentCsr);
+		// Child edge sharpness from the parent level (creases decay by 1).
+		void inheritSharpness(const std::vector<uint32_t>& parentSharp);
 
 	};
 
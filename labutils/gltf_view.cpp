@@ -0,0 +1,410 @@
+#include "gltf_view.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+using namespace labutils;
+
+namespace
+{
+    constexpr std::uint32_t kGlbMagic = 0x46546C67;     // "glTF"
+    constexpr std::uint32_t kChunkJson = 0x4E4F534A;    // "JSON"
+    constexpr std::uint32_t kChunkBin = 0x004E4942;     // "BIN\0"
+
+    std::uint32_t read_u32(const std::uint8_t* aData)
+    {
+        std::uint32_t value;
+        std::memcpy(&value, aData, sizeof(value));
+        return value;
+    }
+
+    std::size_t component_size(int aComponentType)
+    {
+        switch (aComponentType)
+        {
+        case 5120: case 5121: return 1;   // (unsigned) byte
+        case 5122: case 5123: return 2;   // (unsigned) short
+        case 5125: case 5126: return 4;   // unsigned int, float
+        default: return 0;
+        }
+    }
+
+    int component_count(const std::string& aType)
+    {
+        if (aType == "SCALAR") return 1;
+        if (aType == "VEC2") return 2;
+        if (aType == "VEC3") return 3;
+        if (aType == "VEC4") return 4;
+        if (aType == "MAT2") return 4;
+        if (aType == "MAT3") return 9;
+        if (aType == "MAT4") return 16;
+        return 0;
+    }
+
+    std::size_t size_value(const nlohmann::json& aObject, const char* aKey, std::size_t aDefault = 0)
+    {
+        const auto it = aObject.find(aKey);
+        return (it != aObject.end() && it->is_number_unsigned()) ? it->get<std::size_t>() : aDefault;
+    }
+
+    // type, count and element layout of an accessor; 0 if the type is unknown
+    std::size_t describe(const nlohmann::json& aAccessor, GltfView::Accessor& aOut)
+    {
+        aOut.componentType = aAccessor.value("componentType", 0);
+        aOut.components = component_count(aAccessor.value("type", std::string()));
+        aOut.normalized = aAccessor.value("normalized", false);
+        aOut.count = size_value(aAccessor, "count");
+        return component_size(aOut.componentType) * std::size_t(aOut.components);
+    }
+
+    // the payload of a "data:...;base64,..." URI; false on anything else
+    bool decode_data_uri(const std::string& aUri, std::vector<std::uint8_t>& aOut)
+    {
+        const std::size_t comma = aUri.find(',');
+        constexpr char kBase64[] = ";base64";
+        if (comma == std::string::npos || comma < sizeof(kBase64) - 1
+            || aUri.compare(comma - (sizeof(kBase64) - 1), sizeof(kBase64) - 1, kBase64) != 0)
+            return false;
+
+        auto sextet = [](char c) -> int {
+            if (c >= 'A' && c <= 'Z') return c - 'A';
+            if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+            if (c >= '0' && c <= '9') return c - '0' + 52;
+            if (c == '+' || c == '-') return 62;
+            if (c == '/' || c == '_') return 63;
+            return -1;
+        };
+
+        aOut.clear();
+        aOut.reserve((aUri.size() - comma) / 4 * 3);
+        std::uint32_t bits = 0;
+        int pending = 0;
+        for (std::size_t i = comma + 1; i < aUri.size() && aUri[i] != '='; ++i)
+        {
+            const int v = sextet(aUri[i]);
+            if (v < 0)
+                return false;
+            bits = (bits << 6) | std::uint32_t(v);
+            pending += 6;
+            if (pending >= 8)
+            {
+                pending -= 8;
+                aOut.push_back(std::uint8_t(bits >> pending));
+            }
+        }
+        return true;
+    }
+
+    // relative URIs may be percent-encoded ("my%20model.bin")
+    std::string decode_uri_path(const std::string& aUri)
+    {
+        auto hex = [](char c) -> int {
+            if (c >= '0' && c <= '9') return c - '0';
+            if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+            if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+            return -1;
+        };
+
+        std::string out;
+        out.reserve(aUri.size());
+        for (std::size_t i = 0; i < aUri.size(); ++i)
+        {
+            if (aUri[i] == '%' && i + 2 < aUri.size() && hex(aUri[i + 1]) >= 0 && hex(aUri[i + 2]) >= 0)
+            {
+                out.push_back(char(hex(aUri[i + 1]) * 16 + hex(aUri[i + 2])));
+                i += 2;
+            }
+            else
+                out.push_back(aUri[i]);
+        }
+        return out;
+    }
+}
+
+bool GltfView::open(const std::string& aPath)
+{
+    mJson = nlohmann::json();
+    mFiles.clear();
+    mBuffers.clear();
+    mDecoded.clear();
+    mExpanded.clear();
+
+    MappedFile file;
+    if (!file.open(aPath) || file.size() < 4)
+    {
+        std::cerr << "[gltf] cannot read " << aPath << "\n";
+        return false;
+    }
+
+    // .glb: 12 byte header, a JSON chunk, then optionally the BIN chunk that
+    // stands in for buffer 0
+    Span glbBin;
+    const std::uint8_t* jsonBegin = file.data();
+    const std::uint8_t* jsonEnd = file.data() + file.size();
+    if (read_u32(file.data()) == kGlbMagic)
+    {
+        if (file.size() < 20 || read_u32(file.data() + 12 + 4) != kChunkJson)
+        {
+            std::cerr << "[gltf] " << aPath << ": malformed .glb header\n";
+            return false;
+        }
+        const std::size_t total = std::min<std::size_t>(read_u32(file.data() + 8), file.size());
+        const std::size_t jsonLength = read_u32(file.data() + 12);
+        if (20 + jsonLength > total)
+        {
+            std::cerr << "[gltf] " << aPath << ": JSON chunk runs past the file\n";
+            return false;
+        }
+        jsonBegin = file.data() + 20;
+        jsonEnd = jsonBegin + jsonLength;
+
+        const std::size_t binAt = (20 + jsonLength + 3) & ~std::size_t(3);
+        if (binAt + 8 <= total && read_u32(file.data() + binAt + 4) == kChunkBin)
+        {
+            glbBin.data = file.data() + binAt + 8;
+            glbBin.size = std::min<std::size_t>(read_u32(file.data() + binAt), total - binAt - 8);
+        }
+    }
+
+    mJson = nlohmann::json::parse(jsonBegin, jsonEnd, nullptr, false);
+    if (mJson.is_discarded() || !mJson.is_object())
+    {
+        std::cerr << "[gltf] " << aPath << ": invalid JSON\n";
+        return false;
+    }
+
+    const std::size_t slash = aPath.find_last_of("/\\");
+    const std::string dir = slash == std::string::npos ? std::string() : aPath.substr(0, slash + 1);
+
+    const auto buffers = mJson.find("buffers");
+    if (buffers != mJson.end() && buffers->is_array())
+    {
+        for (const auto& buffer : *buffers)
+        {
+            const std::size_t length = size_value(buffer, "byteLength");
+            const auto uri = buffer.find("uri");
+            if (uri == buffer.end())
+            {
+                if (!glbBin.data || glbBin.size < length)
+                {
+                    std::cerr << "[gltf] " << aPath << ": buffer without uri and no matching BIN chunk\n";
+                    return false;
+                }
+                mBuffers.push_back(Span{ glbBin.data, length });
+                continue;
+            }
+
+            const std::string name = uri->is_string() ? uri->get<std::string>() : std::string();
+            if (name.rfind("data:", 0) == 0)
+            {
+                std::vector<std::uint8_t> bytes;
+                if (!decode_data_uri(name, bytes) || bytes.size() < length)
+                {
+                    std::cerr << "[gltf] " << aPath << ": cannot decode an embedded buffer\n";
+                    return false;
+                }
+                mBuffers.push_back(Span{ bytes.data(), length });
+                mDecoded.emplace_back(std::move(bytes));
+                continue;
+            }
+
+            const std::string path = dir + decode_uri_path(name);
+            MappedFile bin;
+            if (name.empty() || !bin.open(path) || bin.size() < length)
+            {
+                std::cerr << "[gltf] cannot map " << path << "\n";
+                return false;
+            }
+            mBuffers.push_back(Span{ bin.data(), length });
+            mFiles.emplace_back(std::move(bin));
+        }
+    }
+
+    // accessors whose elements are not all in a buffer view, once, so that
+    // accessor() stays read-only and can be called from several threads
+    const auto accessors = mJson.find("accessors");
+    if (accessors != mJson.end() && accessors->is_array())
+    {
+        for (std::size_t i = 0; i < accessors->size(); ++i)
+        {
+            const auto& acc = (*accessors)[i];
+            if (!acc.contains("sparse") && acc.contains("bufferView"))
+                continue;
+
+            std::vector<std::uint8_t> bytes;
+            if (!expand_accessor(acc, bytes))
+            {
+                std::cerr << "[gltf] " << aPath << ": invalid sparse accessor " << i << "\n";
+                return false;
+            }
+            mExpanded.emplace(i, std::move(bytes));
+        }
+    }
+
+    // keeps the .glb's BIN chunk (and JSON, already parsed) mapped
+    mFiles.emplace_back(std::move(file));
+    return true;
+}
+
+bool GltfView::accessor(int aIndex, Accessor& aOut) const
+{
+    const auto accessors = mJson.find("accessors");
+    if (aIndex < 0 || accessors == mJson.end() || !accessors->is_array() || std::size_t(aIndex) >= accessors->size())
+        return false;
+    const auto& acc = (*accessors)[std::size_t(aIndex)];
+
+    const auto expanded = mExpanded.find(std::size_t(aIndex));
+    if (expanded == mExpanded.end())
+        return view_accessor(acc, aOut);
+
+    const std::size_t elementSize = describe(acc, aOut);
+    aOut.stride = elementSize;
+    aOut.data = expanded->second.data();
+    return elementSize != 0;
+}
+
+bool GltfView::view_bytes(std::size_t aView, std::size_t aOffset, std::size_t aLength, Span& aOut) const
+{
+    const auto views = mJson.find("bufferViews");
+    if (views == mJson.end() || !views->is_array() || aView >= views->size())
+        return false;
+    const auto& view = (*views)[aView];
+
+    const std::size_t bufferIndex = size_value(view, "buffer", ~std::size_t(0));
+    if (bufferIndex >= mBuffers.size())
+        return false;
+    const Span& buffer = mBuffers[bufferIndex];
+
+    const std::size_t viewOffset = size_value(view, "byteOffset");
+    const std::size_t viewLength = size_value(view, "byteLength");
+    if (viewOffset + viewLength > buffer.size || aOffset + aLength > viewLength)
+        return false;
+
+    aOut.data = buffer.data + viewOffset + aOffset;
+    aOut.size = aLength;
+    return true;
+}
+
+bool GltfView::view_accessor(const nlohmann::json& aAccessor, Accessor& aOut) const
+{
+    const std::size_t elementSize = describe(aAccessor, aOut);
+    if (elementSize == 0)
+        return false;
+
+    const std::size_t viewIndex = size_value(aAccessor, "bufferView", ~std::size_t(0));
+    const auto views = mJson.find("bufferViews");
+    if (views == mJson.end() || !views->is_array() || viewIndex >= views->size())
+        return false;
+    aOut.stride = size_value((*views)[viewIndex], "byteStride", elementSize);
+
+    const std::size_t span = aOut.count > 0 ? (aOut.count - 1) * aOut.stride + elementSize : 0;
+    Span bytes;
+    if (!view_bytes(viewIndex, size_value(aAccessor, "byteOffset"), span, bytes))
+        return false;
+
+    aOut.data = bytes.data;
+    return true;
+}
+
+bool GltfView::expand_accessor(const nlohmann::json& aAccessor, std::vector<std::uint8_t>& aOut) const
+{
+    Accessor acc;
+    const std::size_t elementSize = describe(aAccessor, acc);
+    if (elementSize == 0)
+        return false;
+
+    // the base values, or zeros without a buffer view
+    aOut.assign(acc.count * elementSize, 0);
+    if (aAccessor.contains("bufferView"))
+    {
+        Accessor base;
+        if (!view_accessor(aAccessor, base))
+            return false;
+        for (std::size_t i = 0; i < acc.count; ++i)
+            std::memcpy(aOut.data() + i * elementSize, base.data + i * base.stride, elementSize);
+    }
+
+    const auto sparse = aAccessor.find("sparse");
+    if (sparse == aAccessor.end())
+        return true;
+    const auto indices = sparse->find("indices");
+    const auto values = sparse->find("values");
+    if (indices == sparse->end() || values == sparse->end())
+        return false;
+
+    // indices and values are tightly packed
+    const std::size_t count = size_value(*sparse, "count");
+    const int indexType = indices->value("componentType", 0);
+    const std::size_t indexSize = component_size(indexType);
+    if (indexType != kUnsignedByte && indexType != kUnsignedShort && indexType != kUnsignedInt)
+        return false;
+
+    Span indexBytes, valueBytes;
+    if (!view_bytes(size_value(*indices, "bufferView", ~std::size_t(0)), size_value(*indices, "byteOffset"), count * indexSize, indexBytes)
+        || !view_bytes(size_value(*values, "bufferView", ~std::size_t(0)), size_value(*values, "byteOffset"), count * elementSize, valueBytes))
+        return false;
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        std::uint32_t index = 0;
+        if (indexSize == 1)
+            index = indexBytes.data[i];
+        else if (indexSize == 2)
+        {
+            std::uint16_t v;
+            std::memcpy(&v, indexBytes.data + 2 * i, sizeof(v));
+            index = v;
+        }
+        else
+            index = read_u32(indexBytes.data + 4 * i);
+
+        if (index >= acc.count)
+            return false;
+        std::memcpy(aOut.data() + std::size_t(index) * elementSize, valueBytes.data + i * elementSize, elementSize);
+    }
+    return true;
+}
+
+bool labutils::read_floats(const GltfView::Accessor& aAccessor, float* aOut, std::size_t aOutStride)
+{
+    if (aAccessor.componentType != GltfView::kFloat)
+        return false;
+
+    const std::size_t bytes = std::size_t(aAccessor.components) * sizeof(float);
+    auto* out = reinterpret_cast<std::uint8_t*>(aOut);
+    for (std::size_t i = 0; i < aAccessor.count; ++i)
+        std::memcpy(out + i * aOutStride, aAccessor.data + i * aAccessor.stride, bytes);
+    return true;
+}
+
+bool labutils::read_indices(const GltfView::Accessor& aAccessor, std::uint32_t* aOut)
+{
+    if (aAccessor.components != 1)
+        return false;
+
+    const std::uint8_t* src = aAccessor.data;
+    switch (aAccessor.componentType)
+    {
+    case GltfView::kUnsignedInt:
+        if (aAccessor.stride == sizeof(std::uint32_t))
+            std::memcpy(aOut, src, aAccessor.count * sizeof(std::uint32_t));
+        else
+            for (std::size_t i = 0; i < aAccessor.count; ++i)
+                std::memcpy(aOut + i, src + i * aAccessor.stride, sizeof(std::uint32_t));
+        return true;
+    case GltfView::kUnsignedShort:
+        for (std::size_t i = 0; i < aAccessor.count; ++i)
+        {
+            std::uint16_t v;
+            std::memcpy(&v, src + i * aAccessor.stride, sizeof(v));
+            aOut[i] = v;
+        }
+        return true;
+    case GltfView::kUnsignedByte:
+        for (std::size_t i = 0; i < aAccessor.count; ++i)
+            aOut[i] = src[i * aAccessor.stride];
+        return true;
+    default:
+        return false;
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <json.hpp>
+#include "mapped_file.hpp"
+
+
+
+namespace labutils
+{
+	// A glTF 2.0 asset read in place: only the JSON is parsed, the binary
+	// buffers (the .bin files of a .gltf, or the BIN chunk of a .glb) are
+	// memory-mapped, and accessors point straight into the mapping, so
+	// attribute data is copied once, from the page cache to wherever it is
+	// consumed.
+	//
+	// Buffers given as base64 data: URIs are decoded, and sparse accessors
+	// (or ones without a buffer view, all zeros) are expanded, once by open(),
+	// into storage owned by the view; accessor() then points into that.
+	class GltfView
+	{
+		public:
+			// One accessor, resolved through its buffer view and buffer.
+			struct Accessor
+			{
+				std::uint8_t const* data = nullptr;   // first element
+				std::size_t count = 0;
+				std::size_t stride = 0;               // bytes from one element to the next
+				int componentType = 0;                // TINYGLTF_COMPONENT_TYPE_*, e.g. 5126 float
+				int components = 0;                   // 1 for SCALAR up to 16 for MAT4
+				bool normalized = false;
+			};
+
+			static constexpr int kUnsignedByte = 5121;
+			static constexpr int kUnsignedShort = 5123;
+			static constexpr int kUnsignedInt = 5125;
+			static constexpr int kFloat = 5126;
+
+			// false, with the reason on std::cerr, if the file cannot be read
+			// or uses something not handled here
+			bool open( std::string const& aPath );
+
+			nlohmann::json const& json() const { return mJson; }
+
+			// false if aIndex is out of range or its elements run past the
+			// buffer view
+			bool accessor( int aIndex, Accessor& aOut ) const;
+
+		private:
+			struct Span
+			{
+				std::uint8_t const* data = nullptr;
+				std::size_t size = 0;
+			};
+
+			// aLength bytes from aOffset into buffer view aView
+			bool view_bytes( std::size_t aView, std::size_t aOffset, std::size_t aLength, Span& aOut ) const;
+			// aAccessor's elements where its buffer view holds them
+			bool view_accessor( nlohmann::json const& aAccessor, Accessor& aOut ) const;
+			// aAccessor with its sparse values applied, tightly packed
+			bool expand_accessor( nlohmann::json const& aAccessor, std::vector<std::uint8_t>& aOut ) const;
+
+			nlohmann::json mJson;
+			std::vector<MappedFile> mFiles;
+			std::vector<Span> mBuffers;
+			std::vector<std::vector<std::uint8_t>> mDecoded;                   // data: URI buffers
+			std::unordered_map<std::size_t, std::vector<std::uint8_t>> mExpanded; // by accessor index
+	};
+
+	// Copies aAccessor's elements (float components only) into aOut, one
+	// element every aOutStride bytes.
+	bool read_floats( GltfView::Accessor const& aAccessor, float* aOut, std::size_t aOutStride );
+	// Widens unsigned byte / short / int indices into aOut (aAccessor.count entries).
+	bool read_indices( GltfView::Accessor const& aAccessor, std::uint32_t* aOut );
+}
@@ -0,0 +1,177 @@
+#include "gpu_profiler.hpp"
+#include "cpu_profiler.hpp"
+#include "error.hpp"
+#include "to_string.hpp"
+#include <algorithm>
+
+using namespace labutils;
+
+namespace
+{
+    constexpr std::uint32_t kDropped = ~std::uint32_t(0);
+}
+
+GpuProfiler::GpuProfiler(VulkanContext const& aContext, std::uint32_t aSlots, std::uint32_t aMaxPassesPerSlot)
+    : mDevice(aContext.device)
+    , mMaxPasses(aMaxPassesPerSlot)
+    , mSlots(aSlots)
+{
+    std::uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(aContext.physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(aContext.physicalDevice, &familyCount, families.data());
+
+    std::uint32_t const validBits = aContext.graphicsFamilyIndex < familyCount ? families[aContext.graphicsFamilyIndex].timestampValidBits : 0;
+    if (validBits == 0 || aSlots == 0 || aMaxPassesPerSlot == 0)
+        return;
+
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(aContext.physicalDevice, &props);
+    mNsPerTick = double(props.limits.timestampPeriod);
+    mTickMask = validBits >= 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << validBits) - 1;
+
+    VkQueryPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = 2 * aSlots * aMaxPassesPerSlot;
+
+    VkQueryPool pool = VK_NULL_HANDLE;
+    if (auto const res = vkCreateQueryPool(mDevice, &poolInfo, nullptr, &pool); VK_SUCCESS != res)
+    {
+        throw Error("Unable to create timestamp query pool\n"
+            "vkCreateQueryPool() returned %s", to_string(res).c_str());
+    }
+    mPool = QueryPool(mDevice, pool);
+}
+
+void GpuProfiler::reset(VkCommandBuffer aCmdBuff, std::uint32_t aSlot)
+{
+    if (!enabled())
+        return;
+
+    vkCmdResetQueryPool(aCmdBuff, mPool.handle, 2 * aSlot * mMaxPasses, 2 * mMaxPasses);
+
+    mSlots[aSlot].names.clear();
+    mSlots[aSlot].recordedNs = profile::now_ns();
+    mSlots[aSlot].pending = true;
+    mRecording = aSlot;
+    mOpen.clear();
+}
+
+void GpuProfiler::begin(VkCommandBuffer aCmdBuff, char const* aName)
+{
+    if (!enabled())
+        return;
+
+    Slot& slot = mSlots[mRecording];
+    if (slot.names.size() >= mMaxPasses)
+    {
+        mOpen.push_back(kDropped);
+        return;
+    }
+
+    std::uint32_t const query = 2 * (mRecording * mMaxPasses + std::uint32_t(slot.names.size()));
+    slot.names.push_back(aName);
+    vkCmdWriteTimestamp(aCmdBuff, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, mPool.handle, query);
+    mOpen.push_back(query);
+}
+
+void GpuProfiler::end(VkCommandBuffer aCmdBuff)
+{
+    if (!enabled() || mOpen.empty())
+        return;
+
+    std::uint32_t const query = mOpen.back();
+    mOpen.pop_back();
+    if (query != kDropped)
+        vkCmdWriteTimestamp(aCmdBuff, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mPool.handle, query + 1);
+}
+
+bool GpuProfiler::collect(std::uint32_t aSlot, std::vector<Sample>* aSamples)
+{
+    if (!enabled() || !mSlots[aSlot].pending)
+        return false;
+
+    Slot& slot = mSlots[aSlot];
+    std::uint32_t const count = std::uint32_t(slot.names.size());
+    if (count == 0)
+    {
+        slot.pending = false;
+        return false;
+    }
+
+    std::vector<std::uint64_t> ticks(2 * std::size_t(count));
+    auto const res = vkGetQueryPoolResults(mDevice, mPool.handle, 2 * aSlot * mMaxPasses, 2 * count,
+        ticks.size() * sizeof(std::uint64_t), ticks.data(), sizeof(std::uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (VK_NOT_READY == res)
+        return false;
+    if (VK_SUCCESS != res)
+    {
+        throw Error("Unable to read timestamp queries\n"
+            "vkGetQueryPoolResults() returned %s", to_string(res).c_str());
+    }
+
+    for (std::uint32_t i = 0; i < count; ++i)
+    {
+        double const ms = double((ticks[2 * i + 1] - ticks[2 * i]) & mTickMask) * mNsPerTick * 1e-6;
+        double const startMs = double((ticks[2 * i] - ticks[0]) & mTickMask) * mNsPerTick * 1e-6;
+
+        Average& avg = find_average(slot.names[i]);
+        avg.samples[avg.count % kWindow] = ms;
+        avg.last = ms;
+        ++avg.count;
+
+        if (aSamples)
+            aSamples->push_back(Sample{ slot.names[i], ms, startMs });
+
+        profile::record("GPU", slot.names[i], slot.recordedNs + std::int64_t(startMs * 1e6), std::int64_t(ms * 1e6));
+    }
+
+    slot.pending = false;
+    return true;
+}
+
+std::vector<GpuProfiler::PassTime> GpuProfiler::passes() const
+{
+    std::vector<PassTime> ret;
+    ret.reserve(mAverages.size());
+    for (Average const& avg : mAverages)
+    {
+        PassTime pass;
+        pass.name = avg.name;
+        pass.lastMs = avg.last;
+        pass.samples = std::min(avg.count, kWindow);
+        for (std::uint32_t i = 0; i < pass.samples; ++i)
+            pass.averageMs += avg.samples[i];
+        pass.averageMs /= double(pass.samples);
+        ret.push_back(std::move(pass));
+    }
+    return ret;
+}
+
+void GpuProfiler::print(std::FILE* aOut) const
+{
+    if (!enabled())
+    {
+        std::fprintf(aOut, "GPU timestamps are not supported by the graphics queue\n");
+        return;
+    }
+
+    std::fprintf(aOut, "------- GPU Passes (ms) -------\n");
+    std::fprintf(aOut, "%-20s %10s %10s\n", "", "last", "average");
+    for (PassTime const& pass : passes())
+        std::fprintf(aOut, "%-20s %10.3f %10.3f (%u)\n", pass.name.c_str(), pass.lastMs, pass.averageMs, pass.samples);
+}
+
+GpuProfiler::Average& GpuProfiler::find_average(char const* aName)
+{
+    for (Average& avg : mAverages)
+    {
+        if (avg.name == aName)
+            return avg;
+    }
+
+    mAverages.emplace_back();
+    mAverages.back().name = aName;
+    return mAverages.back();
+}
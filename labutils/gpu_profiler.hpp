@@ -0,0 +1,124 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <volk/volk.h>
+#include "vulkan_context.hpp"
+#include "vkobject.hpp"
+
+
+
+namespace labutils
+{
+	// Timestamps around the passes recorded into a command buffer, read back
+	// once the GPU is done with them instead of waiting for them.
+	//
+	// The queries are split into slots, one per command buffer that can be
+	// in flight. reset() starts recording into a slot (outside a render
+	// pass), begin()/end() bracket a pass, and collect() reads the slot back
+	// after the fence of its submission was waited for; until then it
+	// returns false and the slot is left as it is. Each collected pass adds
+	// a sample to the rolling average of its name, and a zone on the "GPU"
+	// track of the CPU trace (see cpu_profiler.hpp). GPU and CPU clocks are
+	// not calibrated against each other, so the zones are placed from the
+	// time the slot was reset: they line up with the CPU work that recorded
+	// them, ahead of the GPU by the submission latency.
+	class GpuProfiler
+	{
+		public:
+			static constexpr std::uint32_t kWindow = 64;    // samples per average
+
+			struct PassTime
+			{
+				std::string name;
+				double lastMs = 0.0;
+				double averageMs = 0.0;     // over the last `samples`
+				std::uint32_t samples = 0;
+			};
+
+			struct Sample
+			{
+				char const* name;
+				double ms;
+				double startMs;     // after the start of the slot's first pass
+			};
+
+			GpuProfiler() noexcept = default;
+
+			// Disabled, with every call a no-op, when the graphics queue
+			// does not support timestamps.
+			GpuProfiler( VulkanContext const&, std::uint32_t aSlots, std::uint32_t aMaxPassesPerSlot = 32 );
+
+			bool enabled() const noexcept { return VK_NULL_HANDLE != mPool.handle; }
+
+			void reset( VkCommandBuffer, std::uint32_t aSlot );
+
+			// aName is kept until collect(), so it should be a literal.
+			// Passes past aMaxPassesPerSlot are not timed.
+			void begin( VkCommandBuffer, char const* aName );
+			void end( VkCommandBuffer );
+
+			// With aSamples, the slot's passes are appended to it in the order
+			// they were recorded.
+			bool collect( std::uint32_t aSlot, std::vector<Sample>* aSamples = nullptr );
+
+			std::vector<PassTime> passes() const;
+			void print( std::FILE* ) const;
+
+		private:
+			struct Slot
+			{
+				std::vector<char const*> names;     // one per begin(), two queries each
+				std::int64_t recordedNs = 0;        // CPU clock at reset()
+				bool pending = false;
+			};
+
+			struct Average
+			{
+				std::string name;
+				double samples[kWindow] = {};
+				std::uint32_t count = 0;            // samples taken, may exceed kWindow
+				double last = 0.0;
+			};
+
+			Average& find_average( char const* aName );
+
+		private:
+			QueryPool mPool;
+			VkDevice mDevice = VK_NULL_HANDLE;
+			double mNsPerTick = 1.0;
+			std::uint64_t mTickMask = ~std::uint64_t(0);
+			std::uint32_t mMaxPasses = 0;
+
+			std::vector<Slot> mSlots;
+			std::uint32_t mRecording = 0;
+			std::vector<std::uint32_t> mOpen;       // begin() without end(), as query indices in the slot
+			std::vector<Average> mAverages;
+	};
+
+	// begin() when made and end() when destroyed; nothing without a profiler.
+	class GpuScope
+	{
+		public:
+			GpuScope( GpuProfiler* aProfiler, VkCommandBuffer aCmdBuff, char const* aName )
+				: mProfiler( aProfiler ), mCmdBuff( aCmdBuff )
+			{
+				if( mProfiler )
+					mProfiler->begin( mCmdBuff, aName );
+			}
+			~GpuScope()
+			{
+				if( mProfiler )
+					mProfiler->end( mCmdBuff );
+			}
+
+			GpuScope( GpuScope const& ) = delete;
+			GpuScope& operator= (GpuScope const&) = delete;
+
+		private:
+			GpuProfiler* mProfiler;
+			VkCommandBuffer mCmdBuff;
+	};
+}
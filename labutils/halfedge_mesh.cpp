@@ -0,0 +1,202 @@
+#include "halfedge_mesh.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <cassert>
+
+using namespace labutils;
+
+namespace
+{
+    // one outgoing half-edge per vertex, preferring boundary ones so that a
+    // walk around a boundary vertex can start at the boundary
+    void assign_vertex_halfedges(HalfEdgeMesh& aMesh)
+    {
+        aMesh.vertexHalfEdge.assign(aMesh.vertexCount, HalfEdgeMesh::kInvalid);
+        for (std::uint32_t h = 0; h < aMesh.halfedge_count(); ++h)
+        {
+            std::uint32_t& out = aMesh.vertexHalfEdge[aMesh.origin(h)];
+            if (out == HalfEdgeMesh::kInvalid || (aMesh.is_boundary(h) && !aMesh.is_boundary(out)))
+                out = h;
+        }
+    }
+}
+
+HalfEdgeMesh labutils::make_halfedge_mesh(
+    std::vector<std::uint32_t> aCorners,
+    std::uint32_t aCornersPerFace,
+    std::uint32_t aVertexCount)
+{
+    assert(aCornersPerFace >= 3 && aCorners.size() % aCornersPerFace == 0);
+
+    HalfEdgeMesh mesh;
+    mesh.cornersPerFace = aCornersPerFace;
+    mesh.vertexCount = aVertexCount;
+    mesh.heVertex = std::move(aCorners);
+
+    const std::uint32_t H = mesh.halfedge_count();
+    constexpr std::uint32_t kInvalid = HalfEdgeMesh::kInvalid;
+
+    // ---- bucket half-edges by their lower endpoint (stable counting sort) ----
+    std::vector<std::uint32_t> loStart(std::size_t(aVertexCount) + 1, 0);
+    for (std::uint32_t h = 0; h < H; ++h)
+        ++loStart[std::min(mesh.origin(h), mesh.dest(h)) + 1];
+    for (std::uint32_t v = 0; v < aVertexCount; ++v)
+        loStart[v + 1] += loStart[v];
+
+    std::vector<std::uint32_t> byLo(H);
+    {
+        std::vector<std::uint32_t> cursor(loStart.begin(), loStart.end() - 1);
+        for (std::uint32_t h = 0; h < H; ++h)
+            byLo[cursor[std::min(mesh.origin(h), mesh.dest(h))]++] = h;
+    }
+
+    // ---- twins and edge ids in order of first appearance ----
+    mesh.heTwin.assign(H, kInvalid);
+    mesh.heEdge.assign(H, kInvalid);
+    mesh.edgeHalfEdge.clear();
+    mesh.edgeHalfEdge.reserve(H / 2 + 1);
+
+    for (std::uint32_t h = 0; h < H; ++h)
+    {
+        if (mesh.heEdge[h] != kInvalid) continue;
+
+        const std::uint32_t a = mesh.origin(h), b = mesh.dest(h);
+        const std::uint32_t lo = std::min(a, b), hi = std::max(a, b);
+        const std::uint32_t eid = mesh.edge_count();
+
+        mesh.heEdge[h] = eid;
+        mesh.edgeHalfEdge.push_back(h);
+
+        // the bucket is sorted by half-edge id, so later half-edges of the same
+        // edge are met in face order
+        for (std::uint32_t i = loStart[lo]; i < loStart[lo + 1]; ++i)
+        {
+            const std::uint32_t o = byLo[i];
+            if (o <= h || std::max(mesh.origin(o), mesh.dest(o)) != hi) continue;
+
+            mesh.heEdge[o] = eid;
+            if (mesh.heTwin[h] == kInvalid)
+            {
+                mesh.heTwin[h] = o;
+                mesh.heTwin[o] = h;
+            }
+        }
+    }
+
+    assign_vertex_halfedges(mesh);
+
+    return mesh;
+}
+
+HalfEdgeMesh labutils::refine_halfedge_mesh(const HalfEdgeMesh& aParent)
+{
+    constexpr std::uint32_t kInvalid = HalfEdgeMesh::kInvalid;
+
+    const std::uint32_t V = aParent.vertexCount;
+    const std::uint32_t E = aParent.edge_count();
+    const std::uint32_t H = aParent.halfedge_count();
+
+    HalfEdgeMesh child;
+    child.cornersPerFace = 4;
+    child.vertexCount = V + E + aParent.face_count();
+    child.heVertex.resize(std::size_t(H) * 4);
+    child.heTwin.resize(std::size_t(H) * 4);
+    child.heEdge.resize(std::size_t(H) * 4);
+
+    // which half of parent edge e touches vertex v
+    auto half_at = [&](std::uint32_t e, std::uint32_t v) {
+        return 2 * e + (aParent.origin(aParent.edgeHalfEdge[e]) == v ? 0u : 1u);
+    };
+
+    parallel_for(H, [&](std::size_t b, std::size_t end) {
+        for (std::uint32_t h = std::uint32_t(b); h < end; ++h)
+        {
+            const std::uint32_t p = aParent.prev(h);
+            const std::uint32_t v = aParent.origin(h);
+            const std::uint32_t e = aParent.edge(h), ePrev = aParent.edge(p);
+            const std::uint32_t c = 4 * h;
+
+            child.heVertex[c + 0] = v;
+            child.heVertex[c + 1] = V + e;
+            child.heVertex[c + 2] = V + E + aParent.face(h);
+            child.heVertex[c + 3] = V + ePrev;
+
+            child.heEdge[c + 0] = half_at(e, v);
+            child.heEdge[c + 1] = 2 * E + h;
+            child.heEdge[c + 2] = 2 * E + p;
+            child.heEdge[c + 3] = half_at(ePrev, v);
+
+            // outer halves pair up with the quads across the parent edges,
+            // inner edges with the neighbouring quads of the same face. The
+            // half at v lives in the quad of whichever corner of the twin face
+            // sits on v (normally its dest, unless the faces disagree on
+            // orientation).
+            auto outer_at = [&](std::uint32_t t) {
+                if (t == kInvalid) return kInvalid;
+                return (aParent.origin(t) == v) ? 4 * t + 0 : 4 * aParent.next(t) + 3;
+            };
+            child.heTwin[c + 0] = outer_at(aParent.twin(h));
+            child.heTwin[c + 1] = 4 * aParent.next(h) + 2;
+            child.heTwin[c + 2] = 4 * p + 1;
+            child.heTwin[c + 3] = outer_at(aParent.twin(p));
+        }
+    });
+
+    // First (lowest) half-edge of every child edge. Children of a parent face
+    // come before those of any later face, so for the halves of e it is in the
+    // face of e's first half-edge g: quad g holds the half at origin(g) (2e,
+    // see half_at), quad next(g) the other one. Inner edge 2E + h lies between
+    // quads h and next(h).
+    child.edgeHalfEdge.resize(std::size_t(E) * 2 + H);
+    parallel_for(E, [&](std::size_t b, std::size_t end) {
+        for (std::uint32_t e = std::uint32_t(b); e < end; ++e)
+        {
+            const std::uint32_t g = aParent.edgeHalfEdge[e];
+            child.edgeHalfEdge[2 * e + 0] = 4 * g + 0;
+            child.edgeHalfEdge[2 * e + 1] = 4 * aParent.next(g) + 3;
+        }
+    });
+    parallel_for(H, [&](std::size_t b, std::size_t end) {
+        for (std::uint32_t h = std::uint32_t(b); h < end; ++h)
+            child.edgeHalfEdge[2 * E + h] = std::min(4 * h + 1, 4 * aParent.next(h) + 2);
+    });
+
+    assign_vertex_halfedges(child);
+    return child;
+}
+
+std::vector<std::uint32_t> labutils::triangulate_faces(const HalfEdgeMesh& aMesh)
+{
+    const std::uint32_t N = aMesh.cornersPerFace;
+    const std::uint32_t F = aMesh.face_count();
+
+    std::vector<std::uint32_t> out(std::size_t(F) * (N - 2) * 3);
+    parallel_for(F, [&](std::size_t b, std::size_t end) {
+        std::uint32_t* dst = out.data() + b * (N - 2) * 3;
+        for (std::uint32_t f = std::uint32_t(b); f < end; ++f)
+        {
+            const std::uint32_t* c = aMesh.face_corners(f);
+            for (std::uint32_t k = 1; k + 1 < N; ++k)
+            {
+                // (0,1,2), (2,3,0), ... keeps the original quad split
+                if (k == 1) { *dst++ = c[0]; *dst++ = c[1]; *dst++ = c[2]; }
+                else { *dst++ = c[k]; *dst++ = c[k + 1]; *dst++ = c[0]; }
+            }
+        }
+    });
+    return out;
+}
+
+std::vector<std::uint32_t> labutils::edge_line_list(const HalfEdgeMesh& aMesh)
+{
+    std::vector<std::uint32_t> out(std::size_t(aMesh.edge_count()) * 2);
+    parallel_for(aMesh.edge_count(), [&](std::size_t b, std::size_t end) {
+        for (std::uint32_t e = std::uint32_t(b); e < end; ++e)
+        {
+            const std::uint32_t h = aMesh.edgeHalfEdge[e];
+            out[2 * e + 0] = std::min(aMesh.origin(h), aMesh.dest(h));
+            out[2 * e + 1] = std::max(aMesh.origin(h), aMesh.dest(h));
+        }
+    });
+    return out;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+
+namespace labutils
+{
+	// Index-based half-edge mesh for meshes whose faces all have the same
+	// number of corners (3 for the loaded triangles, 4 for every refined level).
+	//
+	// Half-edges are implicit: half-edge h = f * N + k runs from corner k of
+	// face f to corner k+1, so next/prev/face are pure arithmetic and only
+	// origin, twin and edge need storage. Everything is kept as flat SoA arrays
+	// that can be uploaded to the GPU as they are; heVertex doubles as the
+	// face -> corner list and heEdge as the face -> edge list.
+	//
+	// Edge ids are assigned in order of first appearance (face order, then
+	// corner order); this is the order initial_sharpness is given in. On a
+	// non-manifold edge only the first two half-edges are twinned; the others
+	// still share the edge id but have no twin.
+	struct HalfEdgeMesh
+	{
+		static constexpr std::uint32_t kInvalid = ~0u;
+
+		std::uint32_t cornersPerFace = 4;
+		std::uint32_t vertexCount = 0;
+
+		std::vector<std::uint32_t> heVertex;       // origin vertex, per half-edge
+		std::vector<std::uint32_t> heTwin;         // opposite half-edge or kInvalid
+		std::vector<std::uint32_t> heEdge;         // undirected edge id
+
+		std::vector<std::uint32_t> edgeHalfEdge;   // first half-edge of each edge
+		std::vector<std::uint32_t> vertexHalfEdge; // one outgoing half-edge (a boundary one if any), or kInvalid
+
+		std::uint32_t face_count() const { return std::uint32_t(heVertex.size() / cornersPerFace); }
+		std::uint32_t edge_count() const { return std::uint32_t(edgeHalfEdge.size()); }
+		std::uint32_t halfedge_count() const { return std::uint32_t(heVertex.size()); }
+
+		std::uint32_t face(std::uint32_t aH) const { return aH / cornersPerFace; }
+		std::uint32_t next(std::uint32_t aH) const { return (aH % cornersPerFace + 1 == cornersPerFace) ? aH + 1 - cornersPerFace : aH + 1; }
+		std::uint32_t prev(std::uint32_t aH) const { return (aH % cornersPerFace == 0) ? aH + cornersPerFace - 1 : aH - 1; }
+		std::uint32_t twin(std::uint32_t aH) const { return heTwin[aH]; }
+		std::uint32_t edge(std::uint32_t aH) const { return heEdge[aH]; }
+		std::uint32_t origin(std::uint32_t aH) const { return heVertex[aH]; }
+		std::uint32_t dest(std::uint32_t aH) const { return heVertex[next(aH)]; }
+
+		std::uint32_t const* face_corners(std::uint32_t aF) const { return heVertex.data() + std::size_t(aF) * cornersPerFace; }
+		std::uint32_t const* face_edges(std::uint32_t aF) const { return heEdge.data() + std::size_t(aF) * cornersPerFace; }
+
+		bool is_boundary(std::uint32_t aH) const { return heTwin[aH] == kInvalid; }
+	};
+
+	// Build the connectivity for aCorners (faceCount * aCornersPerFace vertex
+	// ids, taken over as heVertex). Linear time: one counting sort of the
+	// half-edges by their lower endpoint, no hashing.
+	HalfEdgeMesh make_halfedge_mesh(
+		std::vector<std::uint32_t> aCorners,
+		std::uint32_t aCornersPerFace,
+		std::uint32_t aVertexCount
+	);
+
+	// Topology of one Catmull-Clark step, derived directly from the parent in a
+	// single pass over its half-edges: no hashing and no sorting, and every
+	// array is allocated once at its final size. Child numbering matches
+	// drawBuffer.comp:
+	//   - parent vertex v stays v, the edge point of e is V + e and the face
+	//     point of f is V + E + f;
+	//   - parent half-edge h (corner k of face f) becomes child quad h,
+	//     (v_k, edgePoint(k), facePoint, edgePoint(k-1));
+	//   - parent edge e splits into child edges 2e (the half touching
+	//     origin(edgeHalfEdge[e])) and 2e + 1; the edge from the edge point of
+	//     h to the face point is 2E + h.
+	// The child always has quads, whatever the parent's cornersPerFace.
+	HalfEdgeMesh refine_halfedge_mesh(HalfEdgeMesh const& aParent);
+
+	// Index buffers for drawing: every face as a triangle fan (corner 0,1,2 /
+	// 2,3,0 for quads) and every edge once as a line.
+	std::vector<std::uint32_t> triangulate_faces(HalfEdgeMesh const& aMesh);
+	std::vector<std::uint32_t> edge_line_list(HalfEdgeMesh const& aMesh);
+}
@@ -0,0 +1,174 @@
+#include "limit_surface.hpp"
+#include "parallel.hpp"
+#include "stencil_table.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <type_traits>
+
+using namespace labutils;
+
+namespace
+{
+    constexpr float kPi = 3.14159265358979f;
+
+    template< typename tPtr >
+    tPtr strided(tPtr aBase, std::size_t aStride, std::size_t aIndex)
+    {
+        using Byte = std::conditional_t<std::is_const_v<std::remove_pointer_t<tPtr>>, const char, char>;
+        return reinterpret_cast<tPtr>(reinterpret_cast<Byte*>(aBase) + aStride * aIndex);
+    }
+
+    // evaluate_limit() once every edge is smooth
+    void evaluate_smooth_limit(
+        const HalfEdgeMesh& aMesh,
+        const TopologyCSR& aCsr,
+        const glm::vec3* aPoints, std::size_t aPointStride,
+        glm::vec3* aPositions, std::size_t aPositionStride,
+        glm::vec3* aNormals, std::size_t aNormalStride)
+    {
+        const std::vector<std::uint32_t>& vfCounts = *aCsr.vertexFaceCounts;
+        const std::vector<std::uint32_t>& vfIndices = *aCsr.vertexFaceIndices;
+        const std::vector<std::uint32_t>& veCounts = *aCsr.vertexEdgeCounts;
+
+        const std::vector<std::uint32_t> vfStart = csr_offsets(vfCounts);
+
+        auto point = [&](std::uint32_t v) -> const glm::vec3& { return *strided(aPoints, aPointStride, v); };
+
+        parallel_for(aMesh.vertexCount, [&](std::size_t begin, std::size_t end) {
+            for (std::uint32_t v = std::uint32_t(begin); v < end; ++v)
+            {
+                const glm::vec3 p = point(v);
+                const std::uint32_t faceCnt = vfCounts[v], edgeCnt = veCounts[v];
+
+                // smooth interior: walk the ring, e_i = dest(h_i) and f_i the
+                // diagonal of the face between e_i and e_{i+1}
+                glm::vec3 position = p;
+                glm::vec3 normal(0.f);
+                bool ring = faceCnt == edgeCnt && faceCnt >= 3;
+                if (ring)
+                {
+                    const std::uint32_t h0 = aMesh.vertexHalfEdge[v];
+                    const float n = float(faceCnt);
+                    const float cn = std::cos(2.f * kPi / n);
+                    const float an = 1.f + cn + std::cos(kPi / n) * std::sqrt(2.f * (9.f + cn));
+
+                    glm::vec3 sumE(0.f), sumF(0.f), tu(0.f), tv(0.f);
+                    std::uint32_t h = h0;
+                    for (std::uint32_t i = 0; ring && i < faceCnt; ++i)
+                    {
+                        const std::uint32_t t = aMesh.twin(h);
+                        if (t == HalfEdgeMesh::kInvalid || aMesh.origin(t) != aMesh.dest(h))
+                        {
+                            ring = false;
+                            break;
+                        }
+                        const std::uint32_t hn = aMesh.next(t);
+                        const glm::vec3& e = point(aMesh.dest(h));
+                        const glm::vec3& f = point(aMesh.dest(aMesh.next(hn)));
+
+                        const float a0 = 2.f * kPi * float(i) / n, a1 = 2.f * kPi * float(i + 1) / n;
+                        sumE += e;
+                        sumF += f;
+                        tu += an * std::cos(a0) * e + (std::cos(a0) + std::cos(a1)) * f;
+                        tv += an * std::sin(a0) * e + (std::sin(a0) + std::sin(a1)) * f;
+
+                        h = hn;
+                        ring = (h == h0) == (i + 1 == faceCnt);
+                    }
+
+                    if (ring)
+                    {
+                        position = (n * n * p + 4.f * sumE + sumF) / (n * (n + 5.f));
+                        normal = glm::cross(tu, tv);
+
+                        // the walk may go either way round; orient like face(h0)
+                        const glm::vec3 wound = glm::cross(point(aMesh.dest(h0)) - p, point(aMesh.origin(aMesh.prev(h0))) - p);
+                        if (glm::dot(normal, wound) < 0.f)
+                            normal = -normal;
+                    }
+                }
+
+                if (!ring)
+                {
+                    for (std::uint32_t i = vfStart[v]; i < vfStart[v] + faceCnt; ++i)
+                    {
+                        const std::uint32_t* c = aMesh.face_corners(vfIndices[i]);
+                        std::uint32_t k = 0;
+                        while (k < 3 && c[k] != v) ++k;
+                        normal += glm::cross(point(c[(k + 1) & 3]) - p, point(c[(k + 3) & 3]) - p);
+                    }
+                }
+
+                const float len = glm::length(normal);
+                *strided(aPositions, aPositionStride, v) = position;
+                *strided(aNormals, aNormalStride, v) = len > 0.f ? normal / len : glm::vec3(0.f);
+            }
+        }, 1024);
+    }
+}
+
+void labutils::evaluate_limit(
+    const HalfEdgeMesh& aMesh,
+    const std::vector<std::uint32_t>& aSharpness,
+    const TopologyCSR& aCsr,
+    const glm::vec3* aPoints, std::size_t aPointStride,
+    glm::vec3* aPositions, std::size_t aPositionStride,
+    glm::vec3* aNormals, std::size_t aNormalStride)
+{
+    assert(aMesh.cornersPerFace == 4);
+
+    const std::uint32_t steps = aSharpness.empty() ? 0 : *std::max_element(aSharpness.begin(), aSharpness.end());
+    if (steps == 0)
+    {
+        evaluate_smooth_limit(aMesh, aCsr, aPoints, aPointStride, aPositions, aPositionStride, aNormals, aNormalStride);
+        return;
+    }
+
+    // A crease of sharpness s only uses the sharp rules for s more steps, so
+    // no closed form covers it. Refine until every crease has decayed; vertex
+    // v stays vertex v of each child and converges to the same point.
+    HalfEdgeMesh mesh = aMesh;
+    std::vector<std::uint32_t> sharpness = aSharpness;
+    sharpness.resize(mesh.edge_count(), 0);
+    std::vector<glm::vec3> points(aMesh.vertexCount);
+    for (std::uint32_t v = 0; v < aMesh.vertexCount; ++v)
+        points[v] = *strided(aPoints, aPointStride, v);
+
+    std::vector<glm::uvec2> edgeList, edgeFaces;
+    std::vector<std::uint32_t> vfCounts, vfIndices, veCounts, veIndices;
+    const TopologyCSR csr{ &edgeList, &edgeFaces, nullptr, &vfCounts, &vfIndices, &veCounts, &veIndices };
+    for (std::uint32_t l = 0; l < steps; ++l)
+    {
+        build_topology_csr(mesh, csr);
+        const StencilTable step = make_refinement_stencils(mesh, sharpness, csr);
+
+        std::vector<glm::vec3> childPoints(step.row_count());
+        evaluate_stencils(step, points.data(), sizeof(glm::vec3), childPoints.data(), sizeof(glm::vec3));
+
+        // parent edge e splits into child edges 2e and 2e + 1
+        HalfEdgeMesh child = refine_halfedge_mesh(mesh);
+        std::vector<std::uint32_t> childSharpness(child.edge_count(), 0);
+        for (std::uint32_t e = 0; e < mesh.edge_count(); ++e)
+        {
+            const std::uint32_t s = sharpness[e] ? sharpness[e] - 1 : 0;
+            childSharpness[2 * e + 0] = s;
+            childSharpness[2 * e + 1] = s;
+        }
+
+        mesh = std::move(child);
+        points = std::move(childPoints);
+        sharpness = std::move(childSharpness);
+    }
+    build_topology_csr(mesh, csr);
+
+    std::vector<glm::vec3> positions(mesh.vertexCount), normals(mesh.vertexCount);
+    evaluate_smooth_limit(mesh, csr, points.data(), sizeof(glm::vec3),
+        positions.data(), sizeof(glm::vec3), normals.data(), sizeof(glm::vec3));
+
+    for (std::uint32_t v = 0; v < aMesh.vertexCount; ++v)
+    {
+        *strided(aPositions, aPositionStride, v) = positions[v];
+        *strided(aNormals, aNormalStride, v) = normals[v];
+    }
+}
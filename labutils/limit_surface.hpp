@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "halfedge_mesh.hpp"
+#include "mesh_topology.hpp"
+
+
+
+namespace labutils
+{
+	// Catmull-Clark limit positions and normals of every vertex of a quad
+	// mesh, in closed form from each vertex's one-ring, so the last refined
+	// level can be drawn on the surface it converges to:
+	//   - smooth interior vertex of valence n, edge neighbours e_i and face
+	//     diagonals f_i: (n^2 v + 4 sum(e_i) + sum(f_i)) / (n (n + 5)), normal
+	//     from the two limit tangents (the cos/sin weighted sums of the ring);
+	//   - boundary vertices and isolated ones keep their position, and their
+	//     normal is the area-weighted average of the faces around them.
+	// Creases are semi-sharp (sharpness s uses the sharp rules for s more
+	// steps), so with any sharpness left the mesh is first refined until it
+	// has all decayed and the limit is taken there; that costs 4^s times the
+	// faces for the largest s. Normals follow the face winding and are unit
+	// length (zero on isolated vertices).
+	//
+	// aCsr must hold the vertex -> face and vertex -> edge arrays and the edge
+	// list. Results are written with a stride, like evaluate_stencils().
+	void evaluate_limit(
+		HalfEdgeMesh const& aMesh,
+		std::vector<std::uint32_t> const& aSharpness,
+		TopologyCSR const& aCsr,
+		glm::vec3 const* aPoints, std::size_t aPointStride,
+		glm::vec3* aPositions, std::size_t aPositionStride,
+		glm::vec3* aNormals, std::size_t aNormalStride
+	);
+}
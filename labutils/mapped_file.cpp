@@ -0,0 +1,139 @@
+#include "mapped_file.hpp"
+
+#include <utility>
+
+#if defined(_WIN32)
+#   define WIN32_LEAN_AND_MEAN
+#   define NOMINMAX
+#   include <windows.h>
+#else
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+using namespace labutils;
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+MappedFile::MappedFile(MappedFile&& aOther) noexcept
+    : mData(std::exchange(aOther.mData, nullptr))
+    , mSize(std::exchange(aOther.mSize, 0))
+    , mOpen(std::exchange(aOther.mOpen, false))
+#if defined(_WIN32)
+    , mFile(std::exchange(aOther.mFile, nullptr))
+    , mMapping(std::exchange(aOther.mMapping, nullptr))
+#endif
+{}
+
+MappedFile& MappedFile::operator=(MappedFile&& aOther) noexcept
+{
+    std::swap(mData, aOther.mData);
+    std::swap(mSize, aOther.mSize);
+    std::swap(mOpen, aOther.mOpen);
+#if defined(_WIN32)
+    std::swap(mFile, aOther.mFile);
+    std::swap(mMapping, aOther.mMapping);
+#endif
+    return *this;
+}
+
+#if defined(_WIN32)
+
+bool MappedFile::open(const std::string& aPath)
+{
+    close();
+
+    HANDLE file = CreateFileA(aPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size{};
+    if (!GetFileSizeEx(file, &size))
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    mFile = file;
+    mSize = std::size_t(size.QuadPart);
+    mOpen = true;
+    if (mSize == 0)
+        return true;
+
+    mMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mMapping)
+        mData = static_cast<const std::uint8_t*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+    if (!mData)
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::close() noexcept
+{
+    if (mData)
+        UnmapViewOfFile(mData);
+    if (mMapping)
+        CloseHandle(mMapping);
+    if (mFile)
+        CloseHandle(mFile);
+    mData = nullptr;
+    mMapping = mFile = nullptr;
+    mSize = 0;
+    mOpen = false;
+}
+
+#else
+
+bool MappedFile::open(const std::string& aPath)
+{
+    close();
+
+    const int fd = ::open(aPath.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st{};
+    if (::fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    mSize = std::size_t(st.st_size);
+    if (mSize > 0)
+    {
+        void* data = ::mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            ::close(fd);
+            mSize = 0;
+            return false;
+        }
+        mData = static_cast<const std::uint8_t*>(data);
+    }
+
+    // the mapping stays valid without the descriptor
+    ::close(fd);
+    mOpen = true;
+    return true;
+}
+
+void MappedFile::close() noexcept
+{
+    if (mData)
+        ::munmap(const_cast<std::uint8_t*>(mData), mSize);
+    mData = nullptr;
+    mSize = 0;
+    mOpen = false;
+}
+
+#endif
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+
+namespace labutils
+{
+	// A whole file mapped read-only into memory, for binary data that is used
+	// in place instead of being read and parsed. Empty files map to nothing
+	// (data() is null, size() is 0) but still count as open.
+	class MappedFile
+	{
+		public:
+			MappedFile() noexcept = default;
+			~MappedFile();
+
+			MappedFile( MappedFile const& ) = delete;
+			MappedFile& operator= (MappedFile const&) = delete;
+
+			MappedFile( MappedFile&& ) noexcept;
+			MappedFile& operator = (MappedFile&&) noexcept;
+
+			// false if the file does not exist or cannot be mapped
+			bool open( std::string const& aPath );
+			void close() noexcept;
+
+			bool is_open() const { return mOpen; }
+			std::uint8_t const* data() const { return mData; }
+			std::size_t size() const { return mSize; }
+
+		private:
+			std::uint8_t const* mData = nullptr;
+			std::size_t mSize = 0;
+			bool mOpen = false;
+#			if defined(_WIN32)
+			void* mFile = nullptr;      // HANDLE
+			void* mMapping = nullptr;   // HANDLE
+#			endif
+	};
+}
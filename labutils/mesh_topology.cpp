@@ -0,0 +1,76 @@
+#include "mesh_topology.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <cassert>
+
+using namespace labutils;
+
+void labutils::build_topology_csr(const HalfEdgeMesh& aMesh, const TopologyCSR& aOut)
+{
+    const std::uint32_t H = aMesh.halfedge_count();
+    const std::uint32_t E = aMesh.edge_count();
+    const std::uint32_t V = aMesh.vertexCount;
+
+    assert(aOut.edgeList && aOut.edgeToFace);
+    assert(aOut.vertexFaceCounts && aOut.vertexFaceIndices);
+    assert(aOut.vertexEdgeCounts && aOut.vertexEdgeIndices);
+
+    // ---- per edge ----
+    auto& edgeList = *aOut.edgeList;
+    auto& edgeToFace = *aOut.edgeToFace;
+    edgeList.resize(E);
+    edgeToFace.resize(E);
+    parallel_for(E, [&](std::size_t begin, std::size_t end) {
+        for (std::uint32_t e = std::uint32_t(begin); e < end; ++e)
+        {
+            const std::uint32_t h = aMesh.edgeHalfEdge[e];
+            const std::uint32_t a = aMesh.origin(h), b = aMesh.dest(h);
+            edgeList[e] = glm::uvec2(std::min(a, b), std::max(a, b));
+            edgeToFace[e] = glm::uvec2(aMesh.face(h), aMesh.is_boundary(h) ? ~0u : aMesh.face(aMesh.twin(h)));
+        }
+    });
+
+    // The vertex lists below are counting sorts; their scatter order is what
+    // makes the lists come out in face / edge order, so they stay serial.
+
+    if (aOut.faceEdges)
+        std::copy(aMesh.heEdge.begin(), aMesh.heEdge.end(), aOut.faceEdges);
+
+    // ---- vertex -> faces ----
+    auto& vfCounts = *aOut.vertexFaceCounts;
+    auto& vfIndices = *aOut.vertexFaceIndices;
+    vfCounts.assign(V, 0);
+    for (std::uint32_t h = 0; h < H; ++h) ++vfCounts[aMesh.origin(h)];
+
+    {
+        std::vector<std::uint32_t> cursor = csr_offsets(vfCounts);
+        vfIndices.resize(H);
+        for (std::uint32_t h = 0; h < H; ++h)
+            vfIndices[cursor[aMesh.origin(h)]++] = aMesh.face(h);
+    }
+
+    // ---- vertex -> edges ----
+    auto& veCounts = *aOut.vertexEdgeCounts;
+    auto& veIndices = *aOut.vertexEdgeIndices;
+    veCounts.assign(V, 0);
+    for (const auto& e : edgeList) { ++veCounts[e.x]; ++veCounts[e.y]; }
+
+    {
+        std::vector<std::uint32_t> cursor = csr_offsets(veCounts);
+        veIndices.resize(std::size_t(E) * 2);
+        for (std::uint32_t e = 0; e < E; ++e)
+        {
+            veIndices[cursor[edgeList[e].x]++] = e;
+            veIndices[cursor[edgeList[e].y]++] = e;
+        }
+    }
+}
+
+std::vector<std::uint32_t> labutils::csr_offsets(const std::vector<std::uint32_t>& aCounts)
+{
+    std::vector<std::uint32_t> offsets(aCounts.size() + 1);
+    offsets[0] = 0;
+    for (std::size_t i = 0; i < aCounts.size(); ++i)
+        offsets[i + 1] = offsets[i] + aCounts[i];
+    return offsets;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "halfedge_mesh.hpp"
+
+
+
+namespace labutils
+{
+	// Flat (CSR) adjacency arrays in the layout the compute shaders read,
+	// exported from a HalfEdgeMesh in a few linear passes.
+	//
+	// Conventions (shared with the shaders):
+	//   - edge ids are the HalfEdgeMesh edge ids (order of first appearance);
+	//   - edgeList[e] stores (min, max) vertex ids;
+	//   - edgeToFace[e] holds the first two faces using e, ~0u if there is none;
+	//   - faceEdges[f * N + k] is the edge from corner k to corner k+1;
+	//   - vertex -> face lists are in face order, vertex -> edge lists in edge
+	//     id order, each incident edge listed once.
+	struct TopologyCSR
+	{
+		std::vector<glm::uvec2>* edgeList = nullptr;
+		std::vector<glm::uvec2>* edgeToFace = nullptr;
+		std::uint32_t*           faceEdges = nullptr;   // optional, faceCount * N entries, caller allocated
+
+		std::vector<std::uint32_t>* vertexFaceCounts = nullptr;
+		std::vector<std::uint32_t>* vertexFaceIndices = nullptr;
+		std::vector<std::uint32_t>* vertexEdgeCounts = nullptr;
+		std::vector<std::uint32_t>* vertexEdgeIndices = nullptr;
+	};
+
+	void build_topology_csr(HalfEdgeMesh const& aMesh, TopologyCSR const& aOut);
+
+	// Exclusive prefix sum of a CSR count array, with a trailing total.
+	std::vector<std::uint32_t> csr_offsets(std::vector<std::uint32_t> const& aCounts);
+}
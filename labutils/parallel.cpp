@@ -0,0 +1,176 @@
+#include "parallel.hpp"
+#include "cpu_profiler.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace labutils;
+
+namespace
+{
+	// set on pool workers and on a caller while it runs chunks, so a nested
+	// parallel_for() runs inline instead of waiting on the pool it is part of
+	thread_local bool tInsidePool = false;
+
+	// Persistent workers, woken once per run_chunks() call. Every participant
+	// (worker i uses slot i + 1, the caller slot 0) owns a contiguous range of
+	// chunk ids and claims from its front; once it is empty it claims from the
+	// other ranges in turn. Claiming is a fetch_add, so owner and thieves never
+	// take the same chunk.
+	class TaskPool
+	{
+	public:
+		TaskPool()
+		{
+			std::size_t const n = std::thread::hardware_concurrency();
+			mSlotCount = n ? n : 1;
+			mRanges = std::make_unique<Range[]>(mSlotCount);
+
+			mWorkers.reserve(mSlotCount - 1);
+			for (std::size_t i = 1; i < mSlotCount; ++i)
+				mWorkers.emplace_back([this, i] { worker_main(i); });
+		}
+
+		~TaskPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mStop = true;
+			}
+			mWake.notify_all();
+			for (auto& t : mWorkers)
+				t.join();
+		}
+
+		TaskPool(TaskPool const&) = delete;
+		TaskPool& operator=(TaskPool const&) = delete;
+
+		std::size_t slot_count() const { return mSlotCount; }
+
+		void run(std::size_t aChunks, void (*aTask)(void*, std::size_t), void* aContext)
+		{
+			std::lock_guard<std::mutex> submit(mSubmit);
+
+			for (std::size_t s = 0; s < mSlotCount; ++s)
+			{
+				mRanges[s].next.store(aChunks * s / mSlotCount, std::memory_order_relaxed);
+				mRanges[s].end = aChunks * (s + 1) / mSlotCount;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mTask = aTask;
+				mContext = aContext;
+				mError = nullptr;
+				mBusy = mWorkers.size();
+				++mGeneration;
+			}
+			mWake.notify_all();
+
+			tInsidePool = true;
+			drain(0);
+			tInsidePool = false;
+
+			std::unique_lock<std::mutex> lock(mMutex);
+			mDone.wait(lock, [this] { return mBusy == 0; });
+			if (mError)
+				std::rethrow_exception(mError);
+		}
+
+	private:
+		struct alignas(64) Range
+		{
+			std::atomic<std::size_t> next{ 0 };
+			std::size_t end = 0;
+		};
+
+		void drain(std::size_t aSlot)
+		{
+			LUT_PROFILE_ZONE("parallel_for chunks");
+			try
+			{
+				for (std::size_t i = 0; i < mSlotCount; ++i)
+				{
+					Range& r = mRanges[(aSlot + i) % mSlotCount];
+					for (std::size_t c = r.next.fetch_add(1); c < r.end; c = r.next.fetch_add(1))
+						mTask(mContext, c);
+				}
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				if (!mError)
+					mError = std::current_exception();
+			}
+		}
+
+		void worker_main(std::size_t aSlot)
+		{
+			tInsidePool = true;
+			LUT_PROFILE_THREAD_NAME("worker " + std::to_string(aSlot));
+
+			std::uint64_t seen = 0;
+			for (;;)
+			{
+				{
+					std::unique_lock<std::mutex> lock(mMutex);
+					mWake.wait(lock, [&] { return mStop || mGeneration != seen; });
+					if (mStop)
+						return;
+					seen = mGeneration;
+				}
+
+				drain(aSlot);
+
+				std::lock_guard<std::mutex> lock(mMutex);
+				if (--mBusy == 0)
+					mDone.notify_one();
+			}
+		}
+
+		std::size_t mSlotCount = 1;
+		std::unique_ptr<Range[]> mRanges;
+		std::vector<std::thread> mWorkers;
+
+		std::mutex mSubmit;      // one run() at a time
+		std::mutex mMutex;       // everything below
+		std::condition_variable mWake, mDone;
+
+		void (*mTask)(void*, std::size_t) = nullptr;
+		void* mContext = nullptr;
+		std::exception_ptr mError;
+		std::size_t mBusy = 0;
+		std::uint64_t mGeneration = 0;
+		bool mStop = false;
+	};
+
+	TaskPool& task_pool()
+	{
+		static TaskPool pool;
+		return pool;
+	}
+}
+
+std::size_t labutils::worker_count()
+{
+	return task_pool().slot_count();
+}
+
+void labutils::detail::run_chunks(std::size_t aChunks, void (*aTask)(void*, std::size_t), void* aContext)
+{
+	if (tInsidePool)
+	{
+		for (std::size_t c = 0; c < aChunks; ++c)
+			aTask(aContext, c);
+		return;
+	}
+
+	task_pool().run(aChunks, aTask, aContext);
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+
+
+
+namespace labutils
+{
+	// Number of threads parallel_for() runs on, the calling one included.
+	// Never returns 0.
+	std::size_t worker_count();
+
+	namespace detail
+	{
+		// Run aTask(aContext, i) for every i in [0, aChunks) on the shared task
+		// pool. Each thread starts on its own share of the chunks and steals
+		// from the others once it runs dry; the calling thread takes part and
+		// returns once every chunk is done. Calls made from inside a task run
+		// inline. The first exception thrown by a task is rethrown here.
+		void run_chunks(std::size_t aChunks, void (*aTask)(void*, std::size_t), void* aContext);
+	}
+
+	// Split [0, aCount) into contiguous chunks and run aFn(begin, end) on each
+	// chunk from the task pool. There are a few chunks per thread, so a thread
+	// that finishes early picks up work left by a slow one. Small ranges
+	// (< aMinChunk) run inline on the calling thread, so it is safe to use on
+	// tiny meshes. Which thread runs a chunk is not fixed, so aFn must only
+	// write to what its own range owns.
+	template< typename tFn >
+	void parallel_for(std::size_t aCount, tFn&& aFn, std::size_t aMinChunk = 4096)
+	{
+		if (0 == aCount)
+			return;
+
+		constexpr std::size_t kChunksPerWorker = 4;
+		std::size_t chunks = std::min(worker_count() * kChunksPerWorker, (aCount + aMinChunk - 1) / aMinChunk);
+		if (chunks <= 1)
+		{
+			aFn(std::size_t(0), aCount);
+			return;
+		}
+
+		std::size_t const step = (aCount + chunks - 1) / chunks;
+		chunks = (aCount + step - 1) / step;
+
+		struct Context
+		{
+			tFn* fn;
+			std::size_t count;
+			std::size_t step;
+		} context{ &aFn, aCount, step };
+
+		detail::run_chunks(chunks, [](void* aContext, std::size_t aChunk) {
+			Context const& c = *static_cast<Context const*>(aContext);
+			std::size_t const b = aChunk * c.step;
+			(*c.fn)(b, std::min(c.count, b + c.step));
+		}, &context);
+	}
+}
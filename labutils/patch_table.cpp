@@ -0,0 +1,166 @@
+#include "patch_table.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <cassert>
+
+using namespace labutils;
+
+namespace
+{
+    // Row-major slots of the 4x4 grid, per corner k of the face: the corner
+    // itself, its neighbour continuing the edge into corner k (y), its
+    // neighbour continuing the edge out of corner k-1 (w) and the diagonal (z).
+    constexpr std::uint32_t kCornerSlot[4] = { 5, 6, 10, 9 };
+    constexpr std::uint32_t kYSlot[4]      = { 4, 2, 11, 13 };
+    constexpr std::uint32_t kWSlot[4]      = { 1, 7, 14, 8 };
+    constexpr std::uint32_t kZSlot[4]      = { 0, 3, 15, 12 };
+
+    // h -> the next outgoing half-edge around origin(h), or kInvalid on a
+    // boundary or where the neighbour is flipped
+    std::uint32_t rotate(const HalfEdgeMesh& aMesh, std::uint32_t aH)
+    {
+        const std::uint32_t t = aMesh.twin(aH);
+        if (t == HalfEdgeMesh::kInvalid || aMesh.origin(t) != aMesh.dest(aH))
+            return HalfEdgeMesh::kInvalid;
+        return aMesh.next(t);
+    }
+
+    // smooth, interior, valence 4 and consistently oriented around origin(h)
+    bool regular_corner(const HalfEdgeMesh& aMesh, const std::vector<std::uint32_t>& aSharpness, std::uint32_t aH)
+    {
+        std::uint32_t h = aH;
+        for (int i = 0; i < 4; ++i)
+        {
+            if (aSharpness[aMesh.edge(h)] != 0)
+                return false;
+            h = rotate(aMesh, h);
+            if (h == HalfEdgeMesh::kInvalid || (h == aH) != (i == 3))
+                return false;
+        }
+        return true;
+    }
+}
+
+bool labutils::gather_patch_points(
+    const HalfEdgeMesh& aMesh,
+    const std::vector<std::uint32_t>& aSharpness,
+    std::uint32_t aF,
+    std::uint32_t aOut[16])
+{
+    assert(aMesh.cornersPerFace == 4);
+
+    for (std::uint32_t k = 0; k < 4; ++k)
+    {
+        if (!regular_corner(aMesh, aSharpness, 4 * aF + k))
+            return false;
+    }
+
+    for (std::uint32_t k = 0; k < 4; ++k)
+    {
+        // corner c with incoming edge a -> c: the face across it holds y,
+        // the face diagonal to this one holds z and w
+        const std::uint32_t h = 4 * aF + k;
+        const std::uint32_t t = aMesh.twin(aMesh.prev(h));        // c -> a
+        const std::uint32_t t2 = aMesh.twin(aMesh.prev(t));       // c -> y
+
+        aOut[kCornerSlot[k]] = aMesh.origin(h);
+        aOut[kYSlot[k]] = aMesh.origin(aMesh.prev(t));
+        aOut[kZSlot[k]] = aMesh.dest(aMesh.next(t2));
+        aOut[kWSlot[k]] = aMesh.origin(aMesh.prev(t2));
+    }
+    return true;
+}
+
+void labutils::bspline_weights(float aT, float aW[4], float aDW[4])
+{
+    const float s = 1.f - aT;
+    const float t2 = aT * aT;
+    const float t3 = t2 * aT;
+
+    aW[0] = s * s * s / 6.f;
+    aW[1] = (3.f * t3 - 6.f * t2 + 4.f) / 6.f;
+    aW[2] = (-3.f * t3 + 3.f * t2 + 3.f * aT + 1.f) / 6.f;
+    aW[3] = t3 / 6.f;
+
+    if (aDW)
+    {
+        aDW[0] = -0.5f * s * s;
+        aDW[1] = 1.5f * t2 - 2.f * aT;
+        aDW[2] = -1.5f * t2 + aT + 0.5f;
+        aDW[3] = 0.5f * t2;
+    }
+}
+
+glm::vec3 labutils::evaluate_patch(const glm::vec3* aPoints, float aU, float aV)
+{
+    float wu[4], wv[4];
+    bspline_weights(aU, wu);
+    bspline_weights(aV, wv);
+
+    glm::vec3 p(0.f);
+    for (int i = 0; i < 4; ++i)
+    {
+        glm::vec3 row(0.f);
+        for (int j = 0; j < 4; ++j)
+            row += wu[j] * aPoints[4 * i + j];
+        p += wv[i] * row;
+    }
+    return p;
+}
+
+void labutils::tessellate_patches(
+    const PatchTable& aTable,
+    std::uint32_t aLevel,
+    std::vector<glm::vec3>& aPoints,
+    std::vector<std::uint32_t>& aQuads)
+{
+    const std::uint32_t P = aTable.patch_count();
+    assert(aTable.points.size() == std::size_t(P) * 16);
+
+    auto segments = [&](std::uint32_t p) {
+        const std::uint32_t l = aTable.levels[p];
+        return 1u << (aLevel > l ? std::min(aLevel - l, 10u) : 0u);
+    };
+
+    // every patch writes its own slice of both arrays
+    std::vector<std::size_t> pointStart(P + 1), quadStart(P + 1);
+    pointStart[0] = aPoints.size();
+    quadStart[0] = aQuads.size();
+    for (std::uint32_t p = 0; p < P; ++p)
+    {
+        const std::size_t n = segments(p);
+        pointStart[p + 1] = pointStart[p] + (n + 1) * (n + 1);
+        quadStart[p + 1] = quadStart[p] + 4 * n * n;
+    }
+    aPoints.resize(pointStart[P]);
+    aQuads.resize(quadStart[P]);
+
+    parallel_for(P, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t p = begin; p < end; ++p)
+        {
+            const std::uint32_t n = segments(std::uint32_t(p));
+            const glm::vec3* cv = aTable.points.data() + 16 * p;
+            const std::uint32_t base = std::uint32_t(pointStart[p]);
+
+            glm::vec3* out = aPoints.data() + pointStart[p];
+            for (std::uint32_t i = 0; i <= n; ++i)
+            {
+                for (std::uint32_t j = 0; j <= n; ++j)
+                    *out++ = evaluate_patch(cv, float(j) / float(n), float(i) / float(n));
+            }
+
+            std::uint32_t* q = aQuads.data() + quadStart[p];
+            for (std::uint32_t i = 0; i < n; ++i)
+            {
+                for (std::uint32_t j = 0; j < n; ++j)
+                {
+                    const std::uint32_t a = base + i * (n + 1) + j;
+                    *q++ = a;
+                    *q++ = a + 1;
+                    *q++ = a + n + 2;
+                    *q++ = a + n + 1;
+                }
+            }
+        }
+    }, 64);
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "halfedge_mesh.hpp"
+
+
+
+namespace labutils
+{
+	// Bicubic B-spline patches for the regular parts of a quad mesh. On a quad
+	// whose four corners are smooth, interior and of valence 4, Catmull-Clark
+	// converges to the uniform bicubic B-spline over the 4x4 grid of points
+	// around it, so such a face can be evaluated directly instead of refined.
+	//
+	// Control points are stored row-major, 16 per patch: point (i, j) is row i
+	// (v) and column j (u), with the face itself spanning rows/columns 1..2.
+	// u runs from corner 0 to corner 1 of the face and v from corner 0 to
+	// corner 3, so (u, v) = (0, 0) is corner 0 and patches keep the face's
+	// orientation.
+	struct PatchTable
+	{
+		std::vector<glm::vec3>     points;   // 16 per patch
+		std::vector<std::uint32_t> levels;   // refinement level each patch was taken at
+
+		// Filled by refine_adaptive(), to match patch sides across levels: the
+		// ids (AdaptiveLevel::vertexId) of each face's corners 0..3, and every
+		// edge split so far as (end, end, edge point).
+		std::vector<glm::uvec4>    corners;
+		std::vector<glm::uvec3>    splits;
+
+		std::uint32_t patch_count() const { return std::uint32_t(levels.size()); }
+	};
+
+	// Control point ids of face aF of aMesh (a quad mesh), row-major as above.
+	// Returns false, leaving aOut unspecified, if the face is not regular: a
+	// corner is on a boundary, has a valence other than 4, touches an edge with
+	// non-zero sharpness, or the faces around it are not consistently
+	// oriented. Only walks the half-edges around the face's corners.
+	bool gather_patch_points(
+		HalfEdgeMesh const& aMesh,
+		std::vector<std::uint32_t> const& aSharpness,
+		std::uint32_t aF,
+		std::uint32_t aOut[16]
+	);
+
+	// Uniform cubic B-spline basis at t in [0, 1], and optionally its
+	// derivative.
+	void bspline_weights(float aT, float aW[4], float aDW[4] = nullptr);
+
+	// Point on the patch with control points aPoints[0..15] at (u, v).
+	glm::vec3 evaluate_patch(glm::vec3 const* aPoints, float aU, float aV);
+
+	// Every patch of aTable as a grid of quads, appended to aPoints/aQuads
+	// (4 corner ids per quad, same orientation as the face). A patch taken at
+	// level l is split 2^(aLevel - l) times per side, so it matches the
+	// density of uniform refinement to aLevel. Patches do not share points.
+	void tessellate_patches(
+		PatchTable const& aTable,
+		std::uint32_t aLevel,
+		std::vector<glm::vec3>& aPoints,
+		std::vector<std::uint32_t>& aQuads
+	);
+}
@@ -0,0 +1,124 @@
+#include "spatial_hash.hpp"
+#include "parallel.hpp"
+#include <cmath>
+#include <unordered_map>
+
+using namespace labutils;
+
+namespace
+{
+    struct CellKey
+    {
+        std::int64_t x, y, z;
+
+        bool operator==(const CellKey& rhs) const
+        {
+            return x == rhs.x && y == rhs.y && z == rhs.z;
+        }
+    };
+
+    struct CellKeyHash
+    {
+        std::size_t operator()(const CellKey& k) const noexcept
+        {
+            // large primes, as in Teschner et al. "Optimized Spatial Hashing"
+            return std::size_t(k.x * 73856093ll) ^ std::size_t(k.y * 19349663ll) ^ std::size_t(k.z * 83492791ll);
+        }
+    };
+
+    inline const glm::vec3& position_at(const glm::vec3* base, std::size_t stride, std::size_t i)
+    {
+        return *reinterpret_cast<const glm::vec3*>(reinterpret_cast<const std::uint8_t*>(base) + i * stride);
+    }
+
+    inline bool matches(const glm::vec3& a, const glm::vec3& b, float eps, WeldMetric metric)
+    {
+        if (metric == WeldMetric::euclidean)
+            return glm::length(a - b) < eps;
+
+        glm::vec3 d = glm::abs(a - b);
+        return d.x < eps && d.y < eps && d.z < eps;
+    }
+}
+
+std::vector<std::uint32_t> labutils::weld_positions(
+    const glm::vec3* aPositions,
+    std::size_t aCount,
+    std::size_t aStride,
+    float aEps,
+    WeldMetric aMetric)
+{
+    std::vector<std::uint32_t> remap(aCount);
+    if (aCount == 0) return remap;
+
+    // Cell size == eps: two positions closer than eps (in either metric) are
+    // never more than one cell apart on any axis. Division happens in double so
+    // rounding can't push a matching pair two cells apart.
+    const double invCell = 1.0 / double(aEps);
+
+    std::vector<CellKey> cells(aCount);
+    parallel_for(aCount, [&](std::size_t b, std::size_t e) {
+        for (std::size_t i = b; i < e; ++i)
+        {
+            const glm::vec3& p = position_at(aPositions, aStride, i);
+            cells[i] = CellKey{
+                std::int64_t(std::floor(double(p.x) * invCell)),
+                std::int64_t(std::floor(double(p.y) * invCell)),
+                std::int64_t(std::floor(double(p.z) * invCell)) };
+        }
+    });
+
+    // Matching stays serial: whether position i starts a cluster depends on
+    // which earlier positions did, and that order is what makes the remap
+    // identical to the linear scan.
+    // cell -> most recently inserted representative; older ones follow via chain[]
+    std::unordered_map<CellKey, std::uint32_t, CellKeyHash> heads;
+    heads.reserve(aCount);
+    std::vector<std::uint32_t> chain(aCount, UINT32_MAX);
+
+    for (std::size_t i = 0; i < aCount; ++i)
+    {
+        const glm::vec3& p = position_at(aPositions, aStride, i);
+        const CellKey& c = cells[i];
+
+        std::uint32_t hit = UINT32_MAX;
+        for (std::int64_t dz = -1; dz <= 1; ++dz)
+            for (std::int64_t dy = -1; dy <= 1; ++dy)
+                for (std::int64_t dx = -1; dx <= 1; ++dx)
+                {
+                    auto it = heads.find(CellKey{ c.x + dx, c.y + dy, c.z + dz });
+                    if (it == heads.end()) continue;
+
+                    for (std::uint32_t j = it->second; j != UINT32_MAX; j = chain[j])
+                        if (j < hit && matches(p, position_at(aPositions, aStride, j), aEps, aMetric))
+                            hit = j;
+                }
+
+        if (hit == UINT32_MAX)
+        {
+            hit = static_cast<std::uint32_t>(i);
+            auto [it, inserted] = heads.try_emplace(c, hit);
+            if (!inserted)
+            {
+                chain[i] = it->second;
+                it->second = hit;
+            }
+        }
+        remap[i] = hit;
+    }
+
+    return remap;
+}
+
+std::uint32_t labutils::compact_weld_remap(std::vector<std::uint32_t>& aRemap)
+{
+    // representatives always precede the vertices welded to them, so a single
+    // forward pass can rewrite the map in place
+    std::uint32_t unique = 0;
+    for (std::size_t i = 0; i < aRemap.size(); ++i)
+    {
+        const std::uint32_t rep = aRemap[i];
+        aRemap[i] = (rep == i) ? unique++ : aRemap[rep];
+    }
+    return unique;
+}
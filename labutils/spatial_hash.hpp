@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+
+
+namespace labutils
+{
+	enum class WeldMetric
+	{
+		perComponent, // all(|a - b| < eps), same test as glm::epsilonEqual
+		euclidean,    // length(a - b) < eps, same test as pos_equal()
+	};
+
+	// Epsilon-aware vertex welding on a uniform grid with cell size eps.
+	//
+	// Positions are visited in order and each one is compared only against the
+	// representatives stored in its own and the 26 neighbouring cells, so the
+	// expected cost is O(n) instead of the O(n^2) linear scan. Among all matching
+	// representatives the lowest index wins, which is exactly what the old
+	// "scan the unique list front to back" loops returned.
+	//
+	// aStride is the distance in bytes between two consecutive positions, so the
+	// pos member of an interleaved vertex can be passed directly.
+	//
+	// Returns, for every input position, the index of the position it was welded
+	// to (its own index if it starts a new cluster).
+	std::vector<std::uint32_t> weld_positions(
+		glm::vec3 const* aPositions,
+		std::size_t aCount,
+		std::size_t aStride,
+		float aEps,
+		WeldMetric aMetric = WeldMetric::perComponent
+	);
+
+	// Turn the representative map from weld_positions() into a compact
+	// 0..uniqueCount-1 numbering (in order of first appearance). Returns the
+	// number of unique positions.
+	std::uint32_t compact_weld_remap(std::vector<std::uint32_t>& aRemap);
+}
@@ -0,0 +1,289 @@
+#include "stencil_table.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <cassert>
+
+// SSE2 is part of x86-64, so there is nothing to detect at run time
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define LUT_STENCIL_SSE 1
+#    include <emmintrin.h>
+#else
+#    define LUT_STENCIL_SSE 0
+#endif
+
+using namespace labutils;
+
+namespace
+{
+    struct Entry
+    {
+        std::uint32_t index;
+        float         weight;
+    };
+
+    // sort [begin, end) of a row by source index and merge duplicates
+    void merge_row(std::vector<Entry>& row, std::size_t begin)
+    {
+        // refinement rows are short, insertion sort beats std::sort there;
+        // composed rows can have a few hundred entries
+        if (row.size() - begin > 32)
+        {
+            std::sort(row.begin() + begin, row.end(),
+                [](const Entry& a, const Entry& b) { return a.index < b.index; });
+        }
+        else
+        {
+            for (std::size_t i = begin + 1; i < row.size(); ++i)
+            {
+                const Entry en = row[i];
+                std::size_t j = i;
+                for (; j > begin && row[j - 1].index > en.index; --j)
+                    row[j] = row[j - 1];
+                row[j] = en;
+            }
+        }
+
+        std::size_t out = begin;
+        for (std::size_t i = begin; i < row.size(); ++i)
+        {
+            if (out > begin && row[out - 1].index == row[i].index)
+                row[out - 1].weight += row[i].weight;
+            else
+                row[out++] = row[i];
+        }
+        row.resize(out);
+    }
+
+    // Rows are generated block by block on the worker threads (aFn(row, out)
+    // appends the entries of one row) and then packed into a single CSR table.
+    template< typename tFn >
+    StencilTable build_table(std::uint32_t aRowCount, std::uint32_t aSourceCount, tFn&& aFn)
+    {
+        constexpr std::uint32_t kBlockRows = 2048;
+        const std::uint32_t blockCount = (aRowCount + kBlockRows - 1) / kBlockRows;
+
+        std::vector<std::vector<Entry>> blocks(blockCount);
+        std::vector<std::uint32_t> rowSize(aRowCount);
+
+        parallel_for(blockCount, [&](std::size_t b, std::size_t e) {
+            for (std::size_t blk = b; blk < e; ++blk)
+            {
+                auto& out = blocks[blk];
+                out.reserve(std::size_t(kBlockRows) * 16);
+                const std::uint32_t r0 = std::uint32_t(blk) * kBlockRows;
+                const std::uint32_t r1 = std::min(aRowCount, r0 + kBlockRows);
+                for (std::uint32_t r = r0; r < r1; ++r)
+                {
+                    const std::size_t start = out.size();
+                    aFn(r, out);
+                    merge_row(out, start);
+                    rowSize[r] = std::uint32_t(out.size() - start);
+                }
+            }
+        }, 1);
+
+        StencilTable table;
+        table.sourceCount = aSourceCount;
+        table.offsets = csr_offsets(rowSize);
+        table.indices.resize(table.offsets.back());
+        table.weights.resize(table.offsets.back());
+
+        parallel_for(blockCount, [&](std::size_t b, std::size_t e) {
+            for (std::size_t blk = b; blk < e; ++blk)
+            {
+                std::size_t dst = table.offsets[std::uint32_t(blk) * kBlockRows];
+                for (const Entry& en : blocks[blk])
+                {
+                    table.indices[dst] = en.index;
+                    table.weights[dst] = en.weight;
+                    ++dst;
+                }
+            }
+        }, 1);
+
+        return table;
+    }
+}
+
+StencilTable labutils::make_refinement_stencils(
+    const HalfEdgeMesh& aParent,
+    const std::vector<std::uint32_t>& aParentSharpness,
+    const TopologyCSR& aParentCsr)
+{
+    const std::uint32_t N = aParent.cornersPerFace;
+    const std::uint32_t V = aParent.vertexCount;
+    const std::uint32_t E = aParent.edge_count();
+    const std::uint32_t F = aParent.face_count();
+
+    const std::vector<glm::uvec2>& edgeList = *aParentCsr.edgeList;
+    const std::vector<std::uint32_t>& vfCounts = *aParentCsr.vertexFaceCounts;
+    const std::vector<std::uint32_t>& vfIndices = *aParentCsr.vertexFaceIndices;
+    const std::vector<std::uint32_t>& veCounts = *aParentCsr.vertexEdgeCounts;
+    const std::vector<std::uint32_t>& veIndices = *aParentCsr.vertexEdgeIndices;
+    assert(edgeList.size() == E && vfCounts.size() == V && veCounts.size() == V);
+
+    const std::vector<std::uint32_t> vfStart = csr_offsets(vfCounts);
+    const std::vector<std::uint32_t> veStart = csr_offsets(veCounts);
+
+    auto face_point = [&](std::uint32_t f, float w, std::vector<Entry>& out) {
+        const std::uint32_t* c = aParent.face_corners(f);
+        for (std::uint32_t k = 0; k < N; ++k)
+            out.push_back({ c[k], w / float(N) });
+    };
+
+    return build_table(V + E + F, V, [&](std::uint32_t r, std::vector<Entry>& out) {
+        if (r >= V + E)
+        {
+            face_point(r - V - E, 1.f, out);
+            return;
+        }
+
+        if (r >= V)
+        {
+            // sharp: midpoint; smooth: average of midpoint and adjacent face points
+            const std::uint32_t e = r - V;
+            const std::uint32_t h = aParent.edgeHalfEdge[e];
+            const bool smooth = aParentSharpness[e] == 0;
+
+            const float wEnd = smooth ? 0.25f : 0.5f;
+            out.push_back({ aParent.origin(h), wEnd });
+            out.push_back({ aParent.dest(h), wEnd });
+            if (smooth)
+            {
+                const float wFace = aParent.is_boundary(h) ? 0.5f : 0.25f;
+                face_point(aParent.face(h), wFace, out);
+                if (!aParent.is_boundary(h)) face_point(aParent.face(aParent.twin(h)), wFace, out);
+            }
+            return;
+        }
+
+        const std::uint32_t v = r;
+        const std::uint32_t* faces = vfIndices.data() + vfStart[v];
+        const std::uint32_t* edges = veIndices.data() + veStart[v];
+        const std::uint32_t  faceCnt = vfCounts[v], edgeCnt = veCounts[v];
+
+        std::uint32_t sharpCnt = 0, neigh[2] = {};
+        for (std::uint32_t i = 0; i < edgeCnt; ++i)
+        {
+            if (aParentSharpness[edges[i]] == 0) continue;
+            const glm::uvec2 ev = edgeList[edges[i]];
+            if (sharpCnt < 2) neigh[sharpCnt] = (ev.x == v) ? ev.y : ev.x;
+            ++sharpCnt;
+        }
+
+        if (sharpCnt >= 3 || faceCnt == 0)                                   // corner (or isolated)
+        {
+            out.push_back({ v, 1.f });
+        }
+        else if (sharpCnt == 2)                                              // crease
+        {
+            out.push_back({ neigh[0], 1.f / 8.f });
+            out.push_back({ v, 6.f / 8.f });
+            out.push_back({ neigh[1], 1.f / 8.f });
+        }
+        else                                                                 // smooth
+        {
+            // (Q + 2R + (n - 3)S) / n with Q the average face point and R the
+            // average edge midpoint
+            const float n = float(faceCnt);
+            for (std::uint32_t i = 0; i < faceCnt; ++i)
+                face_point(faces[i], 1.f / (n * n), out);
+
+            const float wMid = 2.f / (n * float(edgeCnt)) * 0.5f;
+            for (std::uint32_t i = 0; i < edgeCnt; ++i)
+            {
+                out.push_back({ edgeList[edges[i]].x, wMid });
+                out.push_back({ edgeList[edges[i]].y, wMid });
+            }
+            out.push_back({ v, (n - 3.f) / n });
+        }
+    });
+}
+
+StencilTable labutils::compose_stencils(const StencilTable& aOuter, const StencilTable& aInner)
+{
+    assert(aOuter.sourceCount == aInner.row_count());
+
+    return build_table(aOuter.row_count(), aInner.sourceCount, [&](std::uint32_t r, std::vector<Entry>& out) {
+        // slot[k] = position of source k in the current row; duplicates are
+        // accumulated in place so merge_row() only has to sort
+        thread_local std::vector<std::uint32_t> slot;
+        if (slot.size() < aInner.sourceCount) slot.assign(aInner.sourceCount, ~0u);
+
+        const std::size_t start = out.size();
+        for (std::uint32_t i = aOuter.offsets[r]; i < aOuter.offsets[r + 1]; ++i)
+        {
+            const std::uint32_t mid = aOuter.indices[i];
+            const float         w = aOuter.weights[i];
+            for (std::uint32_t j = aInner.offsets[mid]; j < aInner.offsets[mid + 1]; ++j)
+            {
+                std::uint32_t& at = slot[aInner.indices[j]];
+                if (at == ~0u)
+                {
+                    at = std::uint32_t(out.size());
+                    out.push_back({ aInner.indices[j], 0.f });
+                }
+                out[at].weight += w * aInner.weights[j];
+            }
+        }
+
+        for (std::size_t i = start; i < out.size(); ++i)
+            slot[out[i].index] = ~0u;
+    });
+}
+
+void labutils::evaluate_stencils(
+    const StencilTable& aTable,
+    const glm::vec3* aSource, std::size_t aSourceStride,
+    glm::vec3* aResult, std::size_t aResultStride)
+{
+    const std::uint8_t* src = reinterpret_cast<const std::uint8_t*>(aSource);
+    std::uint8_t* dst = reinterpret_cast<std::uint8_t*>(aResult);
+
+    const std::uint32_t* offsets = aTable.offsets.data();
+    const std::uint32_t* indices = aTable.indices.data();
+    const float*         weights = aTable.weights.data();
+
+#if LUT_STENCIL_SSE
+    // One 16-byte load per source and one multiply-add for all three
+    // coordinates; the fourth lane reads whatever follows pos and is dropped.
+    // That needs 16 readable bytes per source, which an interleaved vertex
+    // has but a tightly packed vec3 array does not (the last one would be
+    // read past the end), hence the stride check.
+    if (aSourceStride >= 4 * sizeof(float))
+    {
+        parallel_for(aTable.row_count(), [&](std::size_t b, std::size_t e) {
+            for (std::size_t r = b; r < e; ++r)
+            {
+                __m128 acc = _mm_setzero_ps();
+                for (std::uint32_t i = offsets[r]; i < offsets[r + 1]; ++i)
+                {
+                    const __m128 p = _mm_loadu_ps(reinterpret_cast<const float*>(src + indices[i] * aSourceStride));
+                    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(weights[i]), p));
+                }
+
+                alignas(16) float out[4];
+                _mm_store_ps(out, acc);
+                *reinterpret_cast<glm::vec3*>(dst + r * aResultStride) = glm::vec3(out[0], out[1], out[2]);
+            }
+        });
+        return;
+    }
+#endif
+
+    parallel_for(aTable.row_count(), [&](std::size_t b, std::size_t e) {
+        for (std::size_t r = b; r < e; ++r)
+        {
+            float x = 0.f, y = 0.f, z = 0.f;
+            for (std::uint32_t i = offsets[r]; i < offsets[r + 1]; ++i)
+            {
+                const float* p = reinterpret_cast<const float*>(src + indices[i] * aSourceStride);
+                const float  w = weights[i];
+                x += w * p[0];
+                y += w * p[1];
+                z += w * p[2];
+            }
+            *reinterpret_cast<glm::vec3*>(dst + r * aResultStride) = glm::vec3(x, y, z);
+        }
+    });
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "halfedge_mesh.hpp"
+#include "mesh_topology.hpp"
+
+
+
+namespace labutils
+{
+	// Sparse linear map from a set of source points to a set of result points:
+	// result[r] = sum(weights[i] * source[indices[i]]) for i in
+	// [offsets[r], offsets[r+1]). Stored as CSR so that it can be uploaded to
+	// the GPU as three flat buffers.
+	//
+	// Subdivision is linear in the control points for a fixed topology and
+	// sharpness set, so one table per level captures it completely; moving the
+	// control points then only needs evaluate_stencils().
+	struct StencilTable
+	{
+		std::uint32_t sourceCount = 0;
+
+		std::vector<std::uint32_t> offsets;   // row_count() + 1 entries
+		std::vector<std::uint32_t> indices;
+		std::vector<float>         weights;
+
+		std::uint32_t row_count() const { return offsets.empty() ? 0 : std::uint32_t(offsets.size() - 1); }
+		std::size_t   byte_size() const
+		{
+			return offsets.size() * sizeof(std::uint32_t) + indices.size() * sizeof(std::uint32_t) + weights.size() * sizeof(float);
+		}
+	};
+
+	// One Catmull-Clark step of aParent, expressed in terms of the parent's
+	// vertices. Rows follow the child numbering of refine_halfedge_mesh():
+	// vertex points, then edge points, then face points. aParentCsr must hold
+	// the parent's edgeList and vertex -> face / vertex -> edge arrays.
+	StencilTable make_refinement_stencils(
+		HalfEdgeMesh const& aParent,
+		std::vector<std::uint32_t> const& aParentSharpness,
+		TopologyCSR const& aParentCsr
+	);
+
+	// aOuter applied after aInner: the result reads aInner's sources and has
+	// aOuter's rows. Duplicate sources in a row are merged.
+	StencilTable compose_stencils(StencilTable const& aOuter, StencilTable const& aInner);
+
+	// Apply aTable to aSource (aTable.sourceCount points) and write
+	// aTable.row_count() points to aResult. Both sides are strided, so the pos
+	// member of an interleaved vertex can be passed directly. Rows are split
+	// across worker threads. With a source stride of at least 16 bytes, each
+	// source point is read as one SSE vector, so 16 bytes from every source
+	// point must be readable (true for the pos member of Vertex).
+	void evaluate_stencils(
+		StencilTable const& aTable,
+		glm::vec3 const* aSource, std::size_t aSourceStride,
+		glm::vec3* aResult, std::size_t aResultStride
+	);
+}
@@ -0,0 +1,379 @@
+#include "topology_cache.hpp"
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <json.hpp>
+
+using namespace labutils;
+
+namespace
+{
+    constexpr char kMagic[8] = { 'S', 'U', 'B', 'D', 'T', 'O', 'P', 'O' };
+    constexpr std::uint32_t kVersion = 2;
+
+    struct FileHeader
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t vertexSize;
+        std::uint64_t key;
+        std::uint32_t levelCount;
+        std::uint32_t reserved;
+    };
+    static_assert(sizeof(FileHeader) == 32);
+
+    struct LevelHeader
+    {
+        std::uint32_t cornersPerFace;
+        std::uint32_t vertexCount;
+        std::uint32_t stencilCount;
+        std::uint32_t reserved;
+    };
+
+    std::size_t padded(std::size_t aBytes)
+    {
+        return (aBytes + 7) & ~std::size_t(7);
+    }
+
+    // 8 bytes at a time, with a final avalanche; only has to tell inputs
+    // apart, not resist anyone
+    std::uint64_t hash_bytes(const std::uint8_t* aData, std::size_t aSize, std::uint64_t aSeed)
+    {
+        constexpr std::uint64_t k1 = 0x9E3779B185EBCA87ull, k2 = 0xC2B2AE3D27D4EB4Full;
+        std::uint64_t h = aSeed ^ (aSize * k1);
+
+        std::size_t i = 0;
+        for (; i + 8 <= aSize; i += 8)
+        {
+            std::uint64_t w;
+            std::memcpy(&w, aData + i, 8);
+            h ^= w * k2;
+            h = ((h << 31) | (h >> 33)) * k1;
+        }
+        std::uint64_t tail = 0;
+        std::memcpy(&tail, aData + i, aSize - i);
+        h ^= tail * k2;
+
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ull;
+        h ^= h >> 33;
+        return h;
+    }
+
+    bool seek(std::FILE* aFile, std::size_t aOffset)
+    {
+#if defined(_WIN32)
+        return _fseeki64(aFile, static_cast<long long>(aOffset), SEEK_SET) == 0;
+#else
+        return fseeko(aFile, static_cast<off_t>(aOffset), SEEK_SET) == 0;
+#endif
+    }
+
+    bool hash_file(const std::string& aPath, std::uint64_t& aHash)
+    {
+        MappedFile file;
+        if (!file.open(aPath))
+            return false;
+        aHash = hash_bytes(file.data(), file.size(), aHash);
+        return true;
+    }
+
+    // Bounds-checked walk over the mapped bytes
+    struct Reader
+    {
+        const std::uint8_t* data;
+        std::size_t size;
+        std::size_t at;
+
+        template< typename tPod >
+        bool read(tPod& aOut)
+        {
+            if (size - at < sizeof(tPod)) return false;
+            std::memcpy(&aOut, data + at, sizeof(tPod));
+            at += padded(sizeof(tPod));
+            return true;
+        }
+
+        template< typename tElem >
+        bool read(std::vector<tElem>& aOut)
+        {
+            std::uint64_t bytes = 0;
+            if (!read(bytes) || bytes % sizeof(tElem) != 0 || size - at < padded(bytes)) return false;
+            aOut.resize(std::size_t(bytes / sizeof(tElem)));
+            if (bytes) std::memcpy(aOut.data(), data + at, std::size_t(bytes));
+            at += padded(std::size_t(bytes));
+            return true;
+        }
+
+        bool skip_array()
+        {
+            std::uint64_t bytes = 0;
+            if (!read(bytes) || size - at < padded(bytes)) return false;
+            at += padded(std::size_t(bytes));
+            return true;
+        }
+    };
+
+    struct Writer
+    {
+        std::FILE* file;
+        bool ok = true;
+
+        void write(const void* aData, std::size_t aBytes)
+        {
+            static constexpr std::uint8_t zeros[8] = {};
+            ok = ok && std::fwrite(aData, 1, aBytes, file) == aBytes;
+            const std::size_t pad = padded(aBytes) - aBytes;
+            ok = ok && std::fwrite(zeros, 1, pad, file) == pad;
+        }
+
+        template< typename tPod >
+        void write(const tPod& aValue)
+        {
+            write(&aValue, sizeof(tPod));
+        }
+
+        template< typename tElem >
+        void write(const std::vector<tElem>& aArray)
+        {
+            const std::uint64_t bytes = aArray.size() * sizeof(tElem);
+            write(bytes);
+            write(aArray.data(), std::size_t(bytes));
+        }
+    };
+
+    // Every array of a level record, in file order
+    template< typename tState, typename tFn >
+    void for_each_level_array(tState& aState, tFn&& aFn)
+    {
+        aFn(aState.quadVertices);
+        aFn(aState.mesh.heVertex);
+        aFn(aState.mesh.heTwin);
+        aFn(aState.mesh.heEdge);
+        aFn(aState.mesh.edgeHalfEdge);
+        aFn(aState.mesh.vertexHalfEdge);
+        aFn(aState.quadIndices);
+        aFn(aState.quadLinelists);
+        aFn(aState.edgeList);
+        aFn(aState.edgeToFace);
+        aFn(aState.sharpness);
+        aFn(aState.vertexFaceCounts);
+        aFn(aState.vertexFaceIndices);
+        aFn(aState.vertexEdgeCounts);
+        aFn(aState.vertexEdgeIndices);
+    }
+    constexpr std::uint32_t kLevelArrays = 16;   // the above, plus the stencils' source counts
+    constexpr std::uint32_t kStencilArrays = 3;
+}
+
+std::uint64_t labutils::hash_model_inputs(const std::string& aGltfPath, std::uint32_t aOptions)
+{
+    MappedFile gltf;
+    if (!gltf.open(aGltfPath))
+        return 0;
+
+    std::uint64_t hash = hash_bytes(gltf.data(), gltf.size(), kVersion ^ (std::uint64_t(aOptions) << 32));
+
+    // a .glb carries its buffer; a .gltf may point to external ones
+    const bool binary = gltf.size() >= 4 && std::memcmp(gltf.data(), "glTF", 4) == 0;
+    if (!binary)
+    {
+        const auto json = nlohmann::json::parse(gltf.data(), gltf.data() + gltf.size(), nullptr, false);
+        if (json.is_discarded())
+            return 0;
+
+        const std::size_t slash = aGltfPath.find_last_of("/\\");
+        const std::string dir = slash == std::string::npos ? std::string() : aGltfPath.substr(0, slash + 1);
+
+        const auto buffers = json.find("buffers");
+        if (buffers != json.end() && buffers->is_array())
+        {
+            for (const auto& buffer : *buffers)
+            {
+                const auto uri = buffer.find("uri");
+                if (uri == buffer.end() || !uri->is_string())
+                    continue;
+                const std::string path = uri->get<std::string>();
+                if (path.rfind("data:", 0) == 0)
+                    continue; // embedded, already hashed with the JSON
+                if (!hash_file(dir + path, hash))
+                    return 0;
+            }
+        }
+    }
+
+    return hash ? hash : 1;
+}
+
+TopologyCache::TopologyCache(std::string aPath, std::uint64_t aKey)
+    : mPath(std::move(aPath))
+    , mKey(aKey)
+{
+    if (mKey != 0)
+        mValid = map();
+}
+
+bool TopologyCache::map()
+{
+    mLevelOffsets.clear();
+    if (!mFile.open(mPath))
+        return false;
+
+    Reader in{ mFile.data(), mFile.size(), 0 };
+    FileHeader header{};
+    if (!in.read(header)
+        || std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0
+        || header.version != kVersion
+        || header.vertexSize != sizeof(Vertex)
+        || header.key != mKey)
+    {
+        mFile.close();
+        return false;
+    }
+
+    mBaseOffset = in.at;
+    if (!in.skip_array() || !in.skip_array() || !in.skip_array())
+    {
+        mFile.close();
+        return false;
+    }
+    mEnd = in.at;
+
+    bool ok = true;
+    for (std::uint32_t l = 0; ok && l < header.levelCount; ++l)
+    {
+        const std::size_t offset = in.at;
+        LevelHeader level{};
+        ok = in.read(level);
+        for (std::uint32_t i = 0; ok && i < kLevelArrays + kStencilArrays * level.stencilCount; ++i)
+            ok = in.skip_array();
+        if (ok)
+        {
+            mLevelOffsets.push_back(offset);
+            mEnd = in.at;
+        }
+    }
+
+    // a truncated file still gives the levels before the cut
+    if (!ok)
+        std::cerr << "[topology cache] " << mPath << " is cut short after " << mLevelOffsets.size() << " levels\n";
+    return true;
+}
+
+bool TopologyCache::read_base(std::vector<Vertex>& aVertices, std::vector<std::uint32_t>& aIndices, std::vector<GltfModel::MeshPart>& aParts) const
+{
+    if (!mValid)
+        return false;
+    Reader in{ mFile.data(), mFile.size(), mBaseOffset };
+    return in.read(aVertices) && in.read(aIndices) && in.read(aParts);
+}
+
+bool TopologyCache::read_level(std::uint32_t aLevel, GltfModel::LevelState& aState) const
+{
+    if (!mValid || aLevel == 0 || aLevel > mLevelOffsets.size())
+        return false;
+
+    Reader in{ mFile.data(), mFile.size(), mLevelOffsets[aLevel - 1] };
+    LevelHeader level{};
+    bool ok = in.read(level);
+    for_each_level_array(aState, [&](auto& aArray) { ok = ok && in.read(aArray); });
+
+    std::vector<std::uint32_t> sourceCounts;
+    ok = ok && in.read(sourceCounts) && sourceCounts.size() == level.stencilCount;
+    aState.levelStencils.resize(level.stencilCount);
+    for (std::uint32_t i = 0; ok && i < level.stencilCount; ++i)
+    {
+        StencilTable& table = aState.levelStencils[i];
+        table.sourceCount = sourceCounts[i];
+        ok = in.read(table.offsets) && in.read(table.indices) && in.read(table.weights);
+    }
+
+    aState.mesh.cornersPerFace = level.cornersPerFace;
+    aState.mesh.vertexCount = level.vertexCount;
+    aState.adaptive = AdaptiveLevel{};
+    aState.patches = PatchTable{};
+    return ok;
+}
+
+bool TopologyCache::write_base(const std::vector<Vertex>& aVertices, const std::vector<std::uint32_t>& aIndices, const std::vector<GltfModel::MeshPart>& aParts)
+{
+    if (mKey == 0)
+        return false;
+
+    mFile.close();
+    mValid = false;
+    mLevelOffsets.clear();
+
+    std::FILE* file = std::fopen(mPath.c_str(), "wb");
+    if (!file)
+    {
+        std::cerr << "[topology cache] cannot write " << mPath << "\n";
+        return false;
+    }
+
+    FileHeader header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.vertexSize = sizeof(Vertex);
+    header.key = mKey;
+
+    Writer out{ file };
+    out.write(header);
+    out.write(aVertices);
+    out.write(aIndices);
+    out.write(aParts);
+    const bool ok = out.ok && std::fclose(file) == 0;
+
+    mValid = ok && map();
+    return mValid;
+}
+
+bool TopologyCache::append_level(const GltfModel::LevelState& aState)
+{
+    if (!mValid)
+        return false;
+
+    const std::uint32_t count = level_count() + 1;
+    mFile.close();
+    mValid = false;
+
+    std::FILE* file = std::fopen(mPath.c_str(), "r+b");
+    if (!file)
+    {
+        std::cerr << "[topology cache] cannot write " << mPath << "\n";
+        return false;
+    }
+
+    // anything past the last complete record (one cut short earlier) is
+    // overwritten
+    Writer out{ file };
+    out.ok = seek(file, mEnd);
+
+    LevelHeader level{};
+    level.cornersPerFace = aState.mesh.cornersPerFace;
+    level.vertexCount = aState.mesh.vertexCount;
+    level.stencilCount = std::uint32_t(aState.levelStencils.size());
+    out.write(level);
+    for_each_level_array(aState, [&](const auto& aArray) { out.write(aArray); });
+    std::vector<std::uint32_t> sourceCounts;
+    for (const StencilTable& table : aState.levelStencils)
+        sourceCounts.push_back(table.sourceCount);
+    out.write(sourceCounts);
+    for (const StencilTable& table : aState.levelStencils)
+    {
+        out.write(table.offsets);
+        out.write(table.indices);
+        out.write(table.weights);
+    }
+
+    // the count goes in last, so an interrupted append leaves a valid file
+    out.ok = out.ok && seek(file, offsetof(FileHeader, levelCount));
+    out.ok = out.ok && std::fwrite(&count, sizeof(count), 1, file) == 1;
+    const bool ok = std::fclose(file) == 0 && out.ok;
+
+    mValid = map();
+    return ok && mValid && level_count() == count;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "gltf_model.hpp"
+#include "mapped_file.hpp"
+
+
+
+namespace labutils
+{
+	// Content hash of a glTF file and every external buffer it references (a
+	// .glb is hashed whole), plus aOptions for load settings that change the
+	// result. 0 if one of the files cannot be read. Crease sharpness is not
+	// part of it: a model loaded from a file has none (only
+	// load_unit_gemometry() sets initial_sharpness), so the levels follow
+	// from the file and the load options alone.
+	std::uint64_t hash_model_inputs(std::string const& aGltfPath, std::uint32_t aOptions = 0);
+
+	// Binary file with the welded base mesh and the uniformly refined levels
+	// of one model, so a warm start skips loading, welding and refinement.
+	//
+	// Layout: a fixed header (magic, format version, sizeof(Vertex), the
+	// hash_model_inputs() key and the number of levels), the base vertices,
+	// triangle indices and mesh parts, then one record per level in order. Every array is a
+	// 64-bit byte count followed by the raw elements, padded to 8 bytes, so
+	// the file is mapped and walked without parsing; arrays are copied out of
+	// the mapping as they are. Levels are appended as they are computed.
+	//
+	// A file whose header does not match is ignored and rewritten by
+	// write_base(). Adaptive state (AdaptiveLevel, PatchTable) is not stored.
+	class TopologyCache
+	{
+		public:
+			TopologyCache( std::string aPath, std::uint64_t aKey );
+
+			// true if the file matched the key when opened
+			bool has_base() const { return mValid; }
+			std::uint32_t level_count() const { return std::uint32_t(mLevelOffsets.size()); }
+
+			bool read_base( std::vector<Vertex>& aVertices, std::vector<std::uint32_t>& aIndices, std::vector<GltfModel::MeshPart>& aParts ) const;
+			// aLevel counts from 1; aLevel <= level_count()
+			bool read_level( std::uint32_t aLevel, GltfModel::LevelState& aState ) const;
+
+			// Starts the file over with this base mesh and no levels.
+			bool write_base( std::vector<Vertex> const& aVertices, std::vector<std::uint32_t> const& aIndices, std::vector<GltfModel::MeshPart> const& aParts );
+			// Appends level level_count() + 1.
+			bool append_level( GltfModel::LevelState const& aState );
+
+		private:
+			// (Re)maps the file and indexes the level records; false if the
+			// header does not match or a record is cut short.
+			bool map();
+
+			std::string mPath;
+			std::uint64_t mKey;
+			MappedFile mFile;
+			bool mValid = false;
+			std::size_t mBaseOffset = 0;
+			std::size_t mEnd = 0;               // just past the last complete record
+			std::vector<std::size_t> mLevelOffsets;
+	};
+}
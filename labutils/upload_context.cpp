@@ -0,0 +1,285 @@
+#include "upload_context.hpp"
+#include "cpu_profiler.hpp"
+#include "error.hpp"
+#include "to_string.hpp"
+#include "vkutil.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+using namespace labutils;
+
+UploadContext::UploadContext(VulkanContext const& aContext, Allocator const& aAllocator, VkDeviceSize aRingBytes, std::uint32_t aBatches)
+    : mDevice(aContext.device)
+    , mQueue(aContext.graphicsQueue)
+    , mAllocator(aAllocator.allocator)
+    , mRingBytes((std::max(aRingBytes, kAlignment) + kAlignment - 1) / kAlignment * kAlignment)
+{
+    mRing = create_buffer(
+        aAllocator,
+        mRingBytes,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT
+    );
+    VmaAllocationInfo info{};
+    vmaGetAllocationInfo(mAllocator, mRing.allocation, &info);
+    mMapped = static_cast<std::byte*>(info.pMappedData);
+
+    mPool = create_command_pool(aContext, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+    mBatches.resize(std::max(aBatches, 1u));
+    for (Batch& batch : mBatches)
+    {
+        batch.cmdBuff = alloc_command_buffer(aContext, mPool.handle);
+        batch.done = create_fence(aContext);
+    }
+}
+
+UploadContext::~UploadContext()
+{
+    // the ring and the command buffers must outlive the copies reading them
+    for (Batch& batch : mBatches)
+    {
+        if (batch.pending)
+            vkWaitForFences(mDevice, 1, &batch.done.handle, VK_TRUE, std::numeric_limits<std::uint64_t>::max());
+    }
+}
+
+void UploadContext::upload(VkBuffer aDst, void const* aData, VkDeviceSize aBytes, VkDeviceSize aDstOffset)
+{
+    auto const* src = static_cast<std::byte const*>(aData);
+    upload_elements(aDst, std::size_t(aBytes), 1, [src](std::byte* aOut, std::size_t aFirst, std::size_t aCount) {
+        std::memcpy(aOut, src + aFirst, aCount);
+    }, aDstOffset);
+}
+
+void UploadContext::fill(VkBuffer aDst, VkDeviceSize aBytes, std::uint32_t aValue, VkDeviceSize aDstOffset)
+{
+    if (aBytes > 0)
+        mFills.push_back(Fill{ aDst, aDstOffset, aBytes, aValue });
+}
+
+void UploadContext::copy(VkBuffer aSrc, VkBuffer aDst, VkDeviceSize aBytes)
+{
+    if (aBytes == 0)
+        return;
+
+    VkBufferCopy region{};
+    region.size = aBytes;
+    mDeviceCopies.push_back(DeviceCopy{ aSrc, aDst, region });
+}
+
+void UploadContext::submit()
+{
+    if (!queued())
+        return;
+
+    LUT_PROFILE_FUNCTION();
+
+    Batch& batch = mBatches[mCurrent];
+    if (batch.pending)
+        wait(batch);
+
+    if (auto const res = vkResetFences(mDevice, 1, &batch.done.handle); VK_SUCCESS != res)
+    {
+        throw Error("Unable to reset upload fence\n"
+            "vkResetFences() returned %s", to_string(res).c_str());
+    }
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (auto const res = vkBeginCommandBuffer(batch.cmdBuff, &beginInfo); VK_SUCCESS != res)
+    {
+        throw Error("Beginning command buffer recording\n"
+            "vkBeginCommandBuffer() returned %s", to_string(res).c_str());
+    }
+
+    // one copy command per destination, with all of its regions
+    std::stable_sort(mCopies.begin(), mCopies.end(), [](Copy const& aA, Copy const& aB) { return aA.dst < aB.dst; });
+    std::vector<VkBufferCopy> regions;
+    for (std::size_t i = 0; i < mCopies.size(); )
+    {
+        regions.clear();
+        std::size_t j = i;
+        for (; j < mCopies.size() && mCopies[j].dst == mCopies[i].dst; ++j)
+            regions.push_back(mCopies[j].region);
+
+        vkCmdCopyBuffer(batch.cmdBuff, mRing.buffer, mCopies[i].dst, std::uint32_t(regions.size()), regions.data());
+        i = j;
+    }
+    for (Fill const& fill : mFills)
+        vkCmdFillBuffer(batch.cmdBuff, fill.dst, fill.offset, fill.bytes, fill.value);
+
+    if (!mDeviceCopies.empty())
+    {
+        VkMemoryBarrier uploaded{};
+        uploaded.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        uploaded.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        uploaded.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(batch.cmdBuff, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &uploaded, 0, nullptr, 0, nullptr);
+
+        for (DeviceCopy const& copy : mDeviceCopies)
+            vkCmdCopyBuffer(batch.cmdBuff, copy.src, copy.dst, 1, &copy.region);
+    }
+
+    // one barrier for every destination; whatever reads them next is later on the same queue
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+        | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT
+        | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(
+        batch.cmdBuff,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+        0,
+        1, &barrier,
+        0, nullptr,
+        0, nullptr
+    );
+
+    if (auto const res = vkEndCommandBuffer(batch.cmdBuff); VK_SUCCESS != res)
+    {
+        throw Error("Ending command buffer recording\n"
+            "vkEndCommandBuffer() returned %s", to_string(res).c_str());
+    }
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &batch.cmdBuff;
+    if (auto const res = vkQueueSubmit(mQueue, 1, &submitInfo, batch.done.handle); VK_SUCCESS != res)
+    {
+        throw Error("Submitting uploads\n"
+            "vkQueueSubmit() returned %s", to_string(res).c_str());
+    }
+
+    batch.ringEnd = mHead;
+    batch.pending = true;
+    mCopies.clear();
+    mFills.clear();
+    mDeviceCopies.clear();
+    mCurrent = (mCurrent + 1) % std::uint32_t(mBatches.size());
+}
+
+void UploadContext::flush()
+{
+    submit();
+
+    // oldest first, so mTail only moves forwards
+    for (std::size_t i = 0; i < mBatches.size(); ++i)
+    {
+        Batch& batch = mBatches[(mCurrent + i) % mBatches.size()];
+        if (batch.pending)
+            wait(batch);
+    }
+}
+
+UploadContext::Span UploadContext::reserve(VkDeviceSize aMaxBytes, VkDeviceSize aStride)
+{
+    if (aStride > mRingBytes)
+    {
+        throw Error("Upload element of %llu bytes does not fit the %llu byte staging ring",
+            static_cast<unsigned long long>(aStride), static_cast<unsigned long long>(mRingBytes));
+    }
+
+    // mHead and mTail only ever grow (positions are taken mod mRingBytes), so
+    // a batch's ringEnd stays comparable with them however long it is pending
+    for (;;)
+    {
+        std::uint64_t start = (mHead + kAlignment - 1) / kAlignment * kAlignment;
+        if (start % mRingBytes + aStride > mRingBytes)
+            start += mRingBytes - start % mRingBytes;   // not even one element before the end: wrap
+
+        VkDeviceSize const pos = start % mRingBytes;
+        VkDeviceSize const used = start - mTail;
+        VkDeviceSize const free = used < mRingBytes ? std::min(mRingBytes - used, mRingBytes - pos) : 0;
+        if (free >= aStride)
+        {
+            VkDeviceSize const bytes = std::min(aMaxBytes, free) / aStride * aStride;
+            mHead = start + bytes;
+            return Span{ mMapped + pos, pos, bytes };
+        }
+
+        // full: make room by waiting for the oldest batch, submitting what
+        // is queued first if nothing else is in flight
+        Batch* oldest = nullptr;
+        for (std::size_t i = 0; i < mBatches.size() && !oldest; ++i)
+        {
+            Batch& batch = mBatches[(mCurrent + i) % mBatches.size()];
+            if (batch.pending)
+                oldest = &batch;
+        }
+        if (oldest)
+            wait(*oldest);
+        else
+            submit();
+    }
+}
+
+void UploadContext::queue_copy(VkBuffer aDst, VkDeviceSize aDstOffset, Span const& aSpan)
+{
+    // no-op on coherent memory
+    vmaFlushAllocation(mAllocator, mRing.allocation, aSpan.offset, aSpan.bytes);
+
+    VkBufferCopy region{};
+    region.srcOffset = aSpan.offset;
+    region.dstOffset = aDstOffset;
+    region.size = aSpan.bytes;
+    mCopies.push_back(Copy{ aDst, region });
+}
+
+void UploadContext::wait(Batch& aBatch)
+{
+    LUT_PROFILE_FUNCTION();
+
+    if (auto const res = vkWaitForFences(mDevice, 1, &aBatch.done.handle, VK_TRUE, std::numeric_limits<std::uint64_t>::max()); VK_SUCCESS != res)
+    {
+        throw Error("Waiting for uploads to complete\n"
+            "vkWaitForFences() returned %s", to_string(res).c_str());
+    }
+
+    aBatch.pending = false;
+    mTail = std::max(mTail, aBatch.ringEnd);
+}
+
+std::byte* UploadContext::mapped(Buffer const& aDst, VkDeviceSize aOffset) const
+{
+    VmaAllocationInfo info{};
+    vmaGetAllocationInfo(mAllocator, aDst.allocation, &info);
+    if (!info.pMappedData)
+        return nullptr;
+
+    VkMemoryPropertyFlags flags = 0;
+    vmaGetAllocationMemoryProperties(mAllocator, aDst.allocation, &flags);
+    if (!(flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+        return nullptr;
+
+    return static_cast<std::byte*>(info.pMappedData) + aOffset;
+}
+
+void UploadContext::flush_mapped(Buffer const& aDst, VkDeviceSize aOffset, VkDeviceSize aBytes) const
+{
+    // no-op on coherent memory; the next submit makes the writes visible
+    vmaFlushAllocation(mAllocator, aDst.allocation, aOffset, aBytes);
+}
+
+bool UploadContext::queued() const noexcept
+{
+    return !mCopies.empty() || !mFills.empty() || !mDeviceCopies.empty();
+}
+
+Buffer labutils::create_device_buffer(Allocator const& aAllocator, VkDeviceSize aSize, VkBufferUsageFlags aUsage)
+{
+    // VMA picks device-local host-visible memory when there is some, and
+    // plain device-local memory (left unmapped) otherwise
+    return create_buffer(
+        aAllocator,
+        aSize,
+        aUsage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_ALLOW_TRANSFER_INSTEAD_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+        VMA_MEMORY_USAGE_AUTO
+    );
+}
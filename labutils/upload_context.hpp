@@ -0,0 +1,178 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <volk/volk.h>
+#include "allocator.hpp"
+#include "vkbuffer.hpp"
+#include "vkobject.hpp"
+#include "vulkan_context.hpp"
+
+
+
+namespace labutils
+{
+	// Host-to-device copies through one persistently mapped staging ring.
+	//
+	// Uploads are written into the ring and queue a copy region into their
+	// destination; submit() records the queued regions (one vkCmdCopyBuffer
+	// per destination buffer) and one barrier that makes them visible to
+	// later transfers, shaders, vertex and index reads, and submits them on
+	// the graphics queue. Batches rotate over aBatches command buffers and
+	// fences made once, so a batch can be filled while the previous one is
+	// still copying.
+	//
+	// Ring space is reused once the batch that reads it is done. When the
+	// ring is full, what is queued is submitted and the oldest batch waited
+	// for, so an upload larger than the ring goes through in chunks and the
+	// ring never has to be as big as a mesh.
+	//
+	// write_elements() skips the ring for buffers that are host visible
+	// (see create_device_buffer()) and writes into them in place.
+	class UploadContext
+	{
+		public:
+			static constexpr VkDeviceSize kDefaultRingBytes = VkDeviceSize(32) << 20;
+			static constexpr VkDeviceSize kAlignment = 16;      // of every chunk in the ring
+
+			UploadContext( VulkanContext const&, Allocator const&, VkDeviceSize aRingBytes = kDefaultRingBytes, std::uint32_t aBatches = 2 );
+			~UploadContext();
+
+			UploadContext( UploadContext const& ) = delete;
+			UploadContext& operator= (UploadContext const&) = delete;
+
+			// aBytes from aData to aDst, starting at aDstOffset.
+			void upload( VkBuffer aDst, void const* aData, VkDeviceSize aBytes, VkDeviceSize aDstOffset = 0 );
+
+			// aCount elements of aStride bytes to aDst, starting at
+			// aDstOffset. aWrite( std::byte* aOut, std::size_t aFirst,
+			// std::size_t aCount ) writes elements [aFirst, aFirst + aCount)
+			// to aOut, which is mapped staging memory: it should be written
+			// in order and never read. It is called once per chunk.
+			template< typename tWrite >
+			void upload_elements( VkBuffer aDst, std::size_t aCount, std::size_t aStride, tWrite&& aWrite, VkDeviceSize aDstOffset = 0 );
+
+			// upload_elements(), except that when aDst's memory is mapped,
+			// aWrite is called once with a pointer into aDst itself. The
+			// memory may be write-combined; the same rules apply.
+			template< typename tWrite >
+			void write_elements( Buffer const& aDst, std::size_t aCount, std::size_t aStride, tWrite&& aWrite, VkDeviceSize aDstOffset = 0 );
+
+			// aBytes of aDst set to aValue (vkCmdFillBuffer, so both are
+			// multiples of 4), with the copies of the next batch.
+			void fill( VkBuffer aDst, VkDeviceSize aBytes, std::uint32_t aValue = 0, VkDeviceSize aDstOffset = 0 );
+
+			// Device-side copy, recorded after every upload and fill of the
+			// same batch, so aSrc may be one of their destinations.
+			void copy( VkBuffer aSrc, VkBuffer aDst, VkDeviceSize aBytes );
+
+			// Submits what was queued, without waiting for it.
+			void submit();
+			// submit() and wait until every batch is done.
+			void flush();
+
+			VkDeviceSize ring_bytes() const noexcept { return mRingBytes; }
+
+		private:
+			struct Span
+			{
+				std::byte* data;
+				VkDeviceSize offset;    // in the ring
+				VkDeviceSize bytes;
+			};
+
+			struct Batch
+			{
+				VkCommandBuffer cmdBuff = VK_NULL_HANDLE;
+				Fence done;
+				std::uint64_t ringEnd = 0;  // mHead when it was submitted
+				bool pending = false;
+			};
+
+			struct Copy
+			{
+				VkBuffer dst;
+				VkBufferCopy region;
+			};
+
+			struct DeviceCopy
+			{
+				VkBuffer src;
+				VkBuffer dst;
+				VkBufferCopy region;
+			};
+
+			struct Fill
+			{
+				VkBuffer dst;
+				VkDeviceSize offset;
+				VkDeviceSize bytes;
+				std::uint32_t value;
+			};
+
+			// Room for at least one element and at most aMaxBytes, a multiple of aStride.
+			Span reserve( VkDeviceSize aMaxBytes, VkDeviceSize aStride );
+			void queue_copy( VkBuffer aDst, VkDeviceSize aDstOffset, Span const& );
+			void wait( Batch& );
+
+			// aDst's mapped memory at aOffset, or null if it is not mapped.
+			std::byte* mapped( Buffer const& aDst, VkDeviceSize aOffset ) const;
+			void flush_mapped( Buffer const& aDst, VkDeviceSize aOffset, VkDeviceSize aBytes ) const;
+			bool queued() const noexcept;
+
+		private:
+			VkDevice mDevice = VK_NULL_HANDLE;
+			VkQueue mQueue = VK_NULL_HANDLE;
+			VmaAllocator mAllocator = VK_NULL_HANDLE;
+
+			Buffer mRing;
+			std::byte* mMapped = nullptr;
+			VkDeviceSize mRingBytes = 0;
+			std::uint64_t mHead = 0;        // bytes ever reserved; mod mRingBytes is the write position
+			std::uint64_t mTail = 0;        // everything before it has been copied
+
+			CommandPool mPool;
+			std::vector<Batch> mBatches;
+			std::uint32_t mCurrent = 0;     // the batch the next submit() uses
+			std::vector<Copy> mCopies;
+			std::vector<Fill> mFills;
+			std::vector<DeviceCopy> mDeviceCopies;
+	};
+
+	// A device-local buffer (with TRANSFER_DST added to aUsage) that is also
+	// mapped where device-local memory can be host visible, as on integrated
+	// GPUs and with resizable BAR; UploadContext::write_elements() then
+	// fills it without a staging copy. Elsewhere it is a plain device buffer.
+	Buffer create_device_buffer( Allocator const&, VkDeviceSize, VkBufferUsageFlags aUsage );
+
+	template< typename tWrite > inline
+	void UploadContext::upload_elements( VkBuffer aDst, std::size_t aCount, std::size_t aStride, tWrite&& aWrite, VkDeviceSize aDstOffset )
+	{
+		for( std::size_t first = 0; first < aCount; )
+		{
+			Span const span = reserve( VkDeviceSize(aCount - first) * aStride, aStride );
+			std::size_t const count = std::size_t(span.bytes / aStride);
+
+			aWrite( span.data, first, count );
+			queue_copy( aDst, aDstOffset + VkDeviceSize(first) * aStride, span );
+			first += count;
+		}
+	}
+
+	template< typename tWrite > inline
+	void UploadContext::write_elements( Buffer const& aDst, std::size_t aCount, std::size_t aStride, tWrite&& aWrite, VkDeviceSize aDstOffset )
+	{
+		if( 0 == aCount )
+			return;
+
+		if( std::byte* out = mapped( aDst, aDstOffset ) )
+		{
+			aWrite( out, std::size_t(0), aCount );
+			flush_mapped( aDst, aDstOffset, VkDeviceSize(aCount) * aStride );
+			return;
+		}
+
+		upload_elements( aDst.buffer, aCount, aStride, std::forward<tWrite>(aWrite), aDstOffset );
+	}
+}
@@ -0,0 +1,170 @@
+#include "view_adaptive.hpp"
+#include "limit_surface.hpp"
+#include "mesh_topology.hpp"
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+
+using namespace labutils;
+
+namespace
+{
+    std::uint64_t edge_key(std::uint32_t aA, std::uint32_t aB)
+    {
+        if (aA > aB) std::swap(aA, aB);
+        return (std::uint64_t(aA) << 32) | aB;
+    }
+}
+
+std::vector<std::uint8_t> labutils::select_by_screen_error(const AdaptiveLevel& aLevel, const ScreenError& aError)
+{
+    const HalfEdgeMesh& mesh = aLevel.mesh;
+    const std::uint32_t F = mesh.face_count();
+
+    std::vector<std::uint8_t> refine(F, 0);
+    if (aLevel.level >= aError.maxLevel)
+        return refine;
+
+    std::vector<glm::vec3> centroid(F);
+    for (std::uint32_t f = 0; f < F; ++f)
+    {
+        const std::uint32_t* c = mesh.face_corners(f);
+        centroid[f] = 0.25f * (aLevel.points[c[0]] + aLevel.points[c[1]] + aLevel.points[c[2]] + aLevel.points[c[3]]);
+    }
+
+    for (std::uint32_t f = 0; f < F; ++f)
+    {
+        if (!aLevel.faceActive[f])
+            continue;
+
+        // outside the frustum if all corners are beyond the same plane
+        std::uint32_t outside[5] = {};
+        for (std::uint32_t k = 0; k < 4; ++k)
+        {
+            const glm::vec4 clip = aError.projCam * glm::vec4(aLevel.points[mesh.face_corners(f)[k]], 1.f);
+            outside[0] += clip.x < -clip.w;
+            outside[1] += clip.x > clip.w;
+            outside[2] += clip.y < -clip.w;
+            outside[3] += clip.y > clip.w;
+            outside[4] += clip.w <= 0.f;
+        }
+        if (std::find(std::begin(outside), std::end(outside), 4u) != std::end(outside))
+            continue;
+
+        float error = 0.f;
+        for (std::uint32_t h = 4 * f; h < 4 * f + 4; ++h)
+        {
+            const std::uint32_t t = mesh.twin(h);
+            if (t == HalfEdgeMesh::kInvalid || aLevel.sharpness[mesh.edge(h)] != 0)
+                continue;
+
+            const glm::vec3& a = aLevel.points[mesh.origin(h)];
+            const glm::vec3& b = aLevel.points[mesh.dest(h)];
+            const glm::vec3 offset = 0.25f * (centroid[f] + centroid[t / 4] - a - b);
+            const float w = (aError.projCam * glm::vec4(0.5f * (a + b), 1.f)).w;
+            error = std::max(error, glm::length(offset) * aError.focalPixels / std::max(w, 1e-4f));
+        }
+        refine[f] = error > aError.tolerance;
+    }
+
+    return refine;
+}
+
+ViewDependentStats labutils::view_dependent_mesh(
+    const AdaptiveLevel& aBase,
+    const ScreenError& aError,
+    std::vector<glm::vec3>& aPoints,
+    std::vector<std::uint32_t>& aQuads)
+{
+    ViewDependentStats stats;
+
+    std::vector<glm::uvec3> splits;
+    std::vector<std::uint32_t> faceIds;     // 4 per drawn face, coarsest level first
+    std::vector<glm::vec3> position;        // by vertex id
+    std::vector<std::uint8_t> used;
+
+    AdaptiveLevel level = aBase;
+    while (level.active_face_count() > 0)
+    {
+        const HalfEdgeMesh& mesh = level.mesh;
+        const std::vector<std::uint8_t> refine = select_by_screen_error(level, aError);
+
+        std::vector<glm::uvec2> edgeList, edgeFaces;
+        std::vector<std::uint32_t> vfCounts, vfIndices, veCounts, veIndices;
+        const TopologyCSR csr{ &edgeList, &edgeFaces, nullptr, &vfCounts, &vfIndices, &veCounts, &veIndices };
+        build_topology_csr(mesh, csr);
+
+        std::vector<glm::vec3> limit(mesh.vertexCount), normals(mesh.vertexCount);
+        evaluate_limit(mesh, level.sharpness, csr,
+            level.points.data(), sizeof(glm::vec3),
+            limit.data(), sizeof(glm::vec3),
+            normals.data(), sizeof(glm::vec3));
+
+        position.resize(level.nextVertexId);
+        used.resize(level.nextVertexId, 0);
+
+        bool anyRefined = false;
+        for (std::uint32_t f = 0; f < mesh.face_count(); ++f)
+        {
+            if (!level.faceActive[f])
+                continue;
+            if (refine[f])
+            {
+                anyRefined = true;
+                continue;
+            }
+
+            for (std::uint32_t k = 0; k < 4; ++k)
+            {
+                const std::uint32_t v = mesh.face_corners(f)[k];
+                const std::uint32_t id = level.vertexId[v];
+                position[id] = limit[v];
+                used[id] = 1;
+                faceIds.push_back(id);
+            }
+            ++stats.faces;
+            stats.deepestLevel = std::max(stats.deepestLevel, level.level);
+        }
+
+        if (!anyRefined)
+            break;
+        level = refine_region(level, refine, &splits);
+    }
+
+    // Move the vertices that lie on an edge of a coarser face onto that edge.
+    // Faces are visited coarsest first, so the ends of an edge are final by
+    // the time its inner points are placed.
+    std::unordered_map<std::uint64_t, std::uint32_t> midpoint;
+    midpoint.reserve(splits.size());
+    for (const glm::uvec3& s : splits)
+        midpoint.emplace(edge_key(s.x, s.y), s.z);
+
+    position.resize(level.nextVertexId);
+    auto straighten = [&](auto&& self, std::uint32_t a, std::uint32_t b) -> void {
+        const auto it = midpoint.find(edge_key(a, b));
+        if (it == midpoint.end())
+            return;
+        const std::uint32_t m = it->second;
+        position[m] = 0.5f * (position[a] + position[b]);
+        self(self, a, m);
+        self(self, m, b);
+    };
+    for (std::size_t i = 0; i < faceIds.size(); i += 4)
+    {
+        for (std::uint32_t k = 0; k < 4; ++k)
+            straighten(straighten, faceIds[i + k], faceIds[i + ((k + 1) & 3)]);
+    }
+
+    std::vector<std::uint32_t> remap(used.size(), HalfEdgeMesh::kInvalid);
+    for (const std::uint32_t id : faceIds)
+    {
+        if (remap[id] == HalfEdgeMesh::kInvalid)
+        {
+            remap[id] = std::uint32_t(aPoints.size());
+            aPoints.push_back(position[id]);
+        }
+        aQuads.push_back(remap[id]);
+    }
+
+    return stats;
+}
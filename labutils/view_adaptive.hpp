@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "adaptive_refine.hpp"
+
+
+
+namespace labutils
+{
+	// How far one more Catmull-Clark step would move a face, in pixels.
+	// A smooth edge point sits (c0 + c1 - a - b) / 4 away from the midpoint of
+	// edge ab (c0, c1 the centroids of its faces), which folds both the size
+	// of the face and the curvature around it into one distance; it is
+	// projected at the depth of the edge. Sharp and boundary edges split at
+	// their midpoint and do not count.
+	struct ScreenError
+	{
+		glm::mat4 projCam{ 1.f };
+		float focalPixels = 1.f;        // pixels per unit at distance 1: viewport height * projection[1][1] / 2
+		float tolerance = 1.f;          // pixels; faces below it are not refined
+		std::uint32_t maxLevel = 6;     // stop refining at this level regardless
+	};
+
+	// 1 for every active face of aLevel whose error exceeds the tolerance and
+	// that is at least partly inside the view frustum.
+	std::vector<std::uint8_t> select_by_screen_error(AdaptiveLevel const& aLevel, ScreenError const& aError);
+
+	struct ViewDependentStats
+	{
+		std::uint32_t faces = 0;
+		std::uint32_t deepestLevel = 0;
+	};
+
+	// Refines aBase (a whole level, see make_adaptive_level()) face by face
+	// until every face is below the screen error, and returns the faces to
+	// draw: each one at the level it stopped at, with its corners on the limit
+	// surface (see evaluate_limit()), so a vertex shared by faces of different
+	// levels is at the same place for all of them. Where a coarser face meets
+	// finer ones, the finer vertices along the shared edge are moved onto the
+	// straight coarse edge, so the levels meet without cracks.
+	ViewDependentStats view_dependent_mesh(
+		AdaptiveLevel const& aBase,
+		ScreenError const& aError,
+		std::vector<glm::vec3>& aPoints,
+		std::vector<std::uint32_t>& aQuads
+	);
+}
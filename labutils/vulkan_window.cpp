@@ -641,8 +641,13 @@ namespace
 			queueInfo.pQueuePriorities = queuePriorities;
 		}
 
+		VkPhysicalDeviceFeatures supported{};
+		vkGetPhysicalDeviceFeatures(aPhysicalDev, &supported);
+
 		VkPhysicalDeviceFeatures deviceFeatures{};
 		deviceFeatures.fillModeNonSolid = VK_TRUE;
+		// optional; the patch pipeline checks for it before it is created
+		deviceFeatures.tessellationShader = supported.tessellationShader;
 
 		VkDeviceCreateInfo deviceInfo{};
 		deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -62,6 +62,17 @@ workspace "COMP5892M-vulkan"
 	defines { "SOLUTION_CODE=1" }
 	glslcOptions = glslcOptions .. " -DSOLUTION_CODE"
 
+-- Keep the CPU profiling zones (labutils/cpu_profiler.hpp) in release builds
+newoption {
+	trigger = "profiling",
+	description = "Compile the CPU profiling zones into every configuration"
+}
+
+filter "options:profiling"
+	defines { "LUT_PROFILING=1" }
+
+filter "*"
+
 -- Third party dependencies
 include "third_party" 
 
@@ -102,7 +113,9 @@ project "exercise4-shaders"
 	local shaders = { 
 		"exercise4/shaders/*.vert",
 		"exercise4/shaders/*.frag",
-		"exercise4/shaders/*.comp"
+		"exercise4/shaders/*.comp",
+		"exercise4/shaders/*.tesc",
+		"exercise4/shaders/*.tese"
 	}
 
 	kind "Utility"
@@ -134,6 +147,20 @@ project "labutils"
         "third_party/tinygltf/stb_image_write.h"
     }
 
+-- weld_positions() against the O(n^2) scan it replaced; run from the
+-- repository root, returns non-zero on a mismatch
+project "test-weld"
+	kind "ConsoleApp"
+	location "tests"
+
+	files "tests/weld_positions.cpp"
+
+	includedirs { "third_party/tinygltf" }
+
+	links "labutils"
+
+	dependson "x-glm"
+
 project()
 
 --EOF
@@ -0,0 +1,279 @@
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <algorithm>
+#include <exception>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <filesystem>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/epsilon.hpp>
+
+#include "../labutils/gltf_view.hpp"
+#include "../labutils/spatial_hash.hpp"
+namespace lut = labutils;
+
+// weld_positions() + compact_weld_remap() against the linear scans they
+// replaced: for every input, the remap and the number of unique positions
+// have to be identical. Run from the repository root (the bundled models
+// are read from assets/exercise4/models); returns non-zero on a mismatch.
+
+namespace
+{
+	constexpr char const* kModelDir = "assets/exercise4/models";
+
+	// weldVertices() before the grid: every position is compared against the
+	// unique list front to back with glm::epsilonEqual and joins the first hit.
+	std::vector<std::uint32_t> scan_per_component( std::vector<glm::vec3> const& aPositions, float aEps, std::uint32_t& aUnique )
+	{
+		std::vector<glm::vec3> unique;
+		std::vector<std::uint32_t> remap( aPositions.size() );
+
+		for( std::size_t i = 0; i < aPositions.size(); ++i )
+		{
+			std::uint32_t hit = UINT32_MAX;
+			for( std::uint32_t j = 0; j < unique.size(); ++j )
+			{
+				if( glm::all( glm::epsilonEqual( aPositions[i], unique[j], aEps ) ) )
+				{
+					hit = j;
+					break;
+				}
+			}
+
+			if( UINT32_MAX == hit )
+			{
+				hit = std::uint32_t(unique.size());
+				unique.push_back( aPositions[i] );
+			}
+			remap[i] = hit;
+		}
+
+		aUnique = std::uint32_t(unique.size());
+		return remap;
+	}
+
+	// The same scan with the euclidean test of WeldMetric::euclidean.
+	std::vector<std::uint32_t> scan_euclidean( std::vector<glm::vec3> const& aPositions, float aEps, std::uint32_t& aUnique )
+	{
+		std::vector<glm::vec3> unique;
+		std::vector<std::uint32_t> remap( aPositions.size() );
+
+		for( std::size_t i = 0; i < aPositions.size(); ++i )
+		{
+			std::uint32_t hit = UINT32_MAX;
+			for( std::uint32_t j = 0; j < unique.size() && UINT32_MAX == hit; ++j )
+			{
+				if( glm::length( aPositions[i] - unique[j] ) < aEps )
+					hit = j;
+			}
+
+			if( UINT32_MAX == hit )
+			{
+				hit = std::uint32_t(unique.size());
+				unique.push_back( aPositions[i] );
+			}
+			remap[i] = hit;
+		}
+
+		aUnique = std::uint32_t(unique.size());
+		return remap;
+	}
+
+	int gCases = 0;
+	int gFailures = 0;
+
+	void check( std::string const& aName, std::vector<glm::vec3> const& aPositions, float aEps, lut::WeldMetric aMetric = lut::WeldMetric::perComponent )
+	{
+		++gCases;
+
+		std::uint32_t expectedUnique = 0;
+		std::vector<std::uint32_t> const expected = lut::WeldMetric::perComponent == aMetric
+			? scan_per_component( aPositions, aEps, expectedUnique )
+			: scan_euclidean( aPositions, aEps, expectedUnique );
+
+		std::vector<std::uint32_t> remap = lut::weld_positions( aPositions.data(), aPositions.size(), sizeof(glm::vec3), aEps, aMetric );
+		std::uint32_t const unique = lut::compact_weld_remap( remap );
+
+		if( unique != expectedUnique )
+		{
+			std::fprintf( stderr, "FAIL %s: %u unique positions, expected %u\n", aName.c_str(), unique, expectedUnique );
+			++gFailures;
+			return;
+		}
+
+		for( std::size_t i = 0; i < remap.size(); ++i )
+		{
+			if( remap[i] != expected[i] )
+			{
+				std::fprintf( stderr, "FAIL %s: position %zu welded to %u, expected %u\n", aName.c_str(), i, remap[i], expected[i] );
+				++gFailures;
+				return;
+			}
+		}
+
+		std::printf( "ok   %s (%zu positions, %u unique)\n", aName.c_str(), aPositions.size(), unique );
+	}
+
+	void check_both( std::string const& aName, std::vector<glm::vec3> const& aPositions, float aEps )
+	{
+		check( aName, aPositions, aEps, lut::WeldMetric::perComponent );
+		check( aName + " (euclidean)", aPositions, aEps, lut::WeldMetric::euclidean );
+	}
+
+	// Points spaced just under aEps along aDir from aStart, so each one is
+	// within aEps of its neighbours but not of the ones after those.
+	std::vector<glm::vec3> chain( glm::vec3 aStart, glm::vec3 aDir, float aEps, int aCount )
+	{
+		std::vector<glm::vec3> ret;
+		for( int i = 0; i < aCount; ++i )
+			ret.push_back( aStart + aDir * (0.9f * aEps * float(i)) );
+		return ret;
+	}
+
+	// Points on grid cell boundaries (multiples of aEps), just either side of
+	// them, and aEps apart exactly, which must not weld.
+	std::vector<glm::vec3> cell_boundaries( float aEps )
+	{
+		std::vector<glm::vec3> ret;
+		for( int k = -3; k <= 3; ++k )
+		{
+			float const b = float(k) * aEps;
+			float const lo = std::nextafter( b, -1e30f );
+			float const hi = std::nextafter( b, 1e30f );
+			for( float x : { b, lo, hi } )
+			{
+				ret.emplace_back( x, 0.f, 0.f );
+				ret.emplace_back( x, b, -b );
+				ret.emplace_back( b + 0.5f * aEps, x, x );
+			}
+		}
+		return ret;
+	}
+
+	// Clusters of jittered copies around random centres on both sides of the
+	// origin; the jitter is up to twice aEps, so some copies weld and some not.
+	std::vector<glm::vec3> clusters( float aEps, float aExtent, unsigned aSeed )
+	{
+		std::mt19937 rng( aSeed );
+		std::uniform_real_distribution<float> centre( -aExtent, aExtent );
+		std::uniform_real_distribution<float> jitter( -2.f * aEps, 2.f * aEps );
+
+		std::vector<glm::vec3> ret;
+		for( int c = 0; c < 300; ++c )
+		{
+			glm::vec3 const p( centre( rng ), centre( rng ), centre( rng ) );
+			for( int k = 0; k < 6; ++k )
+				ret.push_back( p + glm::vec3( jitter( rng ), jitter( rng ), jitter( rng ) ) );
+			ret.push_back( p );
+		}
+		std::shuffle( ret.begin(), ret.end(), rng );
+		return ret;
+	}
+
+	// POSITION of every primitive of every mesh in the file, as stored (no
+	// node transforms), one list per primitive.
+	std::vector<std::vector<glm::vec3>> read_primitives( std::string const& aPath )
+	{
+		std::vector<std::vector<glm::vec3>> ret;
+
+		lut::GltfView view;
+		if( !view.open( aPath ) )
+			return ret;
+
+		auto const& json = view.json();
+		auto const meshes = json.find( "meshes" );
+		if( meshes == json.end() )
+			return ret;
+
+		for( auto const& mesh : *meshes )
+		{
+			auto const prims = mesh.find( "primitives" );
+			if( prims == mesh.end() )
+				continue;
+
+			for( auto const& prim : *prims )
+			{
+				auto const attribs = prim.find( "attributes" );
+				if( attribs == prim.end() || !attribs->contains( "POSITION" ) )
+					continue;
+
+				lut::GltfView::Accessor acc;
+				if( !view.accessor( (*attribs)["POSITION"].get<int>(), acc ) || acc.components != 3 )
+					continue;
+
+				std::vector<glm::vec3> positions( acc.count );
+				if( lut::read_floats( acc, &positions[0].x, sizeof(glm::vec3) ) )
+					ret.emplace_back( std::move( positions ) );
+			}
+		}
+
+		return ret;
+	}
+}
+
+int main() try
+{
+	// the tolerances of weldVertices() and preprocessForSubdivision()
+	float const kWeldEps = 1e-5f;
+	float const kPreprocessEps = 1e-6f;
+
+	for( float eps : { kWeldEps, kPreprocessEps, 0.25f } )
+	{
+		std::string const tag = " eps=" + std::to_string( eps );
+
+		check_both( "chain x" + tag, chain( glm::vec3( 0.f ), glm::vec3( 1.f, 0.f, 0.f ), eps, 50 ), eps );
+		check_both( "chain diagonal" + tag, chain( glm::vec3( 0.3f * eps ), glm::normalize( glm::vec3( 1.f, 1.f, 1.f ) ), eps, 50 ), eps );
+		check_both( "chain negative" + tag, chain( glm::vec3( -2.f, -1.f, -3.f ), glm::vec3( -1.f, 0.f, 0.f ), eps, 50 ), eps );
+		check_both( "chain across 0" + tag, chain( glm::vec3( -20.f * eps, 0.f, -eps ), glm::vec3( 0.f, 0.f, 1.f ), eps, 50 ), eps );
+		check_both( "cell boundaries" + tag, cell_boundaries( eps ), eps );
+		check_both( "clusters near 0" + tag, clusters( eps, 100.f * eps, 1 ), eps );
+		check_both( "clusters negative" + tag, clusters( eps, 1.f, 2 ), eps );
+	}
+
+	std::error_code ec;
+	std::vector<std::filesystem::path> scenes;
+	for( auto const& entry : std::filesystem::recursive_directory_iterator( kModelDir, ec ) )
+	{
+		auto const ext = entry.path().extension();
+		if( ".gltf" == ext || ".glb" == ext )
+			scenes.push_back( entry.path() );
+	}
+	std::sort( scenes.begin(), scenes.end() );
+	if( scenes.empty() )
+	{
+		std::fprintf( stderr, "FAIL no models under '%s'; run from the repository root\n", kModelDir );
+		++gFailures;
+	}
+
+	for( auto const& scene : scenes )
+	{
+		auto const prims = read_primitives( scene.string() );
+		if( prims.empty() )
+		{
+			std::fprintf( stderr, "FAIL %s: no positions read\n", scene.string().c_str() );
+			++gFailures;
+			continue;
+		}
+
+		// each primitive on its own, and all of them together (--weld-parts)
+		std::vector<glm::vec3> all;
+		for( std::size_t i = 0; i < prims.size(); ++i )
+		{
+			if( prims.size() > 1 )
+				check( scene.string() + " primitive " + std::to_string( i ), prims[i], kWeldEps );
+			all.insert( all.end(), prims[i].begin(), prims[i].end() );
+		}
+		check( scene.string(), all, kWeldEps );
+	}
+
+	std::printf( "%d of %d cases passed\n", gCases - gFailures, gCases );
+	return 0 == gFailures ? 0 : 1;
+}
+catch( std::exception const& eErr )
+{
+	std::fprintf( stderr, "Error: %s\n", eErr.what() );
+	return 1;
+}